@@ -0,0 +1,378 @@
+/*
+This is the source file of stream_tlaster_tb, the Verilator testbench of the module stream_tlaster of the XADC tutorial.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The testbench drives stream_tlaster (../stream_tlaster.v) simulated by Verilator; see ../README.md for the build
+ * command. The parameters of the module are passed to the testbench as the macros TID_IN_TDATA, CHUNK_SIZE and
+ * FIFO_DEPTH_LOG2, which must match the -G options of the Verilator build.
+ *
+ * Usage: stream_tlaster_tb [-n <runs>] [-s <seed>]
+ *
+ * Each run starts a capture of a random number of samples. The source model is an AXI-Stream master, which holds
+ * its sample till the handshake; the sink model stands for the AXI DMA. The runs of each pattern of tvalid and tready
+ * check on every clock cycle that:
+ * - m_axis_tvalid, m_axis_tdata and m_axis_tlast don't change while m_axis_tvalid is high and m_axis_tready low,
+ * - the sink gets the first count samples the source handed over after the start, in order; a sample may be missing
+ *   only when the FIFO of the module overflowed,
+ * - m_axis_tlast is high on the count-th sample and on every CHUNK_SIZE-th sample (counting the missing samples too),
+ *   and on no other sample, so the chunk with missing samples is shorter,
+ * - m_axis_tvalid stays low between the captures.
+ * The throughput pattern (tvalid and tready always high) also checks that the module passes a sample per clock cycle.
+ * For each pattern, the samples per clock cycle are measured from the first to the last handshake of each capture,
+ * and they must reach RATE_GATE of the ideal rate: the lower of the rate of the source and the duty cycle of
+ * m_axis_tready (the module must never be the bottleneck).
+ * The throughput pattern and the XADC pattern, whose sink pauses after each TLAST like the AXI DMA set up for
+ * the next chunk, must not lose any sample. The overflow pattern pauses the sink for longer than the FIFO can hold.
+ * The tool returns 1 when a check failed. */
+#include "Vstream_tlaster.h"
+#include "verilated.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#ifndef TID_IN_TDATA
+#define TID_IN_TDATA 0
+#endif
+#ifndef CHUNK_SIZE
+#define CHUNK_SIZE 0
+#endif
+#ifndef FIFO_DEPTH_LOG2
+#define FIFO_DEPTH_LOG2 8
+#endif
+#define FIFO_DEPTH ( 1u << FIFO_DEPTH_LOG2 )
+
+#define DEFAULT_RUNS     200
+#define DEFAULT_SEED     1
+#define MAX_COUNT        ( CHUNK_SIZE ? 3 * CHUNK_SIZE + 7 : 1000 ) // The highest count of a run
+#define START_LATENCY    3    // Clock cycles from the start pulse till the first transfer on the m_axis interface
+#define XADC_PERIOD      104  // Clock cycles per sample of the XADC at 1 Msps
+#define DMA_REARM_CYCLES 40   // Clock cycles of low tready after each TLAST in the DMA-like pattern
+#define SINK_READY_BACKPRESSURE 50 // Percentage of the clock cycles the sink is ready in the backpressure pattern
+#define SOURCE_VALID_RANDOM     30 // Percentage of the clock cycles the source gets a new sample in the random pattern
+#define SINK_READY_RANDOM       70 // Percentage of the clock cycles the sink is ready in the random pattern
+#define RATE_GATE        0.95 // Min. ratio of the measured samples per clock cycle to the ideal rate
+/* Clock cycles of low tready at the start and after each TLAST in the overflow pattern: more than the FIFO holds,
+ * but less than a chunk. When the sink isn't ready for a whole chunk, the TLAST of the chunk can't get into the full
+ * FIFO, and the chunk merges with the next one. */
+#define OVERFLOW_STALL   ( CHUNK_SIZE == 0 ? 2 * FIFO_DEPTH : ( FIFO_DEPTH + CHUNK_SIZE ) / 2 )
+#define OVERFLOW_PATTERN ( CHUNK_SIZE == 0 || CHUNK_SIZE > FIFO_DEPTH + 1 ) // The overflow pattern is possible
+
+// Patterns of the tvalid of the source and the tready of the sink
+enum class Pattern {
+	Throughput,  // Both always high
+	Backpressure,// The source always valid, the sink ready at random
+	Random,      // Both at random
+	XadcDma,     // A sample per XADC_PERIOD, the sink not ready for a while after each TLAST (like the AXI DMA re-armed by the CPU)
+	Overflow     // The source always valid, the sink not ready for OVERFLOW_STALL cycles at the start and after each TLAST
+};
+
+static const char *PatternName( Pattern P )
+{
+	switch( P ) {
+		case Pattern::Throughput:   return "throughput";
+		case Pattern::Backpressure: return "backpressure";
+		case Pattern::Random:       return "random";
+		case Pattern::XadcDma:      return "XADC and DMA";
+		case Pattern::Overflow:     return "overflow";
+	}
+	return "";
+} // PatternName
+
+// Samples per clock cycle the source of the pattern offers
+static double SourceRate( Pattern P )
+{
+	switch( P ) {
+		case Pattern::Random:  return SOURCE_VALID_RANDOM / 100.0;
+		case Pattern::XadcDma: return 1.0 / XADC_PERIOD;
+		default:               return 1.0;
+	}
+} // SourceRate
+
+class Testbench {
+public:
+	Testbench( uint32_t Seed ) : Context( new VerilatedContext ), Dut( new Vstream_tlaster( Context.get() ) ), Random( Seed ) {}
+
+	// Perform a capture of Count samples; returns the number of failed checks
+	uint32_t Run( Pattern P, uint32_t Count );
+
+	// Counters of the runs of a pattern; the caller zeroes them
+	uint64_t Lost        = 0; // Samples of the captures, which the sink didn't get
+	uint64_t Beats       = 0; // Samples delivered to the sink
+	uint64_t Cycles      = 0; // Clock cycles from the first till the last handshake of each capture
+	uint64_t ReadyCycles = 0; // Clock cycles of these with m_axis_tready high
+
+private:
+	std::unique_ptr<VerilatedContext> Context;
+	std::unique_ptr<Vstream_tlaster>  Dut;
+	std::mt19937 Random;
+
+	uint32_t NextSample   = 0;     // Sequence number of the sample the source presents
+	bool     SourceValid  = false; // The source presents NextSample
+	uint32_t SinceSample  = 0;     // Clock cycles since the last sample of the XadcDma pattern
+	uint32_t SinkStall    = 0;     // Clock cycles the sink stays not ready in the XadcDma and Overflow patterns
+	bool     PrevStalled  = false; // m_axis_tvalid was high and m_axis_tready low in the previous clock cycle
+	uint64_t PrevData     = 0;
+	bool     PrevLast     = false;
+
+	bool Chance( uint32_t Percent ) { return Random() % 100 < Percent; }
+
+	// The word the module must put on m_axis_tdata for the sample with the sequence number n
+	static uint64_t ExpectedWord( uint32_t n )
+	{
+		const uint64_t Sample = n & 0xFFFF;
+		return TID_IN_TDATA ? ( uint64_t( n % 32 ) << 16 ) | Sample : Sample;
+	}
+
+	void DriveInputs( Pattern P, bool Start );
+	void Step() { Dut->clk = 1; Dut->eval(); Dut->clk = 0; Dut->eval(); }
+};
+
+// Set the inputs of the module for the next rising edge of the clock
+void Testbench::DriveInputs( Pattern P, bool Start )
+{
+	if( !SourceValid ) { // A source of AXI-Stream must hold its sample till the handshake
+		switch( P ) {
+			case Pattern::Throughput:
+			case Pattern::Backpressure:
+			case Pattern::Overflow:
+				SourceValid = true;
+				break;
+			case Pattern::Random:
+				SourceValid = Chance( SOURCE_VALID_RANDOM );
+				break;
+			case Pattern::XadcDma:
+				SourceValid = ++SinceSample >= XADC_PERIOD;
+				if( SourceValid )
+					SinceSample = 0;
+				break;
+		}
+	}
+	Dut->s_axis_tvalid = SourceValid;
+	Dut->s_axis_tdata  = NextSample & 0xFFFF;
+	Dut->s_axis_tid    = NextSample % 32;
+	Dut->start         = Start;
+
+	switch( P ) {
+		case Pattern::Throughput:   Dut->m_axis_tready = 1; break;
+		case Pattern::Backpressure: Dut->m_axis_tready = Chance( SINK_READY_BACKPRESSURE ); break;
+		case Pattern::Random:       Dut->m_axis_tready = Chance( SINK_READY_RANDOM ); break;
+		case Pattern::XadcDma:
+		case Pattern::Overflow:     Dut->m_axis_tready = SinkStall == 0; break;
+	}
+	Dut->eval(); // s_axis_tready depends on m_axis_tready
+} // Testbench::DriveInputs
+
+uint32_t Testbench::Run( Pattern P, uint32_t Count )
+{
+	uint32_t Errors = 0;
+	auto Check = [&]( bool Ok, const char *What, uint32_t Sample ) {
+		if( !Ok && Errors++ < 5 )
+			cerr << PatternName( P ) << ", count " << Count << ", sample " << Sample << ": " << What << endl;
+	};
+
+	// The samples the module took after the start and didn't deliver yet: the sequence number and the index in the capture
+	struct Taken { uint32_t Sample, Index; };
+	std::deque<Taken> Expected;
+	uint32_t TakenCount = 0;
+	uint32_t Beats      = 0; // Samples delivered to the sink
+	uint32_t RunLost    = 0; // Samples of the capture the sink didn't get
+	bool     LastSeen   = false;
+	uint64_t Cycle      = 0;
+	uint64_t FirstBeatCycle = 0;
+	uint64_t LastBeatCycle  = 0;
+	uint64_t RunReady       = 0; // Clock cycles with m_axis_tready high since the first handshake
+	uint64_t ReadyAtLastBeat = 0;
+	const uint64_t Timeout = uint64_t( Count + 10 ) * ( P == Pattern::XadcDma ? XADC_PERIOD + 1 : 20 ) + 10 * FIFO_DEPTH + 1000;
+	Dut->count = Count;
+
+	// A few idle cycles, the module must discard the samples and keep m_axis_tvalid low
+	for( uint32_t i = Random() % 8; i > 0; i-- ) {
+		DriveInputs( P, false );
+		Check( !Dut->m_axis_tvalid, "m_axis_tvalid high before the start", 0 );
+		Check( Dut->s_axis_tready, "s_axis_tready low before the start", 0 );
+		if( SourceValid && Dut->s_axis_tready ) {
+			SourceValid = false;
+			NextSample++;
+		}
+		Step();
+	}
+
+	bool Start = true;
+	if( P == Pattern::Overflow )
+		SinkStall = OVERFLOW_STALL;
+	for( ; Cycle < Timeout && ( !LastSeen || Start ); Cycle++ ) {
+		DriveInputs( P, Start );
+		const bool Valid = Dut->m_axis_tvalid;
+		const bool Ready = Dut->m_axis_tready;
+		const uint64_t Data = Dut->m_axis_tdata;
+		const bool Last = Dut->m_axis_tlast;
+
+		// AXI-Stream: once tvalid is asserted, tvalid, tdata and tlast must be held till the handshake
+		if( PrevStalled ) {
+			Check( Valid, "m_axis_tvalid dropped before the handshake", Beats );
+			Check( Data == PrevData && Last == PrevLast, "m_axis_tdata or m_axis_tlast changed before the handshake", Beats );
+		}
+		PrevStalled = Valid && !Ready;
+		PrevData    = Data;
+		PrevLast    = Last;
+
+		if( Ready && ( Beats > 0 || Valid ) )
+			RunReady++;
+		if( Valid && Ready ) { // A transfer on the m_axis interface
+			// The samples before this one were lost in the module
+			while( !Expected.empty() && Data != ExpectedWord( Expected.front().Sample ) ) {
+				Expected.pop_front();
+				RunLost++;
+			}
+			Check( !Expected.empty(), "wrong sample", Beats );
+			if( !Expected.empty() ) {
+				const uint32_t Index = Expected.front().Index;
+				const bool LastExpected = Index + 1 == Count || ( CHUNK_SIZE != 0 && ( Index + 1 ) % CHUNK_SIZE == 0 );
+				Check( Last == LastExpected, LastExpected ? "m_axis_tlast missing" : "m_axis_tlast on a wrong sample", Index );
+				LastSeen = Index + 1 == Count;
+				Expected.pop_front();
+			}
+			if( Last )
+				SinkStall = P == Pattern::XadcDma ? DMA_REARM_CYCLES : P == Pattern::Overflow ? OVERFLOW_STALL : 0;
+			if( Beats == 0 )
+				FirstBeatCycle = Cycle;
+			Beats++;
+			LastBeatCycle   = Cycle;
+			ReadyAtLastBeat = RunReady;
+		}
+		else if( SinkStall > 0 )
+			SinkStall--;
+
+		if( SourceValid && Dut->s_axis_tready ) { // A transfer on the s_axis interface
+			if( !Start && TakenCount < Count ) { // The module ignores the samples taken at the start edge (still in IDLE)
+				Expected.push_back( { NextSample, TakenCount } );
+				TakenCount++;
+			}
+			SourceValid = false;
+			NextSample++;
+		}
+		Start = false;
+		Step();
+	}
+	Check( LastSeen, "the capture didn't finish", Beats );
+	Check( Beats + RunLost == Count, "samples delivered and lost don't add up to count", Beats );
+	if( P == Pattern::Throughput || P == Pattern::XadcDma )
+		Check( RunLost == 0, "samples lost without an overflow of the FIFO", Beats );
+	if( P == Pattern::Throughput )
+		Check( LastBeatCycle <= uint64_t( Count ) + START_LATENCY - 1, "less than a sample per clock cycle", Beats );
+	Lost += RunLost;
+	if( Beats > 0 ) {
+		this->Beats += Beats;
+		Cycles      += LastBeatCycle - FirstBeatCycle + 1;
+		ReadyCycles += ReadyAtLastBeat;
+	}
+
+	// The module must return to IDLE after the last handshake
+	for( int i = 0; i < 4; i++ ) {
+		DriveInputs( P, false );
+		Check( !Dut->m_axis_tvalid, "m_axis_tvalid high after the last sample", Beats );
+		if( SourceValid && Dut->s_axis_tready ) {
+			SourceValid = false;
+			NextSample++;
+		}
+		Step();
+	}
+	PrevStalled = false;
+	SinkStall   = 0;
+	return Errors;
+} // Testbench::Run
+
+static void Usage()
+{
+	cerr << "usage: stream_tlaster_tb [-n <runs>] [-s <seed>]" << endl;
+	exit( 2 );
+} // Usage
+
+int main( int argc, char *argv[] )
+{
+	uint32_t Runs = DEFAULT_RUNS;
+	uint32_t Seed = DEFAULT_SEED;
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		uint32_t Value = uint32_t( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Runs = Value;
+		else if( strcmp( argv[a], "-s" ) == 0 )
+			Seed = Value;
+		else
+			Usage();
+	}
+	if( Runs == 0 )
+		Usage();
+
+	Testbench Tb( Seed );
+	std::mt19937 Random( Seed );
+	uint32_t Errors = 0;
+	cout << "stream_tlaster with TID_IN_TDATA=" << TID_IN_TDATA << ", CHUNK_SIZE=" << CHUNK_SIZE << ", FIFO_DEPTH_LOG2="
+	     << FIFO_DEPTH_LOG2 << ", " << Runs << " runs per pattern, seed " << Seed << endl;
+	for( Pattern P : { Pattern::Throughput, Pattern::Backpressure, Pattern::Random, Pattern::XadcDma, Pattern::Overflow } ) {
+		if( P == Pattern::Overflow && !OVERFLOW_PATTERN )
+			continue;
+		uint32_t PatternErrors = 0;
+		Tb.Lost = Tb.Beats = Tb.Cycles = Tb.ReadyCycles = 0;
+		const uint32_t PatternRuns = P == Pattern::XadcDma ? ( Runs + 9 ) / 10 : Runs; // The XADC pattern is slow
+		for( uint32_t r = 0; r < PatternRuns; r++ ) {
+			// The edge cases first: a single sample, a single chunk, and a multiple of the chunk
+			uint32_t Count = r == 0 ? 1 : r == 1 && CHUNK_SIZE ? CHUNK_SIZE : r == 2 && CHUNK_SIZE ? 2 * CHUNK_SIZE : 1 + Random() % MAX_COUNT;
+			PatternErrors += Tb.Run( P, Count );
+		}
+		if( P == Pattern::Overflow && Tb.Lost == 0 && PatternErrors++ < 5 )
+			cerr << "overflow: no sample lost" << endl;
+		// The module must pass the samples as fast as the source offers them and the sink takes them
+		const double Rate  = double( Tb.Beats ) / double( Tb.Cycles );
+		const double Ready = double( Tb.ReadyCycles ) / double( Tb.Cycles );
+		const double Ideal = std::min( SourceRate( P ), Ready );
+		if( Rate < RATE_GATE * Ideal && PatternErrors++ < 5 )
+			cerr << PatternName( P ) << ": " << Rate << " samples per clock cycle, below " << RATE_GATE << " of the ideal " << Ideal << endl;
+		cout << "  " << PatternName( P ) << ": " << PatternRuns << " runs, " << Tb.Lost << " samples lost, " << std::fixed
+		     << std::setprecision( 4 ) << Rate << " samples/clock (ideal " << Ideal << "), " << std::defaultfloat
+		     << ( PatternErrors ? "FAILED" : "ok" ) << endl;
+		Errors += PatternErrors;
+	}
+
+	if( Errors ) {
+		cerr << Errors << " check(s) failed" << endl;
+		return 1;
+	}
+	cout << "all checks passed" << endl;
+	return 0;
+} // main
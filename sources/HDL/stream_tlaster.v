@@ -3,6 +3,14 @@ This Verilog module is part of the XADC tutorial. It controls when the data from
 the slave AXI-Stream interface starts to be sent to the master AXI-Stream interface.
 It also controls how many data transfers are made and asserts the TLAST signal
 on the last transfer.
+When the parameter TID_IN_TDATA is set to 1, the master AXI-Stream is 32 bits wide
+and carries the channel address (AXI-Stream TID of the XADC Wizard) in the bits
+[20:16] of the data, so the channel of each sample gets stored in the memory by the DMA.
+When the parameter CHUNK_SIZE is not 0, TLAST is asserted also on every CHUNK_SIZE-th
+sample, i.e., the stream of count samples is split into packets (DMA transfers) of
+CHUNK_SIZE samples. This is used for captures larger than a single DMA transfer.
+The samples pass through a FIFO of 2^FIFO_DEPTH_LOG2 samples, which holds them while
+the DMA isn't ready (between the chunks), so the chunks join without a gap.
 
 Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
 
@@ -30,81 +38,126 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 `timescale 1ns / 1ps
 
-module stream_tlaster(
+module stream_tlaster #(
+    parameter TID_IN_TDATA = 0,   // 1 -> m_axis_tdata is 32 bits wide: {11'b0, s_axis_tid, s_axis_tdata}
+    parameter CHUNK_SIZE = 0,     // Not 0 -> tlast is asserted also on every CHUNK_SIZE-th sample
+    parameter FIFO_DEPTH_LOG2 = 8 // The FIFO holds 2^FIFO_DEPTH_LOG2 samples (at least 4) while m_axis_tready is low
+)(
     input clk,          // AXI-Stream clock
     input start,        // When asserted, starts sending data to the master AXI-Stream 
     input [24:0] count, // Number of data records to be sent before tlast is asserted
     
     //Master AXI-Stream signals
-    output reg [15:0] m_axis_tdata,
-    output reg m_axis_tvalid,
-    output reg m_axis_tlast,
+    output reg [(TID_IN_TDATA ? 31 : 15):0] m_axis_tdata,
+    output reg m_axis_tvalid = 1'b0,
+    output reg m_axis_tlast = 1'b0,
     input m_axis_tready,
 
     //Slave AXI-Stream signals
     input [15:0] s_axis_tdata,
+    input [4:0] s_axis_tid, // Channel address provided by the XADC Wizard (used only when TID_IN_TDATA == 1)
     input s_axis_tvalid,
-    output reg s_axis_tready
+    output s_axis_tready
 );
 
+    // Width of the master AXI-Stream data
+    localparam TDATA_WIDTH = TID_IN_TDATA ? 32 : 16;
+    localparam FIFO_DEPTH = 1 << FIFO_DEPTH_LOG2;
+
+    // Slave AXI-Stream data extended by the channel address
+    wire [31:0] s_axis_tdata_with_tid = {11'b0, s_axis_tid, s_axis_tdata};
+
     // State definitions
-    localparam IDLE = 0,
-               RUNNING = 1,
-               WAIT_FOR_TREADY = 2;
+    localparam [1:0] IDLE = 2'd0,
+                     RUNNING = 2'd1, // Taking count samples into the FIFO
+                     FLUSH = 2'd2;   // All samples taken, sending the rest of the FIFO
 
     // State and internal signals
     reg [1:0] state = IDLE;
     reg [24:0] valid_count;
-    reg s_axis_tvalid_prev;
+    reg [31:0] chunk_count; // Number of samples taken in the current chunk (used only when CHUNK_SIZE != 0)
+    reg tlast_owed = 1'b0;  // A sample with tlast didn't fit in the FIFO, the next sample written gets the tlast
+
+    /* The XADC doesn't stop converting when the DMA isn't ready, so we keep s_axis_tready asserted all the time.
+       In IDLE, the data are discarded. In RUNNING, each sample goes to the FIFO.
+       When the FIFO is full, the sample is lost, but it is still counted in count and in the chunk, so the DMA
+       transfer of the chunk is shorter by the number of the lost samples. The last two places of the FIFO are kept
+       for the samples with tlast (the last sample of a chunk can be followed by the last sample of the capture),
+       so that the chunks keep their boundaries unless the DMA isn't ready for a whole chunk. */
+    assign s_axis_tready = 1'b1;
+
+    reg [TDATA_WIDTH:0] fifo [0:FIFO_DEPTH-1]; // {tlast, tdata}
+    reg [FIFO_DEPTH_LOG2:0] wr_ptr = {(FIFO_DEPTH_LOG2+1){1'b0}};
+    reg [FIFO_DEPTH_LOG2:0] rd_ptr = {(FIFO_DEPTH_LOG2+1){1'b0}};
+    wire [FIFO_DEPTH_LOG2:0] fifo_used = wr_ptr - rd_ptr;
+    wire [31:0] fifo_count = {{(31-FIFO_DEPTH_LOG2){1'b0}}, fifo_used};
+    wire fifo_empty = fifo_count == 0;
+
+    wire capture_end = valid_count == count - 25'd1;
+    wire chunk_end = CHUNK_SIZE != 0 && chunk_count == CHUNK_SIZE - 1;
+    wire sample_last = state == RUNNING ? capture_end || chunk_end || tlast_owed : tlast_owed;
+    wire taking = state == RUNNING || (state == FLUSH && tlast_owed);
+    wire fifo_write = taking && s_axis_tvalid &&
+                      (fifo_count < FIFO_DEPTH - 2 || (sample_last && fifo_count < FIFO_DEPTH));
+
+    /* The master outputs are a register, which holds its sample until it is transferred (tvalid and tready high).
+       It takes the next sample from the FIFO when it's empty or when its sample is transferred in this clock cycle. */
+    wire output_free = !m_axis_tvalid || m_axis_tready;
+
+    // The FIFO memory (distributed RAM)
+    always @(posedge clk) begin
+        if (fifo_write)
+            fifo[wr_ptr[FIFO_DEPTH_LOG2-1:0]] <= {sample_last, s_axis_tdata_with_tid[TDATA_WIDTH-1:0]};
+    end
 
     // Next state logic and outputs
     always @(posedge clk) begin
+        if (fifo_write)
+            wr_ptr <= wr_ptr + 1'b1;
+
+        if (output_free && !fifo_empty) begin
+            {m_axis_tlast, m_axis_tdata} <= fifo[rd_ptr[FIFO_DEPTH_LOG2-1:0]];
+            m_axis_tvalid <= 1'b1;
+            rd_ptr <= rd_ptr + 1'b1;
+        end else if (m_axis_tready) begin
+            // The sample was transferred and there is no next one yet
+            m_axis_tvalid <= 1'b0;
+            m_axis_tlast <= 1'b0;
+        end
+
+        if (taking && s_axis_tvalid)
+            tlast_owed <= sample_last && !fifo_write;
+
         case (state)
             IDLE: begin
                 // Reset everything
-                valid_count <= 0;
-                s_axis_tvalid_prev <= 0;
-                m_axis_tlast <= 0;
-                m_axis_tvalid <= 0;
-                // We keep tready asserted in IDLE to keep the source producing the data 
-                s_axis_tready <= 1;
+                valid_count <= 25'd0;
+                chunk_count <= 0;
                 
                 // Transition to RUNNING when start is asserted
                 if (start)
                     state <= RUNNING;
             end
             RUNNING: begin
-                // Pass through data, valid and ready signal
-                m_axis_tdata <= s_axis_tdata;
-                m_axis_tvalid <= s_axis_tvalid;
-                s_axis_tready <= m_axis_tready;
-
-                // Check for transition from 0 to 1 in s_axis_tvalid
-                if (!s_axis_tvalid_prev && s_axis_tvalid) begin
-                    valid_count <= valid_count + 1;
-                    // Check if the transition count reaches 'count'
-                    if (valid_count == count-1) begin
-                        m_axis_tlast <= 1;
-                        state <= WAIT_FOR_TREADY;
-                    end else begin
-                        m_axis_tlast <= 0;
-                    end
-                end else begin
-                    m_axis_tlast <= 0;
+                if (s_axis_tvalid) begin
+                    valid_count <= valid_count + 25'd1;
+                    // Check if the sample count reaches 'count'
+                    if (capture_end)
+                        state <= FLUSH;
+                    if (chunk_end)
+                        chunk_count <= 0; // The last sample of a chunk; the DMA transfer ends here and the next chunk starts
+                    else
+                        chunk_count <= chunk_count + 1;
                 end
-
-                // Update the previous valid signal state
-                s_axis_tvalid_prev <= s_axis_tvalid;
             end
-            WAIT_FOR_TREADY: begin
+            FLUSH: begin
                 /* To comply with AXI-Stream specification, we can deassert 
                    tvalid and tlast only if m_axis_tready is high. */
-                if( m_axis_tready ) begin
-                    m_axis_tlast <= 0;
-                    m_axis_tvalid <= 0;
+                if (!tlast_owed && fifo_empty && output_free)
                     state <= IDLE;
-                end               
             end
+            default:
+                state <= IDLE;
         endcase
     end
 
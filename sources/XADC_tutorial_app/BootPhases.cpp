@@ -0,0 +1,64 @@
+/*
+This is the source file of the boot-phase timestamps of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "BootPhases.h"
+#include <iomanip>
+
+static Timestamp PhaseTimes[ int(BootPhase::Count) ];
+static bool      PhaseReached[ int(BootPhase::Count) ];
+
+void BootPhaseMark( BootPhase Phase )
+{
+	// Each phase is marked by a single task, so no lock is needed
+	if( !PhaseReached[ int(Phase) ] ) {
+		PhaseTimes[ int(Phase) ]   = TimestampNow();
+		PhaseReached[ int(Phase) ] = true;
+	}
+} // BootPhaseMark
+
+void BootPhasesPrint( std::ostream &Out )
+{
+	const char *PhaseNames[] = { "main", "network init", "peripherals ready", "XADC ready", "link up",
+	                             "address assigned", "network ready", "DHCP bound", "first capture" };
+	static_assert( sizeof(PhaseNames) / sizeof(PhaseNames[0]) == int(BootPhase::Count), "a phase has no name" );
+
+	const Timestamp Start = PhaseTimes[ int(BootPhase::Main) ];
+
+	/* On the board, the global timer isn't restarted by the application, so its reading at main also shows
+	 * how long the boot (e.g., the FSBL) took before the application started. */
+	Out << "boot phase        time [ms]\n" << std::fixed << std::setprecision(1);
+	for( int p = 0; p < int(BootPhase::Count); p++ ) {
+		Out << std::left << std::setw(18) << PhaseNames[p] << std::right;
+		if( !PhaseReached[p] )
+			Out << std::setw(9) << "-";
+		else if( p == int(BootPhase::Main) )
+			Out << std::setw(9) << 0.0 << " (" << TimestampToNs( Start ) / 1e6 << " since the timer started)";
+		else
+			Out << std::setw(9) << TimestampToNs( PhaseTimes[p] - Start ) / 1e6;
+		Out << '\n';
+	}
+	Out.flush();
+} // BootPhasesPrint
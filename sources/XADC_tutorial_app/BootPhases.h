@@ -0,0 +1,53 @@
+/*
+This is the header file of the boot-phase timestamps of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef BOOTPHASES_H
+#define BOOTPHASES_H
+
+#include <ostream>
+#include "Timestamp.h"
+
+// Phases of the startup of the application, in the order they are printed
+enum class BootPhase {
+	Main,             // main() started
+	NetworkInit,      // network_init_thread started, i.e., the scheduler is running
+	PeripheralsReady, // XADC_thread initialized GPIO, the XADC (incl. reading the calibration) and the DMA
+	XadcReady,        // The XADC mode is activated; the XADC converts samples
+	LinkUp,           // The network interface was added (the PHY completed the auto-negotiation)
+	AddressAssigned,  // The board has an IP address (cached lease, static, from DHCP or the fallback)
+	NetworkReady,     // XADC_thread got the network; captures can be sent from now on
+	DhcpBound,        // DHCP supplied the address (it may come after NetworkReady, when the network started with a cached lease)
+	FirstCapture,     // The first capture was sent to the server
+	Count             // Number of the phases
+};
+
+// Record the time the Phase was reached. Only the first call for each phase is recorded.
+void BootPhaseMark( BootPhase Phase );
+
+// Print the time of each phase reached so far, measured from the start of main()
+void BootPhasesPrint( std::ostream &Out );
+
+#endif // BOOTPHASES_H
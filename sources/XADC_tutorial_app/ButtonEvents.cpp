@@ -0,0 +1,125 @@
+/*
+This is the source file of the interrupt-driven button events used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "ButtonEvents.h"
+#include "xstatus.h"
+
+int ButtonEvents::Initialize( XGpioPs &Gpio, u8 Bank, u8 Shift, u8 Count, u32 DebounceMs, void (*Notify)() )
+{
+	if( Count == 0 || Count > 8 || Shift + Count > 32 || DebounceMs == 0 )
+		return XST_FAILURE;
+
+	this->Gpio   = &Gpio;
+	this->Bank   = Bank;
+	this->Shift  = Shift;
+	this->Notify = Notify;
+	Mask  = u8( ( 1u << Count ) - 1 );
+	State = 0;
+
+	Queue = xQueueCreate( QUEUE_LENGTH, sizeof(ButtonEvent) );
+	Timer = xTimerCreate( "buttons", pdMS_TO_TICKS( DebounceMs ), pdFALSE /*one-shot*/, this, TimerCallback );
+	if( Queue == NULL || Timer == NULL )
+		return XST_FAILURE;
+	return XST_SUCCESS;
+} // ButtonEvents::Initialize
+
+int ButtonEvents::EnableInterrupts( u32 IntrId )
+{
+	const u32 Pins = u32( Mask ) << Shift;
+
+	// An interrupt on both edges of the button pins. The other pins of the bank keep their settings.
+	u32 IntrType, IntrPolarity, IntrOnAny;
+	XGpioPs_GetIntrType( Gpio, Bank, &IntrType, &IntrPolarity, &IntrOnAny );
+	XGpioPs_SetIntrType( Gpio, Bank, IntrType | Pins, IntrPolarity, IntrOnAny | Pins );
+	XGpioPs_SetCallbackHandler( Gpio, this, GpioHandler );
+
+	if( xPortInstallInterruptHandler( u8(IntrId), (XInterruptHandler)XGpioPs_IntrHandler, Gpio ) != pdPASS )
+		return XST_FAILURE;
+	vPortEnableInterrupt( u8(IntrId) );
+
+	State = ReadButtons(); // A button held during the startup is reported when it's released
+	XGpioPs_IntrClear( Gpio, Bank, Pins );
+	XGpioPs_IntrEnable( Gpio, Bank, Pins );
+	return XST_SUCCESS;
+} // ButtonEvents::EnableInterrupts
+
+/* Called by XGpioPs_IntrHandler() with the pending interrupts of a bank. The buttons bounce, so there are many edges
+ * per press; each of them only restarts the timer. */
+void ButtonEvents::GpioHandler( void *CallBackRef, u32 Bank, u32 Status )
+{
+	ButtonEvents *Self = (ButtonEvents *)CallBackRef;
+	if( Bank != Self->Bank || ( Status >> Self->Shift & Self->Mask ) == 0 )
+		return;
+
+	Self->Interrupts = Self->Interrupts + 1;
+	if( !Self->EdgePending ) {
+		Self->FirstEdge   = TimestampNow();
+		Self->EdgePending = true;
+	}
+	BaseType_t HigherPriorityTaskWoken = pdFALSE;
+	xTimerResetFromISR( Self->Timer, &HigherPriorityTaskWoken );
+	portYIELD_FROM_ISR( HigherPriorityTaskWoken );
+} // ButtonEvents::GpioHandler
+
+// Called in the timer service task when the buttons were quiet for the debounce time
+void ButtonEvents::TimerCallback( TimerHandle_t Timer )
+{
+	ButtonEvents *Self = (ButtonEvents *)pvTimerGetTimerID( Timer );
+	const Timestamp Edge = Self->FirstEdge;
+	Self->EdgePending = false; // An edge from now on starts the next change
+	Self->Report( Self->ReadButtons(), Edge );
+} // ButtonEvents::TimerCallback
+
+void ButtonEvents::Poll()
+{
+	const u8 Buttons = ReadButtons();
+	if( Buttons != State && !EdgePending ) {
+		FirstEdge   = TimestampNow();
+		EdgePending = true;
+	}
+
+	Filter.ButtonProcess( Buttons );
+	if( Filter.ButtonPressed( Mask ) | Filter.ButtonReleased( Mask ) ) {
+		EdgePending = false;
+		Report( Filter.ButtonCurrent( Mask ), FirstEdge );
+	}
+	else if( Buttons == State )
+		EdgePending = false; // A glitch, which didn't get through the debouncer
+} // ButtonEvents::Poll
+
+// Post the event of the change from State to Buttons, which started at Edge
+void ButtonEvents::Report( u8 Buttons, Timestamp Edge )
+{
+	if( Buttons == State )
+		return; // The buttons bounced back to where they were
+
+	ButtonEvent Event{ u8( Buttons & ~State ), u8( State & ~Buttons ), Edge };
+	State = Buttons;
+	if( xQueueSend( Queue, &Event, 0 ) != pdTRUE )
+		return; // The task doesn't keep up; the event is dropped
+	if( Notify )
+		Notify();
+} // ButtonEvents::Report
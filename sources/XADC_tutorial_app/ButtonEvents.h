@@ -0,0 +1,98 @@
+/*
+This is the header file of the interrupt-driven button events used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef BUTTONEVENTS_H
+#define BUTTONEVENTS_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "timers.h"
+#include "xgpiops.h"
+#include "button_debounce.h"
+#include "Timestamp.h"
+
+// A debounced change of the buttons
+struct ButtonEvent {
+	u8        Pressed;  // BUTTON_PIN_* of the buttons, which were pressed
+	u8        Released; // BUTTON_PIN_* of the buttons, which were released
+	Timestamp Edge;     // When the first edge of the change was seen (the button-to-capture latency is measured from here)
+};
+
+/* ButtonEvents turns the buttons connected to adjacent pins of a GPIO bank into a queue of debounced press
+ * and release events. The buttons must be pulled down, i.e., a pressed button reads as 1.
+ *
+ * With EnableInterrupts(), an edge of a button raises the GPIO interrupt, which (re)starts a one-shot FreeRTOS timer.
+ * When the buttons were quiet for the debounce time, the timer callback reads them, posts the event and calls
+ * the function given to Initialize(). Nothing runs while the buttons aren't touched.
+ * Without the interrupts, Poll() must be called every millisecond; it feeds the Debouncer like the application
+ * did originally (a release passes at once there). Both ways post the same events, so that their button-to-capture
+ * latency can be compared. The buttons fit in 8 bits, where Debouncer is faster than VerticalDebouncer
+ * (see host_tools/debounce_test). */
+class ButtonEvents {
+public:
+	/* Set up the Count buttons read as the bits Shift to Shift+Count-1 of the GPIO Bank (the pins must already be
+	 * inputs). A change is reported when the buttons were stable for DebounceMs. Notify is called after each event
+	 * was posted (in the timer service task, or in the caller of Poll()); it must not block.
+	 * Returns XST_SUCCESS or XST_FAILURE. */
+	int Initialize( XGpioPs &Gpio, u8 Bank, u8 Shift, u8 Count, u32 DebounceMs, void (*Notify)() );
+
+	/* Install the interrupt handler of the GPIO (the interrupt IntrId of the PS GPIO) and enable the edge interrupts
+	 * of the buttons. Returns XST_SUCCESS or XST_FAILURE. */
+	int EnableInterrupts( u32 IntrId );
+
+	// Read the buttons and post the debounced changes; call it every 1 ms when the interrupts aren't enabled
+	void Poll();
+
+	// Get the next event without waiting. Returns false when there's none.
+	bool Receive( ButtonEvent &Event ) { return xQueueReceive( Queue, &Event, 0 ) == pdTRUE; }
+
+	u32 InterruptCount() const { return Interrupts; } // Number of the GPIO interrupts of the buttons
+
+private:
+	static void GpioHandler( void *CallBackRef, u32 Bank, u32 Status );
+	static void TimerCallback( TimerHandle_t Timer );
+
+	u8   ReadButtons() const { return u8( ( XGpioPs_Read( Gpio, Bank ) >> Shift ) & Mask ); }
+	void Report( u8 Buttons, Timestamp Edge );
+
+	static const UBaseType_t QUEUE_LENGTH = 8; // Events waiting for the task
+
+	XGpioPs      *Gpio     = nullptr;
+	u8            Bank     = 0;
+	u8            Shift    = 0;
+	u8            Mask     = 0;
+	u8            State    = 0;       // The debounced state of the buttons reported last
+	QueueHandle_t Queue    = nullptr;
+	TimerHandle_t Timer    = nullptr; // Expires when the buttons were quiet for the debounce time
+	void        (*Notify)() = nullptr; // Called after an event was posted
+	Debouncer     Filter{ 0 };      // Used by Poll(); the buttons are pulled down
+	volatile bool      EdgePending = false; // An edge was seen and the change wasn't reported yet
+	volatile Timestamp FirstEdge   = 0;     // Time of the first edge of the pending change
+	volatile u32       Interrupts  = 0;
+}; // ButtonEvents
+
+#endif // BUTTONEVENTS_H
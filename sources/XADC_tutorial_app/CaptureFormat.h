@@ -0,0 +1,398 @@
+/*
+This is the header file of the capture header line sent by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CAPTUREFORMAT_H
+#define CAPTUREFORMAT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <ostream>
+#include <sstream>
+#include <iomanip>
+
+/* The captures are sent to the server as text, one value (or one pair of values) per line. When the macro CAPTURE_HEADER
+ * in main.cpp is 1, the first line of a capture is a header describing the capture:
+ *
+ *   #! XADC board=1 capture=12 avg=16 div=4 offset=0xFFA0 gain=0x007F time=123456789012 channel=VAUX[1]
+ *
+ * The line starts with '#', like the header lines of the series in the sequencer and simultaneous modes, so tools
+ * skipping comment lines read the values as before. channel= is present only in the single channel mode; the other
+ * modes name the channels in the headers of the series. Unknown keys are ignored by ParseCaptureHeader(), so keys
+ * can be added without breaking older receivers. board= tells the receiver which board the capture comes from,
+ * so the captures of several boards can be aligned by their time (via_socket_server -g).
+ *
+ * When the network is slower than the XADC in the continuous mode (see OVERLOAD_POLICY in main.cpp), the header
+ * carries the counters of the data the board didn't send before this capture:
+ *
+ *   #! XADC board=1 capture=15 ... dropped=2 dropped_samples=2000000
+ *
+ * dropped= is the number of the captures dropped as a whole since the start of the board, dropped_samples= the number
+ * of the samples not sent as values since the start (the dropped captures, the summary-only captures and the gaps).
+ * The counters are cumulative, so a receiver, which missed a capture, still gets the exact numbers; they're written
+ * only when they aren't 0. summary=1 marks a capture sent as a summary: each channel has the line
+ *
+ *   #! XADC-SUMMARY channel=VAUX[1] samples=1000000 min=0.1022 max=0.9011 mean=0.5003
+ *
+ * instead of its values. In the large-capture mode, the chunks dropped during a capture are replaced by the line
+ *
+ *   #! XADC-GAP samples=65536
+ *
+ * at their position among the values (the number of the samples of all the channels the DMA wrote into DiscardBuffer).
+ * The lines start with '#', so they are skipped by the tools skipping comment lines.
+ *
+ * When the macro CAPTURE_TIMING in main.cpp is 1, the last line of a capture tells when its stages happened:
+ *
+ *   #! XADC-TIMING capture=12 samples=1000 avg=16 trigger=123456700000 dma_done=123456789012 first_send=123457001234 last_send=123458003456 clock_offset=-5012345678 clock_rtt=210000
+ *
+ * samples= and avg= repeat the settings of the capture, so that a receiver can tell the latency of each setting
+ * without parsing the capture. The times are in ns since the start of the board, like time= of the header: the trigger (the first edge of the button,
+ * the reception of the command, or the start of a capture of the continuous mode), the completion of the DMA transfer
+ * (of the last chunk in the large-capture mode), the start of the first send() and the return of the last send()
+ * of the capture (the timing line itself is sent after it). clock_offset= is the clock of the receiver minus the clock
+ * of the board, measured by the clock exchange (see ClockSync.h) with the round trip clock_rtt=; the keys are missing
+ * when the receiver didn't answer the exchange. With the offset, the receiver gets the time the last byte was sent
+ * in its own clock, i.e., it can tell how long the data spent in the network.
+ *
+ * The header is shared by the firmware, board_sim and the host tools (the capture archive). */
+#define CAPTURE_HEADER_PREFIX  "#! XADC"
+#define CAPTURE_SUMMARY_PREFIX "#! XADC-SUMMARY"
+#define CAPTURE_GAP_PREFIX     "#! XADC-GAP"
+#define CAPTURE_TIMING_PREFIX  "#! XADC-TIMING"
+
+// Description of a capture carried by the header line
+struct CaptureInfo {
+	uint32_t    Board         = 0; // ID of the board (BOARD_ID in main.cpp); 0 when unknown
+	uint32_t    Number        = 0; // Number of the capture since the start of the board
+	uint16_t    Averaging     = 0; // Number of samples averaged by the XADC (0, 16, 64 or 256)
+	uint16_t    AdcClkDivisor = 0; // ADCCLK divider ratio
+	uint16_t    OffsetCoeff   = 0; // Raw value of the XADC Offset Calibration Coefficient
+	uint16_t    GainCoeff     = 0; // Raw value of the XADC Gain Calibration Coefficient
+	uint64_t    Time          = 0; // Start of the capture (the DMA start signal) in ns since the start of the board
+	std::string Channel;           // Input of the single channel mode (e.g., "VAUX[1]"); empty in the other modes
+	uint32_t    DroppedCaptures = 0; // Captures dropped by the board before this one, since its start
+	uint64_t    DroppedSamples  = 0; // Samples the board didn't send as values before this capture, since its start
+	bool        Summary         = false; // The capture is sent as the summary lines only
+};
+
+// Summary of the samples of a channel of a capture sent as a summary
+struct CaptureSummary {
+	std::string Channel; // Name of the channel (e.g., "VAUX[1]")
+	uint32_t    Samples = 0;
+	float       Min = 0, Max = 0, Mean = 0;
+};
+
+// Times of the stages of a capture carried by the timing line (in ns since the start of the board)
+struct CaptureTiming {
+	uint32_t Number    = 0; // Number of the capture since the start of the board
+	uint32_t Samples   = 0; // Number of samples of the capture
+	uint16_t Averaging = 0; // Number of samples averaged by the XADC (0, 16, 64 or 256)
+	uint64_t Trigger   = 0;
+	uint64_t DmaDone   = 0;
+	uint64_t FirstSend = 0;
+	uint64_t LastSend  = 0;
+	bool     Synced      = false; // ClockOffset and ClockRtt are valid
+	int64_t  ClockOffset = 0;     // Clock of the receiver minus the clock of the board [ns]
+	uint32_t ClockRtt    = 0;     // Round trip of the clock exchange the offset comes from [ns]
+};
+
+// Write the header line of a capture to the stream f
+inline void WriteCaptureHeader( std::ostream &f, const CaptureInfo &Info )
+{
+	std::ostringstream Line; // Formatted separately, so that the formatting flags of f don't apply
+	Line << CAPTURE_HEADER_PREFIX << " board=" << Info.Board << " capture=" << Info.Number << " avg=" << Info.Averaging
+	     << " div=" << Info.AdcClkDivisor << std::hex << std::uppercase << std::setfill('0')
+	     << " offset=0x" << std::setw(4) << Info.OffsetCoeff << " gain=0x" << std::setw(4) << Info.GainCoeff
+	     << std::dec << " time=" << Info.Time;
+	if( !Info.Channel.empty() )
+		Line << " channel=" << Info.Channel;
+	if( Info.DroppedCaptures != 0 )
+		Line << " dropped=" << Info.DroppedCaptures;
+	if( Info.DroppedSamples != 0 )
+		Line << " dropped_samples=" << Info.DroppedSamples;
+	if( Info.Summary )
+		Line << " summary=1";
+	Line << '\n';
+	f << Line.str();
+} // WriteCaptureHeader
+
+// Write the summary line of a channel to the stream f
+inline void WriteCaptureSummary( std::ostream &f, const CaptureSummary &Summary )
+{
+	std::ostringstream Line;
+	Line << std::setprecision(7) << CAPTURE_SUMMARY_PREFIX << " channel=" << Summary.Channel << " samples=" << Summary.Samples
+	     << " min=" << Summary.Min << " max=" << Summary.Max << " mean=" << Summary.Mean << '\n';
+	f << Line.str();
+} // WriteCaptureSummary
+
+// Write the line of a gap of Samples samples to the stream f
+inline void WriteCaptureGap( std::ostream &f, uint64_t Samples )
+{
+	std::ostringstream Line;
+	Line << CAPTURE_GAP_PREFIX << " samples=" << Samples << '\n';
+	f << Line.str();
+} // WriteCaptureGap
+
+// Write the timing line of a capture to the stream f
+inline void WriteCaptureTiming( std::ostream &f, const CaptureTiming &Timing )
+{
+	std::ostringstream Line;
+	Line << CAPTURE_TIMING_PREFIX << " capture=" << Timing.Number << " samples=" << Timing.Samples << " avg=" << Timing.Averaging
+	     << " trigger=" << Timing.Trigger << " dma_done=" << Timing.DmaDone << " first_send=" << Timing.FirstSend
+	     << " last_send=" << Timing.LastSend;
+	if( Timing.Synced )
+		Line << " clock_offset=" << Timing.ClockOffset << " clock_rtt=" << Timing.ClockRtt;
+	Line << '\n';
+	f << Line.str();
+} // WriteCaptureTiming
+
+/* Maximum number of characters written by FormatSampleValue() (e.g., "-1.234567e-123" is 14; the value is a float,
+ * whose exponent has at most 2 digits, the margin covers "-nan" and friends of any C library). */
+#define SAMPLE_VALUE_MAX_CHARS 16
+
+/* Format the Value to Out the way std::ostream does with std::setprecision(7) (the format "%.7g"), without the stream
+ * and its locale. Out must have room for SAMPLE_VALUE_MAX_CHARS characters; no terminating null is written.
+ * Returns the number of characters written.
+ *
+ * The magnitudes 1e-6 to 1e7 (all the voltages of the XADC) are formatted here: a float multiplied by 10^k, k <= 12,
+ * is exact in a double (24 + 28 bits of mantissa), so rounding it to 7 digits (half to even, like printf) gives
+ * the same digits as printf. The other magnitudes, infinities and NaNs are left to snprintf(). */
+inline size_t FormatSampleValue( char *Out, float Value )
+{
+	static const double Pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12 };
+	const double a = std::fabs( double( Value ) );
+	if( a == 0 ) {
+		size_t Length = 0;
+		if( std::signbit( Value ) )
+			Out[ Length++ ] = '-';
+		Out[ Length++ ] = '0';
+		return Length;
+	}
+
+	int k = 0; // a*10^k has 7 digits before the decimal point
+	double m = a;
+	while( m < 1e6 && k < 12 )
+		m = a * Pow10[ ++k ];
+	if( !( m >= 1e6 && m < 1e7 ) ) { // 0, out of the range, not finite
+		char Text[32];
+		const int n = snprintf( Text, sizeof(Text), "%.7g", double( Value ) );
+		const size_t Length = n < 0 ? 0 : size_t( n ) < SAMPLE_VALUE_MAX_CHARS ? size_t( n ) : SAMPLE_VALUE_MAX_CHARS;
+		memcpy( Out, Text, Length );
+		return Length;
+	}
+
+	// Round to 7 digits, half to even
+	uint32_t Digits = uint32_t( m );
+	const double Fraction = m - Digits; // Exact, m < 2^53
+	if( Fraction > 0.5 || ( Fraction == 0.5 && ( Digits & 1 ) ) )
+		Digits++;
+	int Exponent = 6 - k;
+	if( Digits == 10000000 ) { // Rounded up to the next power of ten
+		Digits = 1000000;
+		Exponent++;
+	}
+
+	char d[7];
+	for( int i = 6; i >= 0; i-- ) {
+		d[i] = char( '0' + Digits % 10 );
+		Digits /= 10;
+	}
+	int Significant = 7; // Trailing zeros are removed, like %g does
+	while( Significant > 1 && d[ Significant - 1 ] == '0' )
+		Significant--;
+
+	char *p = Out;
+	if( Value < 0 )
+		*p++ = '-';
+	if( Exponent >= -4 && Exponent < 7 ) { // Fixed notation
+		if( Exponent >= 0 ) {
+			for( int i = 0; i <= Exponent; i++ )
+				*p++ = d[i];
+			if( Significant > Exponent + 1 ) {
+				*p++ = '.';
+				for( int i = Exponent + 1; i < Significant; i++ )
+					*p++ = d[i];
+			}
+		}
+		else {
+			*p++ = '0';
+			*p++ = '.';
+			for( int i = -1; i > Exponent; i-- )
+				*p++ = '0';
+			for( int i = 0; i < Significant; i++ )
+				*p++ = d[i];
+		}
+	}
+	else { // Scientific notation
+		*p++ = d[0];
+		if( Significant > 1 ) {
+			*p++ = '.';
+			for( int i = 1; i < Significant; i++ )
+				*p++ = d[i];
+		}
+		*p++ = 'e';
+		*p++ = Exponent < 0 ? '-' : '+';
+		const int e = Exponent < 0 ? -Exponent : Exponent;
+		*p++ = char( '0' + e / 10 );
+		*p++ = char( '0' + e % 10 );
+	}
+	return size_t( p - Out );
+} // FormatSampleValue
+
+// Parse the header Line (without the line end). Returns false when the Line isn't a capture header.
+inline bool ParseCaptureHeader( const std::string &Line, CaptureInfo &Info )
+{
+	const std::string Prefix( CAPTURE_HEADER_PREFIX " " );
+	if( Line.compare( 0, Prefix.size(), Prefix ) != 0 )
+		return false;
+
+	Info = CaptureInfo{};
+	std::istringstream Items( Line.substr( Prefix.size() ) );
+	std::string Item;
+	while( Items >> Item ) {
+		const size_t Equals = Item.find( '=' );
+		if( Equals == std::string::npos )
+			continue;
+		const std::string Key = Item.substr( 0, Equals );
+		const std::string Value = Item.substr( Equals + 1 );
+		const unsigned long long Number = strtoull( Value.c_str(), nullptr, 0 ); // Accepts the 0x prefix
+
+		if( Key == "board" )
+			Info.Board = uint32_t( Number );
+		else if( Key == "capture" )
+			Info.Number = uint32_t( Number );
+		else if( Key == "avg" )
+			Info.Averaging = uint16_t( Number );
+		else if( Key == "div" )
+			Info.AdcClkDivisor = uint16_t( Number );
+		else if( Key == "offset" )
+			Info.OffsetCoeff = uint16_t( Number );
+		else if( Key == "gain" )
+			Info.GainCoeff = uint16_t( Number );
+		else if( Key == "time" )
+			Info.Time = uint64_t( Number );
+		else if( Key == "channel" )
+			Info.Channel = Value;
+		else if( Key == "dropped" )
+			Info.DroppedCaptures = uint32_t( Number );
+		else if( Key == "dropped_samples" )
+			Info.DroppedSamples = uint64_t( Number );
+		else if( Key == "summary" )
+			Info.Summary = Number != 0;
+	}
+	return true;
+} // ParseCaptureHeader
+
+// Parse the summary Line (without the line end). Returns false when the Line isn't a summary line.
+inline bool ParseCaptureSummary( const std::string &Line, CaptureSummary &Summary )
+{
+	const std::string Prefix( CAPTURE_SUMMARY_PREFIX " " );
+	if( Line.compare( 0, Prefix.size(), Prefix ) != 0 )
+		return false;
+
+	Summary = CaptureSummary{};
+	std::istringstream Items( Line.substr( Prefix.size() ) );
+	std::string Item;
+	while( Items >> Item ) {
+		const size_t Equals = Item.find( '=' );
+		if( Equals == std::string::npos )
+			continue;
+		const std::string Key = Item.substr( 0, Equals );
+		const std::string Value = Item.substr( Equals + 1 );
+
+		if( Key == "channel" )
+			Summary.Channel = Value;
+		else if( Key == "samples" )
+			Summary.Samples = uint32_t( strtoul( Value.c_str(), nullptr, 10 ) );
+		else if( Key == "min" )
+			Summary.Min = strtof( Value.c_str(), nullptr );
+		else if( Key == "max" )
+			Summary.Max = strtof( Value.c_str(), nullptr );
+		else if( Key == "mean" )
+			Summary.Mean = strtof( Value.c_str(), nullptr );
+	}
+	return true;
+} // ParseCaptureSummary
+
+// Parse the gap Line (without the line end). Returns false when the Line isn't a gap line.
+inline bool ParseCaptureGap( const std::string &Line, uint64_t &Samples )
+{
+	const std::string Prefix( CAPTURE_GAP_PREFIX " samples=" );
+	if( Line.compare( 0, Prefix.size(), Prefix ) != 0 )
+		return false;
+	Samples = strtoull( Line.c_str() + Prefix.size(), nullptr, 10 );
+	return true;
+} // ParseCaptureGap
+
+// Parse the timing Line (without the line end). Returns false when the Line isn't a timing line.
+inline bool ParseCaptureTiming( const std::string &Line, CaptureTiming &Timing )
+{
+	const std::string Prefix( CAPTURE_TIMING_PREFIX " " );
+	if( Line.compare( 0, Prefix.size(), Prefix ) != 0 )
+		return false;
+
+	Timing = CaptureTiming{};
+	bool HasOffset = false, HasRtt = false;
+	std::istringstream Items( Line.substr( Prefix.size() ) );
+	std::string Item;
+	while( Items >> Item ) {
+		const size_t Equals = Item.find( '=' );
+		if( Equals == std::string::npos )
+			continue;
+		const std::string Key = Item.substr( 0, Equals );
+		const char *Value = Item.c_str() + Equals + 1;
+
+		if( Key == "capture" )
+			Timing.Number = uint32_t( strtoul( Value, nullptr, 10 ) );
+		else if( Key == "samples" )
+			Timing.Samples = uint32_t( strtoul( Value, nullptr, 10 ) );
+		else if( Key == "avg" )
+			Timing.Averaging = uint16_t( strtoul( Value, nullptr, 10 ) );
+		else if( Key == "trigger" )
+			Timing.Trigger = strtoull( Value, nullptr, 10 );
+		else if( Key == "dma_done" )
+			Timing.DmaDone = strtoull( Value, nullptr, 10 );
+		else if( Key == "first_send" )
+			Timing.FirstSend = strtoull( Value, nullptr, 10 );
+		else if( Key == "last_send" )
+			Timing.LastSend = strtoull( Value, nullptr, 10 );
+		else if( Key == "clock_offset" ) {
+			Timing.ClockOffset = strtoll( Value, nullptr, 10 );
+			HasOffset = true;
+		}
+		else if( Key == "clock_rtt" ) {
+			Timing.ClockRtt = uint32_t( strtoul( Value, nullptr, 10 ) );
+			HasRtt = true;
+		}
+	}
+	Timing.Synced = HasOffset && HasRtt;
+	return true;
+} // ParseCaptureTiming
+
+#endif // CAPTUREFORMAT_H
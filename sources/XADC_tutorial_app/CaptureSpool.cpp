@@ -0,0 +1,292 @@
+/*
+This is the source file of the spool of the captures, which couldn't be sent, used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "CaptureSpool.h"
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SPOOL_MAGIC   0x31505358 // "XSP1", the memory holds a spool
+#define RECORD_MARKER 0x31434552 // "REC1", a record starts here
+#define SKIP_MARKER   0x50494B53 // "SKIP", the rest of the memory is skipped, the next record is at the beginning
+
+// The header at the start of the memory; the ring of the records follows it
+struct CaptureSpool::SpoolHeader {
+	uint32_t Magic;        // SPOOL_MAGIC
+	uint32_t Capacity;     // Number of bytes of the ring
+	uint32_t Head;         // Offset of the oldest record (or of the skipped end of the ring before it)
+	uint32_t Tail;         // Offset, where the next record is written
+	uint32_t Used;         // Number of bytes from Head to Tail, incl. the skipped end of the ring
+	uint32_t Records;      // Number of records from Head to Tail
+	uint32_t NextSequence; // Sequence number of the next record
+	uint32_t Check;        // Check value of the fields above
+};
+
+// The header of a record; the data follow it, padded to ALIGNMENT
+struct CaptureSpool::RecordHeader {
+	uint32_t Marker;   // RECORD_MARKER or SKIP_MARKER
+	uint32_t Size;     // Number of bytes of the data
+	uint32_t Sequence;
+	uint32_t Check;    // Check value of the fields above
+};
+
+// A hash of the Count words (FNV-1a on 32-bit words); it tells a written header from random content of the memory
+static uint32_t CheckValue( const uint32_t *Words, unsigned Count )
+{
+	uint32_t Check = 0x811C9DC5;
+	for( unsigned i = 0; i < Count; i++ )
+		Check = ( Check ^ Words[i] ) * 16777619;
+	return Check;
+} // CheckValue
+
+CaptureSpool::~CaptureSpool()
+{
+	Unmap();
+} // CaptureSpool::~CaptureSpool
+
+// Number of bytes of a record with Size bytes of data
+uint64_t CaptureSpool::RecordBytes( uint64_t Size )
+{
+	return sizeof(RecordHeader) + ( Size + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+} // CaptureSpool::RecordBytes
+
+CaptureSpool::RecordHeader *CaptureSpool::RecordAt( uint32_t Offset ) const
+{
+	return (RecordHeader *)( Ring + Offset );
+} // CaptureSpool::RecordAt
+
+bool CaptureSpool::Attach( void *Memory, uint32_t Size )
+{
+	if( Size < 1024 || Size > MAX_SIZE || (uintptr_t)Memory % ALIGNMENT != 0 )
+		return false;
+	Header   = (SpoolHeader *)Memory;
+	Ring     = (uint8_t *)Memory + sizeof(SpoolHeader);
+	Capacity = ( Size - uint32_t( sizeof(SpoolHeader) ) ) / ALIGNMENT * ALIGNMENT;
+
+	if( Recover() )
+		Recovered = Header->Records;
+	else {
+		Recovered = 0;
+		Format();
+	}
+	HighWater = 0;
+	Publish();
+	return true;
+} // CaptureSpool::Attach
+
+void CaptureSpool::Format()
+{
+	SpoolHeader Empty{};
+	Empty.Magic    = SPOOL_MAGIC;
+	Empty.Capacity = Capacity;
+	*Header = Empty;
+} // CaptureSpool::Format
+
+bool CaptureSpool::Recover()
+{
+	const SpoolHeader H = *Header;
+	if( H.Magic != SPOOL_MAGIC || H.Capacity != Capacity || H.Check != CheckValue( &H.Magic, 7 )
+	    || H.Head > Capacity || H.Tail > Capacity || H.Used > Capacity )
+		return false;
+
+	// The records from Head must end at Tail, have consecutive sequence numbers and take Used bytes
+	uint32_t Offset = H.Head;
+	uint64_t Bytes  = 0;
+	for( uint32_t r = 0; r < H.Records; r++ ) {
+		if( Capacity - Offset < sizeof(RecordHeader) || RecordAt( Offset )->Marker == SKIP_MARKER ) {
+			Bytes += Capacity - Offset;
+			Offset = 0;
+		}
+		const RecordHeader R = *RecordAt( Offset );
+		if( R.Marker != RECORD_MARKER || R.Check != CheckValue( &R.Marker, 3 ) || R.Sequence != H.NextSequence - H.Records + r
+		    || RecordBytes( R.Size ) > Capacity - Offset )
+			return false;
+		Offset += uint32_t( RecordBytes( R.Size ) );
+		Bytes  += RecordBytes( R.Size );
+	}
+	return Offset == H.Tail && Bytes == H.Used;
+} // CaptureSpool::Recover
+
+void CaptureSpool::Publish()
+{
+	Header->Check = CheckValue( &Header->Magic, 7 );
+	Used  = Header->Used;
+	Count = Header->Records;
+	if( Header->Used > HighWater )
+		HighWater = Header->Used;
+} // CaptureSpool::Publish
+
+uint32_t CaptureSpool::OldestOffset() const
+{
+	const uint32_t Offset = Header->Head;
+	if( Capacity - Offset < sizeof(RecordHeader) || RecordAt( Offset )->Marker == SKIP_MARKER )
+		return 0;
+	return Offset;
+} // CaptureSpool::OldestOffset
+
+void CaptureSpool::DropOldest()
+{
+	const uint32_t Offset = OldestOffset();
+	if( Offset != Header->Head ) // The end of the ring was skipped
+		Header->Used -= Capacity - Header->Head;
+	const uint32_t Bytes = uint32_t( RecordBytes( RecordAt( Offset )->Size ) );
+	Header->Head = Offset + Bytes;
+	Header->Used -= Bytes;
+	if( --Header->Records == 0 )
+		Header->Head = Header->Tail = Header->Used = 0;
+} // CaptureSpool::DropOldest
+
+bool CaptureSpool::Store( const void *Meta, uint32_t MetaSize, const void *Data, uint32_t DataSize )
+{
+	const uint64_t Bytes = RecordBytes( uint64_t( MetaSize ) + DataSize );
+	if( Header == nullptr || Bytes > Capacity ) {
+		Rejected++;
+		return false;
+	}
+	const uint32_t Need = uint32_t( Bytes );
+
+	// Drop the oldest records till there's room for the record after Tail or at the beginning of the ring
+	bool     Wrap;
+	uint32_t Skip;
+	while( true ) {
+		if( Header->Records == 0 )
+			Header->Head = Header->Tail = Header->Used = 0;
+		Wrap = Capacity - Header->Tail < Need;
+		Skip = Wrap ? Capacity - Header->Tail : 0;
+		if( uint64_t( Header->Used ) + Skip + Need <= Capacity )
+			break;
+		DropOldest();
+		Overwritten++;
+	}
+
+	// The data are written before the header of the spool, so a reset in between only loses this record
+	if( Skip >= sizeof(RecordHeader) )
+		RecordAt( Header->Tail )->Marker = SKIP_MARKER;
+	const uint32_t Offset = Wrap ? 0 : Header->Tail;
+	RecordHeader *R = RecordAt( Offset );
+	R->Marker   = RECORD_MARKER;
+	R->Size     = MetaSize + DataSize;
+	R->Sequence = Header->NextSequence;
+	R->Check    = CheckValue( &R->Marker, 3 );
+	if( MetaSize > 0 )
+		memcpy( R + 1, Meta, MetaSize );
+	if( DataSize > 0 )
+		memcpy( (uint8_t *)( R + 1 ) + MetaSize, Data, DataSize );
+
+	Header->Tail = Offset + Need;
+	Header->Used += Skip + Need;
+	Header->Records++;
+	Header->NextSequence++;
+	Stored++;
+	Publish();
+	return true;
+} // CaptureSpool::Store
+
+bool CaptureSpool::Peek( Record &Oldest ) const
+{
+	if( Header == nullptr || Header->Records == 0 )
+		return false;
+	const RecordHeader *R = RecordAt( OldestOffset() );
+	Oldest.Data     = R + 1;
+	Oldest.Size     = R->Size;
+	Oldest.Sequence = R->Sequence;
+	return true;
+} // CaptureSpool::Peek
+
+void CaptureSpool::Remove( uint32_t Sequence, Timestamp Duration )
+{
+	if( Header == nullptr || Header->Records == 0 )
+		return;
+	const RecordHeader *R = RecordAt( OldestOffset() );
+	if( R->Sequence != Sequence )
+		return;
+	const uint32_t Size = R->Size;
+	DropOldest();
+	Publish();
+	Replayed++;
+	ReplayedBytes += Size;
+	ReplayTime    += Duration;
+} // CaptureSpool::Remove
+
+CaptureSpool::Statistics CaptureSpool::GetStatistics() const
+{
+	Statistics S;
+	S.Capacity      = Capacity;
+	S.Used          = Used;
+	S.HighWater     = HighWater;
+	S.Records       = Count;
+	S.Recovered     = Recovered;
+	S.Stored        = Stored;
+	S.Overwritten   = Overwritten;
+	S.Rejected      = Rejected;
+	S.Replayed      = Replayed;
+	S.ReplayedBytes = ReplayedBytes;
+	S.ReplayTime    = ReplayTime;
+	return S;
+} // CaptureSpool::GetStatistics
+
+#ifdef __linux__
+bool CaptureSpool::MapFile( const std::string &Path, uint32_t Size )
+{
+	Unmap();
+	if( Size > MAX_SIZE )
+		return false;
+	const int File = open( Path.c_str(), O_RDWR | O_CREAT, 0644 );
+	if( File < 0 )
+		return false;
+	struct stat Status;
+	void *Memory = MAP_FAILED;
+	if( fstat( File, &Status ) == 0 && ( Status.st_size == off_t( Size ) || ftruncate( File, Size ) == 0 ) )
+		Memory = mmap( nullptr, Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0 );
+	close( File ); // The mapping keeps the file open
+	if( Memory == MAP_FAILED )
+		return false;
+
+	Mapped     = Memory;
+	MappedSize = Size;
+	if( !Attach( Memory, Size ) ) {
+		Unmap();
+		return false;
+	}
+	return true;
+} // CaptureSpool::MapFile
+#endif
+
+void CaptureSpool::Unmap()
+{
+#ifdef __linux__
+	if( Mapped != nullptr )
+		munmap( Mapped, MappedSize );
+#endif
+	Mapped = nullptr;
+	Header = nullptr;
+	Ring   = nullptr;
+} // CaptureSpool::Unmap
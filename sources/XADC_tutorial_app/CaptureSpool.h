@@ -0,0 +1,140 @@
+/*
+This is the header file of the spool of the captures, which couldn't be sent, used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CAPTURESPOOL_H
+#define CAPTURESPOOL_H
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include "Timestamp.h"
+
+/* CaptureSpool keeps the captures, which couldn't be sent because the server was unreachable, till they can be
+ * replayed. It's a bounded ring of binary records in a block of memory given to Attach(): on the board, a static
+ * array in the section .noinit of the DDR (so the records survive a reset of the processor); on Linux, a file mapped
+ * by MapFile() (so the records survive a restart of the program).
+ *
+ * The memory starts with a header holding the position of the oldest and of the newest record, followed by the ring.
+ * A record is a small header (a marker, the size, the sequence number and a check value) followed by the data given
+ * to Store(). A record is never split: when it doesn't fit before the end of the memory, the rest of the memory is
+ * skipped and the record starts at the beginning. Peek() can therefore return a pointer to the data of the oldest
+ * record, which is sent right from the spool without copying. When the spool is full, Store() drops the oldest
+ * records to make room, i.e., the spool keeps the newest captures.
+ *
+ * Store(), Peek() and Remove() must be called by a single task (the owner). GetStatistics() can be called by any task;
+ * the counters are read one by one, so they may not be consistent with each other. */
+class CaptureSpool {
+public:
+	static const uint32_t MAX_SIZE = 0x80000000; // Max. size of the memory of a spool
+
+	// The oldest record returned by Peek()
+	struct Record {
+		const void *Data;     // Points into the spool; valid till the next Store() or Remove()
+		uint32_t    Size;     // Number of bytes of the data
+		uint32_t    Sequence; // Number of the record since the spool was formatted
+	};
+
+	// Counters for sizing of the spool and for the replay throughput
+	struct Statistics {
+		uint32_t  Capacity;      // Number of bytes of the ring
+		uint32_t  Used;          // Number of bytes taken by the records
+		uint32_t  HighWater;     // Max. number of bytes taken at the same time
+		uint32_t  Records;       // Number of records in the spool
+		uint32_t  Recovered;     // Number of records found in the memory by Attach()
+		uint32_t  Stored;        // Number of records stored
+		uint32_t  Overwritten;   // Number of the oldest records dropped to make room for new ones
+		uint32_t  Rejected;      // Number of records larger than the spool
+		uint32_t  Replayed;      // Number of records removed after they were replayed
+		uint64_t  ReplayedBytes; // Number of bytes of the data of the replayed records
+		Timestamp ReplayTime;    // Total time of the replays of these records
+	};
+
+	CaptureSpool() {}
+	~CaptureSpool();
+	CaptureSpool( const CaptureSpool & ) = delete;
+	CaptureSpool &operator=( const CaptureSpool & ) = delete;
+
+	/* Use Size bytes of the Memory (aligned on 8 bytes) for the spool. When the Memory holds a valid spool of the same
+	 * size (written before a reset, or by a previous run), its records are kept; otherwise the spool is formatted.
+	 * Returns false when the Size is smaller than 1 kB or higher than MAX_SIZE. */
+	bool Attach( void *Memory, uint32_t Size );
+
+#ifdef __linux__
+	/* Map the file at the Path (created when it doesn't exist) and Attach() it. A file of a different size is resized
+	 * and formatted. Returns false when the file can't be created or mapped. */
+	bool MapFile( const std::string &Path, uint32_t Size );
+#endif
+
+	/* Append a record of the MetaSize bytes of the Meta followed by the DataSize bytes of the Data. The oldest records
+	 * are dropped when the spool is full. Returns false when the record is larger than the spool. */
+	bool Store( const void *Meta, uint32_t MetaSize, const void *Data = nullptr, uint32_t DataSize = 0 );
+
+	// Get the oldest record without removing it. Returns false when the spool is empty.
+	bool Peek( Record &Oldest ) const;
+
+	/* Remove the oldest record after it was replayed; Duration is the time of the replay (for the replay throughput).
+	 * Nothing is removed when the oldest record isn't the Sequence any more (e.g., Store() dropped it meanwhile). */
+	void Remove( uint32_t Sequence, Timestamp Duration );
+
+	bool Empty() const { return Count.load( std::memory_order_relaxed ) == 0; }
+
+	Statistics GetStatistics() const;
+
+private:
+	struct SpoolHeader;
+	struct RecordHeader;
+
+	static const uint32_t ALIGNMENT = 8; // Alignment of the records
+
+	static uint64_t RecordBytes( uint64_t Size );
+	RecordHeader *RecordAt( uint32_t Offset ) const;
+	uint32_t OldestOffset() const; // Offset of the oldest record, after the skipped end of the memory
+	void     DropOldest();
+	void     Format();
+	void     Publish(); // Update the Check of the Header and the counters of the usage
+	bool     Recover(); // Walk the records the Header describes; returns false when the memory doesn't hold a valid spool
+	void     Unmap();
+
+	SpoolHeader *Header = nullptr; // At the start of the memory, the ring follows
+	uint8_t     *Ring   = nullptr;
+	void        *Mapped = nullptr; // The memory mapped by MapFile()
+	uint32_t     MappedSize = 0;
+
+	// The counters read by GetStatistics(); the position of the records is in the Header
+	uint32_t              Capacity = 0;
+	std::atomic<uint32_t> Used{ 0 };
+	std::atomic<uint32_t> HighWater{ 0 };
+	std::atomic<uint32_t> Count{ 0 };
+	std::atomic<uint32_t> Recovered{ 0 };
+	std::atomic<uint32_t> Stored{ 0 };
+	std::atomic<uint32_t> Overwritten{ 0 };
+	std::atomic<uint32_t> Rejected{ 0 };
+	std::atomic<uint32_t> Replayed{ 0 };
+	std::atomic<uint64_t> ReplayedBytes{ 0 };
+	std::atomic<uint64_t> ReplayTime{ 0 };
+}; // CaptureSpool
+
+#endif // CAPTURESPOOL_H
@@ -0,0 +1,131 @@
+/*
+This is the header file of the demultiplexing of the DMA data of the XADC sequencer modes used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CHANNELDEMUX_H
+#define CHANNELDEMUX_H
+
+#include <cstdint>
+
+/* Pure functions splitting the DMA words of the sequencer and simultaneous modes by the channel. They don't use
+ * the Xilinx libraries, so host_tools/demux_test tests them on Linux.
+ * In these modes, a DMA word carries the sample in the bits [15:0] and the channel address (the AXI-Stream TID
+ * of the XADC Wizard) in the bits [20:16] (see the parameter TID_IN_TDATA of stream_tlaster). */
+
+#define DEMUX_CH_AUX_MIN 16 // Channel address of VAUX[0] (XSM_CH_AUX_MIN of xsysmon.h)
+#define DEMUX_PAIRS      8  // Pair n is VAUX[n] sampled by ADC A and VAUX[n+8] sampled by ADC B
+
+// Get the raw sample from a word written by the DMA
+inline uint16_t DmaWordSample( uint32_t Word )
+{
+	return uint16_t( Word & 0xFFFF );
+} // DmaWordSample
+
+// Get the channel address (XADC Wizard AXI-Stream TID) from a word written by the DMA
+inline uint8_t DmaWordChannel( uint32_t Word )
+{
+	return uint8_t( ( Word >> 16 ) & 0x1F );
+} // DmaWordChannel
+
+/* Check whether two consecutive DMA words are the results of a simultaneous conversion of VAUX[n] by ADC A
+ * and VAUX[n+8] by ADC B. The two results of a conversion always come in the same order: the result of ADC A first,
+ * or of ADC B first when BFirst. Returns n and the raw samples of both ADCs, or -1 if the words are not a pair.
+ *
+ * The order must be fixed. Accepting either order would pair the result of ADC B, which starts a transfer (the
+ * transfer started between the two results of a conversion), with the result of ADC A of the next conversion, and
+ * so on till the end of the transfer. */
+inline int GetPair( uint32_t First, uint32_t Second, bool BFirst, uint16_t &RawA, uint16_t &RawB )
+{
+	const uint32_t WordA = BFirst ? Second : First;
+	const uint32_t WordB = BFirst ? First : Second;
+	const uint8_t ChannelA = DmaWordChannel( WordA );
+
+	if( ChannelA < DEMUX_CH_AUX_MIN || ChannelA >= DEMUX_CH_AUX_MIN + DEMUX_PAIRS || DmaWordChannel( WordB ) != ChannelA + 8 )
+		return -1;
+	RawA = DmaWordSample( WordA );
+	RawB = DmaWordSample( WordB );
+	return ChannelA - DEMUX_CH_AUX_MIN;
+} // GetPair
+
+/* Call Fn( Pair, RawA, RawB ) for each pair of Count DMA words from Data, in the order of the data. A word, which
+ * doesn't form a pair with the next one (its counterpart is missing), is skipped. Returns the number of the skipped words. */
+template<typename Word, typename Function>
+uint32_t ForEachPair( const Word *Data, uint32_t Count, bool BFirst, Function Fn )
+{
+	uint32_t Unpaired = 0;
+	uint32_t i = 0;
+	while( i + 1 < Count ) {
+		uint16_t RawA, RawB;
+		const int Pair = GetPair( Data[i], Data[i+1], BFirst, RawA, RawB );
+		if( Pair < 0 ) {
+			Unpaired++; // Skip the unpaired word
+			i++;
+			continue;
+		}
+		Fn( Pair, RawA, RawB );
+		i += 2;
+	}
+	return Unpaired + ( Count - i ); // The last word can't have its counterpart in the data
+} // ForEachPair
+
+// Series of the pairs of samples of a pair of channels, stored interleaved (A, B, A, B, ...)
+template<typename Sample>
+struct PairSeries {
+	uint8_t  Pair;    // VAUX[Pair] and VAUX[Pair+8]
+	uint32_t Count;   // Number of the pairs
+	Sample  *Samples; // 2 * Count samples
+};
+
+/* Split Count DMA words from Data of the simultaneous mode into per-pair series. The samples are converted by
+ * RawToSample() and stored in Out, which must have room for Count samples; the series of a pair is a contiguous part
+ * of it, the series are ordered by the pair and the samples keep their order in time within each series.
+ * Returns the number of the series stored in Series; Unpaired is set to the number of the skipped words. */
+template<typename Word, typename Sample, typename Convert>
+int SplitPairs( const Word *Data, uint32_t Count, bool BFirst, Sample *Out, PairSeries<Sample> Series[ DEMUX_PAIRS ],
+                uint32_t &Unpaired, Convert RawToSample )
+{
+	uint32_t PairCount[ DEMUX_PAIRS ] = {};
+	Unpaired = ForEachPair( Data, Count, BFirst, [&]( int Pair, uint16_t, uint16_t ) { PairCount[Pair]++; } );
+
+	// Assign a contiguous part of Out to each pair, which has samples
+	Sample *Next[ DEMUX_PAIRS ] = {};
+	Sample *Free = Out;
+	int SeriesCount = 0;
+	for( int Pair = 0; Pair < DEMUX_PAIRS; Pair++ ) {
+		if( PairCount[Pair] == 0 )
+			continue;
+		Next[Pair] = Free;
+		Series[SeriesCount++] = { uint8_t( Pair ), PairCount[Pair], Free };
+		Free += 2 * PairCount[Pair];
+	}
+
+	ForEachPair( Data, Count, BFirst, [&]( int Pair, uint16_t RawA, uint16_t RawB ) {
+		*Next[Pair]++ = RawToSample( RawA );
+		*Next[Pair]++ = RawToSample( RawB );
+	} );
+	return SeriesCount;
+} // SplitPairs
+
+#endif // CHANNELDEMUX_H
@@ -0,0 +1,139 @@
+/*
+This is the source file of the clock exchange of the XADC tutorial application with the receiver of the data.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifdef __linux__
+#   include <sys/socket.h>
+#   include <sys/select.h>
+#   include <arpa/inet.h>
+#   include <netinet/in.h>
+#   include <unistd.h>
+#   include <cerrno>
+#   define CLOSE_SOCKET ::close
+#else // If not Linux, we assume FreeRTOS with lwIP
+/* lwIP must be included before any header, which includes sys/errno.h (see the comment in SocketSink.cpp).
+ * This file doesn't use the C++ streams, so no macros need to be un-defined. */
+#   include "lwip/sockets.h"
+#   define CLOSE_SOCKET lwip_close
+#   define INADDR_NONE IPADDR_NONE // lwIP doesn't provide macro INADDR_NONE
+#endif
+
+#include "ClockSync.h"
+
+int ClockProbe::Open( const char *ServerIP, unsigned short Port )
+{
+	Close();
+	Result = ClockOffset{}; // The offset belongs to the previous receiver
+
+	struct sockaddr_in Addr = {};
+	Addr.sin_family      = AF_INET;
+	Addr.sin_port        = htons( Port );
+	Addr.sin_addr.s_addr = inet_addr( ServerIP );
+	if( Addr.sin_addr.s_addr == INADDR_NONE )
+		return EINVAL;
+
+	if( (Socket = socket( AF_INET, SOCK_DGRAM, 0 )) < 0 )
+		return errno;
+	// The socket is connected, so that only the datagrams of the receiver come (and Linux reports an unreachable port)
+	if( connect( Socket, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 ) {
+		int Error = errno;
+		Close();
+		return Error;
+	}
+	return 0;
+} // ClockProbe::Open
+
+void ClockProbe::Close()
+{
+	if( Socket >= 0 ) {
+		CLOSE_SOCKET( Socket );
+		Socket = -1;
+	}
+} // ClockProbe::Close
+
+bool ClockProbe::Measure( unsigned Count, unsigned TimeoutMs )
+{
+	if( Socket < 0 )
+		return false;
+
+	ClockOffset Best;
+	for( unsigned i = 0; i < Count; i++ ) {
+		uint8_t Probe[ CLOCK_PROBE_SIZE ];
+		const uint32_t Seq = ++Sequence;
+		const uint64_t t0 = TimestampToNs( TimestampNow() );
+		PutU32( Probe, CLOCK_PROBE_MAGIC );
+		PutU32( Probe + 4, Seq );
+		PutU64( Probe + 8, t0 );
+		if( send( Socket, Probe, sizeof(Probe), 0 ) != long( sizeof(Probe) ) )
+			break;
+
+		// Wait for the echo of this probe; a late echo of an earlier probe is skipped
+		const Timestamp Deadline = TimestampNow() + TimeoutMs * TIMESTAMP_TICKS_PER_SECOND / 1000;
+		bool Echoed = false;
+		while( !Echoed ) {
+			const Timestamp Now = TimestampNow();
+			if( Now >= Deadline )
+				break;
+			const uint64_t LeftUs = TimestampToNs( Deadline - Now ) / 1000;
+			struct timeval Timeout;
+			Timeout.tv_sec  = long( LeftUs / 1000000 );
+			Timeout.tv_usec = long( LeftUs % 1000000 );
+			fd_set Readable;
+			FD_ZERO( &Readable );
+			FD_SET( Socket, &Readable );
+			if( select( Socket + 1, &Readable, nullptr, nullptr, &Timeout ) <= 0 )
+				break;
+
+			uint8_t Echo[ CLOCK_ECHO_SIZE ];
+			const long n = recv( Socket, Echo, sizeof(Echo), 0 );
+			const uint64_t t3 = TimestampToNs( TimestampNow() );
+			if( n < 0 )
+				break; // E.g., nobody listens on the port
+			if( n != CLOCK_ECHO_SIZE || GetU32( Echo ) != CLOCK_ECHO_MAGIC || GetU32( Echo + 4 ) != Seq || GetU64( Echo + 8 ) != t0 )
+				continue;
+			Echoed = true;
+
+			// The differences of the clocks are computed modulo 2^64, so the offset may be negative
+			const uint64_t t1 = GetU64( Echo + 16 );
+			const uint64_t t2 = GetU64( Echo + 24 );
+			const int64_t Rtt = int64_t( t3 - t0 ) - int64_t( t2 - t1 );
+			if( Rtt < 0 || Rtt > 0xFFFFFFFF )
+				continue; // The echo is broken
+			if( !Best.Valid || uint32_t( Rtt ) < Best.Rtt ) {
+				Best.Valid  = true;
+				Best.Offset = ( int64_t( t1 - t0 ) + int64_t( t2 - t3 ) ) / 2;
+				Best.Rtt    = uint32_t( Rtt );
+			}
+		}
+		if( !Echoed )
+			break;
+	}
+
+	if( !Best.Valid )
+		return false;
+	Best.Measured = TimestampNow();
+	Result = Best;
+	return true;
+} // ClockProbe::Measure
@@ -0,0 +1,116 @@
+/*
+This is the header file of the clock exchange of the XADC tutorial application with the receiver of the data.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include "CommandProtocol.h" // PutU32() and GetU32()
+#include "Timestamp.h"
+#include <cstddef>
+#include <cstdint>
+
+/* The clock exchange lets the receiver of the captures relate the times of the board (ns since the start of the board,
+ * like the time= of the capture header) to its own clock. The board sends a probe in a UDP datagram to the receiver,
+ * which returns an echo carrying the times it received the probe and sent the echo. The receiver answers on the UDP
+ * port with the same number as the TCP port of the data (via_socket_server does). All the multibyte fields are little endian.
+ *
+ * Probe (16 bytes):
+ *   0  u32  Magic (CLOCK_PROBE_MAGIC)
+ *   4  u32  Sequence number chosen by the board, copied to the echo
+ *   8  u64  t0: the board sent the probe [ns of the board]
+ *
+ * Echo (32 bytes):
+ *   0  u32  Magic (CLOCK_ECHO_MAGIC)
+ *   4  u32  Sequence number of the probe
+ *   8  u64  t0 copied from the probe
+ *  16  u64  t1: the receiver received the probe [ns of the receiver]
+ *  24  u64  t2: the receiver sent the echo [ns of the receiver]
+ *
+ * With t3, the time the board received the echo, the offset of the clocks (receiver minus board) is
+ * ((t1 - t0) + (t2 - t3)) / 2 and the round trip is (t3 - t0) - (t2 - t1). The offset is exact when both ways take
+ * the same time; otherwise its error is at most half the round trip, so the probe with the shortest round trip wins.
+ * The clocks drift apart (the crystals differ by tens of ppm), so the exchange is repeated (see CLOCK_SYNC_INTERVAL_MS
+ * in main.cpp). */
+#define CLOCK_PROBE_MAGIC 0x4B4C4358 // "XCLK"
+#define CLOCK_ECHO_MAGIC  0x454C4358 // "XCLE"
+#define CLOCK_PROBE_SIZE  16
+#define CLOCK_ECHO_SIZE   32
+
+static inline void PutU64( uint8_t *p, uint64_t v ) { PutU32( p, uint32_t(v) ); PutU32( p + 4, uint32_t(v >> 32) ); }
+static inline uint64_t GetU64( const uint8_t *p ) { return GetU32( p ) | uint64_t( GetU32( p + 4 ) ) << 32; }
+
+/* Make the Echo of the Probe of Size bytes, which was received at ReceivedNs; SentNs is the time the echo will be sent
+ * (both in ns of the receiver's clock). Returns false when the Probe isn't a clock probe. */
+static inline bool EncodeClockEcho( const uint8_t *Probe, size_t Size, uint64_t ReceivedNs, uint64_t SentNs, uint8_t *Echo )
+{
+	if( Size != CLOCK_PROBE_SIZE || GetU32( Probe ) != CLOCK_PROBE_MAGIC )
+		return false;
+	PutU32( Echo, CLOCK_ECHO_MAGIC );
+	PutU32( Echo + 4, GetU32( Probe + 4 ) );
+	PutU64( Echo + 8, GetU64( Probe + 8 ) );
+	PutU64( Echo + 16, ReceivedNs );
+	PutU64( Echo + 24, SentNs );
+	return true;
+} // EncodeClockEcho
+
+// Offset of the clock of the receiver measured by ClockProbe
+struct ClockOffset {
+	bool      Valid    = false; // Nothing was measured yet
+	int64_t   Offset   = 0;     // Clock of the receiver minus the clock of the board [ns]
+	uint32_t  Rtt      = 0;     // Round trip of the probe the offset comes from [ns]
+	Timestamp Measured = 0;     // When it was measured
+};
+
+/* ClockProbe is the board's side of the clock exchange. It works with lwIP on the board and with the POSIX sockets
+ * on Linux (board_sim). */
+class ClockProbe {
+public:
+	ClockProbe() {}
+	~ClockProbe() { Close(); }
+	ClockProbe( const ClockProbe& ) = delete;
+	ClockProbe& operator=( const ClockProbe& ) = delete;
+
+	/* Open a UDP socket to the receiver at ServerIP (IPv4 address in the numeric form) and Port. An open socket is closed
+	 * first and the offset measured by it is forgotten. Returns 0, or the errno of the socket function which failed (EINVAL for a wrong address). */
+	int Open( const char *ServerIP, unsigned short Port );
+	void Close();
+
+	/* Send up to Count probes one after another, each waiting at most TimeoutMs for its echo, and keep the offset
+	 * of the one with the shortest round trip. The exchange stops at the first probe without an echo, so a receiver,
+	 * which doesn't answer (e.g., file_via_socket.py), costs a single timeout.
+	 * Returns false when no echo came; Offset() keeps the previous result then. */
+	bool Measure( unsigned Count, unsigned TimeoutMs );
+
+	bool               IsOpen() const { return Socket >= 0; }
+	const ClockOffset &Offset() const { return Result; }
+
+private:
+	int         Socket   = -1; // The UDP socket file descriptor; value <0 means that the socket is closed
+	uint32_t    Sequence = 0;  // Sequence number of the last probe
+	ClockOffset Result;
+}; // ClockProbe
+
+#endif // CLOCKSYNC_H
@@ -0,0 +1,174 @@
+/*
+This is the header file of the binary protocol of the command server of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef COMMANDPROTOCOL_H
+#define COMMANDPROTOCOL_H
+
+#include <cstdint>
+
+/* The command server (see CommandServer.h) accepts a TCP connection and serves fixed-size binary requests.
+ * Each request gets exactly one response. A client may send any number of requests over the connection.
+ * All the multibyte fields are little endian.
+ *
+ * Request (8 bytes):
+ *   0  u8   Magic (COMMAND_REQUEST_MAGIC)
+ *   1  u8   Command (CommandCode)
+ *   2  u16  Sequence number chosen by the client, copied to the response
+ *   4  u32  Argument of the command
+ *
+ * Response (32 bytes), every response carries the complete status of the board:
+ *   0  u8   Magic (COMMAND_RESPONSE_MAGIC)
+ *   1  u8   Command the response belongs to
+ *   2  u16  Sequence number of the request
+ *   4  u8   Result (CommandResult)
+ *   5  u8   State (BoardState)
+ *   6  u8   Active input in the single channel mode (0 = VAUX[1], 1 = VP/VN, 0xFF in the other modes)
+ *   7  u8   ADCCLK divider ratio
+ *   8  u32  Number of samples of a capture
+ *  12  u16  Number of samples the XADC averages (0, 16, 64 or 256)
+ *  14  u16  Number of the captures of the continuous mode dropped because the network was behind (saturated to 0xFFFF)
+ *  16  u32  Number of captures done since the start of the board
+ *  20  u32  Command-to-DMA-start latency of the last capture started by a command [ns]
+ *  24  u32  Min. command-to-DMA-start latency [ns]
+ *  28  u32  Max. command-to-DMA-start latency [ns] */
+
+#define COMMAND_SERVER_DEFAULT_PORT 65433 // The data server (file_via_socket.py) uses the port 65432 by default
+
+#define COMMAND_REQUEST_MAGIC  0xAD
+#define COMMAND_RESPONSE_MAGIC 0xDA
+#define COMMAND_REQUEST_SIZE   8
+#define COMMAND_RESPONSE_SIZE  32
+
+enum class CommandCode : uint8_t {
+	Status          = 0, // Return the status only
+	Trigger         = 1, // Perform a capture; the response is sent when the capture was sent to the data server
+	SelectChannel   = 2, // Argument: 0 = VAUX[1], 1 = VP/VN (single channel mode only)
+	SetSampleCount  = 3, // Argument: number of samples of a capture
+	SetAveraging    = 4, // Argument: number of samples the XADC averages (0, 16, 64 or 256)
+	StartContinuous = 5, // Perform captures one after another till StopContinuous
+	StopContinuous  = 6  // Stop the continuous mode after the capture in progress
+};
+
+enum class CommandResult : uint8_t {
+	Ok          = 0,
+	BadCommand  = 1, // Unknown command or wrong magic number
+	BadArgument = 2, // The argument is out of range; the setting wasn't changed
+	Busy        = 3, // The command can't be done in the continuous mode
+	Unsupported = 4, // The command isn't supported in the XADC mode the firmware was built for
+	Failed      = 5  // The capture failed
+};
+
+enum class BoardState : uint8_t {
+	Idle       = 0,
+	Continuous = 1 // Continuous mode is running
+};
+
+#define COMMAND_CHANNEL_NONE 0xFF // Value of CommandResponse::Channel in the sequencer and simultaneous modes
+
+struct CommandRequest {
+	CommandCode Command;
+	uint16_t    Sequence;
+	uint32_t    Argument;
+};
+
+struct CommandResponse {
+	CommandCode   Command;
+	uint16_t      Sequence;
+	CommandResult Result;
+	BoardState    State;
+	uint8_t       Channel;
+	uint8_t       AdcClkDivisor;
+	uint32_t      SampleCount;
+	uint16_t      Averaging;
+	uint16_t      DroppedCaptures;
+	uint32_t      CaptureCount;
+	uint32_t      LastLatencyNs;
+	uint32_t      MinLatencyNs;
+	uint32_t      MaxLatencyNs;
+};
+
+/***** Serialization of the messages; the functions don't depend on the byte order of the CPU *****/
+
+static inline void PutU16( uint8_t *p, uint16_t v ) { p[0] = uint8_t(v); p[1] = uint8_t(v >> 8); }
+static inline void PutU32( uint8_t *p, uint32_t v ) { PutU16( p, uint16_t(v) ); PutU16( p + 2, uint16_t(v >> 16) ); }
+static inline uint16_t GetU16( const uint8_t *p ) { return uint16_t( p[0] | p[1] << 8 ); }
+static inline uint32_t GetU32( const uint8_t *p ) { return GetU16( p ) | uint32_t( GetU16( p + 2 ) ) << 16; }
+
+static inline void EncodeRequest( const CommandRequest &Request, uint8_t *Buffer )
+{
+	Buffer[0] = COMMAND_REQUEST_MAGIC;
+	Buffer[1] = uint8_t( Request.Command );
+	PutU16( Buffer + 2, Request.Sequence );
+	PutU32( Buffer + 4, Request.Argument );
+} // EncodeRequest
+
+// Returns false when Buffer doesn't hold a request (wrong magic number)
+static inline bool DecodeRequest( const uint8_t *Buffer, CommandRequest &Request )
+{
+	Request.Command  = CommandCode( Buffer[1] );
+	Request.Sequence = GetU16( Buffer + 2 );
+	Request.Argument = GetU32( Buffer + 4 );
+	return Buffer[0] == COMMAND_REQUEST_MAGIC;
+} // DecodeRequest
+
+static inline void EncodeResponse( const CommandResponse &Response, uint8_t *Buffer )
+{
+	Buffer[0] = COMMAND_RESPONSE_MAGIC;
+	Buffer[1] = uint8_t( Response.Command );
+	PutU16( Buffer + 2, Response.Sequence );
+	Buffer[4] = uint8_t( Response.Result );
+	Buffer[5] = uint8_t( Response.State );
+	Buffer[6] = Response.Channel;
+	Buffer[7] = Response.AdcClkDivisor;
+	PutU32( Buffer + 8, Response.SampleCount );
+	PutU16( Buffer + 12, Response.Averaging );
+	PutU16( Buffer + 14, Response.DroppedCaptures );
+	PutU32( Buffer + 16, Response.CaptureCount );
+	PutU32( Buffer + 20, Response.LastLatencyNs );
+	PutU32( Buffer + 24, Response.MinLatencyNs );
+	PutU32( Buffer + 28, Response.MaxLatencyNs );
+} // EncodeResponse
+
+// Returns false when Buffer doesn't hold a response (wrong magic number)
+static inline bool DecodeResponse( const uint8_t *Buffer, CommandResponse &Response )
+{
+	Response.Command       = CommandCode( Buffer[1] );
+	Response.Sequence      = GetU16( Buffer + 2 );
+	Response.Result        = CommandResult( Buffer[4] );
+	Response.State         = BoardState( Buffer[5] );
+	Response.Channel       = Buffer[6];
+	Response.AdcClkDivisor = Buffer[7];
+	Response.SampleCount   = GetU32( Buffer + 8 );
+	Response.Averaging     = GetU16( Buffer + 12 );
+	Response.DroppedCaptures = GetU16( Buffer + 14 );
+	Response.CaptureCount  = GetU32( Buffer + 16 );
+	Response.LastLatencyNs = GetU32( Buffer + 20 );
+	Response.MinLatencyNs  = GetU32( Buffer + 24 );
+	Response.MaxLatencyNs  = GetU32( Buffer + 28 );
+	return Buffer[0] == COMMAND_RESPONSE_MAGIC;
+} // DecodeResponse
+
+#endif // COMMANDPROTOCOL_H
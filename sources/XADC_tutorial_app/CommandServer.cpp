@@ -0,0 +1,120 @@
+/*
+This is the source file of the command server of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifdef __linux__
+#   include <sys/socket.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
+#   include <unistd.h>
+#   include <cerrno>
+#   define CLOSE_SOCKET ::close
+#else // If not Linux, we assume FreeRTOS with lwIP
+/* lwIP must be included before any header, which includes sys/errno.h (see the comment in SocketSink.cpp).
+ * This file doesn't use the C++ streams, so no macros need to be un-defined. */
+#   include "lwip/sockets.h"
+#   define CLOSE_SOCKET lwip_close
+#endif
+
+#include "CommandServer.h"
+
+int CommandServer::Open( unsigned short Port )
+{
+	Close();
+
+	if( (ListenSocket = socket( AF_INET, SOCK_STREAM, 0 )) < 0 )
+		return errno;
+
+	int Enable = 1; // Allow the server to be restarted while the previous connection is in TIME_WAIT
+	setsockopt( ListenSocket, SOL_SOCKET, SO_REUSEADDR, &Enable, sizeof(Enable) );
+
+	struct sockaddr_in Addr = {};
+	Addr.sin_family      = AF_INET;
+	Addr.sin_port        = htons( Port );
+	Addr.sin_addr.s_addr = htonl( INADDR_ANY );
+
+	if( bind( ListenSocket, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 || listen( ListenSocket, 1 ) < 0 ) {
+		int Error = errno;
+		Close();
+		return Error;
+	}
+	return 0;
+} // CommandServer::Open
+
+void CommandServer::Close()
+{
+	if( ListenSocket >= 0 ) {
+		CLOSE_SOCKET( ListenSocket );
+		ListenSocket = -1;
+	}
+} // CommandServer::Close
+
+int CommandServer::Run( CommandHandler &Handler )
+{
+	while( ListenSocket >= 0 ) {
+		int Client = accept( ListenSocket, nullptr, nullptr );
+		if( Client < 0 )
+			return errno;
+
+		// The responses are small; we don't want the Nagle's algorithm to hold them back
+		int Enable = 1;
+		setsockopt( Client, IPPROTO_TCP, TCP_NODELAY, &Enable, sizeof(Enable) );
+
+		ServeClient( Client, Handler );
+		CLOSE_SOCKET( Client );
+	}
+	return 0;
+} // CommandServer::Run
+
+void CommandServer::ServeClient( int Client, CommandHandler &Handler )
+{
+	uint8_t RequestBuffer[ COMMAND_REQUEST_SIZE ];
+	uint8_t ResponseBuffer[ COMMAND_RESPONSE_SIZE ];
+
+	while( true ) {
+		// Receive a complete request; TCP may deliver it in pieces
+		int Received = 0;
+		while( Received < COMMAND_REQUEST_SIZE ) {
+			int n = recv( Client, RequestBuffer + Received, COMMAND_REQUEST_SIZE - Received, 0 );
+			if( n <= 0 )
+				return; // The client closed the connection or the connection failed
+			Received += n;
+		}
+		Timestamp ReceivedTime = TimestampNow(); // The command-to-DMA-start latency is measured from here
+
+		CommandRequest  Request;
+		CommandResponse Response = {};
+		if( DecodeRequest( RequestBuffer, Request ) )
+			Handler.Execute( Request, ReceivedTime, Response );
+		else
+			Response.Result = CommandResult::BadCommand;
+		Response.Command  = Request.Command;
+		Response.Sequence = Request.Sequence;
+
+		EncodeResponse( Response, ResponseBuffer );
+		if( send( Client, ResponseBuffer, COMMAND_RESPONSE_SIZE, 0 ) != COMMAND_RESPONSE_SIZE )
+			return;
+	}
+} // CommandServer::ServeClient
@@ -0,0 +1,68 @@
+/*
+This is the header file of the command server of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef COMMANDSERVER_H
+#define COMMANDSERVER_H
+
+#include "CommandProtocol.h"
+#include "Timestamp.h"
+
+/* CommandHandler executes the requests received by the CommandServer.
+ * The firmware implements it by passing the requests to XADC_thread; the board simulation on Linux implements it
+ * by a simulated capture. */
+class CommandHandler {
+public:
+	virtual ~CommandHandler() {}
+
+	/* Execute the Request received at the time Received and fill in the Response
+	 * (Command and Sequence are filled in by the server). It's called in the thread running CommandServer::Run(). */
+	virtual void Execute( const CommandRequest &Request, Timestamp Received, CommandResponse &Response ) = 0;
+}; // CommandHandler
+
+/* CommandServer listens on a TCP port and serves the binary requests defined in CommandProtocol.h.
+ * It serves one client at a time; the next client is accepted when the previous one closed the connection.
+ * The class works with lwIP on the board and with the POSIX sockets on Linux. */
+class CommandServer {
+public:
+	CommandServer() {}
+	~CommandServer() { Close(); }
+
+	// Start listening on the Port. Returns 0, or the errno of the socket function, which failed.
+	int Open( unsigned short Port );
+
+	/* Accept the clients and pass their requests to the Handler. The function returns only when accepting
+	 * a client fails; it returns the errno then. */
+	int Run( CommandHandler &Handler );
+
+	void Close();
+
+private:
+	void ServeClient( int Client, CommandHandler &Handler );
+
+	int ListenSocket = -1; // The listening socket file descriptor; value <0 means that the socket is closed
+}; // CommandServer
+
+#endif // COMMANDSERVER_H
@@ -0,0 +1,97 @@
+/*
+This is the header file of the rings passing the captures between the two cores of Zynq-7000.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CORERING_H
+#define CORERING_H
+
+#include <cstdint>
+#include <new>
+#include "SpscRing.h"
+
+/* The memory shared by the two cores in the dual-core split (see README.md): the upper 64 kB of OCM, which both
+ * cores map at the same address. The standalone BSP of each core must leave it out of its linker script. */
+#define CORE_RING_OCM_BASE 0xFFFF0000
+#define CORE_RING_OCM_SIZE 0x10000
+
+/* Set CORE_RING_CACHED to 0, when both cores map the shared memory as non-cacheable (recommended; then only
+ * the barriers are needed). Set it to 1, when the memory is cacheable; the rings then use SpscNonCoherent, i.e.,
+ * they do the cache maintenance. The host test builds both variants (-DCORE_RING_CACHED=1). */
+#ifndef CORE_RING_CACHED
+#define CORE_RING_CACHED 0
+#endif
+
+#define CORE_RING_SLOTS 64         // Number of the slots of each ring (a power of 2)
+#define CORE_RING_MAGIC 0x474E4952 // "RING"; written by CoreRingsInitialize() as the last step
+
+// A finished capture handed over from the acquisition core (CPU1) to the network core (CPU0). It fills a cache line.
+struct CaptureDescriptor {
+	uint32_t Address;  // Address of the samples in DDR (the same on both cores)
+	uint32_t Bytes;    // Number of bytes the DMA wrote
+	uint32_t Number;   // Number of the capture since the start
+	uint32_t Buffer;   // Index of the buffer; the network core hands it back through the return ring when it's sent
+	uint64_t DmaStart; // Timestamp of the start signal (the global timer is common to both cores)
+	uint64_t DmaDone;  // Timestamp of the end of the DMA transfer
+};
+static_assert( sizeof(CaptureDescriptor) == 32, "CaptureDescriptor must fill a cache line of Zynq" );
+
+#if CORE_RING_CACHED
+typedef SpscRing<CaptureDescriptor, CORE_RING_SLOTS, SpscNonCoherent> CoreRing;
+#else
+typedef SpscRing<CaptureDescriptor, CORE_RING_SLOTS, SpscMultiCore> CoreRing;
+#endif
+
+/* The rings of the dual-core split in the shared memory. Both programs see the same object at CORE_RING_OCM_BASE;
+ * the network core constructs it by CoreRingsInitialize() before it starts the acquisition core, which waits
+ * for it by CoreRingsAttach().
+ *
+ * The rings pass only the descriptors. The samples stay in DDR; the network core must invalidate them in its cache
+ * before reading (DmaRegion::AfterDeviceWrite()), like for a DMA transfer done on the same core. */
+struct CoreRings {
+	alignas(SPSC_RING_LINE_SIZE) uint32_t Magic = 0; // CORE_RING_MAGIC when the rings are constructed
+	CoreRing Captures; // The finished captures, from the acquisition core to the network core
+	CoreRing Returns;  // The buffers, which were sent, from the network core back to the acquisition core
+};
+static_assert( sizeof(CoreRings) <= CORE_RING_OCM_SIZE, "The rings don't fit in the shared memory" );
+
+// Construct empty rings in the shared Memory (aligned on SPSC_RING_LINE_SIZE) and mark them ready for the other side
+static inline CoreRings *CoreRingsInitialize( void *Memory )
+{
+	CoreRings *Rings = new( Memory ) CoreRings;
+	CoreRing::SyncPolicy::Publish( Rings, sizeof(CoreRings) );
+	CoreRing::SyncPolicy::Store( Rings->Magic, CORE_RING_MAGIC ); // The rings are written before the magic
+	CoreRing::SyncPolicy::Publish( &Rings->Magic, sizeof(Rings->Magic) );
+	return Rings;
+} // CoreRingsInitialize
+
+// Get the rings in the shared Memory constructed by the other side. Returns nullptr when they aren't constructed (yet).
+static inline CoreRings *CoreRingsAttach( void *Memory )
+{
+	CoreRings *Rings = static_cast<CoreRings *>( Memory );
+	CoreRing::SyncPolicy::Refresh( Rings, sizeof(CoreRings) );
+	return CoreRing::SyncPolicy::Load( Rings->Magic ) == CORE_RING_MAGIC ? Rings : nullptr;
+} // CoreRingsAttach
+
+#endif // CORERING_H
@@ -0,0 +1,187 @@
+/*
+This is the source file of the pool of DMA buffers used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "DmaBufferPool.h"
+#include "FreeRTOS.h"
+#include "xstatus.h"
+#include "xil_exception.h"
+#include "xpseudo_asm.h"
+
+// Interrupt nesting depth kept by the FreeRTOS port for Cortex-A9 (port.c); it's 0 outside of the ISRs
+extern "C" volatile uint32_t ulPortInterruptNesting;
+
+/* Disable IRQ and return the previous CPSR. Unlike taskENTER_CRITICAL(), this works the same way in a task
+ * and in an ISR, so the handles can be copied and destroyed anywhere. */
+static inline u32 EnterCritical()
+{
+	u32 Cpsr = mfcpsr();
+	Xil_ExceptionDisableMask( XIL_EXCEPTION_IRQ );
+	return Cpsr;
+} // EnterCritical
+
+// Enable IRQ again, if it was enabled before EnterCritical()
+static inline void ExitCritical( u32 Cpsr )
+{
+	if( (Cpsr & XIL_EXCEPTION_IRQ) == 0 ) // The I bit of CPSR is 0 when IRQ is enabled
+		Xil_ExceptionEnableMask( XIL_EXCEPTION_IRQ );
+} // ExitCritical
+
+DmaBuffer::DmaBuffer( const DmaBuffer &Other ) : Pool( Other.Pool ), Block( Other.Block )
+{
+	if( Pool )
+		Pool->AddRef( Block );
+} // DmaBuffer::DmaBuffer
+
+DmaBuffer &DmaBuffer::operator=( const DmaBuffer &Other )
+{
+	if( Other.Pool )
+		Other.Pool->AddRef( Other.Block ); // Before Release(), in case both handles hold the same block
+	Release();
+	Pool  = Other.Pool;
+	Block = Other.Block;
+	return *this;
+} // DmaBuffer::operator=
+
+DmaBuffer &DmaBuffer::operator=( DmaBuffer &&Other )
+{
+	if( this != &Other ) {
+		Release();
+		Pool  = Other.Pool;
+		Block = Other.Block;
+		Other.Pool = nullptr;
+	}
+	return *this;
+} // DmaBuffer::operator=
+
+void DmaBuffer::Release()
+{
+	if( Pool ) {
+		Pool->Release( Block );
+		Pool = nullptr;
+	}
+} // DmaBuffer::Release
+
+u16 DmaBuffer::Detach()
+{
+	Pool = nullptr;
+	return Block;
+} // DmaBuffer::Detach
+
+void *DmaBuffer::Data() const
+{
+	return Pool ? Pool->Blocks[ Block ] : nullptr;
+} // DmaBuffer::Data
+
+u32 DmaBuffer::Size() const
+{
+	return Pool ? Pool->Size : 0;
+} // DmaBuffer::Size
+
+void DmaBuffer::BeforeDeviceWrite( u32 Length ) const
+{
+	configASSERT( ulPortInterruptNesting == 0 ); // The cache maintenance of up to a whole block is too long for an ISR
+	if( Pool )
+		Pool->MemoryRegion->BeforeDeviceWrite( Pool->Blocks[ Block ], Length < Pool->Size ? Length : Pool->Size );
+} // DmaBuffer::BeforeDeviceWrite
+
+int DmaBufferPool::Initialize( DmaRegion &Region, u32 BlockSize, u16 BlockCount )
+{
+	if( BlockCount == 0 || BlockCount > MAX_BLOCKS )
+		return XST_FAILURE;
+
+	MemoryRegion = &Region;
+	Size  = BlockSize;
+	Count = BlockCount;
+
+	FreeHead = NO_BLOCK;
+	for( int i = BlockCount - 1; i >= 0; i-- ) {
+		Blocks[i] = (u8 *)Region.Allocate( BlockSize );
+		if( Blocks[i] == nullptr )
+			return XST_FAILURE;
+		RefCounts[i] = 0;
+		NextFree[i]  = FreeHead;
+		FreeHead     = u16(i);
+	}
+
+	InUse = 0;
+	ResetStatistics();
+	return XST_SUCCESS;
+} // DmaBufferPool::Initialize
+
+DmaBuffer DmaBufferPool::Allocate()
+{
+	u32 Cpsr = EnterCritical();
+
+	u16 Block = FreeHead;
+	if( Block == NO_BLOCK ) {
+		Exhaustions++;
+		ExitCritical( Cpsr );
+		return DmaBuffer();
+	}
+	FreeHead = NextFree[ Block ];
+	RefCounts[ Block ] = 1;
+	Allocations++;
+	if( ++InUse > HighWater )
+		HighWater = InUse;
+
+	ExitCritical( Cpsr );
+	return DmaBuffer( this, Block );
+} // DmaBufferPool::Allocate
+
+void DmaBufferPool::AddRef( u16 Block )
+{
+	u32 Cpsr = EnterCritical();
+	RefCounts[ Block ]++;
+	ExitCritical( Cpsr );
+} // DmaBufferPool::AddRef
+
+void DmaBufferPool::Release( u16 Block )
+{
+	u32 Cpsr = EnterCritical();
+	if( --RefCounts[ Block ] == 0 ) { // Nobody holds the block now, it gets back to the free list
+		NextFree[ Block ] = FreeHead;
+		FreeHead = Block;
+		InUse--;
+	}
+	ExitCritical( Cpsr );
+} // DmaBufferPool::Release
+
+DmaBufferPool::Statistics DmaBufferPool::GetStatistics() const
+{
+	u32 Cpsr = EnterCritical();
+	Statistics Stats{ Size, Count, InUse, HighWater, Allocations, Exhaustions };
+	ExitCritical( Cpsr );
+	return Stats;
+} // DmaBufferPool::GetStatistics
+
+void DmaBufferPool::ResetStatistics()
+{
+	u32 Cpsr = EnterCritical();
+	HighWater   = InUse;
+	Allocations = 0;
+	Exhaustions = 0;
+	ExitCritical( Cpsr );
+} // DmaBufferPool::ResetStatistics
@@ -0,0 +1,134 @@
+/*
+This is the header file of the pool of DMA buffers used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef DMABUFFERPOOL_H
+#define DMABUFFERPOOL_H
+
+#include "DmaMemory.h"
+
+class DmaBufferPool;
+
+/* DmaBuffer is a reference-counted handle of a block of a DmaBufferPool.
+ * Copying the handle adds a reference, destroying it (or calling Release()) removes one. The block returns
+ * to the pool when the last reference is removed. So the DMA, the data processing and the network sending can each
+ * hold the same buffer without copying the data.
+ * Copying, destroying, Release(), Detach() and DmaBufferPool::Adopt() are O(1) and can be used in a task as well as
+ * in an ISR. BeforeDeviceWrite() isn't: its time grows with the length, so it must not be called in an ISR. */
+class DmaBuffer {
+public:
+	DmaBuffer() {}
+	DmaBuffer( const DmaBuffer &Other );
+	DmaBuffer( DmaBuffer &&Other ) : Pool( Other.Pool ), Block( Other.Block ) { Other.Pool = nullptr; }
+	DmaBuffer &operator=( const DmaBuffer &Other );
+	DmaBuffer &operator=( DmaBuffer &&Other );
+	~DmaBuffer() { Release(); }
+
+	// Remove the reference held by this handle; the handle becomes empty
+	void Release();
+
+	/* Hand the reference over to the returned block index, e.g., to pass the buffer through a FreeRTOS queue
+	 * (which copies bytes and doesn't know about the references). The handle becomes empty.
+	 * DmaBufferPool::Adopt() creates a handle from the index again. */
+	u16 Detach();
+
+	explicit operator bool() const { return Pool != nullptr; }
+	void *Data() const;
+	template <typename T> T *As() const { return (T *)Data(); }
+	u32 Size() const;
+	u16 BlockIndex() const { return Block; }
+
+	/* Prepare the first Length bytes of the block for being written by the DMA (DmaRegion::BeforeDeviceWrite()).
+	 * Call it with the length of the transfer before the transfer is started. It takes time proportional to Length,
+	 * so it's asserted that it isn't called in an ISR. */
+	void BeforeDeviceWrite( u32 Length ) const;
+
+private:
+	friend class DmaBufferPool;
+	DmaBuffer( DmaBufferPool *Pool, u16 Block ) : Pool( Pool ), Block( Block ) {}
+
+	DmaBufferPool *Pool  = nullptr; // nullptr when the handle is empty
+	u16            Block = 0;
+}; // DmaBuffer
+
+/* DmaBufferPool is a pool of fixed-size buffers for DMA transfers carved out of a DmaRegion at startup.
+ * The blocks are aligned on the cache line. The pool doesn't do any cache maintenance of a block: the owner prepares
+ * only the range the next transfer writes (DmaBuffer::BeforeDeviceWrite()), which is usually much shorter
+ * than the block.
+ * Allocation takes a block from the head of a free list, and the release puts it back, both in O(1).
+ * The pool never uses the heap.
+ * The free list and the reference counts are guarded by a short section with IRQ disabled,
+ * which makes the pool safe to use in a task as well as in an ISR. */
+class DmaBufferPool {
+public:
+	static const u16 MAX_BLOCKS = 64; // Max. number of blocks of a pool
+
+	// Counters for sizing of the pool
+	struct Statistics {
+		u32 BlockSize;   // Size of a block in bytes
+		u16 BlockCount;  // Number of blocks of the pool
+		u16 InUse;       // Number of blocks allocated now
+		u16 HighWater;   // Max. number of blocks allocated at the same time
+		u32 Allocations; // Number of successful allocations
+		u32 Exhaustions; // Number of allocations, which failed because all the blocks were in use
+	};
+
+	/* Carve BlockCount blocks of BlockSize bytes out of the Region.
+	 * Returns XST_SUCCESS, or XST_FAILURE when BlockCount is higher than MAX_BLOCKS or the region is too small. */
+	int Initialize( DmaRegion &Region, u32 BlockSize, u16 BlockCount );
+
+	// Get a buffer from the pool. Returns an empty handle when all the blocks are in use.
+	DmaBuffer Allocate();
+
+	// Create a handle taking over the reference handed over by DmaBuffer::Detach()
+	DmaBuffer Adopt( u16 Block ) { return DmaBuffer( this, Block ); }
+
+	const DmaRegion &Region() const { return *MemoryRegion; }
+	u32 BlockSize() const { return Size; }
+
+	Statistics GetStatistics() const;
+	void ResetStatistics(); // Zero the counters and set the high-water mark to the number of blocks in use
+
+private:
+	friend class DmaBuffer;
+	void AddRef( u16 Block );
+	void Release( u16 Block );
+
+	static const u16 NO_BLOCK = 0xFFFF; // End of the free list
+
+	DmaRegion *MemoryRegion = nullptr;
+	u8        *Blocks[ MAX_BLOCKS ];   // Memory of the blocks
+	u16        RefCounts[ MAX_BLOCKS ];
+	u16        NextFree[ MAX_BLOCKS ]; // Free list; the index of the next free block
+	u16        FreeHead  = NO_BLOCK;
+	u32        Size      = 0;
+	u16        Count     = 0;
+	u16        InUse     = 0;
+	u16        HighWater = 0;
+	u32        Allocations = 0;
+	u32        Exhaustions = 0;
+}; // DmaBufferPool
+
+#endif // DMABUFFERPOOL_H
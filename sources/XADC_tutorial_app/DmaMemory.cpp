@@ -0,0 +1,93 @@
+/*
+This is the source file of the allocator of the memory for DMA buffers used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "DmaMemory.h"
+#include "xstatus.h"
+#include "xil_cache.h"
+#include "xil_mmu.h"
+
+int DmaRegion::Initialize( void *Base, u32 Size, DmaMemoryType Type )
+{
+	if( Size == 0 || (UINTPTR)Base % DMA_MMU_SECTION_SIZE != 0 || Size % DMA_MMU_SECTION_SIZE != 0 )
+		return XST_FAILURE;
+
+	RegionBase = (u8 *)Base;
+	RegionSize = Size;
+	UsedBytes  = 0;
+	MemoryType = Type;
+
+	/* Write to RAM and invalidate whatever the cache holds of the region (e.g., zeros written during the startup).
+	 * No dirty cache line can then overwrite data written by the DMA, and no stale line remains in the cache
+	 * when we change the memory type below. */
+	Xil_DCacheFlushRange( (UINTPTR)Base, Size );
+
+	if( Type != DmaMemoryType::Cached ) {
+		u32 Attributes = Type == DmaMemoryType::Uncached ? NORM_NONCACHE : NORM_WT_CACHE;
+		for( u32 Offset = 0; Offset < Size; Offset += DMA_MMU_SECTION_SIZE )
+			Xil_SetTlbAttributes( (UINTPTR)Base + Offset, Attributes );
+	}
+
+	return XST_SUCCESS;
+} // DmaRegion::Initialize
+
+void *DmaRegion::Allocate( u32 Size )
+{
+	// Round the size up to whole cache lines, so the next buffer starts on a cache line
+	u32 AlignedSize = ( Size + DMA_CACHE_LINE_SIZE - 1 ) & ~u32(DMA_CACHE_LINE_SIZE - 1);
+
+	if( Size == 0 || AlignedSize > RegionSize - UsedBytes )
+		return nullptr;
+
+	void *Buffer = RegionBase + UsedBytes;
+	UsedBytes += AlignedSize;
+	return Buffer;
+} // DmaRegion::Allocate
+
+void DmaRegion::InvalidateLines( const void *Buffer, u32 Size )
+{
+	/* Xil_DCacheInvalidateRange() flushes the partial cache lines at the ends of an unaligned range (to protect data
+	 * of the neighbors). Our buffers own their cache lines, so we align the range and the lines are only invalidated. */
+	UINTPTR Start = (UINTPTR)Buffer & ~UINTPTR(DMA_CACHE_LINE_SIZE - 1);
+	UINTPTR End   = ( (UINTPTR)Buffer + Size + DMA_CACHE_LINE_SIZE - 1 ) & ~UINTPTR(DMA_CACHE_LINE_SIZE - 1);
+
+	Xil_DCacheInvalidateRange( Start, End - Start );
+} // DmaRegion::InvalidateLines
+
+void DmaRegion::BeforeDeviceWrite( const void *Buffer, u32 Size ) const
+{
+	/* Only a write-back cache can hold dirty lines, which it could write over the data written by the DMA.
+	 * Invalidating them is enough, because their content is going to be overwritten anyway. */
+	if( MemoryType == DmaMemoryType::Cached )
+		InvalidateLines( Buffer, Size );
+} // DmaRegion::BeforeDeviceWrite
+
+void DmaRegion::AfterDeviceWrite( const void *Buffer, u32 BytesWritten ) const
+{
+	/* The CPU may have loaded (or speculatively prefetched) lines of the buffer into the cache while the DMA was writing.
+	 * We invalidate them, so the CPU reads the data from RAM. */
+	if( MemoryType != DmaMemoryType::Uncached && BytesWritten > 0 )
+		InvalidateLines( Buffer, BytesWritten );
+} // DmaRegion::AfterDeviceWrite
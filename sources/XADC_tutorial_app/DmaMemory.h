@@ -0,0 +1,84 @@
+/*
+This is the header file of the allocator of the memory for DMA buffers used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef DMAMEMORY_H
+#define DMAMEMORY_H
+
+#include "xil_types.h"
+
+#define DMA_CACHE_LINE_SIZE  32       // Cache line size of the L1 caches of Cortex-A9 and of the L2 cache of Zynq-7000
+#define DMA_MMU_SECTION_SIZE 0x100000 // The MMU sets memory attributes per section of 1 MB
+
+// Size rounded up to whole MMU sections. Use it to declare the memory of a DmaRegion.
+#define DMA_REGION_SIZE(Size) ( ( (Size) + DMA_MMU_SECTION_SIZE - 1 ) / DMA_MMU_SECTION_SIZE * DMA_MMU_SECTION_SIZE )
+
+/* Type of the memory of a DmaRegion. It defines, which cache maintenance a DMA transfer to a buffer needs.
+ * The DMA writes directly to RAM, and the CPU must not read stale data from its cache afterwards. */
+enum class DmaMemoryType {
+	Cached,       // Write-back cacheable (the default mapping of DDR). The range the DMA writes is invalidated
+	              // before and after the transfer (no flush is needed, because no cache line is shared between buffers).
+	WriteThrough, // Write-through cacheable. There are never dirty cache lines, so only the range the DMA actually wrote
+	              // is invalidated after the transfer.
+	Uncached      // Non-cacheable. No cache maintenance is needed, but every read of the CPU goes to RAM.
+};
+
+/* DmaRegion is a region of memory, which DMA buffers are allocated from.
+ * The buffers are aligned on the cache line and their size is rounded up to whole cache lines, so the cache maintenance
+ * of one buffer never affects another buffer or other data. */
+class DmaRegion {
+public:
+	/* Initialize the region in the memory Base of Size bytes and set its memory type in the MMU.
+	 * Base and Size must be aligned on DMA_MMU_SECTION_SIZE; declare the memory as:
+	 *   static u8 Memory[ DMA_REGION_SIZE(n) ] __attribute__((aligned(DMA_MMU_SECTION_SIZE)));
+	 * Returns XST_SUCCESS or XST_FAILURE (when Base or Size is not aligned). */
+	int Initialize( void *Base, u32 Size, DmaMemoryType Type );
+
+	/* Allocate a buffer of Size bytes. Returns nullptr when there is not enough free memory in the region.
+	 * The buffers can't be freed; allocate them during the initialization of the application. */
+	void *Allocate( u32 Size );
+
+	/* Prepare Size bytes of the Buffer for being written by the DMA. Call it before the transfer is started.
+	 * Buffer must be a buffer (or a part of it starting on a cache line) allocated from this region. */
+	void BeforeDeviceWrite( const void *Buffer, u32 Size ) const;
+
+	/* Make BytesWritten bytes, which the DMA wrote to the Buffer, visible to the CPU. Call it after the transfer is done.
+	 * BytesWritten is what the DMA actually transferred (its buffer length register), i.e., only this range is invalidated. */
+	void AfterDeviceWrite( const void *Buffer, u32 BytesWritten ) const;
+
+	DmaMemoryType Type() const { return MemoryType; }
+	u32 FreeBytes() const { return RegionSize - UsedBytes; }
+
+private:
+	u8  *RegionBase = nullptr;
+	u32  RegionSize = 0;
+	u32  UsedBytes  = 0;
+	DmaMemoryType MemoryType = DmaMemoryType::Cached;
+
+	// Invalidate the cache lines of Size bytes at Buffer (the range is extended to whole cache lines)
+	static void InvalidateLines( const void *Buffer, u32 Size );
+};
+
+#endif // DMAMEMORY_H
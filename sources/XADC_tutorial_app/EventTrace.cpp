@@ -0,0 +1,122 @@
+/*
+This is the source file of the event trace of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "EventTrace.h"
+
+#if EVENT_TRACE
+#include <cstring>
+
+#if !defined(__linux__) && !defined(__WIN32__) // If not Linux nor Windows, we assume Zynq with FreeRTOS
+#include "FreeRTOS.h"
+#include "task.h"
+#include "xil_types.h"
+#endif
+
+TraceRecord           TraceRing[ EVENT_TRACE_SIZE ];
+std::atomic<uint32_t> TraceHead{ 0 };
+std::atomic<bool>     TraceRunning{ true };
+
+#define TRACE_MAX_TASKS 16 // Max. number of the tasks, which names are registered
+
+// Names of the tasks registered by TraceTaskStart()
+struct TraceTask {
+	uint32_t    Task;
+	const char *Name;
+};
+static TraceTask             TraceTasks[ TRACE_MAX_TASKS ];
+static std::atomic<uint32_t> TraceTaskCount{ 0 };
+
+uint32_t TraceCurrentTask()
+{
+#if defined(__linux__) || defined(__WIN32__)
+	// The threads are numbered from 1 in the order they record their first event
+	static std::atomic<uint32_t> NextThread{ 1 };
+	static thread_local uint32_t Thread = NextThread.fetch_add( 1, std::memory_order_relaxed );
+	return Thread;
+#else
+	return uint32_t( (UINTPTR)xTaskGetCurrentTaskHandle() );
+#endif
+} // TraceCurrentTask
+
+void TraceTaskStart( const char *Name )
+{
+	uint32_t Task = TraceCurrentTask();
+	uint32_t Index = TraceTaskCount.fetch_add( 1, std::memory_order_relaxed );
+
+	if( Index < TRACE_MAX_TASKS )
+		TraceTasks[ Index ] = TraceTask{ Task, Name };
+	TraceWrite( TraceEvent::TaskStart, Task, 0 );
+} // TraceTaskStart
+
+void TraceClear()
+{
+	TraceHead.store( 0, std::memory_order_relaxed );
+} // TraceClear
+
+// Append the little-endian bytes of Value to Out
+static void PutLittleEndian( std::ostream &Out, uint64_t Value, int Size )
+{
+	for( int i = 0; i < Size; i++ )
+		Out.put( char( Value >> (8 * i) ) );
+} // PutLittleEndian
+
+uint32_t TraceDump( std::ostream &Out )
+{
+	bool WasRunning = TraceRunning.exchange( false );
+
+	uint32_t Head   = TraceHead.load();
+	uint32_t Count  = Head < EVENT_TRACE_SIZE ? Head : EVENT_TRACE_SIZE;
+	uint32_t Tasks  = TraceTaskCount.load();
+	if( Tasks > TRACE_MAX_TASKS )
+		Tasks = TRACE_MAX_TASKS;
+
+	PutLittleEndian( Out, TRACE_DUMP_MAGIC, 4 );
+	PutLittleEndian( Out, TRACE_DUMP_VERSION, 2 );
+	PutLittleEndian( Out, Tasks, 2 );
+	PutLittleEndian( Out, Count, 4 );
+	PutLittleEndian( Out, TIMESTAMP_TICKS_PER_SECOND, 4 );
+
+	for( uint32_t t = 0; t < Tasks; t++ ) {
+		char Name[ TRACE_TASK_NAME_SIZE ] = {};
+		strncpy( Name, TraceTasks[t].Name, TRACE_TASK_NAME_SIZE - 1 );
+		PutLittleEndian( Out, TraceTasks[t].Task, 4 );
+		Out.write( Name, TRACE_TASK_NAME_SIZE );
+	}
+
+	// Both the board and the Linux hosts are little-endian, so the records are written as they are
+	for( uint32_t i = Head - Count; i != Head; i++ )
+		Out.write( (const char *)&TraceRing[ i & (EVENT_TRACE_SIZE - 1) ], sizeof(TraceRecord) );
+	Out.flush();
+
+	TraceRunning.store( WasRunning );
+	return Count;
+} // TraceDump
+#else
+uint32_t TraceCurrentTask() { return 0; }
+void TraceTaskStart( const char * ) {}
+void TraceClear() {}
+uint32_t TraceDump( std::ostream & ) { return 0; }
+#endif // EVENT_TRACE
@@ -0,0 +1,146 @@
+/*
+This is the header file of the event trace of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+/* Set EVENT_TRACE to 1 to record a timeline of the events of the tasks (see TraceEvent) into a ring buffer.
+ * When it's 0, the trace points are compiled out, i.e., they cost nothing. The macro can also be set on the command line
+ * of the compiler (-DEVENT_TRACE=1), which is handy for the host tools. */
+#ifndef EVENT_TRACE
+#define EVENT_TRACE 0
+#endif
+
+// Number of events the ring buffer holds (must be a power of two). Each event takes 16 bytes.
+#define EVENT_TRACE_SIZE 4096
+
+#include <cstdint>
+#include <ostream>
+#include <atomic>
+#include "Timestamp.h"
+
+// Events recorded by the trace points
+enum class TraceEvent : uint16_t {
+	TaskStart,      // A task started (the name of the task is registered by TraceTaskStart())
+	TaskStop,       // A task is about to end
+	CaptureBegin,   // A capture was triggered (Argument: number of the capture, lower 16 bits)
+	CaptureEnd,     // The capture was sent to the server (Argument: 1 when sent, 0 when sending failed)
+	DmaStart,       // The start signal of stream_tlaster was given (Argument: number of bytes, saturated to 0xFFFF)
+	DmaDone,        // The task saw the DMA transfer done (Argument: number of bytes, saturated to 0xFFFF)
+	DmaChunk,       // ISR: the DMA completed a chunk (Argument: block of the chunk, TRACE_CHUNK_DROPPED when discarded)
+	SendBegin,      // SocketBuffer calls send() (Argument: number of bytes, saturated to 0xFFFF)
+	SendEnd,        // send() returned (Argument: number of bytes sent, saturated to 0xFFFF; 0 on an error)
+	QueueWaitBegin, // A task starts waiting on a queue (Argument: TraceQueue)
+	QueueWaitEnd,   // The wait on the queue ended (Argument: TraceQueue, with TRACE_QUEUE_TIMEOUT when nothing came)
+	CommandBegin,   // XADC_thread starts executing a remote command (Argument: CommandCode)
+	CommandEnd,     // The remote command is done (Argument: CommandResult)
+	CaptureDrop,    // A capture of the continuous mode was dropped, the network is behind (Argument: number of the capture, lower 16 bits)
+	Count           // Number of the events
+};
+
+// Queues, which the QueueWait events refer to
+enum class TraceQueue : uint16_t {
+	FilledChunks,  // Chunks passed from the DMA interrupt handler to sender_thread
+	RemoteReplies, // Responses passed from XADC_thread to command_server_thread
+	SendJobs,      // Captures passed from XADC_thread to sender_thread
+};
+#define TRACE_QUEUE_TIMEOUT 0x8000 // Added to the argument of QueueWaitEnd, when the wait timed out
+#define TRACE_CHUNK_DROPPED 0xFFFF // Argument of DmaChunk, when the chunk was written into DiscardBuffer
+
+#define TRACE_TASK_ISR 0 // Task of the events recorded in an interrupt handler
+
+/* A record of the ring buffer. The dump sends the records as they are (little-endian); the layout is a part
+ * of the dump format described at TraceDump(). */
+struct TraceRecord {
+	uint64_t Time;     // Timestamp of the event
+	uint32_t Task;     // Handle of the FreeRTOS task (ID of the thread on Linux), TRACE_TASK_ISR in an ISR
+	uint16_t Event;    // TraceEvent
+	uint16_t Argument; // Meaning depends on the Event
+};
+static_assert( sizeof(TraceRecord) == 16, "TraceRecord must take 16 bytes" );
+static_assert( ( EVENT_TRACE_SIZE & (EVENT_TRACE_SIZE - 1) ) == 0, "EVENT_TRACE_SIZE must be a power of two" );
+
+#define TRACE_DUMP_MAGIC     0x43525458 // "XTRC" in the file
+#define TRACE_DUMP_VERSION   1
+#define TRACE_TASK_NAME_SIZE 28 // Size of a name in the task table of the dump, incl. the terminating zero
+
+/* The ring buffer is shared by the tasks and the interrupt handlers without any lock: a writer reserves a slot
+ * by the atomic increment of TraceHead (LDREX/STREX on Cortex-A9) and fills it in. When the ring is full,
+ * the oldest events are overwritten. */
+extern TraceRecord           TraceRing[ EVENT_TRACE_SIZE ];
+extern std::atomic<uint32_t> TraceHead;    // Number of events recorded since the start (or since TraceClear())
+extern std::atomic<bool>     TraceRunning; // Recording is paused while the ring is being dumped
+
+// Record the Event of the Task. It takes a few dozen cycles; it can be called in a task as well as in an ISR.
+static inline void TraceWrite( TraceEvent Event, uint32_t Task, uint16_t Argument )
+{
+	if( !TraceRunning.load( std::memory_order_relaxed ) )
+		return;
+	TraceRecord &Record = TraceRing[ TraceHead.fetch_add( 1, std::memory_order_relaxed ) & (EVENT_TRACE_SIZE - 1) ];
+	Record.Time     = TimestampNow();
+	Record.Task     = Task;
+	Record.Event    = uint16_t(Event);
+	Record.Argument = Argument;
+} // TraceWrite
+
+// Saturate a size to the 16-bit argument of an event
+static inline uint16_t TraceSize( uint64_t Size )
+{
+	return Size > 0xFFFF ? 0xFFFF : uint16_t(Size);
+} // TraceSize
+
+// Identification of the calling task recorded with the events
+uint32_t TraceCurrentTask();
+
+// Register the Name of the calling task (Name must be a string constant) and record TaskStart
+void TraceTaskStart( const char *Name );
+
+// Discard the events recorded so far
+void TraceClear();
+
+/* Write the recorded events to Out in the binary format read by trace2json (sources/host_tools). Recording is paused
+ * during the dump. Returns the number of events written.
+ * All the values are little-endian:
+ *   header (16 bytes): u32 TRACE_DUMP_MAGIC, u16 TRACE_DUMP_VERSION, u16 number of tasks, u32 number of events,
+ *                      u32 ticks of the timestamps per second
+ *   task table:        for each task u32 Task, char Name[ TRACE_TASK_NAME_SIZE ] (padded by zeros)
+ *   events:            TraceRecord of each event, the oldest first */
+uint32_t TraceDump( std::ostream &Out );
+
+#if EVENT_TRACE
+// Record the Event (without the "TraceEvent::") of the calling task
+#define TRACE_EVENT( Event, Argument )     TraceWrite( TraceEvent::Event, TraceCurrentTask(), (Argument) )
+// Record the Event in an interrupt handler
+#define TRACE_EVENT_ISR( Event, Argument ) TraceWrite( TraceEvent::Event, TRACE_TASK_ISR, (Argument) )
+// Register the name of the calling task and record its start
+#define TRACE_TASK_START( Name )           TraceTaskStart( Name )
+#else
+#define TRACE_EVENT( Event, Argument )     do {} while(0)
+#define TRACE_EVENT_ISR( Event, Argument ) do {} while(0)
+#define TRACE_TASK_START( Name )           do {} while(0)
+#endif
+
+#endif // EVENTTRACE_H
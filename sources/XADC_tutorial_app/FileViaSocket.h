@@ -30,24 +30,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef FILEVIASOCKET_H
 #define FILEVIASOCKET_H
 
+#include "SocketSink.h"
 #include <ostream>
 #include <exception>
+#include <string>
 
 /* SocketBuffer is the streambuf class which is used by the FileViaSocket ostream class.
- * All logic of sending data over an IP socket is implemented in this class. */
+ * It's a thin adapter: the logic of sending data over an IP socket is implemented in SocketSink (see SocketSink.h),
+ * the errors of opening the connection are turned into the exceptions of FileViaSocket.
+ * SocketBuffer has no put area, each character and sequence goes straight to the sink, so the writes to the stream
+ * and to its sink() can be mixed. */
 class SocketBuffer : public std::streambuf {
 public:
-	/* SOCKET_BUFF_SIZE is length of the array we use as buffer before sending the data via the socket.
-	 * Ideally it should be equal to the max. number of bytes sent in a TCP packet.
-	 * I tested using Wireshark that on FreeRTOS on Xilinx Zynq (using lwIP 2.1.3) 1446 bytes of data are sent
-	 * in one TCP packet. On Ubuntu 22.04 it's 1448 bytes and on Windows 11 it's 1460 bytes of data. */
-#ifdef __WIN32__
-	static int const SOCKET_BUFF_SIZE = 1460;
-#elif defined(__linux__)
-	static int const SOCKET_BUFF_SIZE = 1448;
-#else // If not Windows nor Linux, we assume FreeRTOS with lwIP
-	static int const SOCKET_BUFF_SIZE = 1446;
-#endif
+	static int const SOCKET_BUFF_SIZE = SocketSink::BUFFER_SIZE; // Size of the buffer of the sink
 
 	SocketBuffer() : std::streambuf() {}
 	SocketBuffer( const std::string &serverIP, unsigned short port ) : std::streambuf() {
@@ -56,7 +51,9 @@ public:
 	~SocketBuffer() override { close(); }
 
 	void open( const std::string &ip, unsigned short port );
-	void close();
+	void close() { Sink.close(); }
+
+	SocketSink &sink() { return Sink; }
 
 protected:
 	/* This method is called when ostream wants to write one character
@@ -70,9 +67,7 @@ protected:
 	int sync() override;
 
 private:
-	int Socket = -1;  // The IP socket file descriptor; value <0 means that the socket is closed
-	char buffer[SOCKET_BUFF_SIZE] = {}; // Buffer for writes to the socket
-	int bytesInBuffer{0};               // Number of bytes stored in the buffer
+	SocketSink Sink;
 }; //class SocketBuffer
 
 /* FileViaSocket is a simple descendant of ostream.
@@ -91,6 +86,14 @@ public:
 		Buff.close();
 	}
 
+	/* The sink the stream writes to. Writing the data, which need no formatting, (or formatting them without
+	 * the stream, e.g., the samples by FormatSampleValue()) directly to the sink avoids the overhead of ostream.
+	 * Opening the connection by sink().open() reports an error by a code instead of an exception.
+	 * The latency mode (SocketSink::setFlushDeadline()) and TCP_NODELAY are set on the sink, too. */
+	SocketSink &sink() {
+		return Buff.sink();
+	}
+
 protected:
 	SocketBuffer Buff;
 
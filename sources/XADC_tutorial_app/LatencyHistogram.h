@@ -0,0 +1,95 @@
+/*
+This is the header file of the latency histogram used by the XADC tutorial application and its host tools.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <cstdint>
+
+/* LatencyHistogram counts durations in logarithmic buckets: each power of two is split into 8 sub-buckets,
+ * so a percentile is known with the error below 12.5 %. Min and max are exact.
+ * Recording takes a few instructions regardless of the number of durations recorded. The histogram isn't thread-safe;
+ * the latency probes (see LatencyProbes.h) guard it, via_socket_server uses it from a single thread. */
+class LatencyHistogram {
+public:
+	void Record( uint64_t Ticks ) {
+		Buckets[ BucketIndex( Ticks ) ]++;
+		if( Count == 0 || Ticks < Min )
+			Min = Ticks;
+		if( Ticks > Max )
+			Max = Ticks;
+		Count++;
+	}
+
+	void Reset() { *this = LatencyHistogram(); }
+
+	uint32_t RecordedCount() const { return Count; }
+	uint64_t MinTicks() const { return Min; }
+	uint64_t MaxTicks() const { return Max; }
+
+	// The duration, which Permille thousandths of the recorded durations don't exceed (e.g., 990 for p99)
+	uint64_t Percentile( unsigned Permille ) const {
+		uint64_t Rank = ( uint64_t(Count) * Permille + 999 ) / 1000; // Rank of the duration, counted from 1
+		uint64_t Seen = 0;
+		for( int i = 0; i < BUCKET_COUNT; i++ ) {
+			Seen += Buckets[i];
+			if( Seen >= Rank && Seen > 0 ) {
+				uint64_t Upper = BucketUpperBound( i );
+				return Upper > Max ? Max : Upper < Min ? Min : Upper;
+			}
+		}
+		return Max;
+	}
+
+private:
+	static const int SUB_BUCKET_BITS = 3;
+	static const int SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+	static const int BUCKET_COUNT    = SUB_BUCKETS + ( 64 - SUB_BUCKET_BITS ) * SUB_BUCKETS;
+
+	// Values below SUB_BUCKETS have their own bucket, larger values share a bucket with the values of the same
+	// power of two and the same SUB_BUCKET_BITS bits below the most significant bit
+	static int BucketIndex( uint64_t v ) {
+		if( v < SUB_BUCKETS )
+			return int(v);
+		int Exponent = 63 - __builtin_clzll( v );
+		int Sub = int( v >> (Exponent - SUB_BUCKET_BITS) ) & ( SUB_BUCKETS - 1 );
+		return SUB_BUCKETS + ( Exponent - SUB_BUCKET_BITS ) * SUB_BUCKETS + Sub;
+	}
+	static uint64_t BucketUpperBound( int i ) {
+		if( i < SUB_BUCKETS )
+			return uint64_t(i);
+		int Exponent = ( i - SUB_BUCKETS ) / SUB_BUCKETS + SUB_BUCKET_BITS;
+		uint64_t Sub = uint64_t( ( i - SUB_BUCKETS ) % SUB_BUCKETS + SUB_BUCKETS );
+		return ( ( Sub + 1 ) << (Exponent - SUB_BUCKET_BITS) ) - 1;
+	}
+
+	uint32_t Buckets[ BUCKET_COUNT ] = {};
+	uint32_t Count = 0;
+	uint64_t Min   = 0;
+	uint64_t Max   = 0;
+}; // LatencyHistogram
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,100 @@
+/*
+This is the source file of the latency probes of the capture pipeline of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "LatencyProbes.h"
+#include "LatencyHistogram.h"
+#include "Timestamp.h"
+#include <iomanip>
+
+#if LATENCY_PROBES
+#if defined(__linux__) || defined(__WIN32__)
+#include <mutex>
+static std::mutex HistogramsMutex;
+#define HISTOGRAMS_LOCK()   HistogramsMutex.lock()
+#define HISTOGRAMS_UNLOCK() HistogramsMutex.unlock()
+#else // If not Linux nor Windows, we assume FreeRTOS on Zynq
+#include "FreeRTOS.h"
+#include "task.h"
+#define HISTOGRAMS_LOCK()   taskENTER_CRITICAL()
+#define HISTOGRAMS_UNLOCK() taskEXIT_CRITICAL()
+#endif
+
+static LatencyHistogram Histograms[ int(LatencyStage::Count) ];
+
+void LatencyRecord( LatencyStage Stage, uint64_t Ticks )
+{
+	HISTOGRAMS_LOCK();
+	Histograms[ int(Stage) ].Record( Ticks );
+	HISTOGRAMS_UNLOCK();
+} // LatencyRecord
+
+void LatencyReset()
+{
+	for( LatencyHistogram &h : Histograms ) {
+		HISTOGRAMS_LOCK();
+		h.Reset();
+		HISTOGRAMS_UNLOCK();
+	}
+} // LatencyReset
+
+void LatencyDump( std::ostream &Out )
+{
+	const char *StageNames[] = { "DMA arm", "start pulse", "DMA completion", "cache invalidate",
+	                             "conversion", "formatting", "socket send", "capture", "button" };
+	static_assert( sizeof(StageNames) / sizeof(StageNames[0]) == int(LatencyStage::Count), "a stage has no name" );
+
+	Out << "stage                count       min       p50       p99       max [us]\n"
+	    << std::fixed << std::setprecision(2);
+	for( int s = 0; s < int(LatencyStage::Count); s++ ) {
+		/* Only the printed values are taken under the lock, so that the printing doesn't hold it. A copy of the histogram
+		 * (about 2 kB) would be too large for the stack of the console task. */
+		HISTOGRAMS_LOCK();
+		const LatencyHistogram &h = Histograms[s];
+		const uint32_t Count = h.RecordedCount();
+		const uint64_t Min   = h.MinTicks();
+		const uint64_t P50   = h.Percentile( 500 );
+		const uint64_t P99   = h.Percentile( 990 );
+		const uint64_t Max   = h.MaxTicks();
+		HISTOGRAMS_UNLOCK();
+		Out << std::left << std::setw(17) << StageNames[s] << std::right << std::setw(9) << Count;
+		if( Count > 0 )
+			Out << std::setw(10) << TimestampToNs( Min ) / 1000.0
+			    << std::setw(10) << TimestampToNs( P50 ) / 1000.0
+			    << std::setw(10) << TimestampToNs( P99 ) / 1000.0
+			    << std::setw(10) << TimestampToNs( Max ) / 1000.0;
+		Out << '\n';
+	}
+	Out.flush();
+} // LatencyDump
+#else
+void LatencyRecord( LatencyStage, uint64_t ) {}
+void LatencyReset() {}
+
+void LatencyDump( std::ostream &Out )
+{
+	Out << "latency probes are disabled (set LATENCY_PROBES to 1 in LatencyProbes.h)" << std::endl;
+} // LatencyDump
+#endif // LATENCY_PROBES
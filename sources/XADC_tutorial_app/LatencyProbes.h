@@ -0,0 +1,86 @@
+/*
+This is the header file of the latency probes of the capture pipeline of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef LATENCYPROBES_H
+#define LATENCYPROBES_H
+
+/* Set LATENCY_PROBES to 1 to measure the time spent in each stage of a capture (see LatencyStage).
+ * When it's 0, the probes are compiled out, i.e., they cost nothing. The macro can also be set on the command line
+ * of the compiler (-DLATENCY_PROBES=1), which is handy for the host tools. */
+#ifndef LATENCY_PROBES
+#define LATENCY_PROBES 0
+#endif
+
+#include <cstdint>
+#include <ostream>
+
+// Stages of the capture pipeline measured by the probes
+enum class LatencyStage : uint8_t {
+	DmaArm,          // Setting the DMA up for a transfer (XAxiDma_SimpleTransfer)
+	StartPulse,      // The start signal of stream_tlaster
+	DmaCompletion,   // From the start signal till the DMA transfer is done (a chunk is received in the large-capture mode)
+	CacheInvalidate, // Cache maintenance after the transfer
+	Conversion,      // Demultiplexing and conversion to volts (the sequencer and simultaneous modes only;
+	                 // the single channel mode converts the samples while formatting them)
+	Formatting,      // Formatting the text sent to the server, incl. the SocketSend calls it makes
+	SocketSend,      // A single send() of SocketBuffer
+	Capture,         // The whole capture, from the trigger till the last byte was passed to the socket
+	Button,          // From the first edge of the button BTN0 till the start signal of the capture it triggered
+	Count            // Number of the stages
+};
+
+/* Record the duration Ticks (a difference of two timestamps) of the Stage.
+ * The stages are recorded by several tasks, so the histograms are guarded by a critical section (a mutex on Linux).
+ * Don't record a stage in an interrupt handler; pass the timestamp to a task instead. */
+void LatencyRecord( LatencyStage Stage, uint64_t Ticks );
+
+// Print min, p50, p99 and max of each stage measured so far
+void LatencyDump( std::ostream &Out );
+
+// Discard the durations recorded so far
+void LatencyReset();
+
+#if LATENCY_PROBES
+#include "Timestamp.h"
+
+// Declare the timestamp Name and start a measurement
+#define LATENCY_PROBE_START( Name )          Timestamp Name = TimestampNow()
+// Record the duration since the timestamp Name as the Stage and restart the measurement from now
+#define LATENCY_PROBE_LAP( Stage, Name )     do { Timestamp Now_ = TimestampNow(); \
+                                                  LatencyRecord( LatencyStage::Stage, Now_ - (Name) ); \
+                                                  (Name) = Now_; } while(0)
+// Record the duration Ticks as the Stage
+#define LATENCY_PROBE_RECORD( Stage, Ticks ) LatencyRecord( LatencyStage::Stage, (Ticks) )
+// Restart the measurement of the timestamp Name from now
+#define LATENCY_PROBE_RESTART( Name )        (Name) = TimestampNow()
+#else
+#define LATENCY_PROBE_START( Name )          do {} while(0)
+#define LATENCY_PROBE_LAP( Stage, Name )     do {} while(0)
+#define LATENCY_PROBE_RECORD( Stage, Ticks ) do {} while(0)
+#define LATENCY_PROBE_RESTART( Name )        do {} while(0)
+#endif
+
+#endif // LATENCYPROBES_H
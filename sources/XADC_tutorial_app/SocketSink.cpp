@@ -0,0 +1,345 @@
+/*
+This is the source file of the lightweight sink writing data to a remote system via an IP socket connection.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "SocketSink.h"
+#include "LatencyProbes.h"
+#include "EventTrace.h"
+#include <cstring>
+
+#ifdef __WIN32__
+#   include <winsock2.h>
+#   include <cerrno>
+#   define SHUTDOWN_HOW_BOTH SD_BOTH   // We pass this as a parameter to function shutdown()
+#elif defined(__linux__)
+#   include <sys/socket.h>
+#   include <arpa/inet.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
+#   include <unistd.h>
+#   include <cerrno>
+#   define SHUTDOWN_HOW_BOTH SHUT_RDWR // We pass this as a parameter to function shutdown()
+#else // If not Windows nor Linux, we assume FreeRTOS with lwIP
+/* When using lwIP and the C++ library together, we face an issue with two different definitions of errno.
+ * lwIP defines errno as a global variable in lwip/errno.h. lwIP functions set this global variable.
+ * However, the headers of the C++ library (e.g., ostream) take with them sys/errno.h
+ * (for example Xilinx/Vitis/2023.1/gnu/aarch32/nt/gcc-arm-none-eabi/aarch32-xilinx-eabi/usr/include/errno.h),
+ * which defines errno differently (as an attribute of global reentrancy structure, returned by function).
+ * By un-defining macro "errno" defined in sys/errno.h, we get access to the global variable errno defined
+ * in  lwip/errno.h. */
+#undef errno
+
+/* Following macros are defined in lwip/errno.h differently from sys/errno.h. We are un-defining
+ * them to avoid compiler warning (there is no other way to disable this warning). */
+#   undef ENAMETOOLONG
+#   undef EDEADLK
+#   undef ENOLCK
+#   undef ENOSYS
+#   undef ENOTEMPTY
+#   undef ELOOP
+#   undef ENOMSG
+#   undef EIDRM
+#   undef EMULTIHOP
+#   undef EBADMSG
+#   undef EOVERFLOW
+#   undef EILSEQ
+#   undef ENOTSOCK
+#   undef EDESTADDRREQ
+#   undef EMSGSIZE
+#   undef EPROTOTYPE
+#   undef EPROTONOSUPPORT
+#   undef EAFNOSUPPORT
+#   undef EADDRINUSE
+#   undef EADDRNOTAVAIL
+#   undef ENETDOWN
+#   undef ENETUNREACH
+#   undef ENETRESET
+#   undef ECONNABORTED
+#   undef EISCONN
+#   undef ENOTCONN
+#   undef ETOOMANYREFS
+#   undef ETIMEDOUT
+#   undef EHOSTDOWN
+#   undef EHOSTUNREACH
+#   undef EALREADY
+#   undef EINPROGRESS
+#   undef ESTALE
+#   undef EDQUOT
+#   undef ENOPROTOOPT
+
+#   include "lwip/sockets.h"
+#   define SHUTDOWN_HOW_BOTH SHUT_RDWR  // We pass this as a parameter to function shutdown()
+#   define INADDR_NONE IPADDR_NONE      // lwIP doesn't provide macro INADDR_NONE
+#   undef close  // Macro "close" defined in lwip/sockets.h messes with our methods named "close"
+#endif
+
+// errno of the last socket call (WSAGetLastError() on Windows)
+static inline int lastSocketError()
+{
+#ifdef __WIN32__
+	return WSAGetLastError();
+#else
+	return errno;
+#endif
+} // lastSocketError
+
+/* Call send() and record its duration as the stage SocketSend of the latency probes, and its begin and end
+ * in the event trace. Without the probes and the trace (see LatencyProbes.h and EventTrace.h), it's just the call of send(). */
+static inline long probedSend( int socket, const char *data, size_t n )
+{
+	TRACE_EVENT( SendBegin, TraceSize( n ) );
+	LATENCY_PROBE_START( sendStart );
+	long sent = send( socket, data, int(n), 0 );
+	LATENCY_PROBE_LAP( SocketSend, sendStart );
+	TRACE_EVENT( SendEnd, sent > 0 ? TraceSize( sent ) : 0 );
+	return sent;
+} // probedSend
+
+SinkError SocketSink::open( const char *serverIP, unsigned short port )
+{
+	close(); // We may still have an open socket from before
+	Error = SinkError::NotOpen;
+	SystemError = 0;
+	bytesInBuffer = 0;
+	Sends = 0;
+	FirstSend = LastSend = 0;
+
+	// Create socket
+	if( (Socket = socket(AF_INET, SOCK_STREAM, 0 )) < 0 )
+		return fail( SinkError::SocketCreation, lastSocketError() );
+
+	struct sockaddr_in serv_addr = {};
+	serv_addr.sin_family = AF_INET;
+	serv_addr.sin_port = htons(port);
+
+	// Convert the IPv4 address from text to binary form
+	serv_addr.sin_addr.s_addr = inet_addr( serverIP );
+	if( serv_addr.sin_addr.s_addr == INADDR_NONE )
+		return fail( SinkError::WrongAddress, 0 );
+
+	// Connect to the server
+	if( connect(Socket, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0 )
+		return fail( SinkError::Connection, lastSocketError() );
+
+	if( NoDelay >= 0 && !applyNoDelay() )
+		return fail( SinkError::Option, lastSocketError() );
+
+	Error = SinkError::None;
+	return Error;
+} // SocketSink::open
+
+SinkError SocketSink::close()
+{
+	if( Socket < 0 )
+		return SinkError::None;
+
+	SinkError Result = flush(); // Write remaining data from the buffer to the socket
+	shutdown(Socket, SHUTDOWN_HOW_BOTH); // Gracefully closing the socket
+
+#ifdef __WIN32__
+	closesocket( Socket ); // Calling Winsock2 function for closing the socket
+#elif defined(__linux__)
+	::close( Socket );     // Calling the global library function for closing the file descriptor
+#else // If not Windows nor Linux, we assume FreeRTOS with lwIP
+	lwip_close( Socket );
+#endif
+	Socket = -1;
+	bytesInBuffer = 0;
+	if( Error == SinkError::None )
+		Error = SinkError::NotOpen;
+	return Result;
+} // SocketSink::close
+
+SinkError SocketSink::write( const char *data, size_t size )
+{
+	if( Error != SinkError::None )
+		return Error;
+
+	bool Waiting = bytesInBuffer > 0; // The data join the ones waiting in the buffer (and their deadline)
+	if( bytesInBuffer + size >= size_t(BUFFER_SIZE) ) { // Data won't fit in the buffer; we need to send data to the socket
+		size_t bytesConsumed = 0; // Number of bytes we already consumed from data
+
+		// If we have data in the buffer, we fill the buffer to be full and send it
+		if( bytesInBuffer > 0 ) {
+			bytesConsumed = BUFFER_SIZE - bytesInBuffer;
+			memcpy( buffer + bytesInBuffer, data, bytesConsumed );
+			bytesInBuffer = 0;
+			if( !sendAll( buffer, BUFFER_SIZE ) )
+				return Error;
+			Waiting = false;
+		}
+
+		// Now send all data, which would not fit in the buffer
+		size_t n2 = ( size - bytesConsumed ) - ( size - bytesConsumed ) % BUFFER_SIZE;
+		if( n2 > 0 ) { // Is there something to send?
+			if( !sendAll( data + bytesConsumed, n2 ) )
+				return Error;
+			bytesConsumed += n2;
+		}
+
+		// We store data, which are still remaining, in the buffer
+		memcpy( buffer, data + bytesConsumed, size - bytesConsumed );
+		bytesInBuffer = int( size - bytesConsumed );
+	}
+	else { // Data still fit in the buffer
+		memcpy( buffer + bytesInBuffer, data, size );
+		bytesInBuffer += int( size );
+	}
+
+	if( FlushDeadline != 0 && bytesInBuffer > 0 ) { // The latency mode
+		const Timestamp Now = TimestampNow();
+		if( !Waiting )
+			FirstUnsent = Now; // The deadline of the data in the buffer starts now
+		else if( Now - FirstUnsent >= FlushDeadline )
+			return flush();
+	}
+	return SinkError::None;
+} // SocketSink::write
+
+SinkError SocketSink::flush()
+{
+	if( Error != SinkError::None )
+		return Error == SinkError::NotOpen && bytesInBuffer == 0 ? SinkError::None : Error;
+
+	if( bytesInBuffer > 0 ) {
+		const int n = bytesInBuffer;
+		bytesInBuffer = 0;
+		if( !sendAll( buffer, n ) )
+			return Error;
+	}
+	return SinkError::None;
+} // SocketSink::flush
+
+void SocketSink::setFlushDeadline( uint32_t Microseconds )
+{
+	FlushDeadline = Timestamp( Microseconds ) * TIMESTAMP_TICKS_PER_SECOND / 1000000;
+	if( Microseconds > 0 && FlushDeadline == 0 )
+		FlushDeadline = 1; // Shorter than a tick of the timer
+	FirstUnsent = TimestampNow(); // The data already in the buffer get the full deadline
+} // SocketSink::setFlushDeadline
+
+SinkError SocketSink::flushDue()
+{
+	if( FlushDeadline == 0 || bytesInBuffer == 0 || TimestampNow() - FirstUnsent < FlushDeadline )
+		return SinkError::None;
+	return flush();
+} // SocketSink::flushDue
+
+uint32_t SocketSink::timeToDeadline() const
+{
+	if( FlushDeadline == 0 || bytesInBuffer == 0 )
+		return UINT32_MAX;
+	const Timestamp Elapsed = TimestampNow() - FirstUnsent;
+	if( Elapsed >= FlushDeadline )
+		return 0;
+	return uint32_t( ( TimestampToNs( FlushDeadline - Elapsed ) + 999 ) / 1000 );
+} // SocketSink::timeToDeadline
+
+SinkError SocketSink::setNoDelay( bool On )
+{
+	NoDelay = On ? 1 : 0;
+	if( Socket >= 0 && !applyNoDelay() )
+		return SinkError::Option;
+	return SinkError::None;
+} // SocketSink::setNoDelay
+
+// Set TCP_NODELAY of the socket as requested by setNoDelay()
+bool SocketSink::applyNoDelay()
+{
+	int value = NoDelay;
+	return setsockopt( Socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&value, sizeof(value) ) == 0;
+} // SocketSink::applyNoDelay
+
+// Send the data; on a failure, the error is set and false is returned
+bool SocketSink::sendAll( const char *data, size_t size )
+{
+	if( Sends++ == 0 )
+		FirstSend = TimestampNow();
+	long sent = probedSend( Socket, data, size );
+	if( sent == long(size) ) {
+		LastSend = TimestampNow();
+		return true;
+	}
+	fail( SinkError::Send, sent < 0 ? lastSocketError() : 0 );
+	return false;
+} // SocketSink::sendAll
+
+// Keep the first error; a socket, which failed to open, is closed
+SinkError SocketSink::fail( SinkError error, int systemError )
+{
+	if( Error == SinkError::None || Error == SinkError::NotOpen ) {
+		Error = error;
+		SystemError = systemError;
+	}
+	if( error != SinkError::Send && Socket >= 0 ) {
+#ifdef __WIN32__
+		closesocket( Socket );
+#elif defined(__linux__)
+		::close( Socket );
+#else
+		lwip_close( Socket );
+#endif
+		Socket = -1;
+	}
+	return error;
+} // SocketSink::fail
+
+const char *SocketSink::errorText( SinkError error )
+{
+	switch( error ) {
+		case SinkError::None:           return "No error";
+		case SinkError::SocketCreation: return "Socket creation error!";
+		case SinkError::WrongAddress:   return "Server IP was provided in a wrong format!";
+		case SinkError::Connection:     return "Socket connection error!";
+		case SinkError::Send:           return "Socket send error!";
+		case SinkError::NotOpen:        return "Socket is not open!";
+		case SinkError::Option:         return "Socket option error!";
+	}
+	return "Unknown error!";
+} // SocketSink::errorText
+
+const char *SocketSink::errorHint( int systemError )
+{
+#ifdef __WIN32__
+	if( systemError == WSAECONNREFUSED )
+		return " (connection refused; is server running?)";
+	else if( systemError == WSAETIMEDOUT )
+		return " (connection timed out; is server accessible?)";
+#else
+	switch( systemError ) {
+		case ECONNREFUSED: // On Linux this error is raised when server is not running
+		                   // on the target host.
+			return " (connection refused; is server running?)";
+		case ETIMEDOUT:
+			return " (connection timed out; is server accessible?)";
+		case ECONNRESET:   // On lwIP this error is raised when server is not running
+		                   // on the target host.
+			return " (connection reset by peer; is server running?)";
+		case ECONNABORTED: // On lwIP this error is raised instead of ETIMEDOUT
+			return " (SW caused connection abort; is server accessible?)";
+	}
+#endif
+	return "";
+} // SocketSink::errorHint
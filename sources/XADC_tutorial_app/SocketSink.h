@@ -0,0 +1,156 @@
+/*
+This is the header file of the lightweight sink writing data to a remote system via an IP socket connection.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SOCKETSINK_H
+#define SOCKETSINK_H
+
+#include "Timestamp.h"
+#include <cstddef>
+#include <cstdint>
+
+// Errors reported by SocketSink
+enum class SinkError {
+	None = 0,
+	SocketCreation, // socket() failed
+	WrongAddress,   // The server IP isn't an IPv4 address in the numeric form
+	Connection,     // connect() failed
+	Send,           // send() failed or didn't take all the data; the connection is unusable
+	NotOpen,        // The sink isn't open
+	Option          // setsockopt() failed (TCP_NODELAY)
+};
+
+/* SocketSink writes data to a server via a TCP connection, like FileViaSocket, without a stream: the data are passed
+ * by write() as a pointer and a size, flush() sends what's buffered. Errors are returned as SinkError codes instead
+ * of exceptions, and nothing is allocated on the heap; the buffer is a member of the object. The formatting of
+ * values is left to the caller (e.g., FormatSampleValue() in CaptureFormat.h), so no locale or stream state is involved.
+ *
+ * The first error is kept by the sink. After an error of send() the connection is in an unknown state (part of
+ * the data may have been sent), so the following writes fail right away with the same error, till the sink is
+ * opened again. FileViaSocket is an adapter on top of SocketSink; see FileViaSocket::sink().
+ *
+ * By default, the data are sent when the buffer fills, or on flush() and close() (the throughput mode). In the latency
+ * mode, set by setFlushDeadline(), the data are sent also when the deadline expired since the first byte, which
+ * wasn't sent yet, was written. The deadline is checked by each write; when no write comes, the owner of the sink
+ * calls flushDue() (e.g., when its wait with the timeout timeToDeadline() expired). So a slow stream of small
+ * messages is sent in segments at most the deadline apart, instead of a segment per message (like a flush after each
+ * of them does) or a segment per full buffer. */
+class SocketSink {
+public:
+	/* BUFFER_SIZE is length of the array we use as buffer before sending the data via the socket.
+	 * Ideally it should be equal to the max. number of bytes sent in a TCP packet.
+	 * I tested using Wireshark that on FreeRTOS on Xilinx Zynq (using lwIP 2.1.3) 1446 bytes of data are sent
+	 * in one TCP packet. On Ubuntu 22.04 it's 1448 bytes and on Windows 11 it's 1460 bytes of data. */
+#ifdef __WIN32__
+	static int const BUFFER_SIZE = 1460;
+#elif defined(__linux__)
+	static int const BUFFER_SIZE = 1448;
+#else // If not Windows nor Linux, we assume FreeRTOS with lwIP
+	static int const BUFFER_SIZE = 1446;
+#endif
+
+	SocketSink() {}
+	~SocketSink() { close(); }
+	SocketSink( const SocketSink& ) = delete;
+	SocketSink& operator=( const SocketSink& ) = delete;
+
+	/* Connect to the server at serverIP (IPv4 address in the numeric form) and port. A sink which is open
+	 * is closed first. Returns SinkError::None, or the error (systemError() tells the errno of the call which failed). */
+	SinkError open( const char *serverIP, unsigned short port );
+
+	/* Flush the buffer and close the connection; does nothing when the sink isn't open.
+	 * Returns the error of the flush, i.e., SinkError::None when all the data were passed to the network stack. */
+	SinkError close();
+
+	/* Write size bytes of data. They are copied to the buffer; each time the buffer fills, it's sent.
+	 * Data larger than the buffer are sent directly from data in multiples of BUFFER_SIZE. */
+	SinkError write( const char *data, size_t size );
+
+	// Write a single character
+	SinkError put( char c ) {
+		if( bytesInBuffer < BUFFER_SIZE - 1 && Error == SinkError::None && FlushDeadline == 0 ) {
+			buffer[ bytesInBuffer++ ] = c;
+			return SinkError::None;
+		}
+		return write( &c, 1 );
+	}
+
+	// Send the data in the buffer
+	SinkError flush();
+
+	/* Set the latency mode: the data are sent at latest Microseconds after the first byte, which wasn't sent yet,
+	 * was written (provided a write or flushDue() comes by then). 0 sets the throughput mode (the default). */
+	void setFlushDeadline( uint32_t Microseconds );
+
+	// Send the data in the buffer, when their deadline expired
+	SinkError flushDue();
+
+	/* Microseconds till the deadline of the data in the buffer (0 when it expired already);
+	 * UINT32_MAX when there's no deadline, i.e., the buffer is empty or the sink is in the throughput mode. */
+	uint32_t timeToDeadline() const;
+
+	/* Set TCP_NODELAY of the connection: true disables the Nagle algorithm, so a small segment is sent right away
+	 * even when the previous one wasn't acknowledged yet. The setting is applied to the open connection and to
+	 * the ones opened later; without a call, the default of the network stack is kept (the Nagle algorithm on).
+	 * The latency mode needs it, otherwise a flushed segment may wait for the acknowledgment of the previous one.
+	 * Returns SinkError::Option when the stack refused it; the connection can be used anyway. */
+	SinkError setNoDelay( bool On );
+
+	bool      isOpen() const      { return Socket >= 0; }
+	SinkError error() const       { return Error; }       // The first error since open(); SinkError::None when there's none
+	int       systemError() const { return SystemError; } // errno (WSAGetLastError() on Windows) of the error; 0 when it has none
+	uint32_t  sendCount() const   { return Sends; }       // Number of send() calls since open(), i.e., about the number of TCP segments
+
+	/* Time of the start of the first send() since open(), and of the return of the last successful one; 0 when there
+	 * was none. The data were passed to the network stack then; they may still wait in its send buffer. */
+	Timestamp firstSendTime() const { return FirstSend; }
+	Timestamp lastSendTime() const  { return LastSend; }
+
+	// Description of the error (e.g., "Socket connection error!")
+	static const char *errorText( SinkError error );
+
+	/* Hint on the likely cause of the errno (WSAGetLastError() on Windows) of a failed connect(),
+	 * e.g., " (connection refused; is server running?)". Returns an empty string when there's none. */
+	static const char *errorHint( int systemError );
+
+private:
+	SinkError fail( SinkError error, int systemError );
+	bool      sendAll( const char *data, size_t size );
+	bool      applyNoDelay();
+
+	int       Socket        = -1; // The IP socket file descriptor; value <0 means that the socket is closed
+	SinkError Error         = SinkError::NotOpen;
+	int       SystemError   = 0;
+	int       bytesInBuffer = 0;  // Number of bytes stored in the buffer
+	uint32_t  Sends         = 0;
+	int       NoDelay       = -1; // TCP_NODELAY set by setNoDelay(); -1 when the default of the stack is kept
+	Timestamp FlushDeadline = 0;  // The deadline in Timestamp ticks; 0 in the throughput mode
+	Timestamp FirstUnsent   = 0;  // When the first byte in the buffer was written (in the latency mode)
+	Timestamp FirstSend     = 0;  // See firstSendTime()
+	Timestamp LastSend      = 0;  // See lastSendTime()
+	char      buffer[BUFFER_SIZE] = {}; // Buffer for writes to the socket
+}; // SocketSink
+
+#endif // SOCKETSINK_H
@@ -0,0 +1,291 @@
+/*
+This is the header file of the lock-free single-producer single-consumer ring used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__linux__) || defined(__WIN32__)
+#define SPSC_RING_LINE_SIZE 64 // Cache line of the x86 and ARMv8 processors the host tools run on
+#else // If not Linux nor Windows, we assume Zynq
+#include "xil_cache.h"
+#define SPSC_RING_LINE_SIZE 32 // Cache line of the L1 caches of Cortex-A9 and of the L2 cache of Zynq-7000
+#endif
+
+/* The synchronization policies of SpscRing. A policy gives the memory order of the accesses to the indexes and
+ * the cache maintenance of the ring memory:
+ *   Load()    reads the index of the other side; the slots it covers are read after it
+ *   Store()   advances the own index; the slots it covers were accessed before it
+ *   Publish() writes the data the other side is going to read from the cache to the memory
+ *   Refresh() discards the cached copy of the data the other side wrote */
+
+/* The producer and the consumer run on the same core, e.g., an interrupt handler and a task, or two tasks of FreeRTOS.
+ * A core sees its own accesses in program order, so only the compiler must keep the order; no DMB is emitted.
+ * Don't use it for the threads on Linux, they may run on different cores. */
+struct SpscSameCore {
+	static uint32_t Load( const uint32_t &Index ) {
+		uint32_t Value = __atomic_load_n( &Index, __ATOMIC_RELAXED );
+		__atomic_signal_fence( __ATOMIC_ACQUIRE );
+		return Value;
+	}
+	static void Store( uint32_t &Index, uint32_t Value ) {
+		__atomic_signal_fence( __ATOMIC_RELEASE );
+		__atomic_store_n( &Index, Value, __ATOMIC_RELAXED );
+	}
+	static void Publish( const void *, size_t ) {}
+	static void Refresh( const void *, size_t ) {}
+};
+
+/* The producer and the consumer run on different cores, whose caches are coherent for the ring memory (the threads
+ * on Linux), or the ring memory isn't cacheable (the OCM mapped non-cacheable by both cores of Zynq).
+ * The index is stored with release semantics and loaded with acquire semantics (DMB on Cortex-A9). */
+struct SpscMultiCore {
+	static uint32_t Load( const uint32_t &Index ) { return __atomic_load_n( &Index, __ATOMIC_ACQUIRE ); }
+	static void Store( uint32_t &Index, uint32_t Value ) { __atomic_store_n( &Index, Value, __ATOMIC_RELEASE ); }
+	static void Publish( const void *, size_t ) {}
+	static void Refresh( const void *, size_t ) {}
+};
+
+/* The producer and the consumer run on the two cores of Zynq without coherence of their caches for the ring memory
+ * (two programs in an AMP configuration sharing cacheable memory). On top of the barriers of SpscMultiCore,
+ * the writer flushes the slots and its index, and the reader invalidates them before reading.
+ * On Linux, it's the same as SpscMultiCore. */
+struct SpscNonCoherent : SpscMultiCore {
+#if defined(__linux__) || defined(__WIN32__)
+	static void Publish( const void *, size_t ) {}
+	static void Refresh( const void *, size_t ) {}
+#else
+	static void Publish( const void *Data, size_t Size ) { Xil_DCacheFlushRange( (UINTPTR)Data, Size ); }
+	static void Refresh( const void *Data, size_t Size ) { Xil_DCacheInvalidateRange( (UINTPTR)Data, Size ); }
+#endif
+};
+
+// Contiguous slots of an SpscRing reserved for writing or ready for reading
+template<typename T>
+struct SpscSpan {
+	T       *Data;
+	uint32_t Count;
+};
+
+/* SpscRing is a lock-free ring of Capacity items of type T, passed from a single producer to a single consumer
+ * (e.g., from the DMA interrupt handler to the task sending the data). Push() and Pop() never block; the caller
+ * decides what to do with a full or empty ring (wait for a notification, drop, count).
+ *
+ * Each side has a cache line of its own: its index and its copy of the index of the other side, which is read again
+ * only when the ring looks full (producer) or empty (consumer). The sides therefore don't share a written cache line
+ * in the common case. The items are copied; T must be trivially copyable.
+ * The producer may copy the items in (Push()) or write them in place (Reserve() and Commit()); the consumer may copy
+ * them out (Pop()) or read them in place (Peek() and Consume()). The batch variants publish all the items by a single
+ * store of the index. The indexes count the items since the start; Capacity is a power of 2, so they wrap around
+ * correctly.
+ *
+ * The memory order is given by the policy Sync: SpscSameCore, SpscMultiCore (the default) or SpscNonCoherent.
+ * The ring has no pointers, so it can be constructed in memory shared by two programs (see CoreRing.h). */
+template<typename T, uint32_t Capacity, class Sync = SpscMultiCore>
+class SpscRing {
+	static_assert( Capacity >= 2 && ( Capacity & ( Capacity - 1 ) ) == 0, "Capacity must be a power of 2" );
+	static_assert( std::is_trivially_copyable<T>::value, "The items are copied as bytes" );
+
+public:
+	typedef Sync SyncPolicy;
+	static constexpr uint32_t MASK = Capacity - 1;
+
+	/* Producer: put the Item to the ring. Returns false when the ring is full. */
+	bool Push( const T &Item )
+	{
+		SpscSpan<T> Span = Reserve( 1 );
+		if( Span.Count == 0 )
+			return false;
+		*Span.Data = Item;
+		Commit( 1 );
+		return true;
+	} // Push
+
+	/* Producer: put up to Count Items to the ring. Returns the number of the items put (less when it got full). */
+	uint32_t Push( const T *Items, uint32_t Count )
+	{
+		const uint32_t Head = __atomic_load_n( &Producer.Index, __ATOMIC_RELAXED ); // Only this side writes it
+		const uint32_t Free = FreeSlots( Head, Count );
+		if( Count > Free )
+			Count = Free;
+		for( uint32_t i = 0; i < Count; i++ )
+			Slots[ ( Head + i ) & MASK ] = Items[i];
+		Commit( Count );
+		return Count;
+	} // Push
+
+	/* Producer: reserve up to Max contiguous free slots to be written in place. The span is empty when the ring is full;
+	 * it's shorter than Max when fewer slots are free or the free slots wrap around. Call Commit() when they're written. */
+	SpscSpan<T> Reserve( uint32_t Max )
+	{
+		const uint32_t Head  = __atomic_load_n( &Producer.Index, __ATOMIC_RELAXED );
+		const uint32_t Free  = FreeSlots( Head, Max );
+		const uint32_t First = Head & MASK;
+		uint32_t Count = Free < Max ? Free : Max;
+		if( Count > Capacity - First )
+			Count = Capacity - First;
+		return SpscSpan<T>{ &Slots[ First ], Count };
+	} // Reserve
+
+	/* Producer: pass the first Count slots of the last Reserve() to the consumer. */
+	void Commit( uint32_t Count )
+	{
+		if( Count == 0 )
+			return;
+		const uint32_t Head = __atomic_load_n( &Producer.Index, __ATOMIC_RELAXED );
+		for( SpscSpan<T> Part : Parts( Head, Count ) )
+			Sync::Publish( Part.Data, Part.Count * sizeof(T) );
+		Sync::Store( Producer.Index, Head + Count );
+		Sync::Publish( &Producer, sizeof(Producer) );
+	} // Commit
+
+	/* Consumer: take the oldest Item from the ring. Returns false when the ring is empty. */
+	bool Pop( T &Item )
+	{
+		SpscSpan<const T> Span = Peek( 1 );
+		if( Span.Count == 0 )
+			return false;
+		Item = *Span.Data;
+		Consume( 1 );
+		return true;
+	} // Pop
+
+	/* Consumer: take up to Count oldest Items from the ring. Returns the number of the items taken. */
+	uint32_t Pop( T *Items, uint32_t Count )
+	{
+		const uint32_t Tail   = __atomic_load_n( &Consumer.Index, __ATOMIC_RELAXED ); // Only this side writes it
+		const uint32_t Filled = FilledSlots( Tail, Count );
+		if( Count > Filled )
+			Count = Filled;
+		for( SpscSpan<T> Part : Parts( Tail, Count ) )
+			Sync::Refresh( Part.Data, Part.Count * sizeof(T) );
+		for( uint32_t i = 0; i < Count; i++ )
+			Items[i] = Slots[ ( Tail + i ) & MASK ];
+		Consume( Count );
+		return Count;
+	} // Pop
+
+	/* Consumer: get up to Max contiguous oldest items to be read in place. The span is empty when the ring is empty.
+	 * Call Consume() when they were read; the producer doesn't reuse the slots till then. */
+	SpscSpan<const T> Peek( uint32_t Max )
+	{
+		const uint32_t Tail   = __atomic_load_n( &Consumer.Index, __ATOMIC_RELAXED );
+		const uint32_t Filled = FilledSlots( Tail, Max );
+		const uint32_t First = Tail & MASK;
+		uint32_t Count = Filled < Max ? Filled : Max;
+		if( Count > Capacity - First )
+			Count = Capacity - First;
+		if( Count > 0 )
+			Sync::Refresh( &Slots[ First ], Count * sizeof(T) );
+		return SpscSpan<const T>{ &Slots[ First ], Count };
+	} // Peek
+
+	/* Consumer: free the first Count slots of the last Peek() for the producer. */
+	void Consume( uint32_t Count )
+	{
+		if( Count == 0 )
+			return;
+		Sync::Store( Consumer.Index, __atomic_load_n( &Consumer.Index, __ATOMIC_RELAXED ) + Count );
+		Sync::Publish( &Consumer, sizeof(Consumer) );
+	} // Consume
+
+	/* Consumer: discard all the items in the ring. */
+	void Clear()
+	{
+		Sync::Refresh( &Producer, sizeof(Producer) );
+		Consumer.PeerIndex = Sync::Load( Producer.Index );
+		Sync::Store( Consumer.Index, Consumer.PeerIndex );
+		Sync::Publish( &Consumer, sizeof(Consumer) );
+	} // Clear
+
+	/* Either side: the number of the items in the ring. The other side may change it right away. */
+	uint32_t Count() const
+	{
+		// The own line is clean (the index is published whenever it's stored); a lost PeerIndex is just read again
+		Sync::Refresh( &Producer, sizeof(Producer) );
+		Sync::Refresh( &Consumer, sizeof(Consumer) );
+		return Sync::Load( Producer.Index ) - Sync::Load( Consumer.Index );
+	} // Count
+
+	static constexpr uint32_t Size() { return Capacity; }
+
+private:
+	// Producer: the number of the free slots at the index Head; the index of the consumer is read again when fewer than Wanted
+	uint32_t FreeSlots( uint32_t Head, uint32_t Wanted )
+	{
+		uint32_t Free = Capacity - ( Head - Producer.PeerIndex );
+		if( Free < Wanted ) { // Look whether the consumer freed more slots meanwhile
+			Sync::Refresh( &Consumer, sizeof(Consumer) );
+			Producer.PeerIndex = Sync::Load( Consumer.Index );
+			Free = Capacity - ( Head - Producer.PeerIndex );
+		}
+		return Free;
+	} // FreeSlots
+
+	// Consumer: the number of the filled slots at the index Tail; the index of the producer is read again when fewer than Wanted
+	uint32_t FilledSlots( uint32_t Tail, uint32_t Wanted )
+	{
+		uint32_t Filled = Consumer.PeerIndex - Tail;
+		if( Filled < Wanted ) { // Look whether the producer added more items meanwhile
+			Sync::Refresh( &Producer, sizeof(Producer) );
+			Consumer.PeerIndex = Sync::Load( Producer.Index );
+			Filled = Consumer.PeerIndex - Tail;
+		}
+		return Filled;
+	} // FilledSlots
+
+	// The Count slots from the index First split into the part till the end of Slots and the part wrapped around
+	struct SpanPair {
+		SpscSpan<T> Part[2];
+		const SpscSpan<T> *begin() const { return Part; }
+		const SpscSpan<T> *end() const   { return Part + ( Part[1].Count ? 2 : 1 ); }
+	};
+	SpanPair Parts( uint32_t First, uint32_t Count )
+	{
+		const uint32_t Start = First & MASK;
+		const uint32_t Till  = Count < Capacity - Start ? Count : Capacity - Start;
+		return SpanPair{ { { &Slots[ Start ], Till }, { &Slots[0], Count - Till } } };
+	} // Parts
+
+	struct alignas(SPSC_RING_LINE_SIZE) Side {
+		uint32_t Index     = 0; // Items pushed (producer) or popped (consumer) since the start
+		uint32_t PeerIndex = 0; // The index of the other side as read last
+	};
+	Side Producer;
+	Side Consumer;
+	alignas(SPSC_RING_LINE_SIZE) T Slots[ Capacity ];
+}; // SpscRing
+
+// The smallest power of 2, which is at least N (use it for Capacity of SpscRing)
+static constexpr uint32_t SpscCapacityFor( uint32_t N )
+{
+	return N <= 2 ? 2 : 2 * SpscCapacityFor( ( N + 1 ) / 2 );
+} // SpscCapacityFor
+
+#endif // SPSCRING_H
@@ -0,0 +1,234 @@
+/*
+This is the source file of the TCP throughput test of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifdef __linux__
+#   include <ctime>
+#   include <fstream>
+#   include <sstream>
+#else // If not Linux, we assume FreeRTOS with lwIP
+/* lwIP must be included before any header, which includes sys/errno.h (see the comment in SocketSink.cpp).
+ * lwip/stats.h doesn't use errno, so no macros need to be un-defined. */
+#   include "lwip/stats.h"
+#   include "FreeRTOS.h"
+#   include "task.h"
+#endif
+
+#include "ThroughputTest.h"
+#include "FileViaSocket.h"
+#include <iomanip>
+
+#ifdef __linux__
+static TcpCounters ReadTcpCounters()
+{
+	TcpCounters Counters{ -1, -1, -1, -1 };
+
+	/* /proc/net/snmp has a line with the names of the TCP counters followed by a line with their values:
+	 *   Tcp: RtoAlgorithm RtoMin ... OutSegs RetransSegs ...
+	 *   Tcp: 1 200 ... 123456 12 ... */
+	std::ifstream Snmp( "/proc/net/snmp" );
+	std::string Names, Values;
+	while( std::getline( Snmp, Names ) )
+		if( Names.compare( 0, 4, "Tcp:" ) == 0 ) {
+			std::getline( Snmp, Values );
+			break;
+		}
+
+	std::istringstream NameStream( Names ), ValueStream( Values );
+	std::string Name, Value;
+	while( NameStream >> Name && ValueStream >> Value ) {
+		if( Name == "OutSegs" )
+			Counters.Segments = std::stoll( Value );
+		else if( Name == "RetransSegs" )
+			Counters.Retransmissions = std::stoll( Value );
+	}
+	return Counters;
+} // ReadTcpCounters
+
+static int64_t CounterDifference( int64_t Before, int64_t After )
+{
+	return Before < 0 || After < 0 ? -1 : After - Before;
+} // CounterDifference
+
+// CPU time of the calling thread
+static Timestamp CpuTime()
+{
+	struct timespec Time;
+	clock_gettime( CLOCK_THREAD_CPUTIME_ID, &Time );
+	return Timestamp( Time.tv_sec ) * 1000000000ULL + Timestamp( Time.tv_nsec );
+} // CpuTime
+
+/* On Linux, the load is the CPU time of the calling thread during the test. The sink (the loopback sink of the host
+ * tool runs in another thread) is not included. */
+class LoadMeter {
+public:
+	void Calibrate() {}
+	void Start() { StartTime = CpuTime(); }
+	float Stop( Timestamp Duration ) { return Duration ? float( CpuTime() - StartTime ) / float( Duration ) : -1.0f; }
+private:
+	Timestamp StartTime = 0;
+}; // LoadMeter
+#else
+static TcpCounters ReadTcpCounters()
+{
+	TcpCounters Counters{ -1, -1, -1, -1 };
+#if LWIP_STATS && TCP_STATS
+	Counters.Drops        = lwip_stats.tcp.drop;
+	Counters.MemoryErrors = lwip_stats.tcp.memerr;
+#endif
+#if LWIP_STATS && MIB2_STATS
+	Counters.Segments        = lwip_stats.mib2.tcpoutsegs;
+	Counters.Retransmissions = lwip_stats.mib2.tcpretranssegs;
+#endif
+	return Counters;
+} // ReadTcpCounters
+
+/* The counters of lwIP wrap around; the MIB2 counters are 32-bit, the protocol counters are STAT_COUNTER
+ * (16-bit unless LWIP_STATS_LARGE is set). The Mask is the max. value of the counter. */
+static int64_t CounterDifference( int64_t Before, int64_t After, uint32_t Mask = 0xFFFFFFFF )
+{
+	return Before < 0 || After < 0 ? -1 : int64_t( uint32_t( After - Before ) & Mask );
+} // CounterDifference
+
+static volatile uint32_t IdleLoops; // Incremented by load_meter_thread whenever the CPU has nothing else to do
+
+/* FreeRTOS thread of the idle priority counting in a loop. It runs only when no other task is ready,
+ * so the number of loops per second falls with the load of the CPU. */
+static void load_meter_thread(void *p)
+{
+	while(1)
+		IdleLoops = IdleLoops + 1;
+} // load_meter_thread
+
+/* On the board, the load is measured by comparing the rate of load_meter_thread during the test with its rate
+ * while the calling task sleeps. */
+class LoadMeter {
+public:
+	~LoadMeter() {
+		if( Task )
+			vTaskDelete( Task );
+	}
+	void Calibrate() {
+		if( xTaskCreate( load_meter_thread, "load_meter", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, &Task ) != pdPASS ) {
+			Task = NULL;
+			return;
+		}
+		Timestamp Start = TimestampNow();
+		IdleLoops = 0;
+		vTaskDelay( pdMS_TO_TICKS( 100 ) );
+		IdleRate = double( IdleLoops ) / double( TimestampNow() - Start );
+	}
+	void Start() { IdleLoops = 0; }
+	float Stop( Timestamp Duration ) {
+		if( !Task || IdleRate <= 0 || Duration == 0 )
+			return -1.0f;
+		double Load = 1.0 - double( IdleLoops ) / double( Duration ) / IdleRate;
+		return Load < 0 ? 0.0f : float( Load );
+	}
+private:
+	TaskHandle_t Task = NULL;
+	double IdleRate = 0; // Loops per tick of the timestamps, when the CPU is idle
+}; // LoadMeter
+#endif
+
+static char Payload[ THROUGHPUT_TEST_MAX_WRITE_SIZE ];
+
+bool RunThroughputTest( const std::string &ServerIP, unsigned short Port, unsigned Seconds, uint32_t WriteSize,
+                        ThroughputResult &Result )
+{
+	Result = ThroughputResult{};
+	if( WriteSize == 0 || WriteSize > THROUGHPUT_TEST_MAX_WRITE_SIZE )
+		WriteSize = THROUGHPUT_TEST_DEFAULT_WRITE_SIZE;
+
+	// The payload looks like the samples sent by a capture (a value in volts per line)
+	const char Line[] = "1.234567\n";
+	for( uint32_t i = 0; i < WriteSize; i++ )
+		Payload[i] = Line[ i % ( sizeof(Line) - 1 ) ];
+
+	LoadMeter Meter;
+	Meter.Calibrate(); // Before the connection is opened, the CPU is idle
+
+	FileViaSocket f( ServerIP, Port ); // Declare the object and open the network connection; it's closed on return
+	const TcpCounters Before = ReadTcpCounters();
+	const Timestamp Start = TimestampNow();
+	const Timestamp End   = Start + Timestamp( Seconds ) * TIMESTAMP_TICKS_PER_SECOND;
+	Meter.Start();
+
+	while( f && TimestampNow() < End ) {
+		f.write( Payload, WriteSize );
+		Result.Writes++;
+	}
+	f.flush();
+
+	Result.Duration = TimestampNow() - Start;
+	Result.CpuLoad  = Meter.Stop( Result.Duration );
+	Result.Sent     = bool(f);
+	Result.Bytes    = uint64_t( WriteSize ) * Result.Writes;
+
+	const TcpCounters After = ReadTcpCounters();
+	Result.Tcp.Segments        = CounterDifference( Before.Segments, After.Segments );
+	Result.Tcp.Retransmissions = CounterDifference( Before.Retransmissions, After.Retransmissions );
+#ifdef __linux__
+	Result.Tcp.Drops           = CounterDifference( Before.Drops, After.Drops );
+	Result.Tcp.MemoryErrors    = CounterDifference( Before.MemoryErrors, After.MemoryErrors );
+#else
+	Result.Tcp.Drops           = CounterDifference( Before.Drops, After.Drops, (STAT_COUNTER)~0U );
+	Result.Tcp.MemoryErrors    = CounterDifference( Before.MemoryErrors, After.MemoryErrors, (STAT_COUNTER)~0U );
+#endif
+	return Result.Sent;
+} // RunThroughputTest
+
+// Print the Counter, or n/a when the network stack doesn't provide it
+static void PrintCounter( std::ostream &Out, int64_t Counter )
+{
+	if( Counter < 0 )
+		Out << "n/a";
+	else
+		Out << Counter;
+} // PrintCounter
+
+void PrintThroughputResult( std::ostream &Out, const ThroughputResult &Result )
+{
+	const double Seconds = TimestampToNs( Result.Duration ) / 1e9;
+
+	Out << std::fixed << std::setprecision(2)
+	    << Result.Bytes << " bytes in " << Seconds << " s (" << Result.Writes << " writes of "
+	    << ( Result.Writes ? Result.Bytes / Result.Writes : 0 ) << " bytes): "
+	    << ( Seconds > 0 ? Result.Bytes * 8 / Seconds / 1e6 : 0.0 ) << " Mbit/s" << ( Result.Sent ? "" : " (connection broken!)" ) << '\n'
+	    << "CPU load: ";
+	if( Result.CpuLoad < 0 )
+		Out << "n/a";
+	else
+		Out << std::setprecision(1) << Result.CpuLoad * 100 << " %";
+	Out << "\nTCP segments sent: ";
+	PrintCounter( Out, Result.Tcp.Segments );
+	Out << ", retransmitted: ";
+	PrintCounter( Out, Result.Tcp.Retransmissions );
+	Out << ", dropped: ";
+	PrintCounter( Out, Result.Tcp.Drops );
+	Out << ", out of memory: ";
+	PrintCounter( Out, Result.Tcp.MemoryErrors );
+	Out << std::endl;
+} // PrintThroughputResult
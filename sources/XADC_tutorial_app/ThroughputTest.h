@@ -0,0 +1,75 @@
+/*
+This is the header file of the TCP throughput test of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef THROUGHPUTTEST_H
+#define THROUGHPUTTEST_H
+
+#include <cstdint>
+#include <string>
+#include <ostream>
+#include "Timestamp.h"
+
+#define THROUGHPUT_TEST_DEFAULT_PORT       5001  // The port of the sink (the same as the default port of iperf)
+#define THROUGHPUT_TEST_DEFAULT_SECONDS    10    // Duration of the test
+#define THROUGHPUT_TEST_DEFAULT_WRITE_SIZE 1024  // Number of bytes passed to the stream by a single write
+#define THROUGHPUT_TEST_MAX_WRITE_SIZE     65536
+#define THROUGHPUT_TEST_MAX_SECONDS        3600
+
+/* Counters of the TCP of the network stack; -1 when the stack doesn't provide the counter.
+ * lwIP provides them when statistics are enabled in the BSP (LWIP_STATS with TCP_STATS and MIB2_STATS).
+ * On Linux, they are the counters of the whole system from /proc/net/snmp (only segments and retransmissions). */
+struct TcpCounters {
+	int64_t Segments;        // Segments sent
+	int64_t Retransmissions; // Segments retransmitted
+	int64_t Drops;           // Segments dropped by lwIP
+	int64_t MemoryErrors;    // Segments lwIP couldn't allocate memory for (the sender has to wait)
+};
+
+// The result of RunThroughputTest()
+struct ThroughputResult {
+	uint64_t    Bytes;     // Number of bytes written to the stream
+	uint64_t    Writes;    // Number of the writes
+	Timestamp   Duration;  // From the first write till the stream was flushed
+	float       CpuLoad;   // Share of the CPU time (0 to 1) used during the test, negative when it wasn't measured
+	TcpCounters Tcp;       // Difference of the counters during the test
+	bool        Sent;      // All the data were accepted by the socket
+};
+
+/* Stream a synthetic payload (text lines like the samples of a capture) to the sink at ServerIP:Port for Seconds.
+ * The payload goes through FileViaSocket, i.e., through the same SocketSink send path as the captures.
+ * The payload is passed to the stream in writes of WriteSize bytes (1 to THROUGHPUT_TEST_MAX_WRITE_SIZE):
+ * writes smaller than SocketSink::BUFFER_SIZE are copied into its buffer (like the formatted samples),
+ * the larger ones are mostly sent directly from the payload.
+ * CPU load on the board is measured by a task of the idle priority counting while the CPU has nothing else to do
+ * (calibrated for 100 ms before the test). On Linux, it's the CPU time of the calling thread.
+ * Returns false when the connection broke. Throws the exceptions of FileViaSocket when the connection can't be opened. */
+bool RunThroughputTest( const std::string &ServerIP, unsigned short Port, unsigned Seconds, uint32_t WriteSize,
+                        ThroughputResult &Result );
+
+// Print the result in Mbit/s together with the CPU load and the TCP counters
+void PrintThroughputResult( std::ostream &Out, const ThroughputResult &Result );
+
+#endif // THROUGHPUTTEST_H
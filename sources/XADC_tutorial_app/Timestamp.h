@@ -0,0 +1,69 @@
+/*
+This is the header file of the timestamps used for latency measurements by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <cstdint>
+
+/* Timestamp is a reading of a free-running clock in its native ticks. Reading it costs a few instructions only,
+ * so it can be taken anywhere, incl. an ISR. Use TimestampToNs() to convert a difference of two timestamps.
+ * On the board, it's the 64-bit global timer of Zynq-7000 (counting at 1/2 of the CPU clock).
+ * On Linux and Windows (host tools and the simulation), it's std::chrono::steady_clock. */
+typedef uint64_t Timestamp;
+
+#if defined(__linux__) || defined(__WIN32__)
+#include <chrono>
+
+static inline Timestamp TimestampNow()
+{
+	return Timestamp( std::chrono::duration_cast<std::chrono::nanoseconds>(
+	                      std::chrono::steady_clock::now().time_since_epoch() ).count() );
+} // TimestampNow
+
+#define TIMESTAMP_TICKS_PER_SECOND 1000000000ULL
+#else // If not Linux nor Windows, we assume Zynq
+#include "xtime_l.h"
+
+static inline Timestamp TimestampNow()
+{
+	XTime Time;
+	XTime_GetTime( &Time );
+	return Time;
+} // TimestampNow
+
+#define TIMESTAMP_TICKS_PER_SECOND ( (uint64_t)COUNTS_PER_SECOND )
+#endif
+
+// Convert a number of ticks (i.e., a difference of two timestamps) to nanoseconds
+static inline uint64_t TimestampToNs( Timestamp Ticks )
+{
+	// Whole seconds are converted separately, so that the multiplication doesn't overflow for long intervals
+	return Ticks / TIMESTAMP_TICKS_PER_SECOND * 1000000000ULL
+	     + Ticks % TIMESTAMP_TICKS_PER_SECOND * 1000000000ULL / TIMESTAMP_TICKS_PER_SECOND;
+} // TimestampToNs
+
+#endif // TIMESTAMP_H
@@ -0,0 +1,98 @@
+/*
+This is the header file of the vertical-counter debouncer used by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef VERTICALDEBOUNCER_H
+#define VERTICALDEBOUNCER_H
+
+#include <cstdint>
+#include "button_debounce.h" // NUM_BUTTON_STATES and BUTTON_PIN_*
+
+/* VerticalDebouncer debounces all the pins of a port of type Port (uint8_t up to uint64_t) at once. A pin changes its
+ * debounced state when it differed from it in Depth consecutive calls of ButtonProcess(); a press and a release are
+ * debounced the same way.
+ *
+ * The class Debouncer of button_debounce.h keeps the last NUM_BUTTON_STATES samples and ANDs all of them on every
+ * call. Here, each pin has a counter of the consecutive samples, which differ from its debounced state. The counters
+ * are "vertical": bit i of the counters of all the pins is stored in the word Count[i]. Counting and comparing with
+ * Depth are therefore a few bitwise operations per bit of the counter, for all the pins together. A call costs
+ * the same for 8 and 64 pins, but it isn't constant: it grows with log2(Depth) (the number of the counter bits).
+ * Debouncer is faster for a single 8-bit port with a short depth, which is why ButtonEvents keeps using it;
+ * VerticalDebouncer pays off for wide ports and long depths (host_tools/debounce_test measures both).
+ *
+ * With Symmetric = false, a release passes at once, which is exactly what Debouncer does with
+ * Depth = NUM_BUTTON_STATES (host_tools/debounce_test checks that).
+ * The methods have the same meaning as in Debouncer, so the classes are interchangeable. */
+template<typename Port, unsigned Depth = NUM_BUTTON_STATES, bool Symmetric = true>
+class VerticalDebouncer {
+	static_assert( Depth > 0 && Depth <= 255, "Depth must be 1 to 255" );
+
+public:
+	// PulledUpButtons are the pins which read as 1 when the button isn't pressed
+	explicit VerticalDebouncer( Port PulledUpButtons = 0 ) : PullType( PulledUpButtons ) {}
+
+	// Process a new sample of the port; call it on a regular interval (e.g., every 1 ms)
+	void ButtonProcess( Port PortStatus )
+	{
+		const Port Diff = Port( PortStatus ^ PullType ^ State ); // The pins which differ from the debounced state
+
+		// Count[] += 1 for the pins in Diff, the counters of the others start from 0 again
+		Port Carry = Diff;
+		Port Hit   = Diff; // The pins whose counter reached Depth
+		for( unsigned i = 0; i < PLANES; i++ ) {
+			const Port Bit = Port( Count[i] & Diff );
+			Count[i] = Port( Bit ^ Carry );
+			Carry    = Port( Bit & Carry );
+			Hit &= ( Depth >> i & 1 ) ? Count[i] : Port( ~Count[i] );
+		}
+		if( !Symmetric )
+			Hit |= Port( Diff & State ); // A released button passes at once
+
+		for( unsigned i = 0; i < PLANES; i++ )
+			Count[i] &= Port( ~Hit );
+		Changed = Hit;
+		State  ^= Hit;
+	} // ButtonProcess
+
+	// The pins of GPIOButtonPins, which were pressed by the last call of ButtonProcess()
+	Port ButtonPressed( Port GPIOButtonPins ) const { return Port( Changed & State & GPIOButtonPins ); }
+
+	// The pins of GPIOButtonPins, which were released by the last call of ButtonProcess()
+	Port ButtonReleased( Port GPIOButtonPins ) const { return Port( Changed & ~State & GPIOButtonPins ); }
+
+	// The pins of GPIOButtonPins, which are pressed now
+	Port ButtonCurrent( Port GPIOButtonPins ) const { return Port( State & GPIOButtonPins ); }
+
+private:
+	static constexpr unsigned Bits( unsigned n ) { return n ? 1 + Bits( n >> 1 ) : 0; }
+	static constexpr unsigned PLANES = Bits( Depth ); // Bits of the counters
+
+	Port Count[PLANES] = {}; // Count[i] holds bit i of the counters of all the pins
+	Port State    = 0;       // The debounced state, 1 = pressed
+	Port Changed  = 0;       // The pins which changed the debounced state by the last sample
+	Port PullType;
+}; // VerticalDebouncer
+
+#endif // VERTICALDEBOUNCER_H
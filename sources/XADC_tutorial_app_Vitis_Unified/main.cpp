@@ -27,53 +27,321 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
+#include "timers.h"
 #include "xgpiops.h"
 #include "xsysmon.h"
 #include "xaxidma.h"
 #include "xparameters.h"
 #include "lwip/sys.h"
-#include "button_debounce.h"
+#include "xuartps_hw.h"
+#include "xtime_l.h"
+#include "ButtonEvents.h"
 #include "FileViaSocket.h"
+#include "DmaMemory.h"
+#include "DmaBufferPool.h"
+#include "SpscRing.h"
+#include "CommandServer.h"
+#include "LatencyProbes.h"
+#include "EventTrace.h"
+#include "ThroughputTest.h"
+#include "BootPhases.h"
+#include "CaptureFormat.h"
+#include "CaptureSpool.h"
+#include "ClockSync.h"
+#include "ChannelDemux.h"
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <cstdio>
 using std::cout;
 using std::cerr;
 using std::endl;
 
-/* Number of samples transferred in one DMA transfer. Max. value is 33,554,431 */
+/* Default number of samples transferred in one DMA transfer. It can be changed at runtime by the console command "count".
+ * In the sequencer mode, this is the total number of samples of all the scanned channels.
+ * In the simultaneous mode, this is the total number of samples of both ADCs, i.e., twice the number of conversions. */
 #define SAMPLE_COUNT 1000
 
-#if SAMPLE_COUNT > 0x01FFFFFF
-	#error "SAMPLE_COUNT is higher than possible max. of 33,554,431 (>0x01FFFFFF)"
+/* Max. number of samples transferred in one DMA transfer. Max. value is 33,554,431
+ * The DMA buffer of this size is allocated statically, i.e., it is ready when the application starts. */
+#define MAX_SAMPLE_COUNT 1000000
+
+#if MAX_SAMPLE_COUNT > 0x01FFFFFF
+	#error "MAX_SAMPLE_COUNT is higher than possible max. of 33,554,431 (>0x01FFFFFF)"
+#endif
+
+/* Large-capture mode: when CHUNK_SAMPLE_COUNT is not 0, a capture is split into chunks of CHUNK_SAMPLE_COUNT samples,
+ * each of them transferred by a separate DMA transfer. A completed chunk is converted and sent over the network
+ * while the DMA fills the next chunks. A capture can then have up to 33,554,431 samples, and only CHUNK_BUFFERS chunks
+ * are held in the memory (MAX_SAMPLE_COUNT is not used).
+ * The value must be equal to the parameter CHUNK_SIZE of stream_tlaster in the HW design, and the S2MM interrupt
+ * of the AXI DMA must be connected to the PS (see README.md). The FIFO of stream_tlaster holds the samples while
+ * the DMA is being set up for the next chunk, so the chunks join without a gap. */
+#define CHUNK_SAMPLE_COUNT 0       // Large-capture mode is disabled, a capture is a single DMA transfer
+//#define CHUNK_SAMPLE_COUNT 65536 // Large-capture mode with chunks of 64 Ki samples
+#define CHUNK_BUFFERS 4            // Number of chunk buffers; the DMA fills them while the completed chunks are being sent
+
+#if CHUNK_SAMPLE_COUNT > 0
+	#define CAPTURE_MAX_SAMPLE_COUNT 0x01FFFFFF // Limited only by the 25-bit count input of stream_tlaster
+	#if CHUNK_SAMPLE_COUNT < 1024 || CHUNK_SAMPLE_COUNT % 16 != 0
+		#error "CHUNK_SAMPLE_COUNT must be at least 1024 and divisible by 16"
+	#endif
+	#if CHUNK_BUFFERS < 2 || CHUNK_BUFFERS > 64
+		#error "CHUNK_BUFFERS must be from 2 to 64 (DmaBufferPool::MAX_BLOCKS)"
+	#endif
+#else
+	#define CAPTURE_MAX_SAMPLE_COUNT MAX_SAMPLE_COUNT
 #endif
+#if SAMPLE_COUNT > CAPTURE_MAX_SAMPLE_COUNT
+	#error "SAMPLE_COUNT is higher than max. number of samples of a capture"
+#endif
+
+/* Type of the memory the DMA buffers are placed in. It defines the cache maintenance needed for each DMA transfer
+ * (see DmaMemory.h). Leave one of the lines below uncommented. */
+#define DMA_MEMORY_TYPE DmaMemoryType::Cached          // Write-back cache, the range written by the DMA is invalidated
+//#define DMA_MEMORY_TYPE DmaMemoryType::WriteThrough  // Write-through cache, the range written by the DMA is invalidated after the transfer only
+//#define DMA_MEMORY_TYPE DmaMemoryType::Uncached      // No cache maintenance, but the CPU reads the samples directly from RAM
 
-/* Set XADC averaging.
+/* Set DMA_BENCHMARK to 1 to enable the console command "bench", which compares per-capture overhead of the memory types.
+ * It needs three extra megabytes of memory. */
+#define DMA_BENCHMARK 0
+
+#if DMA_BENCHMARK && CHUNK_SAMPLE_COUNT > 0
+	#error "The DMA benchmark can't be used in the large-capture mode"
+#endif
+
+/* Set default XADC averaging. It can be changed at runtime by the console command "avg".
  * Leave one of the lines below uncommented to set averaging mode of the XADC. */
 #define AVERAGING_MODE XSM_AVG_0_SAMPLES // No averaging
 //#define AVERAGING_MODE XSM_AVG_16_SAMPLES  // Averaging over  16 acquisition samples
 //#define AVERAGING_MODE XSM_AVG_64_SAMPLES  // Averaging over  64 acquisition samples
 //#define AVERAGING_MODE XSM_AVG_256_SAMPLES // Averaging over 256 acquisition samples
 
+/* Default ADCCLK divider ratio. It can be changed at runtime by the console command "div".
+ * When the XADC input clock is 104 MHz, the value 4 results in 1 Msps sampling rate. */
+#define ADC_CLK_DIVISOR 4
+
+/* Set XADC operating mode.
+ * Leave one of the lines below uncommented to set the mode. */
+#define XADC_MODE_SINGLE_CHANNEL 0
+#define XADC_MODE_SEQUENCER      1
+#define XADC_MODE_SIMULTANEOUS   2
+#define XADC_MODE XADC_MODE_SINGLE_CHANNEL  // Single channel mode; BTN1 switches between VAUX[1] and VP/VN
+//#define XADC_MODE XADC_MODE_SEQUENCER     // Continuous sequencer mode scanning the channels in SEQUENCER_CHANNELS
+//#define XADC_MODE XADC_MODE_SIMULTANEOUS  // Simultaneous sampling of the channel pairs in SIMULTANEOUS_AUX_PAIRS
+
+/* Channels scanned in the sequencer mode, ORed XSM_SEQ_CH_* masks from xsysmon.h.
+ * VP/VN is sampled in bipolar mode, VAUX channels in unipolar mode.
+ * Cora Z7 board pins A0-A5 are connected to VAUX[1], VAUX[9], VAUX[6], VAUX[15], VAUX[5] and VAUX[13].
+ * The channels must be enabled in the XADC Wizard in the HW design. */
+#define SEQUENCER_CHANNELS ( XSM_SEQ_CH_VPVN | XSM_SEQ_CH_AUX01 | XSM_SEQ_CH_AUX09 )
+
+/* Channel pairs sampled in the simultaneous mode, ORed XSM_SEQ_CH_AUX00 to XSM_SEQ_CH_AUX07 masks from xsysmon.h.
+ * Selecting VAUX[n] means that ADC A samples VAUX[n] and ADC B samples VAUX[n+8] at the same instant.
+ * All the channels are sampled in unipolar mode.
+ * On Cora Z7, VAUX[1]+VAUX[9] are board pins A0+A1 and VAUX[5]+VAUX[13] are board pins A4+A5. */
+#define SIMULTANEOUS_AUX_PAIRS ( XSM_SEQ_CH_AUX01 )
+/* Order of the two results of a conversion in the simultaneous mode: 0 when the XADC Wizard sends the result of ADC A
+ * (VAUX[n]) first, 1 when it sends the result of ADC B (VAUX[n+8]) first. With the wrong order, most samples
+ * of a capture are reported as unpaired. */
+#define SIMULTANEOUS_B_FIRST 0
+
+#if XADC_MODE == XADC_MODE_SIMULTANEOUS && SAMPLE_COUNT % 2 != 0
+	#error "SAMPLE_COUNT must be even in the simultaneous mode (each conversion provides two samples)"
+#endif
+#if XADC_MODE == XADC_MODE_SIMULTANEOUS && CHUNK_SAMPLE_COUNT % 2 != 0
+	#error "CHUNK_SAMPLE_COUNT must be even in the simultaneous mode"
+#endif
+
 /* IP address and port of the server running the script file_via_socket.py.
- * The address must be provided in numerical form in a string, e.g., "192.168.44.10".*/
+ * The address must be provided in numerical form in a string, e.g., "192.168.44.10".
+ * These are the default values; they can be changed at runtime by the console command "server".*/
 const std::string    SERVER_ADDR( "###SERVER_ADDR is not set###" );
 //const std::string    SERVER_ADDR( "192.168.44.10" );
 const unsigned short SERVER_PORT{ 65432 }; //The server script file_via_socket.py uses the port 65432 by default.
 
+/* Port of the command server, which allows triggering captures and changing the settings over the network
+ * (see CommandProtocol.h and the host tool xadc_cmd). Set it to 0 to disable the command server. */
+#define COMMAND_SERVER_PORT COMMAND_SERVER_DEFAULT_PORT
+
+/* Set CAPTURE_HEADER to 1 to start each capture sent to the server with a header line describing the capture
+ * (its number, averaging, ADCCLK divider ratio, calibration coefficients and time; see CaptureFormat.h).
+ * The capture archive of the host tools stores the header with the samples. Set it to 0 to send only the values. */
+#define CAPTURE_HEADER 1
+
+/* ID of the board sent in the capture header, so that the receiver can tell the boards apart and align their captures
+ * by time (see via_socket_server in the host tools). Give each board a unique number from 1 up.
+ * Please note that the boards on the same network need unique MAC addresses as well (see network_thread.cpp). */
+#define BOARD_ID 1
+
+/* Set BUTTON_INTERRUPTS to 1 to get the presses of the buttons from the GPIO interrupts (see ButtonEvents.h).
+ * Set it to 0 to poll the buttons every 1 ms (the original way). */
+#define BUTTON_INTERRUPTS 1
+#define BUTTON_DEBOUNCE_MS 10 // A press or a release is reported when the buttons were stable for this long
+#define CONSOLE_POLL_MS    20 // XADC_thread checks the serial console this often (the UART FIFO holds 64 characters)
+
+/* Set DMA_INTERRUPT to 1 when the output s2mm_introut of the AXI DMA is connected to IRQ_F2P of the PS (as the large-capture
+ * mode requires, see CHUNK_SAMPLE_COUNT). The end of a DMA transfer then comes as an interrupt.
+ * With 0, XADC_thread checks every 1 ms whether the DMA transfer is done (it works with the HW design of the tutorial). */
+#define DMA_INTERRUPT 0
+
+/* What the continuous mode does when the network is slower than the XADC, i.e., when a capture is done while
+ * the previous ones are still being sent and no buffer would be free for the next capture.
+ * Leave one of the lines below uncommented. The header of each capture carries the counters of the data
+ * not sent before it (see CaptureFormat.h), so the gaps are explicit to the receiver; the console command
+ * "overload" prints them. The captures triggered by BTN0 or by a command are never dropped.
+ * In the large-capture mode, the policy isn't used: a chunk, which finds no free buffer, is always dropped
+ * and replaced by a gap line. */
+#define OVERLOAD_BLOCK       0 // The next capture waits till a buffer is free (no data are dropped, the captures are further apart)
+#define OVERLOAD_DROP_OLDEST 1 // The oldest capture waiting for the network is dropped (with three buffers)
+#define OVERLOAD_DROP_NEWEST 2 // The capture just done is dropped, and the next one starts in its buffer
+#define OVERLOAD_SUMMARY     3 // The capture just done is sent as a summary (min, max and mean of each channel) only
+#define OVERLOAD_POLICY OVERLOAD_BLOCK
+//#define OVERLOAD_POLICY OVERLOAD_DROP_OLDEST
+//#define OVERLOAD_POLICY OVERLOAD_DROP_NEWEST
+//#define OVERLOAD_POLICY OVERLOAD_SUMMARY
+
+/* When CAPTURE_SPOOL_SIZE is not 0, a capture, which can't be sent because the connection to the server can't be
+ * opened, is kept in the spool (see CaptureSpool.h) and replayed when the server is reachable again. CAPTURE_SPOOL_SIZE
+ * is the size of the spool in bytes; it's in the section .noinit of the DDR, so the spooled captures survive a reset
+ * of the processor. The lscript.ld generated by Vitis doesn't define the section, so add it before enabling the spool
+ * (see README.md); otherwise, the linker places the spool wherever it sees fit.
+ * The spool isn't used in the large-capture mode, where the chunks of a capture are sent during the capture. */
+#define CAPTURE_SPOOL_SIZE 0                 // The spool is disabled, the captures, which can't be sent, are lost
+//#define CAPTURE_SPOOL_SIZE (16*1024*1024) // Spool of 16 MB (requires the section .noinit in the lscript.ld)
+#define SPOOL_RETRY_MS 1000 // While the server is unreachable, sender_thread tries to replay the spooled captures this often
+
+/* SEND_FLUSH_DEADLINE_US sets the latency mode of the data connection (see SocketSink.h): the formatted data wait
+ * in the buffer of the sink at most this many microseconds before they are sent, even when the buffer isn't full.
+ * It matters in the large-capture mode, where the chunks of a slow capture (e.g., with averaging) come far apart,
+ * and the end of a chunk would otherwise wait for the next one. With 0, the data are sent in full buffers only
+ * (and at the end of the capture), which needs the fewest TCP segments.
+ * SEND_TCP_NODELAY 1 disables the Nagle algorithm on the data connection, 0 enables it, -1 keeps the default of lwIP
+ * (enabled). The latency mode needs it disabled, otherwise a flushed segment may wait for the acknowledgment
+ * of the previous one. */
+#define SEND_FLUSH_DEADLINE_US 0       // Throughput mode: the data are sent in full buffers
+//#define SEND_FLUSH_DEADLINE_US 2000  // Latency mode: the data are sent at most 2 ms after they were formatted
+#define SEND_TCP_NODELAY ( SEND_FLUSH_DEADLINE_US > 0 ? 1 : -1 )
+
+/* Set CAPTURE_TIMING to 1 to end each capture sent to the server with the timing line (see CaptureFormat.h): when
+ * the trigger came, when the DMA transfer was done, and when the first and the last byte were passed to lwIP.
+ * Before the timing line, sender_thread measures the offset of the server's clock by the clock exchange
+ * (see ClockSync.h), when the last measurement is older than CLOCK_SYNC_INTERVAL_MS. via_socket_server answers
+ * the exchange and prints the histograms of the latency of the stages (see the host tools).
+ * The replayed captures of the spool have no timing line. */
+#define CAPTURE_TIMING 0
+//#define CAPTURE_TIMING 1
+#define CLOCK_SYNC_INTERVAL_MS 1000 // The clocks drift apart by up to tens of us in this time
+#define CLOCK_SYNC_PROBES      4    // Number of probes of an exchange; the one with the shortest round trip wins
+#define CLOCK_SYNC_TIMEOUT_MS  20   // A server, which doesn't answer, delays a capture by this once per CLOCK_SYNC_INTERVAL_MS
+
 //Size of the stack (as number of 32bit words) for FreeRTOS threads we create
 #define STANDARD_THREAD_STACKSIZE 1024
 
 extern sys_thread_t network_init_thread_handle; // Defined in network_thread.cpp
 extern void network_init_thread(void *p);       // Defined in network_thread.cpp
+extern void network_wait_ready();               // Defined in network_thread.cpp
+
+/* Capture settings, which can be changed at runtime by the commands typed in the serial terminal
+ * (see ProcessConsoleCommand()). They are initialized by the macros and constants above. */
+struct CaptureConfig {
+	u32            SampleCount;   // Number of samples of a capture
+	u8             AveragingMode; // XADC averaging, one of XSM_AVG_*_SAMPLES
+	u8             AdcClkDivisor; // ADCCLK divider ratio
+	std::string    ServerAddr;    // IP address of the server in numerical form
+	unsigned short ServerPort;    // Port of the server
+};
+static CaptureConfig Config{ SAMPLE_COUNT, AVERAGING_MODE, ADC_CLK_DIVISOR, SERVER_ADDR, SERVER_PORT }; // Settings for the next capture
+static CaptureConfig ActiveConfig; // Settings the XADC is configured with, i.e., the settings of the last capture
+
+#if XADC_MODE != XADC_MODE_SINGLE_CHANNEL
+/* In the sequencer and simultaneous modes, we need to know the channel of each sample. The HW design must use stream_tlaster
+ * with the parameter TID_IN_TDATA=1 and AXI DMA with the stream data width of 32 bits.
+ * Each DMA word then holds the raw sample in bits [15:0] and the channel address (XADC Wizard AXI-Stream TID)
+ * in bits [20:16]. */
+typedef u32 DmaWord;
+#else
+typedef u16 DmaWord;
+#endif
 
-/* We need the target buffer of the DMA transfer to be aligned on an address divisible by 4.
- * We are also making it 16 bytes larger than needed, because we need to invalidate Data Cache
- * in a slightly bigger memory range. Otherwise we risk cache issues caused by end of the buffer
- * not aligned with cache line. */
-static u16 DataBuffer[ SAMPLE_COUNT + 8 ] __attribute__((aligned(4)));
+#define DMA_MAX_TRANSFER_BYTES 0x03FFFFFF // The AXI DMA in the HW design has the 26-bit buffer length register
+
+#if CHUNK_SAMPLE_COUNT == 0
+static_assert( MAX_SAMPLE_COUNT * sizeof(DmaWord) <= DMA_MAX_TRANSFER_BYTES, "MAX_SAMPLE_COUNT doesn't fit in a single DMA transfer" );
+
+/* Number of buffers of the captures. A capture holds its buffer as long as any part of the application uses it.
+ * With two buffers, the next capture can start while the previous one is still being sent. Dropping the oldest
+ * capture needs the third buffer: one capture is being sent, one waits for the network and one is being captured. */
+#if OVERLOAD_POLICY == OVERLOAD_DROP_OLDEST
+#define CAPTURE_BUFFERS 3
+#else
+#define CAPTURE_BUFFERS 2
+#endif
+
+/* The pool of the target buffers of the DMA transfers, carved out of DmaBuffers by DMAInitialize().
+ * A buffer is sized for MAX_SAMPLE_COUNT; a capture uses the first ActiveConfig.SampleCount samples of it. */
+static DmaBufferPool CapturePool;
+
+#define SPOOL_ENABLED ( CAPTURE_SPOOL_SIZE > 0 )
+
+#define DMA_BUFFERS_SIZE ( CAPTURE_BUFFERS * MAX_SAMPLE_COUNT * sizeof(DmaWord) ) // Memory needed for the DMA buffers
+#else
+static_assert( CHUNK_SAMPLE_COUNT * sizeof(DmaWord) <= DMA_MAX_TRANSFER_BYTES, "CHUNK_SAMPLE_COUNT doesn't fit in a single DMA transfer" );
+
+/* The pool of the buffers of the chunks of the large-capture mode, carved out of DmaBuffers by DMAInitialize().
+ * The DMA writes into DiscardBuffer when all chunk buffers are in use, i.e., when the network is too slow. */
+static DmaBufferPool ChunkPool;
+static DmaWord      *DiscardBuffer;
+
+#define DMA_BUFFERS_SIZE ( ( CHUNK_BUFFERS + 1 ) * CHUNK_SAMPLE_COUNT * sizeof(DmaWord) ) // Memory needed for the DMA buffers
+
+// A chunk filled by the DMA, passed from DmaRxIntrHandler() to ReceiveAndSendChunks() running in sender_thread
+struct FilledChunk {
+	u16 Block;         // Block of ChunkPool (DmaBuffer::Detach() of the reference held by the DMA)
+	u32 Count;         // Number of samples in the chunk
+	u32 DroppedBefore; // DroppedSamples when the chunk was completed, i.e., the samples dropped before the chunk
+	                   // and the samples lost in the chunk itself
+	Timestamp Done;    // When the DMA completed the chunk
+};
+/* Chunks filled by the DMA, waiting to be sent. The interrupt handler and sender_thread run on the same core,
+ * so the ring needs no memory barriers; DmaRxIntrHandler() wakes ChunkReader by a task notification after a push. */
+static SpscRing<FilledChunk, SpscCapacityFor( CHUNK_BUFFERS ), SpscSameCore> FilledChunks;
+static TaskHandle_t ChunkReader; // The task running ReceiveAndSendChunks()
+
+// State of the chunked capture shared with DmaRxIntrHandler()
+static volatile s16 ChunkInFlight;    // Block of ChunkPool the DMA writes into (-1 means DiscardBuffer)
+static volatile u32 ChunksToArm;      // Number of chunks of the capture the DMA wasn't set up for yet
+static volatile u32 ChunksToComplete; // Number of chunks of the capture the DMA didn't complete yet
+static volatile u32 LastChunkCount;   // Number of samples in the last chunk of the capture
+static volatile u32 DroppedChunks;    // Number of chunks written into DiscardBuffer
+static volatile u32 DroppedSamples;   // Number of samples not received: the chunks written into DiscardBuffer and LostSamples
+static volatile u32 LostSamples;      // Number of samples lost in the FIFO of stream_tlaster (the chunks were shorter)
+static volatile bool DmaError;        // The DMA reported an error
+
+#define SPOOL_ENABLED 0 // The captures aren't spooled in the large-capture mode
+#endif
+
+/* The region of memory the DMA buffers are allocated from. Its memory type is set by DMA_MEMORY_TYPE.
+ * The MMU sets the memory type per 1 MB section, therefore the memory is aligned on 1 MB. */
+static u8 DmaBuffersMemory[ DMA_REGION_SIZE(DMA_BUFFERS_SIZE) ] __attribute__((aligned(DMA_MMU_SECTION_SIZE)));
+static DmaRegion DmaBuffers;
+
+static Timestamp DmaStartTime; // Time of the start signal of the last capture (see StartDmaTransfer())
+static u32 CaptureCount;       // Number of captures done since the start
+
+// Counters of the data not sent because the network was slower than the XADC (see OVERLOAD_POLICY); XADC_thread updates them
+struct OverloadCounters {
+	u32 DroppedCaptures; // Captures of the continuous mode dropped as a whole
+	u32 SummaryCaptures; // Captures of the continuous mode sent as a summary only
+	u64 DroppedSamples;  // Samples not sent as values: the dropped and the summary-only captures, and the dropped chunks
+	u32 Stalls;          // Captures of the continuous mode, after which the next capture had to wait for a free buffer
+};
+static OverloadCounters Overload;
 
 static XGpioPs GpioInstance;   // The PS GPIO instance
+static ButtonEvents Buttons;   // Debounced presses of the buttons BTN0 and BTN1
 static XSysMon XADCInstance;   // The XADC instance
 static XAxiDma AxiDmaInstance; // The AXI DMA instance
 
@@ -81,6 +349,56 @@ enum class eXADCInput { VAUX1, VPVN };              // Enumeration type for vali
 static eXADCInput ActiveXADCInput;                  // Defines, which input is active
 static float (*Xadc_RawToVoltageFunc)(u16 RawData); // Pointer to the function for converting raw measurement to volts.
                                                     // We switch it between the function for AUX1 and the function for VP/VN.
+static u16 ADCOffsetCoeff; // Raw value of the Offset Calibration Coefficient read by XADCInitialize()
+static u16 GainCoeff;      // Raw value of the Gain Calibration Coefficient read by XADCInitialize()
+/* Interrupt ID of the PS GPIO.
+ * The system device tree flow doesn't generate the interrupt ID in xparameters.h, the PS GPIO has the ID 52 on Zynq-7000. */
+#define GPIO_INTR_ID 52
+
+/* Events of the control loop of XADC_thread. XADC_thread blocks on the queue ControlEvents till an event comes, and none
+ * of its handlers waits for the network (sender_thread sends the captures), so a slow send can't delay the next trigger.
+ * Each source has at most one event in the queue at a time (CaptureSent one per job), so posting never waits. */
+enum class ControlEventType : u8 {
+	Buttons,       // ButtonEvents posted a debounced change of the buttons
+	DmaDone,       // The DMA transfer of a capture is done (Value: number of bytes written, DMA_DONE_ERROR on an error)
+	CaptureSent,   // sender_thread is done with a capture (Value: index of the job in Jobs)
+	RemoteCommand, // The command server passed a request in RemoteCommands
+	Tick,          // The periodic timer: check the console (and poll the buttons when BUTTON_INTERRUPTS is 0)
+};
+struct ControlEvent {
+	ControlEventType Type;
+	u32              Value;
+	Timestamp        Time; // When the event happened
+};
+#define CONTROL_EVENTS 16         // Length of the queue ControlEvents
+#define DMA_DONE_ERROR 0xFFFFFFFF // Value of DmaDone, when the DMA reported an error
+static QueueHandle_t ControlEvents;
+static volatile bool ButtonsPending; // The event Buttons is in the queue
+static volatile bool TickPending;    // The event Tick is in the queue
+
+// State of the control loop of XADC_thread
+enum class ControlState : u8 {
+	Idle,      // A capture can start (when a job is free)
+	Capturing, // The DMA transfer of a capture runs (in the large-capture mode: sender_thread performs the capture)
+};
+static ControlState State = ControlState::Idle;
+
+// Post an event to XADC_thread. It doesn't block; don't call it in an ISR.
+static void PostControlEvent(ControlEventType Type, u32 Value = 0)
+{
+	ControlEvent Event{ Type, Value, TimestampNow() };
+	xQueueSend( ControlEvents, &Event, 0 );
+} // PostControlEvent
+
+// Called by ButtonEvents when it posted a change of the buttons
+static void ButtonsChanged()
+{
+	if( !ButtonsPending ) {
+		ButtonsPending = true;
+		PostControlEvent( ControlEventType::Buttons );
+	}
+} // ButtonsChanged
+
 // Initialize the GPIO subsystem
 static int GPIOInitialize()
 {
@@ -108,9 +426,15 @@ static int GPIOInitialize()
 	 * which sets number of data samples we transfer form the XADC via DMA.
 	 * EMIO pin 81 is connected to board's button BTN0 and EMIO pin 82 to BTN1. */
 	XGpioPs_SetDirection( &GpioInstance, 2 /*Bank 2*/, 0x03FFFFFF );    //Set 26 EMIO pins 54-80 as outputs (pins 81 and 82 will be inputs)
-	XGpioPs_Write( &GpioInstance, 2 /*Bank 2*/, SAMPLE_COUNT << 1 );    //Set sample count to pins 55-80 and set start/stop signal to 0
+	XGpioPs_Write( &GpioInstance, 2 /*Bank 2*/, 0 );                    //Set sample count on pins 55-80 and start/stop signal to 0 (ApplyCaptureConfig() sets the sample count)
 	XGpioPs_SetOutputEnable( &GpioInstance, 2 /*Bank 2*/, 0x03FFFFFF ); //Enable 26 EMIO pins 54-80
 
+	// The buttons BTN0 and BTN1 are the two bits of Bank 2 above the 26 output pins
+	if( Buttons.Initialize( GpioInstance, 2 /*Bank 2*/, 26, 2, BUTTON_DEBOUNCE_MS, ButtonsChanged ) == XST_FAILURE ) {
+		cerr << "ButtonEvents::Initialize failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+
 	return 0;
 } // GPIOInitialize
 
@@ -120,54 +444,103 @@ static float Xadc_RawToVoltageAUX1(u16 RawData)
 	const float Scale = 3.32; // We use VAUX[1] as unipolar; it has the scale from 0 V to 3.32 V.
 	                          // There is voltage divider of R1 = 2.32 kOhm and R2 = 1 kOhm on the input.
 
-#if AVERAGING_MODE == XSM_AVG_0_SAMPLES
-	// XADC doesn't do averaging, only the 12 most significant bits of RawData are valid
-	return Scale * ( float(RawData >> 4) / float(0xFFF) );
-#else
-	// XADC does average samples, all 16 bits of RawData are valid
-	return Scale * ( float(RawData)      / float(0xFFFF) );
-#endif
+	if( ActiveConfig.AveragingMode == XSM_AVG_0_SAMPLES )
+		// XADC doesn't do averaging, only the 12 most significant bits of RawData are valid
+		return Scale * ( float(RawData >> 4) / float(0xFFF) );
+	else
+		// XADC does average samples, all 16 bits of RawData are valid
+		return Scale * ( float(RawData)      / float(0xFFFF) );
 } // Xadc_RawToVoltageAUX1
 
 // Conversion function of XADC raw sample to voltage for the channel VP/VN
 static float Xadc_RawToVoltageVPVN(u16 RawData)
 {
-#if AVERAGING_MODE == XSM_AVG_0_SAMPLES
-	// XADC doesn't do averaging, only the 12 most significant bits of RawData are valid
+	if( ActiveConfig.AveragingMode == XSM_AVG_0_SAMPLES ) {
+		// XADC doesn't do averaging, only the 12 most significant bits of RawData are valid
+
+		if( (RawData >> 4) == 0x800 ) // This is the special case of the lowest negative value.
+			return -0.5;              // The measuring range in bipolar mode is -500 mV to 499.75 mV.
 
-	if( (RawData >> 4) == 0x800 ) // This is the special case of the lowest negative value.
-		return -0.5;              // The measuring range in bipolar mode is -500 mV to 499.75 mV.
+		float sign;
 
-	float sign;
+		if( RawData & 0x8000 ) {    // Is sign bit equal to 1? I.e. is RawData negative?
+			sign = -1.0;
+			RawData = ~RawData + 1; // Get absolute value from negative two's complement integer
+		}
+		else
+			sign = 1.0;
 
-	if( RawData & 0x8000 ) {    // Is sign bit equal to 1? I.e. is RawData negative?
-		sign = -1.0;
-		RawData = ~RawData + 1; // Get absolute value from negative two's complement integer
+		RawData = RawData >> 4; // We are not using averaging, only the 12 most significant bits of RawData are valid
+		return sign * float(RawData) * ( 1.0/4096.0 ); // One bit equals to the reading of 244 uV. I.e., 1/4096 == 244e-6
 	}
-	else
-		sign = 1.0;
+	else {
+		// XADC does average samples, all 16 bits of RawData are valid
 
-	RawData = RawData >> 4; // We are not using averaging, only the 12 most significant bits of RawData are valid
-	return sign * float(RawData) * ( 1.0/4096.0 ); // One bit equals to the reading of 244 uV. I.e., 1/4096 == 244e-6
-#else
-	// XADC does average samples, all 16 bits of RawData are valid
+		if( RawData == 0x8000 ) // This is the special case of the lowest negative value. The measuring range is -500 mV to 499.75 mV.
+			return -0.5;
 
-	if( RawData == 0x8000 ) // This is the special case of the lowest negative value. The measuring range is -500 mV to 499.75 mV.
-		return -0.5;
+		float sign;
 
-	float sign;
+		if( RawData & 0x8000 ) {    // Is sign bit equal to 1? I.e. is RawData negative?
+			sign = -1.0;
+			RawData = ~RawData + 1; // Get absolute value from negative two's complement integer
+		}
+		else
+			sign = 1.0;
 
-	if( RawData & 0x8000 ) {    // Is sign bit equal to 1? I.e. is RawData negative?
-		sign = -1.0;
-		RawData = ~RawData + 1; // Get absolute value from negative two's complement integer
+		return sign * float(RawData) * ( 1.0/65535.0 ); // One bit equals to the reading of 1/65535 volts
 	}
-	else
-		sign = 1.0;
-
-	return sign * float(RawData) * ( 1.0/65535.0 ); // One bit equals to the reading of 1/65535 volts
-#endif
 } // Xadc_RawToVoltageVPVN
 
+#if XADC_MODE != XADC_MODE_SINGLE_CHANNEL
+static_assert( DEMUX_CH_AUX_MIN == XSM_CH_AUX_MIN, "ChannelDemux.h doesn't match xsysmon.h" );
+
+// Get the bit mask of the channel in the XADC sequencer channel enable registers (XSM_SEQ_CH_* of xsysmon.h)
+static u32 ChannelToSeqMask(u8 Channel)
+{
+	if( Channel == XSM_CH_VPVN )
+		return XSM_SEQ_CH_VPVN;
+	if( Channel >= XSM_CH_AUX_MIN && Channel <= XSM_CH_AUX_MAX )
+		return XSM_SEQ_CH_AUX00 << (Channel - XSM_CH_AUX_MIN);
+	return 0; // We don't scan other channels
+} // ChannelToSeqMask
+
+#define CHANNEL_NAME_MAX_CHARS 11 // "channel 255"
+// The header line of a series "# <channel name>,<channel name> <number of samples>\n" (see WriteSamples())
+#define SERIES_HEADER_MAX_CHARS ( 2 + 2*CHANNEL_NAME_MAX_CHARS + 1 + 1 + 10 + 1 )
+
+/* Write the human-readable name of the channel to Text of Size characters (incl. the terminating zero).
+ * Returns the length of the name. */
+static size_t FormatChannelName(char *Text, size_t Size, u8 Channel)
+{
+	int n;
+	if( Channel == XSM_CH_VPVN )
+		n = snprintf( Text, Size, "VP/VN" );
+	else if( Channel >= XSM_CH_AUX_MIN && Channel <= XSM_CH_AUX_MAX )
+		n = snprintf( Text, Size, "VAUX[%d]", Channel - XSM_CH_AUX_MIN );
+	else
+		n = snprintf( Text, Size, "channel %d", Channel );
+	if( n < 0 )
+		return 0;
+	return size_t(n) < Size ? size_t(n) : Size - 1;
+} // FormatChannelName
+
+// Get the human-readable name of the channel
+static std::string ChannelName(u8 Channel)
+{
+	char Name[ CHANNEL_NAME_MAX_CHARS + 1 ];
+	return std::string( Name, FormatChannelName( Name, sizeof(Name), Channel ) );
+} // ChannelName
+
+/* Get the function converting raw samples of the channel to voltage.
+ * All the analog inputs A0-A5 of Cora Z7 have the same voltage divider as VAUX[1],
+ * therefore the conversion function for VAUX[1] applies to all the VAUX channels. */
+static float (*ChannelRawToVoltageFunc(u8 Channel))(u16 RawData)
+{
+	return Channel == XSM_CH_VPVN ? Xadc_RawToVoltageVPVN : Xadc_RawToVoltageAUX1;
+} // ChannelRawToVoltageFunc
+#endif // XADC_MODE != XADC_MODE_SINGLE_CHANNEL
+
 // Convert 12-bit two's complement integer stored in u16 to int16_t
 static int16_t Convert12BitToSigned16Bit(u16 num)
 {
@@ -207,12 +580,12 @@ static int XADCInitialize()
 	}
 
 	// Print values of calibration coefficients. (Calibration was done automatically during FPGA configuration.)
-	u16 ADCOffsetCoeff = XSysMon_GetCalibCoefficient(&XADCInstance, XSM_CALIB_ADC_OFFSET_COEFF); //Read value of the Offset Calibration Coefficient from the XADC register
+	ADCOffsetCoeff = XSysMon_GetCalibCoefficient(&XADCInstance, XSM_CALIB_ADC_OFFSET_COEFF); //Read value of the Offset Calibration Coefficient from the XADC register
 	cout << "calib coefficient ADC offset: "
 	     << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << ADCOffsetCoeff       // Print Offset Coeff. raw value in hex
 	     << std::dec << " (" << Convert12BitToSigned16Bit(ADCOffsetCoeff >> 4) << " bits)" << endl; // Print the Offset Coeff. value
 
-	u16 GainCoeff = XSysMon_GetCalibCoefficient(&XADCInstance, XSM_CALIB_GAIN_ERROR_COEFF); //Read value of the Gain Calibration Coefficient from the XADC register
+	GainCoeff = XSysMon_GetCalibCoefficient(&XADCInstance, XSM_CALIB_GAIN_ERROR_COEFF); //Read value of the Gain Calibration Coefficient from the XADC register
 	cout << "calib coefficient gain error: "
 	     << std::hex << std::setw(4) << GainCoeff                              // Print Gain Coeff. raw value in hex
 	     << std::dec << std::fixed << std::setprecision(1) << std::showpoint
@@ -220,7 +593,7 @@ static int XADCInitialize()
 
 	// Disable all interrupts
 	XSysMon_IntrGlobalDisable(&XADCInstance);
-	// Disable the Channel Sequencer (we will use the Single Channel mode)
+	// Disable the Channel Sequencer (ActivateXADCInput() or ActivateSequencer() selects the mode later)
 	XSysMon_SetSequencerMode(&XADCInstance, XSM_SEQ_MODE_SINGCHAN);
 	// Disable all alarms
 	XSysMon_SetAlarmEnables(&XADCInstance, 0);
@@ -233,9 +606,6 @@ static int XADCInitialize()
 	// Write Configuration Register 0
 	XSysMon_WriteReg(XADCInstance.Config.BaseAddress, XSM_CFR0_OFFSET, RegValue);
 
-	// Set averaging mode
-	XSysMon_SetAvg(&XADCInstance, AVERAGING_MODE); // Select averaging mode by defining value of the macro AVERAGING_MODE
-
 	/* Enable offset and gain calibration
 	 * When internal FPGA voltage references are used, the Gain Calibration Coefficient has constant value 0x007F and should be ignored.
 	 * Cora Z7 is an example of Zynq board relying on internal voltage reference.
@@ -256,9 +626,9 @@ static int ActivateXADCInput()
 {
 	XStatus Status;
 
-	/* Set the ADCCLK frequency equal to 1/4 of the XADC input clock.
-	 * When the input clock is 104 MHz it will result in 1 Msps sampling rate. */
-	XSysMon_SetAdcClkDivisor(&XADCInstance, 4);
+	/* Set the ADCCLK frequency (by default equal to 1/4 of the XADC input clock).
+	 * When the input clock is 104 MHz, the divider ratio 4 results in 1 Msps sampling rate. */
+	XSysMon_SetAdcClkDivisor(&XADCInstance, ActiveConfig.AdcClkDivisor);
 
 	if( ActiveXADCInput == eXADCInput::VAUX1 ) {
 		// Set single channel unipolar mode for VAUX[1] analog input
@@ -297,6 +667,613 @@ static int ActivateXADCInput()
 	return XST_SUCCESS;
 } // ActivateXADCInput
 
+#if XADC_MODE != XADC_MODE_SINGLE_CHANNEL
+/* Activate the sequencer in the mode SequencerMode on the channels Channels (ORed XSM_SEQ_CH_* masks).
+ * We use XSM_SEQ_MODE_CONTINPASS for the sequencer mode and XSM_SEQ_MODE_SIMUL for the simultaneous mode. */
+static int ActivateSequencer(u8 SequencerMode, u32 Channels)
+{
+	XStatus Status;
+
+	// Set the ADCCLK frequency (by default 1/4 of the XADC input clock, i.e., 1 Msps shared by all the scanned channels)
+	XSysMon_SetAdcClkDivisor(&XADCInstance, ActiveConfig.AdcClkDivisor);
+
+	// The sequencer must be in the safe mode while we configure it
+	XSysMon_SetSequencerMode(&XADCInstance, XSM_SEQ_MODE_SAFE);
+
+	Status = XSysMon_SetSeqChEnables(&XADCInstance, Channels);
+	if(Status != XST_SUCCESS) {
+		cerr << "XSysMon_SetSeqChEnables failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+
+	// VP/VN is sampled in bipolar mode, all VAUX channels in unipolar mode
+	Status = XSysMon_SetSeqInputMode(&XADCInstance, Channels & XSM_SEQ_CH_VPVN);
+	if(Status != XST_SUCCESS) {
+		cerr << "XSysMon_SetSeqInputMode failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+
+	// In the sequencer mode, averaging set by XSysMon_SetAvg() applies only to the channels enabled here
+	Status = XSysMon_SetSeqAvgEnables(&XADCInstance, ActiveConfig.AveragingMode == XSM_AVG_0_SAMPLES ? 0 : Channels);
+	if(Status != XST_SUCCESS) {
+		cerr << "XSysMon_SetSeqAvgEnables failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+
+	// Default 4 ADCCLKs used for the settling on all channels
+	Status = XSysMon_SetSeqAcqTime(&XADCInstance, 0);
+	if(Status != XST_SUCCESS) {
+		cerr << "XSysMon_SetSeqAcqTime failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+
+	XSysMon_SetSequencerMode(&XADCInstance, SequencerMode);
+
+	if( SequencerMode == XSM_SEQ_MODE_SIMUL ) {
+		cout << "simultaneous sampling is activated on the channel pairs:";
+		for( u8 Channel = XSM_CH_AUX_MIN; Channel < XSM_CH_AUX_MIN + 8; Channel++ )
+			if( Channels & ChannelToSeqMask(Channel) )
+				cout << ' ' << ChannelName(Channel) << '+' << ChannelName(Channel + 8);
+	}
+	else {
+		cout << "sequencer is activated on the channels:";
+		for( u8 Channel = 0; Channel <= XSM_CH_AUX_MAX; Channel++ )
+			if( Channels & ChannelToSeqMask(Channel) )
+				cout << ' ' << ChannelName(Channel);
+	}
+	cout << endl;
+
+	return XST_SUCCESS;
+} // ActivateSequencer
+
+/* Per-channel series demultiplexed from the DMA data by DemultiplexData() or DemultiplexPairs().
+ * Samples of all the channels are stored in ChannelData, series of a channel is a contiguous part of it.
+ * In the simultaneous mode, a series holds the pairs of samples of two channels converted at the same instant,
+ * stored interleaved (A, B, A, B, ...). */
+struct ChannelSeries {
+	u8     Channel;  // XADC channel address (of the channel sampled by ADC A in the simultaneous mode)
+	u8     ChannelB; // Simultaneous mode only: XADC channel address of the channel sampled by ADC B
+	u32    Count;    // Number of samples of the channel (number of pairs in the simultaneous mode)
+	float *Samples;  // Samples of the channel converted to volts
+};
+#if CHUNK_SAMPLE_COUNT == 0
+static float         ChannelData[ MAX_SAMPLE_COUNT ];
+#else
+static float         ChannelData[ CHUNK_SAMPLE_COUNT ]; // Holds the series of a single chunk
+#endif
+static ChannelSeries Series[ XSM_CH_AUX_MAX + 1 ];
+static int           SeriesCount; // Number of valid entries in Series
+
+/* Demultiplex Count DMA words from Data into per-channel series, converting samples to volts with the conversion function
+ * of each channel. Samples keep their order in time within each series. */
+static void DemultiplexData(const DmaWord *Data, u32 Count)
+{
+	u32 ChannelCount[ XSM_CH_AUX_MAX + 1 ] = {};
+	for( u32 i = 0; i < Count; i++ )
+		ChannelCount[ DmaWordChannel(Data[i]) ]++;
+
+	// Assign a contiguous part of ChannelData to each channel, which has samples
+	float *Next[ XSM_CH_AUX_MAX + 1 ] = {};
+	u32 Offset = 0;
+	SeriesCount = 0;
+	for( u8 Channel = 0; Channel <= XSM_CH_AUX_MAX; Channel++ ) {
+		if( ChannelCount[Channel] == 0 )
+			continue;
+		Next[Channel] = ChannelData + Offset;
+		Series[SeriesCount++] = { Channel, 0, ChannelCount[Channel], ChannelData + Offset };
+		Offset += ChannelCount[Channel];
+	}
+
+	for( u32 i = 0; i < Count; i++ ) {
+		u8 Channel = DmaWordChannel(Data[i]);
+		*Next[Channel]++ = ChannelRawToVoltageFunc(Channel)( DmaWordSample(Data[i]) );
+	}
+} // DemultiplexData
+
+static u32 UnpairedSamples; // Simultaneous mode: number of samples demultiplexed last without a counterpart from the other ADC
+
+/* Demultiplex Count DMA words from Data into per-pair series of the simultaneous mode, converting samples to volts
+ * (see SplitPairs() in ChannelDemux.h). Both samples of a conversion come in two consecutive DMA words. A word, which
+ * doesn't form a pair with its neighbor (e.g., when the transfer started between the two results of a conversion),
+ * is skipped and counted in UnpairedSamples. */
+static void DemultiplexPairs(const DmaWord *Data, u32 Count)
+{
+	PairSeries<float> Pairs[ DEMUX_PAIRS ];
+	// All VAUX channels of Cora Z7 have the same voltage divider
+	const int PairCount = SplitPairs( Data, Count, SIMULTANEOUS_B_FIRST, ChannelData, Pairs, UnpairedSamples, Xadc_RawToVoltageAUX1 );
+
+	SeriesCount = 0;
+	for( int p = 0; p < PairCount; p++ )
+		Series[SeriesCount++] = { u8(XSM_CH_AUX_MIN + Pairs[p].Pair), u8(XSM_CH_AUX_MIN + Pairs[p].Pair + 8), Pairs[p].Count, Pairs[p].Samples };
+} // DemultiplexPairs
+#endif // XADC_MODE != XADC_MODE_SINGLE_CHANNEL
+
+// In the sequencer and simultaneous modes, demultiplex Count DMA words from Data into Series. Does nothing in the single channel mode.
+static void DemultiplexSamples(const DmaWord *Data, u32 Count)
+{
+#if XADC_MODE == XADC_MODE_SEQUENCER
+	DemultiplexData( Data, Count );  // Split samples into per-channel series converted to volts
+#elif XADC_MODE == XADC_MODE_SIMULTANEOUS
+	DemultiplexPairs( Data, Count ); // Split samples into per-pair series converted to volts
+#endif
+} // DemultiplexSamples
+
+// What started a capture
+enum class TriggerSource : u8 {
+	Button,     // BTN0
+	Command,    // A remote command (the trigger or the start of the continuous mode)
+	Continuous, // The next capture of the continuous mode
+};
+
+/* A capture passed from XADC_thread to sender_thread. XADC_thread fills the job in when it starts the capture,
+ * and the job carries everything sender_thread needs. XADC_thread can therefore change the settings and start
+ * the next capture while the previous one is being sent. */
+struct CaptureJob {
+	CaptureConfig Config;    // The settings of the capture
+	u32           Number;    // Number of the capture since the start
+	TriggerSource Source;
+	bool          Reply;     // The command server waits for the result of the capture
+	Timestamp     Triggered; // When the trigger came (the first edge of the button, the reception of the command)
+	Timestamp     Started;   // When XADC_thread started the capture
+	Timestamp     DmaStart;  // Time of the start signal (0 when the capture failed before it)
+	Timestamp     DmaDone;   // When the DMA transfer was done (of the last chunk sent in the large-capture mode)
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+	float       (*RawToVoltage)(u16 RawData); // The conversion function of the input of the capture
+	const char   *Channel;                   // Name of the input of the capture
+#endif
+#if CHUNK_SAMPLE_COUNT == 0
+	DmaBuffer     Capture;      // The buffer of the capture; sender_thread releases it when the capture was sent
+	u32           BytesWritten; // Number of bytes the DMA wrote
+#else
+	u32           GapSamples;   // Set by sender_thread: number of the samples of the chunks dropped (or lost) during the capture
+#endif
+	bool          SummaryOnly;     // Send only the summary of each channel (OVERLOAD_SUMMARY)
+	u32           DroppedCaptures; // Overload.DroppedCaptures and Overload.DroppedSamples when the capture was passed
+	u64           DroppedSamples;  // to sender_thread; the header of the capture carries them
+	bool          Sent;   // Set by sender_thread: the data were sent to the server
+	int           Status; // Set by sender_thread: XST_FAILURE on an error, after which the application can't continue
+};
+
+// Print the first 8 values (of each series in the sequencer and simultaneous modes) to the console
+static void PrintSamples(const CaptureJob &Job, const DmaWord *Data, u32 Count)
+{
+	cout << std::defaultfloat << std::setprecision(7); // Disabling std::fixed used in previous output
+#if XADC_MODE == XADC_MODE_SEQUENCER
+	for( int s = 0; s < SeriesCount; s++ ) {
+		cout << "\n***** XADC DATA " << ChannelName(Series[s].Channel) << "[0..7] *****\n";
+		for( u32 i = 0; i < 8 && i < Series[s].Count; i++ )
+			cout << Series[s].Samples[i] << endl;
+	}
+#elif XADC_MODE == XADC_MODE_SIMULTANEOUS
+	for( int s = 0; s < SeriesCount; s++ ) {
+		cout << "\n***** XADC DATA " << ChannelName(Series[s].Channel) << ',' << ChannelName(Series[s].ChannelB) << "[0..7] *****\n";
+		for( u32 i = 0; i < 8 && i < Series[s].Count; i++ )
+			cout << Series[s].Samples[2*i] << ',' << Series[s].Samples[2*i + 1] << endl;
+	}
+#else
+	cout << "\n***** XADC DATA[0..7] *****\n";
+	for( u32 i = 0; i < 8 && i < Count; i++ )
+		cout << Job.RawToVoltage( DmaWordSample(Data[i]) ) << endl;
+#endif
+} // PrintSamples
+
+/* Write the values (Series demultiplexed from Data in the sequencer and simultaneous modes) to the network Sink.
+ * The values are formatted by FormatSampleValue() and written to the sink directly: the text is the same as that
+ * of the stream with std::setprecision(7), without its locale-aware formatting and the virtual calls per value.
+ * Errors are kept by the sink; the caller checks them when flushing the stream of the sink. */
+static void WriteSamples(SocketSink &Sink, const CaptureJob &Job, const DmaWord *Data, u32 Count)
+{
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+	char Line[ 2*SAMPLE_VALUE_MAX_CHARS + 2 ]; // One line of values
+#else
+	static_assert( SERIES_HEADER_MAX_CHARS >= 2*SAMPLE_VALUE_MAX_CHARS + 2, "Line must hold a line of values" );
+	char Line[ SERIES_HEADER_MAX_CHARS + 1 ]; // One line of values, or the header line of a series (with the zero of snprintf)
+#endif
+	size_t n;
+#if XADC_MODE == XADC_MODE_SEQUENCER
+	/* Each series starts with a header line "# <channel name> <number of samples>",
+	 * followed by the samples of the channel, one value per line. */
+	for( int s = 0; s < SeriesCount; s++ ) {
+		Line[ 0 ] = '#';
+		Line[ 1 ] = ' ';
+		n = 2;
+		n += FormatChannelName( Line + n, sizeof(Line) - n, Series[s].Channel );
+		n += snprintf( Line + n, sizeof(Line) - n, " %lu\n", (unsigned long)Series[s].Count );
+		Sink.write( Line, n );
+		for( u32 i = 0; i < Series[s].Count; i++ ) {
+			n = FormatSampleValue( Line, Series[s].Samples[i] );
+			Line[ n++ ] = '\n';
+			Sink.write( Line, n );
+		}
+	}
+#elif XADC_MODE == XADC_MODE_SIMULTANEOUS
+	/* Each series starts with a header line "# <channel A name>,<channel B name> <number of pairs>",
+	 * followed by the pairs of samples converted at the same instant, one pair "A,B" per line. */
+	for( int s = 0; s < SeriesCount; s++ ) {
+		Line[ 0 ] = '#';
+		Line[ 1 ] = ' ';
+		n = 2;
+		n += FormatChannelName( Line + n, sizeof(Line) - n, Series[s].Channel );
+		Line[ n++ ] = ',';
+		n += FormatChannelName( Line + n, sizeof(Line) - n, Series[s].ChannelB );
+		n += snprintf( Line + n, sizeof(Line) - n, " %lu\n", (unsigned long)Series[s].Count );
+		Sink.write( Line, n );
+		for( u32 i = 0; i < Series[s].Count; i++ ) {
+			n = FormatSampleValue( Line, Series[s].Samples[2*i] );
+			Line[ n++ ] = ',';
+			n += FormatSampleValue( Line + n, Series[s].Samples[2*i + 1] );
+			Line[ n++ ] = '\n';
+			Sink.write( Line, n );
+		}
+	}
+#else
+	for( u32 i = 0; i < Count; i++ ) {
+		n = FormatSampleValue( Line, Job.RawToVoltage( DmaWordSample(Data[i]) ) );
+		Line[ n++ ] = '\n';
+		Sink.write( Line, n );
+	}
+#endif
+} // WriteSamples
+
+// Summarize Count values of a Channel; ValueAt(i) returns the i-th value
+template<typename ValueFunction>
+static CaptureSummary SummarizeValues(const std::string &Channel, u32 Count, ValueFunction ValueAt)
+{
+	CaptureSummary Summary;
+	Summary.Channel = Channel;
+	Summary.Samples = Count;
+	double Sum = 0;
+	for( u32 i = 0; i < Count; i++ ) {
+		const float Value = ValueAt( i );
+		if( i == 0 || Value < Summary.Min )
+			Summary.Min = Value;
+		if( i == 0 || Value > Summary.Max )
+			Summary.Max = Value;
+		Sum += Value;
+	}
+	Summary.Mean = Count ? float( Sum / Count ) : 0;
+	return Summary;
+} // SummarizeValues
+
+/* Write the summary line of each channel (see CaptureFormat.h) to the network stream f instead of the values.
+ * It's used for the captures, which waited for the network (OVERLOAD_SUMMARY). */
+static void WriteSummary(std::ostream &f, const CaptureJob &Job, const DmaWord *Data, u32 Count)
+{
+#if XADC_MODE == XADC_MODE_SEQUENCER
+	for( int s = 0; s < SeriesCount; s++ ) {
+		const float *Samples = Series[s].Samples;
+		WriteCaptureSummary( f, SummarizeValues( ChannelName(Series[s].Channel), Series[s].Count, [Samples]( u32 i ) { return Samples[i]; } ) );
+	}
+#elif XADC_MODE == XADC_MODE_SIMULTANEOUS
+	for( int s = 0; s < SeriesCount; s++ ) { // The pairs "A,B" are interleaved
+		const float *Samples = Series[s].Samples;
+		WriteCaptureSummary( f, SummarizeValues( ChannelName(Series[s].Channel), Series[s].Count, [Samples]( u32 i ) { return Samples[2*i]; } ) );
+		WriteCaptureSummary( f, SummarizeValues( ChannelName(Series[s].ChannelB), Series[s].Count, [Samples]( u32 i ) { return Samples[2*i + 1]; } ) );
+	}
+#else
+	// The raw values are converted like in WriteSamples(), just not formatted
+	WriteCaptureSummary( f, SummarizeValues( Job.Channel, Count, [&Job, Data]( u32 i ) { return Job.RawToVoltage( DmaWordSample(Data[i]) ); } ) );
+#endif
+} // WriteSummary
+
+#if CAPTURE_HEADER
+// Write the header line of the capture (see CaptureFormat.h) to the network stream f
+static void WriteCaptureInfo(std::ostream &f, const CaptureJob &Job)
+{
+	const u16 AveragedSamples[] = { 0, 16, 64, 256 }; // Indexed by XSM_AVG_*_SAMPLES
+
+	CaptureInfo Info;
+	Info.Board         = BOARD_ID;
+	Info.Number        = Job.Number;
+	Info.Averaging     = AveragedSamples[ Job.Config.AveragingMode ];
+	Info.AdcClkDivisor = Job.Config.AdcClkDivisor;
+	Info.OffsetCoeff   = ADCOffsetCoeff;
+	Info.GainCoeff     = GainCoeff;
+	Info.Time          = TimestampToNs( Job.DmaStart );
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+	Info.Channel = Job.Channel;
+#endif
+	Info.DroppedCaptures = Job.DroppedCaptures;
+	Info.DroppedSamples  = Job.DroppedSamples;
+	Info.Summary         = Job.SummaryOnly;
+	WriteCaptureHeader( f, Info );
+} // WriteCaptureInfo
+#endif
+
+#if CAPTURE_TIMING
+/* The clock exchange with the server of the captures; only sender_thread uses it. The socket is opened again
+ * when the server changes (the console command server), which forgets the offset measured before. */
+static ClockProbe     ServerClock;
+static std::string    ServerClockAddr;
+static unsigned short ServerClockPort;
+static Timestamp      ServerClockTried;    // The last exchange, whether it succeeded or not
+static bool           ServerClockReported; // The result of the first exchange with the server was printed
+
+// Measure the offset of the clock of the server at Addr:Port, when the last exchange is older than CLOCK_SYNC_INTERVAL_MS
+static void SyncServerClock(const std::string &Addr, unsigned short Port)
+{
+	if( !ServerClock.IsOpen() || Addr != ServerClockAddr || Port != ServerClockPort ) {
+		ServerClockAddr     = Addr;
+		ServerClockPort     = Port;
+		ServerClockTried    = 0;
+		ServerClockReported = false;
+		int Error = ServerClock.Open( Addr.c_str(), Port );
+		if( Error != 0 ) {
+			cerr << "ClockProbe::Open failed! errno == " << Error << endl;
+			return;
+		}
+	}
+	const Timestamp Now = TimestampNow();
+	if( ServerClockTried != 0 && Now - ServerClockTried < CLOCK_SYNC_INTERVAL_MS * TIMESTAMP_TICKS_PER_SECOND / 1000 )
+		return;
+	ServerClockTried = Now;
+
+	const bool Synced = ServerClock.Measure( CLOCK_SYNC_PROBES, CLOCK_SYNC_TIMEOUT_MS );
+	if( !ServerClockReported ) {
+		ServerClockReported = true;
+		if( Synced )
+			cout << "clock of the server synchronized (round trip " << ServerClock.Offset().Rtt / 1000 << " us)" << endl;
+		else
+			cout << "the server doesn't answer the clock exchange, the timing lines have no clock offset" << endl;
+	}
+} // SyncServerClock
+
+/* Write the timing line of the capture (see CaptureFormat.h) to the network stream f. It's called after the data
+ * of the capture were flushed, so the times of the first and the last send are known. */
+static void WriteTimingInfo(FileViaSocket &f, const CaptureJob &Job)
+{
+	const u16 AveragedSamples[] = { 0, 16, 64, 256 }; // Indexed by XSM_AVG_*_SAMPLES
+	const SocketSink &Sink = f.sink();
+	CaptureTiming Timing;
+	Timing.Number    = Job.Number;
+	Timing.Samples   = Job.Config.SampleCount;
+	Timing.Averaging = AveragedSamples[ Job.Config.AveragingMode ];
+	Timing.Trigger   = TimestampToNs( Job.Triggered != 0 ? Job.Triggered : Job.Started ); // The continuous mode has no trigger
+	Timing.DmaDone   = TimestampToNs( Job.DmaDone );
+	Timing.FirstSend = TimestampToNs( Sink.firstSendTime() );
+	Timing.LastSend  = TimestampToNs( Sink.lastSendTime() );
+
+	SyncServerClock( Job.Config.ServerAddr, Job.Config.ServerPort ); // Measured after the last send, so it doesn't delay the data
+	const ClockOffset &Clock = ServerClock.Offset();
+	Timing.Synced      = Clock.Valid;
+	Timing.ClockOffset = Clock.Offset;
+	Timing.ClockRtt    = Clock.Rtt;
+	WriteCaptureTiming( f, Timing );
+} // WriteTimingInfo
+#endif
+
+/* Open the connection of the stream f to the server. It's opened by the sink of the stream, which returns an error code
+ * instead of throwing an exception (with its message built on the heap). The error is printed unless Quiet.
+ * Returns false when the connection can't be opened. */
+static bool OpenServerStream(FileViaSocket &f, const std::string &Addr, unsigned short Port, bool Quiet = false)
+{
+	SocketSink &Sink = f.sink();
+#if SEND_TCP_NODELAY >= 0
+	Sink.setNoDelay( SEND_TCP_NODELAY == 1 ); // Applied when the connection is opened
+#endif
+	Sink.setFlushDeadline( SEND_FLUSH_DEADLINE_US );
+	if( Sink.open( Addr.c_str(), Port ) == SinkError::None )
+		return true;
+
+	if( !Quiet ) {
+		cerr << "Error on opening the socket:\n" << SocketSink::errorText( Sink.error() );
+		if( Sink.systemError() != 0 )
+			cerr << " errno == " << Sink.systemError() << SocketSink::errorHint( Sink.systemError() );
+		cerr << endl;
+	}
+	return false;
+} // OpenServerStream
+
+#if SPOOL_ENABLED
+/* The spool of the captures, which couldn't be sent (see CAPTURE_SPOOL_SIZE); only sender_thread stores and replays
+ * the captures. The memory isn't cleared at the startup, so the captures spooled before a reset are replayed after it.
+ * The section .noinit must be defined in the lscript.ld (see README.md). */
+static u8 SpoolMemory[ CAPTURE_SPOOL_SIZE ] __attribute__((section(".noinit"), aligned(8)));
+static CaptureSpool Spool;
+
+// The description of a spooled capture; the DMA words of the capture follow it in the record
+struct SpooledCapture {
+	Timestamp DmaStart;
+	u64       DroppedSamples;
+	u32       Number;
+	u32       SampleCount;
+	u32       DroppedCaptures;
+	u8        AveragingMode;
+	u8        AdcClkDivisor;
+	u8        Vpvn;        // Single channel mode: the capture is of VP/VN (else of VAUX[1])
+	u8        SummaryOnly;
+};
+static_assert( sizeof(SpooledCapture) % 8 == 0, "The DMA words must stay aligned in the record" );
+
+// The spooled captures are replayed to the server of the last capture sender_thread got
+static std::string    ReplayServerAddr( SERVER_ADDR );
+static unsigned short ReplayServerPort = SERVER_PORT;
+static u32            ReplayFailures; // Replays, which couldn't open the connection or were interrupted
+
+// Keep the capture of the Job, which couldn't be sent, in the spool
+static void SpoolCapture(const CaptureJob &Job, const DmaWord *Data)
+{
+	SpooledCapture Meta{};
+	Meta.DmaStart        = Job.DmaStart;
+	Meta.DroppedSamples  = Job.DroppedSamples;
+	Meta.Number          = Job.Number;
+	Meta.SampleCount     = Job.Config.SampleCount;
+	Meta.DroppedCaptures = Job.DroppedCaptures;
+	Meta.AveragingMode   = Job.Config.AveragingMode;
+	Meta.AdcClkDivisor   = Job.Config.AdcClkDivisor;
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+	Meta.Vpvn            = Job.RawToVoltage == Xadc_RawToVoltageVPVN;
+#endif
+	Meta.SummaryOnly     = Job.SummaryOnly;
+
+	if( Spool.Store( &Meta, sizeof(Meta), Data, Job.Config.SampleCount * sizeof(DmaWord) ) )
+		cout << "capture " << Job.Number << " kept in the spool, " << Spool.GetStatistics().Records << " capture(s) to replay" << endl;
+	else
+		cerr << "capture " << Job.Number << " is larger than the spool, it's lost" << endl;
+} // SpoolCapture
+
+/* Send the oldest spooled capture to the server; it's removed from the spool when it was sent.
+ * Returns false when it couldn't be sent (the server is still unreachable), i.e., the replay should be tried later. */
+static bool ReplaySpooledCapture()
+{
+	CaptureSpool::Record Record;
+	if( !Spool.Peek( Record ) )
+		return true;
+	const SpooledCapture &Meta = *(const SpooledCapture *)Record.Data;
+	const DmaWord *Data = (const DmaWord *)( &Meta + 1 );
+
+	// The job of the capture as it was when the capture was spooled
+	CaptureJob Job{};
+	Job.Config          = CaptureConfig{ Meta.SampleCount, Meta.AveragingMode, Meta.AdcClkDivisor, ReplayServerAddr, ReplayServerPort };
+	Job.Number          = Meta.Number;
+	Job.DmaStart        = Meta.DmaStart;
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+	Job.RawToVoltage    = Meta.Vpvn ? Xadc_RawToVoltageVPVN : Xadc_RawToVoltageAUX1;
+	Job.Channel         = Meta.Vpvn ? "VP/VN" : "VAUX[1]";
+#endif
+	Job.SummaryOnly     = Meta.SummaryOnly;
+	Job.DroppedCaptures = Meta.DroppedCaptures;
+	Job.DroppedSamples  = Meta.DroppedSamples;
+	DemultiplexSamples( Data, Meta.SampleCount );
+
+	const Timestamp Start = TimestampNow();
+	bool Sent = false;
+	FileViaSocket f;
+	if( OpenServerStream( f, ReplayServerAddr, ReplayServerPort, true ) ) { // Otherwise the capture stays in the spool
+		f << std::setprecision(7);
+#if CAPTURE_HEADER
+		WriteCaptureInfo( f, Job );
+#endif
+		if( Job.SummaryOnly )
+			WriteSummary( f, Job, Data, Meta.SampleCount );
+		else
+			WriteSamples( f.sink(), Job, Data, Meta.SampleCount );
+		f.flush();
+		Sent = bool(f);
+		f.close();
+	}
+	if( !Sent ) {
+		ReplayFailures++;
+		return false;
+	}
+
+	Spool.Remove( Record.Sequence, TimestampNow() - Start );
+	if( Spool.Empty() )
+		cout << "all spooled captures replayed (type spool to see the statistics)" << endl;
+	return true;
+} // ReplaySpooledCapture
+#endif // SPOOL_ENABLED
+
+#if CHUNK_SAMPLE_COUNT > 0 || DMA_INTERRUPT
+/* Interrupt ID of the S2MM channel of the AXI DMA (s2mm_introut connected to IRQ_F2P[0] of the PS).
+ * The system device tree flow doesn't generate the XPAR_FABRIC_* macros, IRQ_F2P[0] has the interrupt ID 61 on Zynq-7000. */
+#define DMA_RX_INTR_ID 61
+#endif
+
+#if CHUNK_SAMPLE_COUNT > 0
+/* Interrupt handler of the S2MM channel of the AXI DMA in the large-capture mode.
+ * When a chunk is completed, the handler immediately sets the DMA up for the next chunk (before the FIFO
+ * of stream_tlaster fills up) and passes the completed chunk to ReceiveAndSendChunks().
+ * The buffer of the next chunk is allocated from ChunkPool. When all the buffers are in use, the next chunk is written
+ * into DiscardBuffer and counted as dropped. A chunk shorter than expected lost samples in the FIFO; they are counted
+ * in DroppedSamples too, so that ReceiveAndSendChunks() marks them by a gap line. */
+static void DmaRxIntrHandler(void *Callback)
+{
+	XAxiDma *Dma = (XAxiDma *)Callback;
+	BaseType_t HigherPriorityTaskWoken = pdFALSE;
+
+	u32 IrqStatus = XAxiDma_IntrGetIrq( Dma, XAXIDMA_DEVICE_TO_DMA );
+	XAxiDma_IntrAckIrq( Dma, IrqStatus, XAXIDMA_DEVICE_TO_DMA );
+
+	if( IrqStatus & XAXIDMA_IRQ_ERROR_MASK ) {
+		DmaError = true; // The DMA halts on an error; ReceiveAndSendChunks() reports it
+		return;
+	}
+	if( !(IrqStatus & XAXIDMA_IRQ_IOC_MASK) )
+		return;
+
+	/* Number of samples the DMA received; the last chunk of a capture is usually shorter than the buffer.
+	 * stream_tlaster counts the samples lost in its FIFO in the chunk, so a chunk with lost samples is shorter too. */
+	u32 Count = XAxiDma_ReadReg( Dma->RxBdRing[0].ChanBase, XAXIDMA_BUFFLEN_OFFSET ) / sizeof(DmaWord);
+	const u32 Expected = ChunksToComplete > 1 ? CHUNK_SAMPLE_COUNT : LastChunkCount;
+	const u32 Lost = Count < Expected ? Expected - Count : 0;
+	ChunksToComplete = ChunksToComplete - 1;
+	s16 Completed = ChunkInFlight;
+	TRACE_EVENT_ISR( DmaChunk, Completed < 0 ? TRACE_CHUNK_DROPPED : u16(Completed) );
+
+	if( ChunksToArm > 0 ) {
+		DmaBuffer Next = ChunkPool.Allocate(); // ReceiveAndSendChunks() prepares the blocks for the DMA before releasing them
+		UINTPTR Target;
+		if( Next ) {
+			Target = (UINTPTR)Next.Data();
+			ChunkInFlight = s16( Next.Detach() ); // The reference is held by the DMA till the chunk is completed
+		}
+		else { // All chunk buffers are in use
+			ChunkInFlight = -1;
+			Target = (UINTPTR)DiscardBuffer;
+		}
+		if( XAxiDma_SimpleTransfer( Dma, Target, CHUNK_SAMPLE_COUNT * sizeof(DmaWord), XAXIDMA_DEVICE_TO_DMA ) != XST_SUCCESS )
+			DmaError = true;
+		ChunksToArm = ChunksToArm - 1;
+	}
+
+	if( Completed < 0 ) {
+		DroppedSamples = DroppedSamples + Count + Lost;
+		DroppedChunks  = DroppedChunks + 1;
+	}
+	else {
+		DroppedSamples = DroppedSamples + Lost; // The gap line before the values of the chunk marks them
+		LostSamples    = LostSamples + Lost;
+		FilledChunks.Push( FilledChunk{ u16(Completed), Count, DroppedSamples, TimestampNow() } ); // The ring has a slot for each chunk buffer
+		vTaskNotifyGiveFromISR( ChunkReader, &HigherPriorityTaskWoken );
+	}
+
+	portYIELD_FROM_ISR( HigherPriorityTaskWoken );
+} // DmaRxIntrHandler
+#elif DMA_INTERRUPT
+// Interrupt handler of the S2MM channel of the AXI DMA. It passes the end of the DMA transfer to XADC_thread.
+static void DmaRxIntrHandler(void *Callback)
+{
+	XAxiDma *Dma = (XAxiDma *)Callback;
+	BaseType_t HigherPriorityTaskWoken = pdFALSE;
+
+	u32 IrqStatus = XAxiDma_IntrGetIrq( Dma, XAXIDMA_DEVICE_TO_DMA );
+	XAxiDma_IntrAckIrq( Dma, IrqStatus, XAXIDMA_DEVICE_TO_DMA );
+	if( !(IrqStatus & ( XAXIDMA_IRQ_IOC_MASK | XAXIDMA_IRQ_ERROR_MASK )) )
+		return;
+
+	ControlEvent Event{ ControlEventType::DmaDone, DMA_DONE_ERROR, TimestampNow() };
+	if( !(IrqStatus & XAXIDMA_IRQ_ERROR_MASK) ) // After the transfer, the buffer length register holds the number of bytes written
+		Event.Value = XAxiDma_ReadReg( Dma->RxBdRing[0].ChanBase, XAXIDMA_BUFFLEN_OFFSET );
+	xQueueSendFromISR( ControlEvents, &Event, &HigherPriorityTaskWoken );
+
+	portYIELD_FROM_ISR( HigherPriorityTaskWoken );
+} // DmaRxIntrHandler
+#endif
+
+#if DMA_BENCHMARK
+/* Memory of the regions compared by the benchmark, one MMU section for each memory type.
+ * The index is the value of DmaMemoryType. */
+static u8        BenchMemory[3][ DMA_MMU_SECTION_SIZE ] __attribute__((aligned(DMA_MMU_SECTION_SIZE)));
+static DmaRegion BenchRegions[3];
+static DmaWord  *BenchBuffers[3];
+
+// Initialize the regions of the benchmark and allocate a buffer of the whole region in each of them
+static int InitializeDmaBenchmark()
+{
+	const DmaMemoryType Types[3] = { DmaMemoryType::Cached, DmaMemoryType::WriteThrough, DmaMemoryType::Uncached };
+
+	for( int i = 0; i < 3; i++ ) {
+		if( BenchRegions[i].Initialize( BenchMemory[i], DMA_MMU_SECTION_SIZE, Types[i] ) == XST_FAILURE ) {
+			cerr << "DmaRegion::Initialize failed! terminating" << endl;
+			return XST_FAILURE;
+		}
+		BenchBuffers[i] = (DmaWord *)BenchRegions[i].Allocate( DMA_MMU_SECTION_SIZE );
+	}
+	return XST_SUCCESS;
+} // InitializeDmaBenchmark
+#endif
+
 // Initialize AXI DMA
 static int DMAInitialize()
 {
@@ -319,48 +1296,1186 @@ static int DMAInitialize()
 	XAxiDma_IntrDisable(&AxiDmaInstance, XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DEVICE_TO_DMA);
 	XAxiDma_IntrDisable(&AxiDmaInstance, XAXIDMA_IRQ_ALL_MASK, XAXIDMA_DMA_TO_DEVICE);
 
+	// Allocate the DMA buffers
+	if( DmaBuffers.Initialize( DmaBuffersMemory, sizeof(DmaBuffersMemory), DMA_MEMORY_TYPE ) == XST_FAILURE ) {
+		cerr << "DmaRegion::Initialize failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+#if CHUNK_SAMPLE_COUNT == 0
+	if( CapturePool.Initialize( DmaBuffers, MAX_SAMPLE_COUNT * sizeof(DmaWord), CAPTURE_BUFFERS ) == XST_FAILURE ) {
+		cerr << "DmaBufferPool::Initialize failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+#else
+	if( ChunkPool.Initialize( DmaBuffers, CHUNK_SAMPLE_COUNT * sizeof(DmaWord), CHUNK_BUFFERS ) == XST_FAILURE ) {
+		cerr << "DmaBufferPool::Initialize failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+	DiscardBuffer = (DmaWord *)DmaBuffers.Allocate( CHUNK_SAMPLE_COUNT * sizeof(DmaWord) );
+#endif
+#if DMA_BENCHMARK
+	if( InitializeDmaBenchmark() == XST_FAILURE )
+		return XST_FAILURE;
+#endif
+
+#if CHUNK_SAMPLE_COUNT > 0 || DMA_INTERRUPT
+	// The S2MM interrupt tells us that a chunk (the capture) was completed
+	if( xPortInstallInterruptHandler( DMA_RX_INTR_ID, DmaRxIntrHandler, &AxiDmaInstance ) != pdPASS ) {
+		cerr << "xPortInstallInterruptHandler failed! terminating" << endl;
+		return XST_FAILURE;
+	}
+	vPortEnableInterrupt( DMA_RX_INTR_ID );
+	XAxiDma_IntrEnable(&AxiDmaInstance, XAXIDMA_IRQ_IOC_MASK | XAXIDMA_IRQ_ERROR_MASK, XAXIDMA_DEVICE_TO_DMA);
+#endif
+
 	return 0;
 } // DMAInitialize
 
-// Perform a DMA transfer of digitized samples from XADC into RAM
-static int ReceiveData()
+// Initiate the DMA transfer of Size bytes into Buffer and start the AXI-Stream of data coming from XADC
+static int StartDmaTransfer(DmaWord *Buffer, u32 Size)
 {
-	Xil_DCacheFlushRange( (UINTPTR)DataBuffer, sizeof(DataBuffer) );  // Just in case, flush any data in DataBuffer, held in CPU cache, to RAM
-
-	// Initiate the DMA transfer
 	XStatus Status;
-	Status = XAxiDma_SimpleTransfer( &AxiDmaInstance, (UINTPTR)DataBuffer, SAMPLE_COUNT * sizeof(u16), XAXIDMA_DEVICE_TO_DMA );
+	LATENCY_PROBE_START( Probe );
+	Status = XAxiDma_SimpleTransfer( &AxiDmaInstance, (UINTPTR)Buffer, Size, XAXIDMA_DEVICE_TO_DMA );
 	if(Status != XST_SUCCESS) {
 		cerr << "XAxiDma_SimpleTransfer failed! terminating" << endl;
 		return XST_FAILURE;
 	}
+	LATENCY_PROBE_LAP( DmaArm, Probe );
 
 	XGpioPs_WritePin( &GpioInstance, 54, 1 /*high*/ ); // Set start signal to start generation of the AXI-Stream of data coming from XADC
 	XGpioPs_WritePin( &GpioInstance, 54, 0 /*low*/  ); // Reset the start signal (it needed to be high for just a single PL clock cycle)
+	DmaStartTime = TimestampNow();
+	LATENCY_PROBE_RECORD( StartPulse, DmaStartTime - Probe );
+	TRACE_EVENT( DmaStart, TraceSize( Size ) );
+
+	return XST_SUCCESS;
+} // StartDmaTransfer
 
+#if DMA_BENCHMARK
+// Wait till the DMA transfer is done. Returns the number of bytes the DMA actually wrote.
+static u32 WaitDmaTransfer()
+{
 	while( XAxiDma_Busy(&AxiDmaInstance, XAXIDMA_DEVICE_TO_DMA) ) // Wait till DMA transfer is done
 		vTaskDelay( pdMS_TO_TICKS( 1 ) ); // Wait 1 ms
 
-	/* Invalidate the CPU cache for the memory region holding the DataBuffer.
-	 * DMA transfer wasn't using the CPU cache, it wrote directly to RAM.
-	 * We need the CPU to get data from the RAM, not cache, when processing data in the DataBuffer.
+	// After the transfer, the buffer length register holds the number of bytes written
+	return XAxiDma_ReadReg( AxiDmaInstance.RxBdRing[0].ChanBase, XAXIDMA_BUFFLEN_OFFSET );
+} // WaitDmaTransfer
+#endif
+
+// Activate the XADC mode selected by the macro XADC_MODE with averaging and ADCCLK divider ratio from ActiveConfig
+static int ActivateXADCMode()
+{
+	XSysMon_SetAvg(&XADCInstance, ActiveConfig.AveragingMode);
+
+#if XADC_MODE == XADC_MODE_SEQUENCER
+	// Start scanning the channels by the sequencer
+	return ActivateSequencer( XSM_SEQ_MODE_CONTINPASS, SEQUENCER_CHANNELS );
+#elif XADC_MODE == XADC_MODE_SIMULTANEOUS
+	// Start the simultaneous sampling of the channel pairs
+	return ActivateSequencer( XSM_SEQ_MODE_SIMUL, SIMULTANEOUS_AUX_PAIRS );
+#else
+	// Activate the input selected by ActiveXADCInput
+	return ActivateXADCInput();
+#endif
+} // ActivateXADCMode
+
+/* Apply the settings from Config before a capture.
+ * The XADC is re-activated only when averaging or ADCCLK divider ratio has changed. */
+static int ApplyCaptureConfig()
+{
+	bool XADCChanged = Config.AveragingMode != ActiveConfig.AveragingMode || Config.AdcClkDivisor != ActiveConfig.AdcClkDivisor;
+	ActiveConfig = Config;
+
+	if( XADCChanged ) {
+		if( ActivateXADCMode() == XST_FAILURE )
+			return XST_FAILURE;
+		vTaskDelay( pdMS_TO_TICKS( 1 ) ); // Give the XADC time to provide samples with the new settings
+	}
+
+	// Set sample count to pins 55-80 of the stream_tlaster module and keep start/stop signal (pin 54) at 0
+	XGpioPs_Write( &GpioInstance, 2 /*Bank 2*/, ActiveConfig.SampleCount << 1 );
+
+	return XST_SUCCESS;
+} // ApplyCaptureConfig
+
+// Print the capture settings to the console
+static void PrintCaptureConfig(const CaptureConfig &Cfg)
+{
+	const std::string AveragingModeDescr[] = { "no", "16 samples", "64 samples", "256 samples" };
+
+	cout << "will connect to the network address " << Cfg.ServerAddr << ':' << Cfg.ServerPort << endl;
+	cout << "samples per capture: " << Cfg.SampleCount << endl;
+	cout << AveragingModeDescr[Cfg.AveragingMode] << " averaging is used" << endl;
+	cout << "ADCCLK divider ratio: " << unsigned(Cfg.AdcClkDivisor) << endl;
+} // PrintCaptureConfig
+
+#if DMA_BENCHMARK
+static volatile u32 BenchSink; // Keeps the compiler from optimizing out the reading of the samples
+
+// Time in microseconds between two readings of the global timer
+static float ElapsedUs(XTime Start, XTime End)
+{
+	return float(End - Start) * 1e6f / float(COUNTS_PER_SECOND);
+} // ElapsedUs
+
+/* Compare per-capture overhead of the DMA buffers in the three memory types of DmaRegion and of the cache maintenance
+ * used by the application before (flush of the buffer before the transfer and invalidation after it, with cache lines
+ * shared with neighbor data). Each variant performs BENCH_CAPTURES captures of ActiveConfig.SampleCount samples.
+ * The time of the cache maintenance before and after the transfer and the time the CPU needs to read all the samples
+ * is measured (the transfer itself takes the same time in all the variants). "before" is the whole maintenance
+ * the application does to arm a capture buffer (DmaBuffer::BeforeDeviceWrite() of the capture length); the pool
+ * adds none when the buffer is released. */
+static void RunDmaBenchmark()
+{
+	const int BENCH_CAPTURES = 16;
+	const u32 CaptureSize = ActiveConfig.SampleCount * sizeof(DmaWord);
+
+	if( CaptureSize > DMA_MMU_SECTION_SIZE ) {
+		cerr << "bench: count must be at most " << DMA_MMU_SECTION_SIZE / sizeof(DmaWord) << endl;
+		return;
+	}
+
+	struct BenchVariant {
+		const char *Name;
+		int         Region;          // Index into BenchRegions (value of DmaMemoryType)
+		bool        FlushInvalidate; // The former cache maintenance instead of DmaRegion
+	};
+	const BenchVariant Variants[] = { { "flush+invalidate", int(DmaMemoryType::Cached),       true  },
+	                                  { "cached",           int(DmaMemoryType::Cached),       false },
+	                                  { "write-through",    int(DmaMemoryType::WriteThrough), false },
+	                                  { "uncached",         int(DmaMemoryType::Uncached),     false } };
+
+	cout << "DMA buffer benchmark: " << ActiveConfig.SampleCount << " samples, average of " << BENCH_CAPTURES << " captures [us]" << endl;
+	cout << "memory type       before  after    read    total" << endl;
+	cout << std::fixed << std::setprecision(1);
+
+	for( const BenchVariant &v : Variants ) {
+		DmaRegion &Region = BenchRegions[ v.Region ];
+		/* The former DataBuffer was aligned on 4 bytes only. We start the buffer in the middle of a cache line
+		 * for the former cache maintenance to get the same cost of the partial cache lines. */
+		DmaWord *Buffer = v.FlushInvalidate ? BenchBuffers[ v.Region ] + 4 / sizeof(DmaWord) : BenchBuffers[ v.Region ];
+		u32 Size = v.FlushInvalidate ? CaptureSize + 8 * sizeof(DmaWord) : CaptureSize; // The former buffer had 8 extra samples
+		if( (u8 *)Buffer + Size > BenchMemory[ v.Region ] + DMA_MMU_SECTION_SIZE )
+			Size = BenchMemory[ v.Region ] + DMA_MMU_SECTION_SIZE - (u8 *)Buffer;
+		float BeforeUs = 0, AfterUs = 0, ReadUs = 0;
+
+		for( int c = 0; c < BENCH_CAPTURES; c++ ) {
+			XTime t0, t1, t2, t3, t4;
+
+			XTime_GetTime( &t0 );
+			if( v.FlushInvalidate )
+				Xil_DCacheFlushRange( (UINTPTR)Buffer, Size );
+			else
+				Region.BeforeDeviceWrite( Buffer, CaptureSize );
+			XTime_GetTime( &t1 );
+
+			if( StartDmaTransfer( Buffer, CaptureSize ) == XST_FAILURE )
+				return;
+			u32 BytesWritten = WaitDmaTransfer();
+
+			XTime_GetTime( &t2 );
+			if( v.FlushInvalidate )
+				Xil_DCacheInvalidateRange( (UINTPTR)Buffer, Size );
+			else
+				Region.AfterDeviceWrite( Buffer, BytesWritten );
+			XTime_GetTime( &t3 );
+
+			u32 Sum = 0;
+			for( u32 i = 0; i < BytesWritten / sizeof(DmaWord); i++ )
+				Sum += DmaWordSample( Buffer[i] );
+			BenchSink = Sum;
+			XTime_GetTime( &t4 );
+
+			BeforeUs += ElapsedUs( t0, t1 );
+			AfterUs  += ElapsedUs( t2, t3 );
+			ReadUs   += ElapsedUs( t3, t4 );
+		}
+
+		BeforeUs /= BENCH_CAPTURES;
+		AfterUs  /= BENCH_CAPTURES;
+		ReadUs   /= BENCH_CAPTURES;
+		cout << std::left << std::setw(16) << v.Name << std::right
+		     << std::setw(8) << BeforeUs << std::setw(8) << AfterUs << std::setw(8) << ReadUs
+		     << std::setw(9) << BeforeUs + AfterUs + ReadUs << endl;
+	}
+} // RunDmaBenchmark
+#endif // DMA_BENCHMARK
+
+// Check the number of samples of a capture. Returns the error message, or nullptr when the count is valid.
+static const char *CheckSampleCount(u32 Count)
+{
+	static const std::string RangeError = "count must be from 1 to " + std::to_string( CAPTURE_MAX_SAMPLE_COUNT );
+
+	if( Count == 0 || Count > CAPTURE_MAX_SAMPLE_COUNT )
+		return RangeError.c_str();
+#if XADC_MODE == XADC_MODE_SIMULTANEOUS
+	if( Count % 2 != 0 )
+		return "count must be even in the simultaneous mode";
+#endif
+	return nullptr;
+} // CheckSampleCount
+
+// Get the XADC averaging mode (XSM_AVG_*_SAMPLES) for the number of samples averaged. Returns false for an invalid number.
+static bool AveragingModeFromSamples(unsigned Samples, u8 &AveragingMode)
+{
+	switch( Samples ) {
+		case 0:   AveragingMode = XSM_AVG_0_SAMPLES;   return true;
+		case 16:  AveragingMode = XSM_AVG_16_SAMPLES;  return true;
+		case 64:  AveragingMode = XSM_AVG_64_SAMPLES;  return true;
+		case 256: AveragingMode = XSM_AVG_256_SAMPLES; return true;
+	}
+	return false;
+} // AveragingModeFromSamples
+
+/* Send the event trace to the server (see EventTrace.h), i.e., to the address where the next capture is sent.
+ * The tool trace2json (sources/host_tools) converts the received file for a trace viewer. */
+static void SendTrace()
+{
+#if EVENT_TRACE
+	try {
+		FileViaSocket f( Config.ServerAddr, Config.ServerPort ); // Declare the object and open the network connection
+		u32 Count = TraceDump( f );
+		cout << Count << " trace events " << ( f ? "sent" : "failed to send!" ) << endl;
+	} // Object f ceases to exist, destructor on f is called, the connection is closed
+	catch( const std::exception& e ) {
+		cerr << "Error on opening the socket:\n" << e.what() << endl;
+	}
+#else
+	cout << "event trace is disabled (set EVENT_TRACE to 1 in EventTrace.h)" << endl;
+#endif
+} // SendTrace
+
+/* Run the TCP throughput test (see ThroughputTest.h) against the sink running on the server's machine,
+ * which listens on the port THROUGHPUT_TEST_DEFAULT_PORT (e.g., tput sink from sources/host_tools). */
+static void RunThroughputTestCommand(unsigned Seconds, u32 WriteSize)
+{
+	cout << "streaming to " << Config.ServerAddr << ':' << THROUGHPUT_TEST_DEFAULT_PORT << " for " << Seconds << " s in writes of "
+	     << WriteSize << " bytes..." << endl;
+	try {
+		ThroughputResult Result;
+		RunThroughputTest( Config.ServerAddr, THROUGHPUT_TEST_DEFAULT_PORT, Seconds, WriteSize, Result );
+		PrintThroughputResult( cout, Result );
+	}
+	catch( const std::exception& e ) {
+		cerr << "Error on opening the socket:\n" << e.what() << endl;
+	}
+} // RunThroughputTestCommand
+
+/* Process a command typed in the serial terminal. The commands change Config,
+ * which is applied at the start of the next capture:
+ *   count <n>             number of samples of a capture (1 to CAPTURE_MAX_SAMPLE_COUNT)
+ *   avg <0|16|64|256>     number of samples the XADC averages
+ *   div <n>               ADCCLK divider ratio (2 to 255)
+ *   server <ip> [<port>]  address of the server
+ *   config                print the settings
+ *   pool                  print the usage of the pool of the DMA buffers
+ *   overload              print the counters of the data not sent because the network was behind (see OVERLOAD_POLICY)
+ *   spool                 print the occupancy of the spool and the replay throughput (see CAPTURE_SPOOL_SIZE)
+ *   lat [reset]           print (or discard) the latency of the stages of the captures (see LatencyProbes.h)
+ *   trace [clear]         send the event trace to the server (or discard it) (see EventTrace.h)
+ *   tput [<s> [<size>]]   stream a synthetic payload to the throughput sink for s seconds in writes of size bytes
+ *   boot                  print the time of the phases of the startup (see BootPhases.h)
+ *   bench                 run the DMA buffer benchmark (when DMA_BENCHMARK is 1)
+ * The diagnostics trace, tput and bench run in XADC_thread, i.e., the buttons and the remote commands wait till they end. */
+static void ProcessConsoleCommand(const std::string &Line)
+{
+	std::istringstream Args( Line );
+	std::string Command;
+	Args >> Command;
+
+	if( Command == "count" ) {
+		u32 Count = 0;
+		const char *Error = (Args >> Count) ? CheckSampleCount( Count ) : CheckSampleCount( 0 );
+		if( Error )
+			cerr << Error << endl;
+		else
+			Config.SampleCount = Count;
+	}
+	else if( Command == "avg" ) {
+		unsigned Samples;
+		if( !(Args >> Samples) || !AveragingModeFromSamples( Samples, Config.AveragingMode ) )
+			cerr << "avg must be 0, 16, 64 or 256" << endl;
+	}
+	else if( Command == "div" ) {
+		unsigned Divisor;
+		if( !(Args >> Divisor) || Divisor < 2 || Divisor > 255 ) // The XADC doesn't support the divider ratio lower than 2
+			cerr << "div must be from 2 to 255" << endl;
+		else
+			Config.AdcClkDivisor = u8(Divisor);
+	}
+	else if( Command == "server" ) {
+		std::string Addr;
+		unsigned Port = Config.ServerPort;
+		if( !(Args >> Addr) || ( !Args.eof() && !(Args >> Port) ) || Port == 0 || Port > 0xFFFF )
+			cerr << "usage: server <ip> [<port>]" << endl;
+		else {
+			Config.ServerAddr = Addr;
+			Config.ServerPort = (unsigned short)Port;
+		}
+	}
+	else if( Command == "pool" ) {
+#if CHUNK_SAMPLE_COUNT == 0
+		DmaBufferPool::Statistics Stats = CapturePool.GetStatistics();
+#else
+		DmaBufferPool::Statistics Stats = ChunkPool.GetStatistics();
+#endif
+		cout << "DMA buffers: " << Stats.BlockCount << " x " << Stats.BlockSize << " bytes, in use: " << Stats.InUse
+		     << ", high water: " << Stats.HighWater << ", allocations: " << Stats.Allocations
+		     << ", failed (all in use): " << Stats.Exhaustions << endl;
+		return;
+	}
+	else if( Command == "overload" ) {
+		static const char *PolicyNames[] = { "block", "drop oldest", "drop newest", "summary" }; // Indexed by OVERLOAD_POLICY
+		cout << "overload policy: " << PolicyNames[ OVERLOAD_POLICY ] << ", dropped captures: " << Overload.DroppedCaptures
+		     << ", summary-only captures: " << Overload.SummaryCaptures << ", samples not sent: " << Overload.DroppedSamples
+		     << ", waits for a buffer: " << Overload.Stalls << endl;
+		return;
+	}
+#if SPOOL_ENABLED
+	else if( Command == "spool" ) {
+		const CaptureSpool::Statistics Stats = Spool.GetStatistics();
+		cout << "spool: " << Stats.Records << " capture(s) in " << Stats.Used << " of " << Stats.Capacity << " bytes, high water: "
+		     << Stats.HighWater << " bytes, spooled: " << Stats.Stored << ", recovered after the reset: " << Stats.Recovered
+		     << ", overwritten (spool full): " << Stats.Overwritten << ", too large: " << Stats.Rejected << endl
+		     << "replayed: " << Stats.Replayed << " capture(s), " << Stats.ReplayedBytes << " bytes in "
+		     << std::fixed << std::setprecision(1) << TimestampToNs( Stats.ReplayTime ) / 1e6 << " ms ("
+		     << ( Stats.ReplayTime ? Stats.ReplayedBytes / ( TimestampToNs( Stats.ReplayTime ) / 1e9 ) / 1e6 : 0.0 )
+		     << " MB/s), failed attempts (server unreachable): " << ReplayFailures << endl;
+		return;
+	}
+#endif
+	else if( Command == "lat" ) {
+		std::string Arg;
+		if( Args >> Arg && Arg == "reset" )
+			LatencyReset();
+		else
+			LatencyDump( cout );
+		return;
+	}
+	else if( Command == "trace" ) {
+		std::string Arg;
+		if( Args >> Arg && Arg == "clear" )
+			TraceClear();
+		else
+			SendTrace();
+		return;
+	}
+	else if( Command == "boot" ) {
+		BootPhasesPrint( cout );
+		return;
+	}
+	else if( Command == "tput" ) {
+		unsigned Seconds   = THROUGHPUT_TEST_DEFAULT_SECONDS;
+		unsigned WriteSize = THROUGHPUT_TEST_DEFAULT_WRITE_SIZE;
+		if( ( !Args.eof() && !(Args >> Seconds) ) || ( !Args.eof() && !(Args >> WriteSize) ) ||
+		    Seconds == 0 || Seconds > THROUGHPUT_TEST_MAX_SECONDS || WriteSize == 0 || WriteSize > THROUGHPUT_TEST_MAX_WRITE_SIZE )
+			cerr << "usage: tput [<seconds> [<write size>]] (1 to " << THROUGHPUT_TEST_MAX_SECONDS << " s, 1 to "
+			     << THROUGHPUT_TEST_MAX_WRITE_SIZE << " bytes)" << endl;
+		else
+			RunThroughputTestCommand( Seconds, WriteSize );
+		return;
+	}
+#if DMA_BENCHMARK
+	else if( Command == "bench" ) {
+		if( State != ControlState::Idle ) { // The benchmark needs the DMA
+			cerr << "bench: a capture is in progress, try again" << endl;
+			return;
+		}
+		// The benchmark uses the sample count from Config
+		if( ApplyCaptureConfig() == XST_FAILURE )
+			return;
+		RunDmaBenchmark();
+		return;
+	}
+#endif
+	else if( Command != "config" ) {
+		cerr << "unknown command '" << Command << "' (use count, avg, div, server, config, pool, overload, spool, lat, trace, tput or boot)" << endl;
+		return;
+	}
+
+	PrintCaptureConfig( Config );
+} // ProcessConsoleCommand
+
+/* Read characters received from the serial terminal and process complete command lines.
+ * The function doesn't block; it reads only the characters the UART has already received. */
+static void ProcessConsole()
+{
+	static std::string Line;
+
+	while( XUartPs_IsReceiveData( STDIN_BASEADDRESS ) ) {
+		char c = char( XUartPs_ReadReg( STDIN_BASEADDRESS, XUARTPS_FIFO_OFFSET ) );
+
+		if( c == '\r' || c == '\n' ) {
+			if( !Line.empty() ) {
+				cout << endl;
+				ProcessConsoleCommand( Line );
+				Line.clear();
+			}
+		}
+		else if( c == '\b' || c == 0x7F ) { // Backspace or Delete
+			if( !Line.empty() ) {
+				Line.pop_back();
+				cout << "\b \b" << std::flush;
+			}
+		}
+		else {
+			Line += c;
+			cout << c << std::flush; // Echo the character; serial terminals usually don't do it
+		}
+	}
+} // ProcessConsole
+
+#if CHUNK_SAMPLE_COUNT == 0
+#define CAPTURE_JOBS CAPTURE_BUFFERS // A capture holds its job till it was sent, like it holds its buffer
+#else
+#define CAPTURE_JOBS 1               // In the large-capture mode, sender_thread performs the capture while sending it
+#endif
+static_assert( CAPTURE_JOBS + 4 <= CONTROL_EVENTS, "ControlEvents must have room for the events of all the sources" );
+
+static CaptureJob    Jobs[ CAPTURE_JOBS ];
+static bool          JobInUse[ CAPTURE_JOBS ]; // Set by XADC_thread when it starts the capture, cleared on CaptureSent
+static QueueHandle_t SendJobs;                 // Indexes of Jobs passed from XADC_thread to sender_thread
+
+#if CHUNK_SAMPLE_COUNT > 0
+/* Perform the capture of the Job in the large-capture mode.
+ * The DMA transfers the capture in chunks (DmaRxIntrHandler() sets up the transfer of each chunk), and each completed
+ * chunk is converted and written to the network stream f while the DMA fills the next chunks. */
+static int ReceiveAndSendChunks(FileViaSocket &f, CaptureJob &Job)
+{
+	const u32 ChunkCount = ( Job.Config.SampleCount + CHUNK_SAMPLE_COUNT - 1 ) / CHUNK_SAMPLE_COUNT;
+	u32 ChunksReceived  = 0;
+	u32 GapWritten      = 0; // Number of the dropped samples already marked by the gap lines
+#if XADC_MODE == XADC_MODE_SIMULTANEOUS
+	u32 Unpaired = 0;
+#endif
+
+	// All the chunk buffers are free at the start of the capture
+	DmaBuffer First = ChunkPool.Allocate();
+	if( !First ) {
+		cerr << "no free chunk buffer! terminating" << endl;
+		return XST_FAILURE;
+	}
+	ChunkReader = xTaskGetCurrentTaskHandle();
+	FilledChunks.Clear();
+	ChunksToArm      = ChunkCount - 1;
+	ChunksToComplete = ChunkCount;
+	LastChunkCount   = Job.Config.SampleCount - ( ChunkCount - 1 ) * CHUNK_SAMPLE_COUNT;
+	DroppedChunks    = 0;
+	DroppedSamples   = 0;
+	LostSamples      = 0;
+	DmaError         = false;
+
+	/* Initiate the DMA transfer of the first chunk.
+	 * ChunkInFlight must be set before the start: a short chunk may complete (and DmaRxIntrHandler() read
+	 * ChunkInFlight) before StartDmaTransfer() returns. */
+	DmaWord *FirstData = First.As<DmaWord>();
+	ChunkInFlight = s16( First.Detach() ); // The reference is held by the DMA till the chunk is completed
+	if( StartDmaTransfer( FirstData, CHUNK_SAMPLE_COUNT * sizeof(DmaWord) ) == XST_FAILURE ) {
+		ChunkPool.Adopt( u16(ChunkInFlight) ); // The DMA didn't start; the temporary handle releases the block
+		ChunkInFlight = -1;
+		return XST_FAILURE;
+	}
+	Job.DmaStart = DmaStartTime;
+#if CAPTURE_HEADER
+	WriteCaptureInfo( f, Job );
+#endif
+
+	LATENCY_PROBE_START( Probe );
+	while( ChunksReceived + DroppedChunks < ChunkCount ) {
+		if( DmaError ) {
+			cerr << "DMA error during the capture! terminating" << endl;
+			return XST_FAILURE;
+		}
+
+		FilledChunk Chunk;
+		if( !FilledChunks.Pop( Chunk ) ) {
+			TickType_t Wait = pdMS_TO_TICKS( 10 );
+#if SEND_FLUSH_DEADLINE_US > 0
+			/* In the latency mode, the end of the previous chunk waiting in the sink is sent when its deadline expires
+			 * before the next chunk comes. The wait is at least a tick, so the deadline is kept within a tick of FreeRTOS. */
+			const u32 Due = f.sink().timeToDeadline();
+			if( Due != UINT32_MAX ) {
+				const TickType_t DueTicks = pdMS_TO_TICKS( ( Due + 999 ) / 1000 );
+				if( DueTicks < Wait )
+					Wait = DueTicks > 0 ? DueTicks : 1;
+				if( Due == 0 )
+					Wait = 0;
+			}
+#endif
+			// A chunk pushed after the Pop() left the notification pending, so the take returns right away
+			TRACE_EVENT( QueueWaitBegin, u16(TraceQueue::FilledChunks) );
+			if( ulTaskNotifyTake( pdTRUE, Wait ) == 0 )
+				TRACE_EVENT( QueueWaitEnd, u16(TraceQueue::FilledChunks) | TRACE_QUEUE_TIMEOUT );
+			else
+				TRACE_EVENT( QueueWaitEnd, u16(TraceQueue::FilledChunks) );
+#if SEND_FLUSH_DEADLINE_US > 0
+			f.sink().flushDue();
+#endif
+			continue; // Pop again, and check the number of chunks dropped meanwhile
+		}
+
+		LATENCY_PROBE_LAP( DmaCompletion, Probe ); // Time waiting for the chunk
+		Job.DmaDone = Chunk.Done;
+
+		/* The chunks dropped before this one are marked at their position. The samples lost in this chunk are marked
+		 * before its values too (they are missing somewhere in the chunk, after the samples the FIFO held). */
+		if( Chunk.DroppedBefore != GapWritten ) {
+			WriteCaptureGap( f, Chunk.DroppedBefore - GapWritten );
+			GapWritten = Chunk.DroppedBefore;
+		}
+
+		// Take over the reference held by the DMA; the buffer returns to ChunkPool when Buffer is destroyed
+		DmaBuffer Buffer = ChunkPool.Adopt( Chunk.Block );
+		const DmaWord *Data = Buffer.As<DmaWord>();
+		// The DMA wrote directly to RAM, we need the CPU to get data from the RAM, not cache
+		DmaBuffers.AfterDeviceWrite( Data, Chunk.Count * sizeof(DmaWord) );
+		LATENCY_PROBE_LAP( CacheInvalidate, Probe );
+
+		DemultiplexSamples( Data, Chunk.Count );
+		LATENCY_PROBE_LAP( Conversion, Probe );
+		WriteSamples( f.sink(), Job, Data, Chunk.Count );
+		LATENCY_PROBE_LAP( Formatting, Probe );
+		if( ChunksReceived == 0 )
+			PrintSamples( Job, Data, Chunk.Count ); // Print data sample from the first chunk to the console
+		LATENCY_PROBE_RESTART( Probe ); // The wait for the next chunk is measured from here
+#if XADC_MODE == XADC_MODE_SIMULTANEOUS
+		Unpaired += UnpairedSamples;
+#endif
+		ChunksReceived++;
+
+		/* DmaRxIntrHandler() gives the chunk buffers to the DMA right away, so they are prepared for the next transfer
+		 * here, before they return to ChunkPool. Only the range the DMA wrote (and DemultiplexSamples() rewrote) can
+		 * hold dirty cache lines; the rest of the buffer was prepared before. */
+		Buffer.BeforeDeviceWrite( Chunk.Count * sizeof(DmaWord) );
+	} // Buffer ceases to exist, the chunk buffer returns to ChunkPool
+
+	if( DroppedSamples != GapWritten ) // The chunks dropped at the end of the capture
+		WriteCaptureGap( f, DroppedSamples - GapWritten );
+	Job.GapSamples = DroppedSamples;
+	if( DroppedChunks > 0 )
+		cout << DroppedChunks << " chunk(s) with " << DroppedSamples - LostSamples << " samples dropped (data were sent slower than captured)" << endl
+		     << "type pool to see the usage of the chunk buffers" << endl;
+	if( LostSamples > 0 )
+		cout << LostSamples << " sample(s) lost in the FIFO of stream_tlaster (the DMA wasn't set up for the next chunk in time)" << endl;
+#if XADC_MODE == XADC_MODE_SIMULTANEOUS
+	if( Unpaired > 0 )
+		cout << Unpaired << " unpaired sample(s) skipped" << endl;
+#endif
+
+	return XST_SUCCESS;
+} // ReceiveAndSendChunks
+#endif // CHUNK_SAMPLE_COUNT > 0
+
+/* Convert the samples of the capture of the Job and send them to the server (in the large-capture mode, the capture
+ * is performed here, because its chunks are sent while the DMA fills the next ones). Sets Job.Sent.
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int SendCapture(CaptureJob &Job)
+{
+	Job.Sent = false;
+#if CHUNK_SAMPLE_COUNT == 0
+	const DmaWord *Data = Job.Capture.As<DmaWord>();
+
+	/* DMA transfer wasn't using the CPU cache, it wrote directly to RAM.
+	 * We need the CPU to get data from the RAM, not cache, when processing the data.
+	 * Only the cache lines of the range the DMA actually wrote are invalidated (nothing is done for uncached memory).
 	 */
-	Xil_DCacheInvalidateRange( (UINTPTR)DataBuffer, sizeof(DataBuffer) );
+	LATENCY_PROBE_START( Probe );
+	DmaBuffers.AfterDeviceWrite( Data, Job.BytesWritten );
+	LATENCY_PROBE_LAP( CacheInvalidate, Probe );
+
+	DemultiplexSamples( Data, Job.Config.SampleCount );
+	LATENCY_PROBE_LAP( Conversion, Probe );
+	PrintSamples( Job, Data, Job.Config.SampleCount ); // Print data sample to the console
+#if XADC_MODE == XADC_MODE_SIMULTANEOUS
+	if( UnpairedSamples > 0 )
+		cout << UnpairedSamples << " unpaired sample(s) skipped" << endl;
+#endif
+#endif
 
-	return 0;
-} // ReceiveData
+#if SPOOL_ENABLED
+	ReplayServerAddr = Job.Config.ServerAddr;
+	ReplayServerPort = Job.Config.ServerPort;
+#endif
+
+	// Transfer data over the network
+	FileViaSocket f; // Declare the object; the network connection is opened below
+	if( OpenServerStream( f, Job.Config.ServerAddr, Job.Config.ServerPort ) ) {
+		f << std::setprecision(7); // Set decimal precision for the output (of the summary; the samples go to the sink)
+#if CHUNK_SAMPLE_COUNT == 0
+		cout << ( Job.SummaryOnly ? "sending summary (the network is behind)..." : "sending data..." ) << std::flush;
+		LATENCY_PROBE_START( Format );
+#if CAPTURE_HEADER
+		WriteCaptureInfo( f, Job );
+#endif
+		if( Job.SummaryOnly )
+			WriteSummary( f, Job, Data, Job.Config.SampleCount );
+		else
+			WriteSamples( f.sink(), Job, Data, Job.Config.SampleCount );
+		f.flush();
+		LATENCY_PROBE_LAP( Formatting, Format );
+		Job.Sent = bool(f);
+		cout << "   sent" << endl;
+#else
+		// In the large-capture mode, the data are sent during the capture
+		cout << "capturing and sending data in chunks of " << CHUNK_SAMPLE_COUNT << " samples" << endl;
+		if( ReceiveAndSendChunks( f, Job ) == XST_FAILURE )
+			return XST_FAILURE;
+		f.flush();
+		Job.Sent = bool(f);
+		cout << ( Job.Sent ? "capture sent" : "sending data failed!" ) << endl;
+#endif
+#if CAPTURE_TIMING
+		if( Job.Sent )
+			WriteTimingInfo( f, Job ); // It's sent by the close
+#endif
+		f.close();
+	}
+	else {
+#if SPOOL_ENABLED
+		SpoolCapture( Job, Data ); // The data are copied, so the buffer can be released
+#endif
+	}
+#if CHUNK_SAMPLE_COUNT == 0
+	Job.Capture.Release(); // The buffer returns to CapturePool, the next capture can use it
+#endif
+	if( Job.Sent ) {
+		LATENCY_PROBE_RECORD( Capture, TimestampNow() - Job.Started );
+		BootPhaseMark( BootPhase::FirstCapture );
+	}
+	TRACE_EVENT( CaptureEnd, Job.Sent ? 1 : 0 );
+
+	return XST_SUCCESS;
+} // SendCapture
+
+/* FreeRTOS thread sending the captures to the server. It takes the jobs passed by XADC_thread one by one and reports
+ * each of them back by the event CaptureSent. A send may take long (e.g., when the server is slow or doesn't run);
+ * XADC_thread meanwhile handles the buttons, the commands and the console, and starts the next capture.
+ * When no job is waiting, the captures in the spool are replayed one by one, the oldest first; while the server
+ * is unreachable, a replay is tried every SPOOL_RETRY_MS. A new capture is therefore never delayed by more than
+ * the replay of a single capture. */
+static void sender_thread(void *)
+{
+	TRACE_TASK_START( "sender" );
+
+#if SPOOL_ENABLED
+	TickType_t ReplayWait = 0; // How long to wait for a job before the next replay
+	Spool.Attach( SpoolMemory, sizeof(SpoolMemory) );
+	const CaptureSpool::Statistics Stats = Spool.GetStatistics();
+	if( Stats.Recovered > 0 )
+		cout << Stats.Recovered << " capture(s) spooled before the reset will be replayed" << endl;
+#endif
+
+	while(1) {
+		u32 Index;
+		TRACE_EVENT( QueueWaitBegin, u16(TraceQueue::SendJobs) );
+#if SPOOL_ENABLED
+		if( xQueueReceive( SendJobs, &Index, Spool.Empty() ? portMAX_DELAY : ReplayWait ) != pdTRUE ) {
+			TRACE_EVENT( QueueWaitEnd, u16(TraceQueue::SendJobs) | TRACE_QUEUE_TIMEOUT );
+			ReplayWait = ReplaySpooledCapture() ? 0 : pdMS_TO_TICKS( SPOOL_RETRY_MS );
+			continue;
+		}
+#else
+		xQueueReceive( SendJobs, &Index, portMAX_DELAY );
+#endif
+		TRACE_EVENT( QueueWaitEnd, u16(TraceQueue::SendJobs) );
+
+		Jobs[ Index ].Status = SendCapture( Jobs[ Index ] );
+#if SPOOL_ENABLED
+		ReplayWait = Jobs[ Index ].Sent ? 0 : pdMS_TO_TICKS( SPOOL_RETRY_MS ); // The server is reachable again, or still not
+#endif
+		PostControlEvent( ControlEventType::CaptureSent, Index );
+	}
+} // sender_thread
+
+static u32 CapturingJob; // Index of the job of the capture in progress
+
+/* A trigger, which came when no capture could start. The capture starts as soon as the DMA and a job are free.
+ * There's a single pending trigger; another one is refused (a press of BTN0 is ignored, a command gets Busy). */
+static bool          TriggerPending;
+static TriggerSource PendingSource;
+static Timestamp     PendingTriggered;
+static bool          PendingReply;
+
+#if COMMAND_SERVER_PORT != 0
+static bool ContinuousMode; // Captures are performed one after another
+#endif
+
+// Get the index of a free job, or -1 when all the jobs are in use (their captures are being sent)
+static int FreeJob()
+{
+	for( int i = 0; i < CAPTURE_JOBS; i++ )
+		if( !JobInUse[i] )
+			return i;
+	return -1;
+} // FreeJob
+
+// Pass the job Index to sender_thread. The header of the capture gets the overload counters as they are now.
+static void PassToSender(u32 Index)
+{
+	Jobs[ Index ].DroppedCaptures = Overload.DroppedCaptures;
+	Jobs[ Index ].DroppedSamples  = Overload.DroppedSamples;
+	xQueueSend( SendJobs, &Index, 0 ); // The queue has room for all the jobs
+} // PassToSender
+
+#if CHUNK_SAMPLE_COUNT == 0
+// Tell whether a capture is waiting to start: the pending trigger, or the next capture of the continuous mode
+static bool CaptureWaiting()
+{
+#if COMMAND_SERVER_PORT != 0
+	return TriggerPending || ContinuousMode;
+#else
+	return TriggerPending;
+#endif
+} // CaptureWaiting
+
+// Drop the capture of the job Index as a whole; its buffer and its job are free for the next capture
+static void DropCapture(u32 Index)
+{
+	CaptureJob &Job = Jobs[ Index ];
+	TRACE_EVENT( CaptureDrop, u16(Job.Number) );
+	Overload.DroppedCaptures++;
+	Overload.DroppedSamples += Job.Config.SampleCount;
+	Job.Capture.Release();
+	JobInUse[ Index ] = false;
+} // DropCapture
+
+/* The capture of the continuous mode in the job Index is done, a capture is waiting, and all the other jobs are
+ * in use, i.e., the network is slower than the XADC. Apply OVERLOAD_POLICY to the capture. */
+static void HandleOverload(u32 Index)
+{
+#if OVERLOAD_POLICY == OVERLOAD_DROP_OLDEST
+	u32 Oldest;
+	if( xQueueReceive( SendJobs, &Oldest, 0 ) == pdTRUE ) { // sender_thread didn't take the capture yet
+		if( Jobs[ Oldest ].Source == TriggerSource::Continuous ) {
+			DropCapture( Oldest );
+			PassToSender( Index );
+			return;
+		}
+		xQueueSendToFront( SendJobs, &Oldest, 0 ); // A triggered capture is never dropped
+	}
+	DropCapture( Index ); // Nothing older waits for sender_thread
+#elif OVERLOAD_POLICY == OVERLOAD_DROP_NEWEST
+	DropCapture( Index );
+#elif OVERLOAD_POLICY == OVERLOAD_SUMMARY
+	Jobs[ Index ].SummaryOnly = true;
+	PassToSender( Index );
+	Overload.SummaryCaptures++;
+	Overload.DroppedSamples += Jobs[ Index ].Config.SampleCount; // Counted in the headers of the following captures
+	Overload.Stalls++;
+#else
+	PassToSender( Index );
+	Overload.Stalls++;
+#endif
+} // HandleOverload
+#endif // CHUNK_SAMPLE_COUNT == 0
+
+/* Start a capture with the settings from Config in the free job Index. The DMA transfer is started here and DmaDone()
+ * passes the capture to sender_thread; in the large-capture mode, the job goes to sender_thread right away.
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int StartCapture(u32 Index, TriggerSource Source, Timestamp Triggered, bool Reply)
+{
+	CaptureJob &Job = Jobs[ Index ];
+	Job.Started = TimestampNow();
+	TRACE_EVENT( CaptureBegin, u16(CaptureCount) );
+	if( ApplyCaptureConfig() == XST_FAILURE ) // Apply the settings changed by the console or remote commands
+		return XST_FAILURE;
+
+	JobInUse[ Index ] = true;
+	Job.Config    = ActiveConfig;
+	Job.Number    = ++CaptureCount;
+	Job.Source    = Source;
+	Job.Reply     = Reply;
+	Job.Triggered = Triggered;
+	Job.DmaStart  = 0;
+	Job.DmaDone   = 0;
+	Job.SummaryOnly = false;
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+	Job.RawToVoltage = Xadc_RawToVoltageFunc;
+	Job.Channel      = ActiveXADCInput == eXADCInput::VAUX1 ? "VAUX[1]" : "VP/VN";
+#endif
+	CapturingJob = Index;
+	State        = ControlState::Capturing;
+
+#if CHUNK_SAMPLE_COUNT == 0
+	Job.Capture = CapturePool.Allocate();
+	if( !Job.Capture ) {
+		cerr << "no free capture buffer! terminating" << endl;
+		return XST_FAILURE;
+	}
+	/* No cache line of the range the DMA writes may be written over the data from the DMA. Only this range is prepared,
+	 * not the whole buffer sized for MAX_SAMPLE_COUNT. */
+	Job.Capture.BeforeDeviceWrite( Job.Config.SampleCount * sizeof(DmaWord) );
+	if( StartDmaTransfer( Job.Capture.As<DmaWord>(), Job.Config.SampleCount * sizeof(DmaWord) ) == XST_FAILURE )
+		return XST_FAILURE;
+	Job.DmaStart = DmaStartTime;
+#else
+	Job.GapSamples = 0;
+	PassToSender( Index );
+#endif
+
+	return XST_SUCCESS;
+} // StartCapture
+
+/* Start a capture right away or, when the DMA or all the jobs are busy, as soon as possible.
+ * The caller checks that no other trigger is pending. Returns XST_FAILURE on an error, after which the application can't continue. */
+static int RequestCapture(TriggerSource Source, Timestamp Triggered, bool Reply)
+{
+	int Index = FreeJob();
+	if( State == ControlState::Idle && Index >= 0 )
+		return StartCapture( u32(Index), Source, Triggered, Reply );
+
+	TriggerPending   = true;
+	PendingSource    = Source;
+	PendingTriggered = Triggered;
+	PendingReply     = Reply;
+	return XST_SUCCESS;
+} // RequestCapture
+
+/* Start the capture of the pending trigger, or the next capture of the continuous mode, when the DMA and a job are free.
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int StartNextCapture()
+{
+	int Index = FreeJob();
+	if( State != ControlState::Idle || Index < 0 )
+		return XST_SUCCESS;
+
+	if( TriggerPending ) {
+		TriggerPending = false;
+		return StartCapture( u32(Index), PendingSource, PendingTriggered, PendingReply );
+	}
+#if COMMAND_SERVER_PORT != 0
+	if( ContinuousMode )
+		return StartCapture( u32(Index), TriggerSource::Continuous, 0, false );
+#endif
+	return XST_SUCCESS;
+} // StartNextCapture
+
+#if CHUNK_SAMPLE_COUNT == 0
+/* The DMA transfer of the capture in progress is done at the time Time; the DMA wrote BytesWritten bytes.
+ * The capture is passed to sender_thread (or handled by OVERLOAD_POLICY when the network is behind),
+ * and the next capture starts, when one is waiting.
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int DmaDone(u32 BytesWritten, Timestamp Time)
+{
+	if( State != ControlState::Capturing )
+		return XST_SUCCESS; // The end of a transfer of the DMA benchmark
+	if( BytesWritten == DMA_DONE_ERROR ) {
+		cerr << "DMA error during the capture! terminating" << endl;
+		return XST_FAILURE;
+	}
+
+	CaptureJob &Job = Jobs[ CapturingJob ];
+	TRACE_EVENT( DmaDone, TraceSize( BytesWritten ) );
+	LATENCY_PROBE_RECORD( DmaCompletion, Time - Job.DmaStart );
+	Job.BytesWritten = BytesWritten;
+	Job.DmaDone      = Time;
+	State = ControlState::Idle;
+	if( Job.Source == TriggerSource::Continuous && CaptureWaiting() && FreeJob() < 0 )
+		HandleOverload( CapturingJob );
+	else
+		PassToSender( CapturingJob );
+
+	return StartNextCapture();
+} // DmaDone
+#endif
+
+#if COMMAND_SERVER_PORT != 0
+// A request received by the command server, passed to XADC_thread
+struct RemoteCommand {
+	CommandRequest Request;
+	Timestamp      Received; // Time the request was received
+};
+static QueueHandle_t RemoteCommands; // Requests passed from command_server_thread to XADC_thread
+static QueueHandle_t RemoteReplies;  // Responses passed from XADC_thread back to command_server_thread
+
+// Command-to-DMA-start latency of the captures started by the commands [ns]
+static u32 LastLatencyNs, MinLatencyNs, MaxLatencyNs;
+static u32 LatencyCount;
+
+/* The CommandHandler of the firmware. The requests must be executed in XADC_thread (which owns the XADC, the DMA
+ * and Config), therefore the handler passes them through the queue, posts the event RemoteCommand and waits
+ * for the response. */
+class RemoteCommandHandler : public CommandHandler {
+public:
+	void Execute( const CommandRequest &Request, Timestamp Received, CommandResponse &Response ) override {
+		RemoteCommand Command{ Request, Received };
+		xQueueSend( RemoteCommands, &Command, portMAX_DELAY );
+		PostControlEvent( ControlEventType::RemoteCommand );
+		TRACE_EVENT( QueueWaitBegin, u16(TraceQueue::RemoteReplies) );
+		xQueueReceive( RemoteReplies, &Response, portMAX_DELAY );
+		TRACE_EVENT( QueueWaitEnd, u16(TraceQueue::RemoteReplies) );
+	}
+}; // RemoteCommandHandler
+
+// FreeRTOS thread of the command server; it's started by XADC_thread when the subsystems are initialized
+static void command_server_thread(void *)
+{
+	static RemoteCommandHandler Handler;
+	CommandServer Server;
+
+	TRACE_TASK_START( "cmd_server" );
+
+	int Error = Server.Open( COMMAND_SERVER_PORT );
+	if( Error != 0 ) {
+		cerr << "CommandServer::Open failed (errno " << Error << ")! terminating the command server" << endl;
+		TRACE_EVENT( TaskStop, 0 );
+		vTaskDelete(NULL);
+	}
+
+	Error = Server.Run( Handler );
+	cerr << "CommandServer::Run failed (errno " << Error << ")! terminating the command server" << endl;
+	TRACE_EVENT( TaskStop, 0 );
+	vTaskDelete(NULL);
+} // command_server_thread
+
+// Record the command-to-DMA-start latency of the capture started at DmaStart by the command received at the time Received
+static void RecordCommandLatency(Timestamp Received, Timestamp DmaStart)
+{
+	u64 Ns = TimestampToNs( DmaStart - Received );
+	u32 Latency = Ns > 0xFFFFFFFF ? 0xFFFFFFFF : u32(Ns);
+
+	LastLatencyNs = Latency;
+	if( LatencyCount == 0 || Latency < MinLatencyNs )
+		MinLatencyNs = Latency;
+	if( LatencyCount == 0 || Latency > MaxLatencyNs )
+		MaxLatencyNs = Latency;
+	LatencyCount++;
+
+	cout << "command-to-DMA-start latency: " << std::fixed << std::setprecision(1) << Latency / 1000.0f << " us" << endl;
+} // RecordCommandLatency
+
+// Fill in the status of the board to the Response
+static void FillStatus(CommandResponse &Response)
+{
+	Response.State = ContinuousMode ? BoardState::Continuous : BoardState::Idle;
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+	Response.Channel = ActiveXADCInput == eXADCInput::VAUX1 ? 0 : 1;
+#else
+	Response.Channel = COMMAND_CHANNEL_NONE;
+#endif
+	Response.AdcClkDivisor = Config.AdcClkDivisor;
+	Response.SampleCount   = Config.SampleCount;
+	const u16 AveragedSamples[] = { 0, 16, 64, 256 }; // Indexed by XSM_AVG_*_SAMPLES
+	Response.Averaging     = AveragedSamples[ Config.AveragingMode ];
+	Response.CaptureCount  = CaptureCount;
+	Response.DroppedCaptures = Overload.DroppedCaptures > 0xFFFF ? 0xFFFF : u16(Overload.DroppedCaptures);
+	Response.LastLatencyNs = LastLatencyNs;
+	Response.MinLatencyNs  = MinLatencyNs;
+	Response.MaxLatencyNs  = MaxLatencyNs;
+} // FillStatus
+
+// Send the response with the Result and the status of the board to command_server_thread
+static void SendRemoteReply(CommandResult Result)
+{
+	CommandResponse Response = {};
+	Response.Result = Result;
+	FillStatus( Response );
+	TRACE_EVENT( CommandEnd, u16(Response.Result) );
+	xQueueSend( RemoteReplies, &Response, portMAX_DELAY );
+} // SendRemoteReply
+
+/* Execute a request received by the command server and send the response back. The response to the trigger
+ * is sent when the capture was sent (see CaptureSent()).
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int ProcessRemoteCommand(const RemoteCommand &Command)
+{
+	CommandResult Result = CommandResult::Ok;
+	int Status = XST_SUCCESS;
+	const u32 Argument = Command.Request.Argument;
+	TRACE_EVENT( CommandBegin, u16(Command.Request.Command) );
+
+	switch( Command.Request.Command ) {
+		case CommandCode::Status:
+			break;
+		case CommandCode::Trigger:
+			if( ContinuousMode || TriggerPending ) {
+				Result = CommandResult::Busy;
+				break;
+			}
+			Status = RequestCapture( TriggerSource::Command, Command.Received, true );
+			if( Status == XST_SUCCESS )
+				return XST_SUCCESS; // The capture replies when it was sent
+			break;
+		case CommandCode::SelectChannel:
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+			if( Argument > 1 )
+				Result = CommandResult::BadArgument;
+			else if( ContinuousMode || State == ControlState::Capturing )
+				Result = CommandResult::Busy;
+			else {
+				ActiveXADCInput = Argument == 0 ? eXADCInput::VAUX1 : eXADCInput::VPVN;
+				Status = ActivateXADCInput();
+			}
+#else
+			Result = CommandResult::Unsupported; // The channels are given by the macros in the other modes
+#endif
+			break;
+		case CommandCode::SetSampleCount:
+			if( CheckSampleCount( Argument ) )
+				Result = CommandResult::BadArgument;
+			else
+				Config.SampleCount = Argument;
+			break;
+		case CommandCode::SetAveraging:
+			if( !AveragingModeFromSamples( Argument, Config.AveragingMode ) )
+				Result = CommandResult::BadArgument;
+			break;
+		case CommandCode::StartContinuous:
+			if( !ContinuousMode ) {
+				ContinuousMode = true;
+				cout << "continuous mode started" << endl;
+				if( !TriggerPending ) // The latency of the first capture is recorded
+					Status = RequestCapture( TriggerSource::Command, Command.Received, false );
+			}
+			break;
+		case CommandCode::StopContinuous:
+			if( ContinuousMode ) {
+				ContinuousMode = false; // The captures in progress are finished
+				cout << "continuous mode stopped" << endl;
+			}
+			break;
+		default:
+			Result = CommandResult::BadCommand;
+	}
+
+	if( Status == XST_FAILURE )
+		Result = CommandResult::Failed;
+	SendRemoteReply( Result );
+	return Status;
+} // ProcessRemoteCommand
+#endif // COMMAND_SERVER_PORT != 0
+
+/* sender_thread is done with the job Index. The latency of the trigger of the capture is recorded, the command waiting
+ * for the capture gets the response, and the next capture starts, when one is waiting.
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int CaptureSent(u32 Index)
+{
+	CaptureJob &Job = Jobs[ Index ];
+	JobInUse[ Index ] = false;
+	if( Job.Status == XST_FAILURE ) {
+#if COMMAND_SERVER_PORT != 0
+		if( Job.Reply ) // The command server waits for the response; it would hang with its client otherwise
+			SendRemoteReply( CommandResult::Failed );
+#endif
+		return XST_FAILURE;
+	}
+#if CHUNK_SAMPLE_COUNT > 0
+	State = ControlState::Idle; // sender_thread performed the whole capture
+	Overload.DroppedSamples += Job.GapSamples; // The header of the next capture carries them
+#endif
+
+	if( Job.DmaStart > Job.Triggered ) { // Unless the capture failed before its start signal
+		if( Job.Source == TriggerSource::Button )
+			LATENCY_PROBE_RECORD( Button, Job.DmaStart - Job.Triggered );
+#if COMMAND_SERVER_PORT != 0
+		else if( Job.Source == TriggerSource::Command )
+			RecordCommandLatency( Job.Triggered, Job.DmaStart );
+#endif
+	}
+#if COMMAND_SERVER_PORT != 0
+	if( Job.Reply )
+		SendRemoteReply( Job.Sent ? CommandResult::Ok : CommandResult::Failed );
+#endif
+
+	return StartNextCapture();
+} // CaptureSent
+
+/* Process the changes of the buttons posted by ButtonEvents.
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int ProcessButtons()
+{
+	ButtonsPending = false; // A change posted from now on posts a new event
+
+	ButtonEvent Event;
+	while( Buttons.Receive( Event ) ) {
+		if( Event.Pressed & BUTTON_PIN_0 ) { // If Cora Z7 button BTN0 was pressed
+			if( TriggerPending )
+				cout << "a capture is already waiting, BTN0 ignored" << endl;
+			else if( RequestCapture( TriggerSource::Button, Event.Edge, false ) == XST_FAILURE )
+				return XST_FAILURE;
+		}
+
+#if XADC_MODE == XADC_MODE_SINGLE_CHANNEL
+		if( Event.Pressed & BUTTON_PIN_1 ) { // If Cora Z7 button BTN1 was pressed
+			if( State == ControlState::Capturing )
+				cout << "a capture is in progress, BTN1 ignored" << endl;
+			else {
+				// Activate the other channel as input
+				ActiveXADCInput = ActiveXADCInput==eXADCInput::VAUX1 ? eXADCInput::VPVN : eXADCInput::VAUX1;
+				if( ActivateXADCInput() == XST_FAILURE )
+					return XST_FAILURE;
+			}
+		}
+#endif
+	}
+
+	return XST_SUCCESS;
+} // ProcessButtons
+
+// Callback of the periodic timer of XADC_thread; it runs in the timer service task
+static void TickTimerCallback(TimerHandle_t)
+{
+	if( !TickPending ) { // XADC_thread busy with a diagnostic command doesn't get a queue full of ticks
+		TickPending = true;
+		PostControlEvent( ControlEventType::Tick );
+	}
+} // TickTimerCallback
+
+/* Handle an event of the control loop of XADC_thread.
+ * Returns XST_FAILURE on an error, after which the application can't continue. */
+static int HandleControlEvent(const ControlEvent &Event)
+{
+	switch( Event.Type ) {
+		case ControlEventType::Buttons:
+			return ProcessButtons();
+#if CHUNK_SAMPLE_COUNT == 0
+		case ControlEventType::DmaDone:
+			return DmaDone( Event.Value, Event.Time );
+#endif
+		case ControlEventType::CaptureSent:
+			return CaptureSent( Event.Value );
+#if COMMAND_SERVER_PORT != 0
+		case ControlEventType::RemoteCommand: {
+			RemoteCommand Command;
+			if( xQueueReceive( RemoteCommands, &Command, 0 ) == pdTRUE )
+				return ProcessRemoteCommand( Command );
+			break;
+		}
+#endif
+		case ControlEventType::Tick:
+			TickPending = false;
+#if !BUTTON_INTERRUPTS
+			Buttons.Poll(); // Give the status of the buttons to the debouncer
+#endif
+			ProcessConsole(); // Process commands typed in the serial terminal
+			break;
+		default:
+			break;
+	}
+	return XST_SUCCESS;
+} // HandleControlEvent
 
 /* FreeRTOS thread of the main controlling logic of the application.
- * The network_init_thread will start XADC_thread after the network is initialized.
- */
+ * The network_init_thread starts XADC_thread right after lwIP is initialized, so the peripherals are initialized
+ * while the network is starting. XADC_thread then waits till the board has an IP address.
+ * After that, XADC_thread is an event loop: it sleeps on ControlEvents and each event is handled without waiting
+ * for the network. The captures are sent by sender_thread. */
 void XADC_thread(void *)
 {
 	cout << "***** XADC THREAD STARTED *****\n";
-	cout << "will connect to the network address " << SERVER_ADDR << ':' << SERVER_PORT << endl;
-	cout << "samples per DMA transfer: " << SAMPLE_COUNT << endl;
-
-	const std::string AveragingModeDescr[] = { "no", "16 samples", "64 samples", "256 samples" };
-	cout << AveragingModeDescr[AVERAGING_MODE] << " averaging is used" << endl;
+	TRACE_TASK_START( "XADC" );
+	ActiveConfig = Config;
+	PrintCaptureConfig( ActiveConfig );
+
+	// The queues must exist before the subsystems, which post the events, are initialized
+	ControlEvents = xQueueCreate( CONTROL_EVENTS, sizeof(ControlEvent) );
+	SendJobs      = xQueueCreate( CAPTURE_JOBS, sizeof(u32) );
+	if( ControlEvents == NULL || SendJobs == NULL ) {
+		cerr << "xQueueCreate failed! terminating" << endl;
+		vTaskDelete(NULL);
+	}
 
 	// Initialize the subsystems
 	if( GPIOInitialize() == XST_FAILURE )
@@ -369,69 +2484,90 @@ void XADC_thread(void *)
 		vTaskDelete(NULL);
 	if( DMAInitialize()  == XST_FAILURE )
 		vTaskDelete(NULL);
+	BootPhaseMark( BootPhase::PeripheralsReady );
 
+#if XADC_MODE != XADC_MODE_SINGLE_CHANNEL
+	cout << "\npress BTN0 to start ADC conversion" << endl;
+#else
 	cout << "\npress BTN0 to start ADC conversion" << endl
 	     << "press BTN1 to switch between VAUX[1] and VP/VN inputs" << endl;
 
-	// Activate VAUX[1] as input
+	// VAUX[1] is the input activated first
 	ActiveXADCInput = eXADCInput::VAUX1;
-	if( ActivateXADCInput() == XST_FAILURE )
+#endif
+	cout << "type count, avg, div, server or config to change the settings" << endl;
+
+	if( ActivateXADCMode() == XST_FAILURE )
 		vTaskDelete(NULL);
+	BootPhaseMark( BootPhase::XadcReady );
+
+	/* The thread was started together with the network, so the peripherals were initialized while the PHY was
+	 * negotiating the link. The captures can't be sent (nor the commands received) without the IP address, though. */
+	network_wait_ready();
+	BootPhaseMark( BootPhase::NetworkReady );
+	BootPhasesPrint( cout );
+
+	/* sender_thread has a lower priority than XADC_thread, so that an event preempts a send in progress
+	 * (e.g., the next capture starts while the previous one is formatted). */
+	sys_thread_new( "sender", sender_thread, NULL, STANDARD_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO - 1 );
+
+#if COMMAND_SERVER_PORT != 0
+	RemoteCommands = xQueueCreate( 1, sizeof(RemoteCommand) );
+	RemoteReplies  = xQueueCreate( 1, sizeof(CommandResponse) );
+	if( RemoteCommands == NULL || RemoteReplies == NULL ) {
+		cerr << "xQueueCreate failed! terminating" << endl;
+		vTaskDelete(NULL);
+	}
+	sys_thread_new( "cmd_server", command_server_thread, NULL, STANDARD_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO );
+	cout << "command server listens on the port " << COMMAND_SERVER_PORT << endl;
+#endif
 
-	// The object for debouncing the buttons (i.e., for ensuring that the app gets a filtered signal from the buttons for smooth control)
-	Debouncer btns( 0 ); // Passing 0 to the constructor because our buttons are pull-down buttons
+	// The buttons are reported from now on (a press during the startup doesn't trigger a capture)
+#if BUTTON_INTERRUPTS
+	if( Buttons.EnableInterrupts( GPIO_INTR_ID ) == XST_FAILURE ) {
+		cerr << "ButtonEvents::EnableInterrupts failed! terminating" << endl;
+		vTaskDelete(NULL);
+	}
+	const TickType_t TickPeriod = pdMS_TO_TICKS( CONSOLE_POLL_MS );
+#else
+	const TickType_t TickPeriod = pdMS_TO_TICKS( 1 ); // Buttons.Poll() needs to be called every 1 ms
+#endif
+	TimerHandle_t TickTimer = xTimerCreate( "tick", TickPeriod, pdTRUE, NULL, TickTimerCallback );
+	if( TickTimer == NULL || xTimerStart( TickTimer, 0 ) != pdPASS ) {
+		cerr << "xTimerCreate failed! terminating" << endl;
+		vTaskDelete(NULL);
+	}
 
 	while(1) {
-		/* Give status of the buttons to the debouncer.
-		 * EMIO pin 81 is connected to board's button BTN0 and EMIO pin 82 to BTN1.
-		 * Therefore, we must ignore the 26 lower bits of XGpioPs_Read return value to provide
-		 * 2-bit buttons' state to the debouncer. */
-		btns.ButtonProcess( XGpioPs_Read( &GpioInstance, 2 /*Bank 2*/ ) >> 26 );
-
-		if( btns.ButtonPressed(BUTTON_PIN_0) ) { // If Cora Z7 button BTN0 was pressed
-			if( ReceiveData() == XST_FAILURE )   // Perform a DMA transfer of digitized samples from XADC into RAM
+#if CHUNK_SAMPLE_COUNT == 0 && !DMA_INTERRUPT
+		// Without the DMA interrupt, the end of the DMA transfer is checked every 1 ms while a capture runs
+		const TickType_t Wait = State == ControlState::Capturing ? pdMS_TO_TICKS( 1 ) : portMAX_DELAY;
+#else
+		const TickType_t Wait = portMAX_DELAY;
+#endif
+		ControlEvent Event;
+		if( xQueueReceive( ControlEvents, &Event, Wait ) == pdTRUE )
+			if( HandleControlEvent( Event ) == XST_FAILURE )
 				vTaskDelete(NULL); // We end this thread on error
 
-			// Print data sample of the first 8 values to the console
-			cout << "\n***** XADC DATA[0..7] *****\n";
-			cout << std::defaultfloat << std::setprecision(7); // Disabling std::fixed used in previous output
-			for( int i = 0; i < 8; i++ )
-				cout << Xadc_RawToVoltageFunc( DataBuffer[i]) << endl;
-
-			// Transfer data over the network
-			try {
-				FileViaSocket f( SERVER_ADDR, SERVER_PORT ); // Declare the object and open the network connection
-
-				cout << "sending data..." << std::flush;
-				f << std::setprecision(7); // Set decimal precision for the output
-				for( int i = 0; i < SAMPLE_COUNT; i++ )
-					f << Xadc_RawToVoltageFunc( DataBuffer[i]) << '\n'; /* We are using '\n' on purpose instead of std::endl, because
-					                                                     * std::endl has a side effect of flushing the buffer, i.e.,
-					                                                     * each single value would be immediately sent in a TCP packet. */
-				cout << "   sent" << endl;
-			} // Object f ceases to exist, destructor on f is called, the connection is closed
-			catch( const std::exception& e ) {
-				cerr << "Error on opening the socket:\n" << e.what() << endl;
-			}
-		}
-
-		if( btns.ButtonPressed(BUTTON_PIN_1) ) { // If Cora Z7 button BTN1 was pressed
-			// Activate the other channel as input
-			ActiveXADCInput = ActiveXADCInput==eXADCInput::VAUX1 ? eXADCInput::VPVN : eXADCInput::VAUX1;
-			if( ActivateXADCInput() == XST_FAILURE )
+#if CHUNK_SAMPLE_COUNT == 0 && !DMA_INTERRUPT
+		if( State == ControlState::Capturing && !XAxiDma_Busy( &AxiDmaInstance, XAXIDMA_DEVICE_TO_DMA ) ) {
+			// After the transfer, the buffer length register holds the number of bytes written
+			u32 BytesWritten = XAxiDma_ReadReg( AxiDmaInstance.RxBdRing[0].ChanBase, XAXIDMA_BUFFLEN_OFFSET );
+			if( DmaDone( BytesWritten, TimestampNow() ) == XST_FAILURE )
 				vTaskDelete(NULL); // We end this thread on error
 		}
-
-		vTaskDelay( pdMS_TO_TICKS( 1 ) ); // Wait 1 ms
+#endif
 	} // while(1)
 } // XADC_thread
 
 int main()
 {
+	BootPhaseMark( BootPhase::Main );
 	cout << "\n*************** PROGRAM STARTED ***************" << endl;
 
 	/* Starting the thread, which initializes the network.
-	 * It will start the XADC_thread when the network is ready. */
+	 * It will start the XADC_thread as soon as lwIP is initialized. */
 	network_init_thread_handle = sys_thread_new("network_init_thread", network_init_thread, 0,
 	                                            STANDARD_THREAD_STACKSIZE,
 	                                            DEFAULT_THREAD_PRIO);
@@ -38,19 +38,43 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "lwip/dhcp.h"
 #include "xparameters.h"
 
+#include "FreeRTOS.h"
+#include "semphr.h"
+
 #include "FileViaSocket.h"
+#include "EventTrace.h"
+#include "BootPhases.h"
 
-//Fallback IP address used when DHCP is not successful
+//Fallback IP address used when DHCP is not successful (and the static address of NETWORK_START_STATIC)
 #define DEFAULT_IP_ADDRESS	"192.168.44.150"
 #define DEFAULT_IP_MASK		"255.255.255.0"
 #define DEFAULT_GW_ADDRESS	"192.168.44.1"
 
+/* How the board gets its IP address at startup:
+ * NETWORK_START_DHCP:   wait for DHCP (up to DHCP_TIMEOUT_MSECS), then use the fallback address above.
+ * NETWORK_START_STATIC: use the address above right after the link is up; DHCP runs in the background,
+ *                       and the address it supplies replaces the static one.
+ * NETWORK_START_LEASE:  use the lease obtained by DHCP before the last reset right after the link is up;
+ *                       DHCP runs in the background (and usually supplies the same address again).
+ *                       Without a cached lease (e.g., after a power cycle), it works like NETWORK_START_DHCP. */
+#define NETWORK_START_DHCP   0
+#define NETWORK_START_STATIC 1
+#define NETWORK_START_LEASE  2
+
+#define NETWORK_START NETWORK_START_LEASE
+//#define NETWORK_START NETWORK_START_STATIC
+//#define NETWORK_START NETWORK_START_DHCP
+
+#define DHCP_TIMEOUT_MSECS 10000 // How long we wait for DHCP before using the fallback address
+#define DHCP_POLL_MSECS    10    // How often we check whether DHCP supplied the address
+
 //Size of the stack (as number of 32bit words) for threads we create:
 #define STANDARD_THREAD_STACKSIZE 1024
 
 sys_thread_t network_init_thread_handle;
 static int complete_nw_thread;
 struct netif server_netif;
+static SemaphoreHandle_t network_ready; // Given when the board has an IP address
 
 extern volatile int dhcp_timoutcntr;
 err_t dhcp_start(struct netif *netif);
@@ -90,6 +114,61 @@ static void assign_default_ip(ip_addr_t *ip, ip_addr_t *mask, ip_addr_t *gw)
 		xil_printf("Invalid default gateway address: %d\r\n", err);
 } //assign_default_ip
 
+/* The lease obtained by DHCP is kept in a section, which isn't initialized at the startup. It survives a reset
+ * of the processor (e.g., by the SRST button or from the debugger), not a power cycle; the checksum tells
+ * whether the memory still holds a lease. */
+#define LEASE_CACHE_MAGIC 0x4C454153 // "LEAS"
+
+struct lease_cache {
+	u32 magic;
+	u32 ip, mask, gw;
+	u32 checksum;
+};
+static struct lease_cache cached_lease __attribute__((section(".noinit")));
+
+static u32 lease_checksum(const struct lease_cache *lease)
+{
+	return ~( lease->magic + lease->ip + ( lease->mask << 1 ) + ( lease->gw << 2 ) );
+}
+
+static int load_cached_lease(ip_addr_t *ip, ip_addr_t *mask, ip_addr_t *gw)
+{
+	if (cached_lease.magic != LEASE_CACHE_MAGIC || cached_lease.checksum != lease_checksum(&cached_lease)
+	    || cached_lease.ip == 0)
+		return 0;
+
+	ip->addr   = cached_lease.ip;
+	mask->addr = cached_lease.mask;
+	gw->addr   = cached_lease.gw;
+	return 1;
+} //load_cached_lease
+
+static void save_cached_lease(const ip_addr_t *ip, const ip_addr_t *mask, const ip_addr_t *gw)
+{
+	cached_lease.magic    = LEASE_CACHE_MAGIC;
+	cached_lease.ip       = ip->addr;
+	cached_lease.mask     = mask->addr;
+	cached_lease.gw       = gw->addr;
+	cached_lease.checksum = lease_checksum(&cached_lease);
+} //save_cached_lease
+
+/* Wait till the board has an IP address. It's called by XADC_thread, which initializes the peripherals
+ * while the network is starting. */
+void network_wait_ready()
+{
+	xSemaphoreTake(network_ready, portMAX_DELAY);
+	xSemaphoreGive(network_ready); // Other tasks may wait as well
+} //network_wait_ready
+
+// Signal to the tasks in network_wait_ready() that the board has an IP address
+static void set_network_ready()
+{
+	BootPhaseMark(BootPhase::AddressAssigned);
+	print_ip_settings(&(server_netif.ip_addr), &(server_netif.netmask), &(server_netif.gw));
+	xil_printf("\r\n");
+	xSemaphoreGive(network_ready);
+} //set_network_ready
+
 static void network_thread(void *)
 {
 	int mscnt = 0;
@@ -97,6 +176,8 @@ static void network_thread(void *)
 	/* the mac address of the board. this should be unique per board */
 	u8_t mac_ethernet_address[] = { 0x00, 0x0a, 0x35, 0x00, 0x01, 0x02 };
 
+	TRACE_TASK_START( "nw_thread" );
+
 	xil_printf("\n\r");
 	xil_printf("------lwIP Socket Mode TCP Startup------\r\n");
 
@@ -104,8 +185,10 @@ static void network_thread(void *)
 	if (!xemac_add(&server_netif, NULL, NULL, NULL, mac_ethernet_address,
 	               XPAR_XEMACPS_0_BASEADDR)) {
 		xil_printf("Error adding N/W interface\r\n");
+		TRACE_EVENT( TaskStop, 0 );
 		return;
 	}
+	BootPhaseMark(BootPhase::LinkUp);
 
 	netif_set_default(&server_netif);
 
@@ -142,10 +225,28 @@ static void network_thread(void *)
 void network_init_thread(void *)
 {
 	int mscnt = 0;
+	int address_assigned = 0;
+
+	BootPhaseMark(BootPhase::NetworkInit);
+	TRACE_TASK_START( "network_init_thread" );
 
 	/* initialize lwIP before calling sys_thread_new */
 	lwip_init();
 
+	network_ready = xSemaphoreCreateBinary();
+	if (network_ready == NULL) {
+		xil_printf("ERROR: xSemaphoreCreateBinary failed\r\n");
+		TRACE_EVENT( TaskStop, 0 );
+		vTaskDelete(NULL);
+	}
+
+	/* Start the thread, which handles the XADC, right away. It initializes the peripherals while the PHY
+	 * negotiates the link and DHCP runs, and then it waits in network_wait_ready() for the IP address. */
+	/* any thread using lwIP should be created using sys_thread_new */
+	sys_thread_new("XADC", XADC_thread, NULL,
+	               STANDARD_THREAD_STACKSIZE,
+	               DEFAULT_THREAD_PRIO);
+
 	/* Start the thread, which will start the network and DHCP.  */
 	/* any thread using lwIP should be created using sys_thread_new */
 	sys_thread_new("nw_thread", network_thread, NULL,
@@ -156,32 +257,46 @@ void network_init_thread(void *)
 	if (!complete_nw_thread)
 		vTaskSuspend(NULL);
 
+#if NETWORK_START == NETWORK_START_STATIC
+	xil_printf("Using the static IP address, DHCP continues in the background\r\n");
+	assign_default_ip(&(server_netif.ip_addr), &(server_netif.netmask), &(server_netif.gw));
+	address_assigned = 1;
+#elif NETWORK_START == NETWORK_START_LEASE
+	if (load_cached_lease(&(server_netif.ip_addr), &(server_netif.netmask), &(server_netif.gw))) {
+		xil_printf("Using the cached DHCP lease, DHCP continues in the background\r\n");
+		address_assigned = 1;
+	}
+#endif
+	if (address_assigned)
+		set_network_ready();
+
 	/* Wait for IP address being obtained by DHCP */
 	while (1) {
-		vTaskDelay(DHCP_FINE_TIMER_MSECS / portTICK_RATE_MS);
-		if (server_netif.ip_addr.addr) {
+		vTaskDelay(DHCP_POLL_MSECS / portTICK_RATE_MS);
+		if (dhcp_supplied_address(&server_netif)) {
+			BootPhaseMark(BootPhase::DhcpBound);
 			xil_printf("DHCP request success\r\n");
+			save_cached_lease(&(server_netif.ip_addr), &(server_netif.netmask), &(server_netif.gw));
+			if (!address_assigned)
+				set_network_ready();
+			else
+				print_ip_settings(&(server_netif.ip_addr), &(server_netif.netmask), &(server_netif.gw));
 			break;
 		}
-		mscnt += DHCP_FINE_TIMER_MSECS;
-		if (mscnt >= 10000) {
-			xil_printf("ERROR: DHCP request timed out\r\n");
-			assign_default_ip(&(server_netif.ip_addr), &(server_netif.netmask),
-							&(server_netif.gw));
+		mscnt += DHCP_POLL_MSECS;
+		if (mscnt >= DHCP_TIMEOUT_MSECS) {
+			if (!address_assigned) {
+				xil_printf("ERROR: DHCP request timed out\r\n");
+				assign_default_ip(&(server_netif.ip_addr), &(server_netif.netmask),
+								&(server_netif.gw));
+				set_network_ready();
+			}
+			else
+				xil_printf("DHCP request timed out, keeping the IP address\r\n");
 			break;
 		}
 	}
 
-	print_ip_settings(&(server_netif.ip_addr), &(server_netif.netmask), &(server_netif.gw));
-
-	xil_printf("\r\n");
-
-	/*** network is ready, we can now start the thread, which handles the XADC ***/
-
-	/* any thread using lwIP should be created using sys_thread_new */
-	sys_thread_new("XADC", XADC_thread, NULL,
-	               STANDARD_THREAD_STACKSIZE,
-	               DEFAULT_THREAD_PRIO);
-
+	TRACE_EVENT( TaskStop, 0 );
 	vTaskDelete(NULL); // All done, we can end this thread
 } //network_init_thread
@@ -0,0 +1,133 @@
+/*
+This is the source file of the aligner of the captures of several boards of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "CaptureAligner.h"
+
+#include <algorithm>
+
+void CaptureAligner::Add( Capture &&C, uint64_t Now, std::vector<Capture> &Ready )
+{
+	if( !C.HasInfo || C.Info.Board == 0 ) {
+		Stats.Unaligned++;
+		Ready.push_back( std::move( C ) );
+		return;
+	}
+
+	// Update the estimate of the clock of the board
+	const int64_t Delta = int64_t( C.ReceiveTime ) - int64_t( C.Info.Time );
+	auto Found = Clocks.find( C.Info.Board );
+	if( Found == Clocks.end() )
+		Found = Clocks.emplace( C.Info.Board, BoardClock{ Delta, C.Info.Number } ).first;
+	BoardClock &Clock = Found->second;
+	if( C.Info.Number <= Clock.LastNumber || Delta < Clock.Offset )
+		Clock.Offset = Delta; // The capture came faster than any before, or the board was restarted
+	Clock.LastNumber = C.Info.Number;
+	const uint64_t Start = C.Info.Time + uint64_t( Clock.Offset );
+
+	// Join the first open group close enough in time, which doesn't have a capture of the board yet
+	size_t Target = Pending.size();
+	for( size_t g = 0; g < Pending.size() && Target == Pending.size(); g++ ) {
+		const Group &G = Pending[g];
+		const uint64_t Difference = Start > G.Start ? Start - G.Start : G.Start - Start;
+		if( Difference > Tolerance )
+			continue;
+		bool HasBoard = false;
+		for( const Capture &Member : G.Members )
+			HasBoard |= Member.Info.Board == C.Info.Board;
+		if( !HasBoard )
+			Target = g;
+	}
+	if( Target == Pending.size() ) {
+		Pending.emplace_back();
+		Pending.back().Start    = Start;
+		Pending.back().Received = Now;
+	}
+	Group &G = Pending[ Target ];
+	G.Members.push_back( std::move( C ) );
+	G.Starts.push_back( Start );
+
+	// The group is complete when each board seen so far contributed
+	if( G.Members.size() == Clocks.size() ) {
+		Close( G, Ready );
+		Stats.Complete++;
+		Pending.erase( Pending.begin() + std::ptrdiff_t( Target ) );
+	}
+	Flush( Now, false, Ready );
+} // CaptureAligner::Add
+
+void CaptureAligner::Flush( uint64_t Now, bool All, std::vector<Capture> &Ready )
+{
+	while( !Pending.empty() && ( All || Now - Pending.front().Received >= Hold ) ) {
+		Close( Pending.front(), Ready );
+		Stats.Incomplete++;
+		Pending.pop_front();
+	}
+} // CaptureAligner::Flush
+
+void CaptureAligner::Close( Group &G, std::vector<Capture> &Ready )
+{
+	GroupCount++;
+	if( G.Members.size() == 1 ) { // A single board; there's nothing to align
+		Ready.push_back( std::move( G.Members[0] ) );
+		return;
+	}
+
+	const uint64_t Earliest = *std::min_element( G.Starts.begin(), G.Starts.end() );
+	const uint64_t Latest   = *std::max_element( G.Starts.begin(), G.Starts.end() );
+	Stats.MaxSpread = std::max( Stats.MaxSpread, Latest - Earliest );
+
+	// The aligned capture takes the settings of the first member; the members are in the order of the board IDs
+	std::vector<size_t> Order( G.Members.size() );
+	for( size_t m = 0; m < Order.size(); m++ )
+		Order[m] = m;
+	std::sort( Order.begin(), Order.end(), [&G]( size_t a, size_t b ) { return G.Members[a].Info.Board < G.Members[b].Info.Board; } );
+
+	Capture Aligned;
+	Aligned.HasInfo     = true;
+	Aligned.Aligned     = true;
+	Aligned.BoardCount  = uint32_t( G.Members.size() );
+	Aligned.Info        = G.Members[ Order[0] ].Info;
+	Aligned.Info.Board  = 0;
+	Aligned.Info.Number = GroupCount;
+	Aligned.Info.Time   = 0;
+	Aligned.Info.Channel.clear();
+	Aligned.ReceiveTime = Earliest;
+	for( size_t m : Order ) {
+		Capture &Member = G.Members[m];
+		Aligned.InvalidLines += Member.InvalidLines;
+		Aligned.MissingSamples += Member.MissingSamples;
+		for( CaptureSeries &Series : Member.Series ) {
+			Series.Board       = Member.Info.Board;
+			Series.StartOffset = int32_t( G.Starts[m] - Earliest );
+			Series.OffsetCoeff = Member.Info.OffsetCoeff;
+			Series.GainCoeff   = Member.Info.GainCoeff;
+			Series.CaptureNumber = Member.Info.Number;
+			Series.BoardTime     = Member.Info.Time;
+			Aligned.Series.push_back( std::move( Series ) );
+		}
+	}
+	Ready.push_back( std::move( Aligned ) );
+} // CaptureAligner::Close
@@ -0,0 +1,97 @@
+/*
+This is the header file of the aligner of the captures of several boards of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CAPTUREALIGNER_H
+#define CAPTUREALIGNER_H
+
+#include "CaptureArchive.h"
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <map>
+
+/* CaptureAligner groups the captures of several boards by the time they were triggered, and joins each group
+ * into one aligned capture with the series of all the boards (see CAPTURE_FLAG_ALIGNED in CaptureArchive.h).
+ *
+ * The boards' clocks aren't synchronized: the time in the capture header counts from the start of each board.
+ * The aligner therefore estimates the offset of each board's clock from the clock of the receiver as the minimum of
+ * (receive time - board time) over the captures of the board. The minimum is the capture whose connection came the
+ * fastest; the constant part of the delay (the capture itself, the connection setup) is the same for all the boards
+ * with the same settings, so it cancels out when their captures are compared. The estimate is reset when the capture
+ * number of a board goes down, i.e., when the board was restarted.
+ * Captures whose start times (on the receiver clock) differ by at most the tolerance form a group; each board
+ * contributes at most one capture. A group is complete when all the boards seen so far contributed; otherwise it's
+ * closed when it's older than the hold time. Captures without the header line (or without a board ID) can't be
+ * aligned; they are passed on as they are. */
+class CaptureAligner {
+public:
+	CaptureAligner( uint64_t ToleranceNs, uint64_t HoldNs ) : Tolerance( ToleranceNs ), Hold( HoldNs ) {}
+
+	// Counters of the groups closed so far
+	struct Statistics {
+		uint64_t Complete;   // Groups with a capture of every board
+		uint64_t Incomplete; // Groups closed by the hold time
+		uint64_t Unaligned;  // Captures passed on without alignment
+		uint64_t MaxSpread;  // Max. difference of the start times within a group [ns]
+	};
+
+	/* Add the capture received at Now (ns since the Unix epoch). The captures and groups ready to be stored are
+	 * appended to Ready. */
+	void Add( Capture &&C, uint64_t Now, std::vector<Capture> &Ready );
+
+	// Close the groups older than the hold time (or all the groups when All is true) and append them to Ready
+	void Flush( uint64_t Now, bool All, std::vector<Capture> &Ready );
+
+	size_t BoardCount() const { return Clocks.size(); }
+	const Statistics &GetStatistics() const { return Stats; }
+
+private:
+	// Estimate of the clock of a board
+	struct BoardClock {
+		int64_t  Offset;     // Minimum of (receive time - board time)
+		uint32_t LastNumber; // Number of the last capture of the board
+	};
+
+	// Captures of several boards started at about the same time
+	struct Group {
+		uint64_t             Start;    // Start of the first capture on the receiver clock
+		uint64_t             Received; // When the first capture was received
+		std::vector<Capture> Members;
+		std::vector<uint64_t> Starts;  // Start of each member on the receiver clock
+	};
+
+	void Close( Group &G, std::vector<Capture> &Ready );
+
+	const uint64_t Tolerance;
+	const uint64_t Hold;
+	std::map<uint32_t, BoardClock> Clocks; // Indexed by the board ID
+	std::deque<Group> Pending;             // Open groups in the order they were created
+	uint32_t   GroupCount = 0;
+	Statistics Stats{};
+}; // CaptureAligner
+
+#endif // CAPTUREALIGNER_H
@@ -0,0 +1,451 @@
+/*
+This is the source file of the capture archive of the host tools of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "CaptureArchive.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+using std::cerr;
+using std::endl;
+
+static const uint8_t Padding[ CAPTURE_ARCHIVE_ALIGN ] = {};
+
+static uint64_t AlignUp( uint64_t Value )
+{
+	return ( Value + CAPTURE_ARCHIVE_ALIGN - 1 ) & ~uint64_t( CAPTURE_ARCHIVE_ALIGN - 1 );
+} // AlignUp
+
+static void PrintError( const char *What, const std::string &Path )
+{
+	cerr << What << ' ' << Path << " failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+} // PrintError
+
+/***** CaptureTextParser *****/
+
+bool CaptureTextParser::IsCaptureText( char First )
+{
+	return First == '#' || First == '-' || First == '+' || First == '.' || ( First >= '0' && First <= '9' )
+	    || First == '\n' || First == '\r' || First == ' ';
+} // CaptureTextParser::IsCaptureText
+
+void CaptureTextParser::Feed( const char *Data, size_t Size )
+{
+	const char *End = Data + Size;
+	while( Data < End ) {
+		const char *LineEnd = (const char *)memchr( Data, '\n', size_t( End - Data ) );
+		if( LineEnd == nullptr ) {
+			Partial.append( Data, End );
+			return;
+		}
+		if( Partial.empty() )
+			ParseLine( Data, LineEnd );
+		else {
+			Partial.append( Data, LineEnd );
+			ParseLine( Partial.data(), Partial.data() + Partial.size() );
+			Partial.clear();
+		}
+		Data = LineEnd + 1;
+	}
+} // CaptureTextParser::Feed
+
+Capture &CaptureTextParser::Finish()
+{
+	if( !Partial.empty() ) {
+		ParseLine( Partial.data(), Partial.data() + Partial.size() );
+		Partial.clear();
+	}
+	return Result;
+} // CaptureTextParser::Finish
+
+void CaptureTextParser::ParseLine( const char *Begin, const char *End )
+{
+	if( End > Begin && End[-1] == '\r' )
+		End--;
+	if( Begin == End )
+		return;
+
+	if( *Begin == '#' ) {
+		const std::string Line( Begin, End );
+		CaptureInfo Info;
+		if( ParseCaptureHeader( Line, Info ) ) {
+			Result.HasInfo = true;
+			Result.Info    = Info;
+			return;
+		}
+		// The samples the board dropped (a gap among the values, or a channel of a summary-only capture)
+		uint64_t Gap;
+		CaptureSummary Summary;
+		if( ParseCaptureGap( Line, Gap ) ) {
+			Result.MissingSamples += uint32_t( Gap );
+			return;
+		}
+		if( ParseCaptureSummary( Line, Summary ) ) {
+			Result.MissingSamples += Summary.Samples;
+			return;
+		}
+		// A header of a series "# <channels> <count>"; other comment lines are skipped
+		const size_t LastSpace = Line.rfind( ' ' );
+		if( Line.size() < 2 || Line[1] != ' ' || LastSpace <= 1 )
+			return;
+		const std::string Channels = Line.substr( 2, LastSpace - 2 );
+		const unsigned long Rows = strtoul( Line.c_str() + LastSpace + 1, nullptr, 10 );
+
+		Current = nullptr;
+		for( CaptureSeries &Series : Result.Series ) // The series continues in the next chunk of a large capture
+			if( Series.HeaderLine && Series.Channels == Channels )
+				Current = &Series;
+		if( Current == nullptr ) {
+			Result.Series.emplace_back();
+			Current = &Result.Series.back();
+			Current->Channels   = Channels;
+			Current->Columns    = uint16_t( 1 + std::count( Channels.begin(), Channels.end(), ',' ) );
+			Current->HeaderLine = true;
+		}
+		Current->Samples.reserve( Current->Samples.size() + Rows * Current->Columns );
+		return;
+	}
+
+	// A line of values "<value>[,<value>...]"
+	float    Values[ 2 ];
+	uint16_t Count = 0;
+	const char *Next = Begin;
+	while( true ) {
+		char *ValueEnd;
+		const float Value = strtof( Next, &ValueEnd );
+		if( ValueEnd == Next || Count == 2 || ValueEnd > End ) {
+			Result.InvalidLines++;
+			return;
+		}
+		Values[ Count++ ] = Value;
+		if( ValueEnd == End )
+			break;
+		if( *ValueEnd != ',' ) {
+			Result.InvalidLines++;
+			return;
+		}
+		Next = ValueEnd + 1;
+	}
+
+	if( Current == nullptr ) { // The values of the single channel mode have no series header
+		Result.Series.emplace_back();
+		Current = &Result.Series.back();
+		Current->Channels = Result.Info.Channel;
+		Current->Columns  = Count;
+	}
+	if( Count != Current->Columns ) {
+		Result.InvalidLines++;
+		return;
+	}
+	Current->Samples.insert( Current->Samples.end(), Values, Values + Count );
+} // CaptureTextParser::ParseLine
+
+/***** CaptureArchiveWriter *****/
+
+// Read the header of a file of the archive, or write it when the file is empty. Returns false on an error.
+static bool PrepareFileHeader( int File, uint32_t Magic, const std::string &Path, uint64_t &Size )
+{
+	struct stat Stat;
+	if( fstat( File, &Stat ) < 0 ) {
+		PrintError( "fstat of", Path );
+		return false;
+	}
+	Size = uint64_t( Stat.st_size );
+
+	ArchiveFileHeader Header = { Magic, CAPTURE_ARCHIVE_VERSION, sizeof(ArchiveFileHeader), 0 };
+	if( Size == 0 ) {
+		if( pwrite( File, &Header, sizeof(Header), 0 ) != ssize_t( sizeof(Header) ) ) {
+			PrintError( "write to", Path );
+			return false;
+		}
+		Size = sizeof(Header);
+		return true;
+	}
+
+	ArchiveFileHeader Existing;
+	if( pread( File, &Existing, sizeof(Existing), 0 ) != ssize_t( sizeof(Existing) ) || Existing.Magic != Magic ) {
+		cerr << Path << " is not a file of a capture archive" << endl;
+		return false;
+	}
+	if( Existing.Version != CAPTURE_ARCHIVE_VERSION ) {
+		cerr << Path << " has the version " << Existing.Version << " of the capture archive, " << CAPTURE_ARCHIVE_VERSION << " is supported" << endl;
+		return false;
+	}
+	return true;
+} // PrepareFileHeader
+
+// Write all the buffers at the Offset of the File. Returns false on an error.
+static bool WriteAll( int File, std::vector<struct iovec> &Buffers, uint64_t Offset )
+{
+	size_t First = 0;
+	while( First < Buffers.size() ) {
+		int Count = int( std::min<size_t>( Buffers.size() - First, IOV_MAX ) );
+		ssize_t n = pwritev( File, &Buffers[ First ], Count, off_t( Offset ) );
+		if( n < 0 ) {
+			if( errno == EINTR )
+				continue;
+			return false;
+		}
+		Offset += uint64_t(n);
+		// Skip the buffers written completely, and move the start of the one written partially
+		while( First < Buffers.size() && size_t(n) >= Buffers[ First ].iov_len )
+			n -= ssize_t( Buffers[ First++ ].iov_len );
+		if( First < Buffers.size() ) {
+			Buffers[ First ].iov_base = (uint8_t *)Buffers[ First ].iov_base + n;
+			Buffers[ First ].iov_len -= size_t(n);
+		}
+	}
+	return true;
+} // WriteAll
+
+bool CaptureArchiveWriter::Open( const std::string &Path )
+{
+	Close();
+	const std::string IndexPath = Path + CAPTURE_INDEX_SUFFIX;
+
+	DataFile  = open( Path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+	IndexFile = open( IndexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+	if( DataFile < 0 || IndexFile < 0 ) {
+		PrintError( "open of", DataFile < 0 ? Path : IndexPath );
+		Close();
+		return false;
+	}
+
+	uint64_t IndexSize;
+	if( !PrepareFileHeader( DataFile, CAPTURE_ARCHIVE_MAGIC, Path, DataSize )
+	    || !PrepareFileHeader( IndexFile, CAPTURE_INDEX_MAGIC, IndexPath, IndexSize ) ) {
+		Close();
+		return false;
+	}
+
+	// Cut off an incomplete entry and a record without an entry, which remain when a writer was interrupted
+	Entries = ( IndexSize - sizeof(ArchiveFileHeader) ) / sizeof(CaptureIndexEntry);
+	uint64_t End = CAPTURE_ARCHIVE_ALIGN;
+	if( Entries > 0 ) {
+		CaptureIndexEntry Last;
+		CaptureRecordHeader Record;
+		if( pread( IndexFile, &Last, sizeof(Last), off_t( sizeof(ArchiveFileHeader) + ( Entries - 1 ) * sizeof(Last) ) ) != ssize_t( sizeof(Last) )
+		    || pread( DataFile, &Record, sizeof(Record), off_t( Last.Offset ) ) != ssize_t( sizeof(Record) )
+		    || Record.Magic != CAPTURE_RECORD_MAGIC || Last.Offset + Record.RecordSize > DataSize ) {
+			cerr << "the last capture of the archive " << Path << " is damaged" << endl;
+			Close();
+			return false;
+		}
+		End = Last.Offset + Record.RecordSize;
+	}
+	if( ftruncate( IndexFile, off_t( sizeof(ArchiveFileHeader) + Entries * sizeof(CaptureIndexEntry) ) ) < 0
+	    || ftruncate( DataFile, off_t( End ) ) < 0 ) {
+		PrintError( "truncate of", Path );
+		Close();
+		return false;
+	}
+	DataSize = End;
+	return true;
+} // CaptureArchiveWriter::Open
+
+void CaptureArchiveWriter::Close()
+{
+	if( DataFile >= 0 )
+		close( DataFile );
+	if( IndexFile >= 0 )
+		close( IndexFile );
+	DataFile  = -1;
+	IndexFile = -1;
+	Entries   = 0;
+} // CaptureArchiveWriter::Close
+
+bool CaptureArchiveWriter::Append( const Capture &C )
+{
+	if( DataFile < 0 )
+		return false;
+
+	// The headers are prepared in one buffer, the samples are written directly from the series
+	std::vector<uint8_t> Headers( sizeof(CaptureRecordHeader) + C.Series.size() * sizeof(SeriesHeader) );
+	CaptureRecordHeader &Record = *(CaptureRecordHeader *)Headers.data();
+	SeriesHeader *Series = (SeriesHeader *)( Headers.data() + sizeof(CaptureRecordHeader) );
+
+	Record.Magic         = CAPTURE_RECORD_MAGIC;
+	Record.SeriesCount   = uint32_t( C.Series.size() );
+	Record.ReceiveTime   = C.ReceiveTime;
+	Record.BoardTime     = C.Info.Time;
+	Record.CaptureNumber = C.Info.Number;
+	Record.Flags         = uint16_t( ( C.HasInfo ? CAPTURE_FLAG_INFO : 0 ) | ( C.Aligned ? CAPTURE_FLAG_ALIGNED : 0 ) );
+	Record.Averaging     = C.Info.Averaging;
+	Record.AdcClkDivisor = C.Info.AdcClkDivisor;
+	Record.OffsetCoeff   = C.Info.OffsetCoeff;
+	Record.GainCoeff     = C.Info.GainCoeff;
+	Record.Format        = uint16_t( SampleFormat::Float32 );
+	Record.InvalidLines  = C.InvalidLines;
+	Record.Board         = C.Aligned ? 0 : C.Info.Board;
+	Record.BoardCount    = C.BoardCount;
+	Record.MissingSamples = C.MissingSamples;
+
+	std::vector<struct iovec> Buffers;
+	Buffers.push_back( { Headers.data(), Headers.size() } );
+	uint64_t Size = Headers.size();
+	for( size_t s = 0; s < C.Series.size(); s++ ) {
+		const CaptureSeries &From = C.Series[s];
+		strncpy( Series[s].Channels, From.Channels.c_str(), CAPTURE_CHANNELS_SIZE - 1 );
+		Series[s].Columns = From.Columns;
+		Series[s].Flags   = From.HeaderLine ? SERIES_FLAG_HEADER_LINE : 0;
+		Series[s].Rows    = uint32_t( From.Samples.size() / From.Columns );
+		Series[s].Board       = C.Aligned ? From.Board : C.Info.Board;
+		Series[s].StartOffset = C.Aligned ? From.StartOffset : 0;
+		Series[s].OffsetCoeff = C.Aligned ? From.OffsetCoeff : C.Info.OffsetCoeff;
+		Series[s].GainCoeff   = C.Aligned ? From.GainCoeff : C.Info.GainCoeff;
+		Series[s].CaptureNumber = C.Aligned ? From.CaptureNumber : C.Info.Number;
+		Series[s].BoardTime     = C.Aligned ? From.BoardTime : C.Info.Time;
+
+		Buffers.push_back( { (void *)Padding, size_t( AlignUp( Size ) - Size ) } );
+		Series[s].Offset = AlignUp( Size );
+		Buffers.push_back( { (void *)From.Samples.data(), From.Samples.size() * sizeof(float) } );
+		Size = Series[s].Offset + From.Samples.size() * sizeof(float);
+	}
+	Buffers.push_back( { (void *)Padding, size_t( AlignUp( Size ) - Size ) } );
+	Record.RecordSize = AlignUp( Size );
+
+	const CaptureIndexEntry Entry = { DataSize, C.ReceiveTime };
+	if( !WriteAll( DataFile, Buffers, DataSize ) ) {
+		PrintError( "write to", "the data file of the archive" );
+		return false;
+	}
+	if( pwrite( IndexFile, &Entry, sizeof(Entry), off_t( sizeof(ArchiveFileHeader) + Entries * sizeof(Entry) ) ) != ssize_t( sizeof(Entry) ) ) {
+		PrintError( "write to", "the index of the archive" );
+		return false;
+	}
+	DataSize += Record.RecordSize;
+	Entries++;
+	return true;
+} // CaptureArchiveWriter::Append
+
+/***** CaptureView and CaptureArchiveReader *****/
+
+CaptureInfo CaptureView::Info() const
+{
+	const CaptureRecordHeader &H = Header();
+	CaptureInfo Info;
+	Info.Board         = H.Board;
+	Info.Number        = H.CaptureNumber;
+	Info.Averaging     = H.Averaging;
+	Info.AdcClkDivisor = H.AdcClkDivisor;
+	Info.OffsetCoeff   = H.OffsetCoeff;
+	Info.GainCoeff     = H.GainCoeff;
+	Info.Time          = H.BoardTime;
+	if( H.SeriesCount == 1 && !( Series( 0 ).Flags & SERIES_FLAG_HEADER_LINE ) )
+		Info.Channel = Series( 0 ).Channels;
+	return Info;
+} // CaptureView::Info
+
+// Map the whole file read-only. Returns nullptr on an error (which is printed).
+static const uint8_t *MapFile( const std::string &Path, uint32_t Magic, size_t &Size )
+{
+	int File = open( Path.c_str(), O_RDONLY | O_CLOEXEC );
+	struct stat Stat;
+	if( File < 0 || fstat( File, &Stat ) < 0 ) {
+		PrintError( "open of", Path );
+		if( File >= 0 )
+			close( File );
+		return nullptr;
+	}
+	Size = size_t( Stat.st_size );
+	if( Size < sizeof(ArchiveFileHeader) ) {
+		cerr << Path << " is not a file of a capture archive" << endl;
+		close( File );
+		return nullptr;
+	}
+	void *Map = mmap( nullptr, Size, PROT_READ, MAP_SHARED, File, 0 );
+	close( File ); // The mapping remains valid
+	if( Map == MAP_FAILED ) {
+		PrintError( "mmap of", Path );
+		return nullptr;
+	}
+
+	const ArchiveFileHeader &Header = *(const ArchiveFileHeader *)Map;
+	if( Header.Magic != Magic || Header.Version != CAPTURE_ARCHIVE_VERSION ) {
+		cerr << Path << " is not a file of a capture archive of the version " << CAPTURE_ARCHIVE_VERSION << endl;
+		munmap( Map, Size );
+		return nullptr;
+	}
+	return (const uint8_t *)Map;
+} // MapFile
+
+bool CaptureArchiveReader::Open( const std::string &Path )
+{
+	Close();
+	Data     = MapFile( Path, CAPTURE_ARCHIVE_MAGIC, DataSize );
+	IndexMap = Data ? MapFile( Path + CAPTURE_INDEX_SUFFIX, CAPTURE_INDEX_MAGIC, IndexSize ) : nullptr;
+	if( IndexMap == nullptr ) {
+		Close();
+		return false;
+	}
+	Index   = (const CaptureIndexEntry *)( IndexMap + sizeof(ArchiveFileHeader) );
+	Entries = ( IndexSize - sizeof(ArchiveFileHeader) ) / sizeof(CaptureIndexEntry);
+	return true;
+} // CaptureArchiveReader::Open
+
+void CaptureArchiveReader::Close()
+{
+	if( Data )
+		munmap( (void *)Data, DataSize );
+	if( IndexMap )
+		munmap( (void *)IndexMap, IndexSize );
+	Data     = nullptr;
+	IndexMap = nullptr;
+	Index    = nullptr;
+	Entries  = 0;
+} // CaptureArchiveReader::Close
+
+bool CaptureArchiveReader::Get( size_t i, CaptureView &View ) const
+{
+	if( i >= Entries )
+		return false;
+
+	// Check that the record, its series and their samples lie within the mapped file
+	const uint64_t Offset = Index[i].Offset;
+	const CaptureRecordHeader *Record = (const CaptureRecordHeader *)( Data + Offset );
+	bool Valid = Offset % CAPTURE_ARCHIVE_ALIGN == 0 && Offset + sizeof(CaptureRecordHeader) <= DataSize
+	          && Record->Magic == CAPTURE_RECORD_MAGIC && Record->RecordSize <= DataSize - Offset
+	          && sizeof(CaptureRecordHeader) + uint64_t( Record->SeriesCount ) * sizeof(SeriesHeader) <= Record->RecordSize;
+	View.Record = Data + Offset;
+	for( uint32_t s = 0; Valid && s < Record->SeriesCount; s++ ) {
+		const SeriesHeader &Series = View.Series( s );
+		Valid = Series.Columns > 0 && Series.Offset % CAPTURE_ARCHIVE_ALIGN == 0
+		     && Series.Offset + uint64_t( Series.Rows ) * Series.Columns * sizeof(float) <= Record->RecordSize;
+	}
+	if( !Valid ) {
+		cerr << "the capture " << i << " of the archive is damaged" << endl;
+		View.Record = nullptr;
+	}
+	return Valid;
+} // CaptureArchiveReader::Get
@@ -0,0 +1,229 @@
+/*
+This is the header file of the capture archive of the host tools of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef CAPTUREARCHIVE_H
+#define CAPTUREARCHIVE_H
+
+#include "CaptureFormat.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* The capture archive stores the captures received from the boards in a binary form, which can be memory-mapped.
+ * It consists of two files, to which data are only appended:
+ *   <name>      the data file: ArchiveFileHeader, then the capture records, each starting on CAPTURE_ARCHIVE_ALIGN
+ *   <name>.idx  the index: ArchiveFileHeader, then a CaptureIndexEntry per capture
+ * A capture record is a CaptureRecordHeader, followed by a SeriesHeader per series, followed by the samples of the series.
+ * The samples of a series are an array of float32 volts (Rows x Columns, row by row) starting on CAPTURE_ARCHIVE_ALIGN.
+ * So a reader maps both files and gets to the samples of any capture in O(1), without parsing anything.
+ *
+ * The record is written before its index entry. When the writer is interrupted, the archive is consistent up to the last
+ * index entry; CaptureArchiveWriter::Open() cuts off the incomplete rest.
+ * The numbers are little-endian (the byte order of x86 and ARM hosts). */
+#define CAPTURE_ARCHIVE_MAGIC   0x52414358 // "XCAR"
+#define CAPTURE_INDEX_MAGIC     0x49414358 // "XCAI"
+#define CAPTURE_RECORD_MAGIC    0x50414358 // "XCAP"
+#define CAPTURE_ARCHIVE_VERSION 2         // 2: the board IDs and the aligned records of several boards
+#define CAPTURE_ARCHIVE_ALIGN   64         // Alignment of the records and of the sample arrays (a cache line)
+#define CAPTURE_CHANNELS_SIZE   24         // Size of the channel names of a series incl. the terminating zero
+#define CAPTURE_INDEX_SUFFIX    ".idx"
+
+enum class SampleFormat : uint16_t {
+	Float32 = 1, // Volts as float; the board sends the samples converted to volts
+	Raw16   = 2, // Raw XADC register values (12-bit sample in the bits [15:4]); reserved for a binary transfer of the board
+};
+
+// Header of the data file and of the index file
+struct ArchiveFileHeader {
+	uint32_t Magic;      // CAPTURE_ARCHIVE_MAGIC or CAPTURE_INDEX_MAGIC
+	uint32_t Version;    // CAPTURE_ARCHIVE_VERSION
+	uint32_t HeaderSize; // sizeof(ArchiveFileHeader); the index entries start here, the records start on CAPTURE_ARCHIVE_ALIGN
+	uint32_t Reserved;
+};
+
+#define CAPTURE_FLAG_INFO    0x0001 // The capture started with the header line; the fields from CaptureInfo are valid
+#define CAPTURE_FLAG_ALIGNED 0x0002 // The record joins the captures of several boards triggered at the same time
+
+// Header of a capture record
+struct CaptureRecordHeader {
+	uint32_t Magic;         // CAPTURE_RECORD_MAGIC
+	uint32_t SeriesCount;   // Number of the SeriesHeader structures following this header
+	uint64_t RecordSize;    // Size of the record incl. the headers, the samples and the padding
+	uint64_t ReceiveTime;   // When the receiver accepted the connection, in ns since the Unix epoch
+	                        // (an aligned record: the estimated start of the captures on the clock of the receiver)
+	uint64_t BoardTime;     // CaptureInfo::Time; start of the capture in ns since the start of the board (0 in an aligned record)
+	uint32_t CaptureNumber; // CaptureInfo::Number (an aligned record: the number of the group since the receiver started)
+	uint16_t Flags;         // CAPTURE_FLAG_*
+	uint16_t Averaging;     // CaptureInfo::Averaging
+	uint16_t AdcClkDivisor; // CaptureInfo::AdcClkDivisor
+	uint16_t OffsetCoeff;   // CaptureInfo::OffsetCoeff
+	uint16_t GainCoeff;     // CaptureInfo::GainCoeff
+	uint16_t Format;        // SampleFormat of the samples
+	uint32_t InvalidLines;  // Number of the received lines, which couldn't be parsed
+	uint32_t Board;         // CaptureInfo::Board (0 in an aligned record; the series tell their boards)
+	uint32_t BoardCount;    // Number of the boards whose captures the record holds
+	uint32_t MissingSamples; // Number of the samples the board didn't send as values (the gap and summary lines)
+};
+
+#define SERIES_FLAG_HEADER_LINE 0x0001 // The series started with the line "# <channels> <count>" (sequencer and simultaneous modes)
+
+// Header of a series of samples of a capture
+struct SeriesHeader {
+	char     Channels[ CAPTURE_CHANNELS_SIZE ]; // Channel names separated by ',' (e.g., "VAUX[1]" or "VAUX[1],VAUX[9]")
+	uint16_t Columns;       // Number of the samples per row: 1, or 2 for the pairs of the simultaneous mode
+	uint16_t Flags;         // SERIES_FLAG_*
+	uint32_t Rows;          // Number of the rows
+	uint64_t Offset;        // Offset of the samples from the start of the record
+	uint32_t Board;         // ID of the board which captured the series
+	int32_t  StartOffset;   // Start of the capture of the series relative to ReceiveTime of an aligned record [ns]; 0 otherwise
+	uint16_t OffsetCoeff;   // Calibration coefficients of the board (see CaptureInfo)
+	uint16_t GainCoeff;
+	uint32_t CaptureNumber; // CaptureInfo::Number and CaptureInfo::Time of the capture of the board
+	uint64_t BoardTime;
+};
+
+// Entry of the index file
+struct CaptureIndexEntry {
+	uint64_t Offset;      // Offset of the record in the data file
+	uint64_t ReceiveTime; // CaptureRecordHeader::ReceiveTime, so the index alone can be searched by time
+};
+
+static_assert( sizeof(ArchiveFileHeader) == 16, "the layout of the archive must not depend on the compiler" );
+static_assert( sizeof(CaptureRecordHeader) == 64, "the layout of the archive must not depend on the compiler" );
+static_assert( sizeof(SeriesHeader) == 64, "the layout of the archive must not depend on the compiler" );
+static_assert( sizeof(CaptureIndexEntry) == 16, "the layout of the archive must not depend on the compiler" );
+
+// A series of a capture in memory
+struct CaptureSeries {
+	std::string        Channels;           // Channel names separated by ','
+	uint16_t           Columns    = 1;     // Number of the samples per row
+	bool               HeaderLine = false; // The series started with the line "# <channels> <count>"
+	std::vector<float> Samples;            // Rows x Columns samples, row by row
+	uint32_t           Board         = 0;  // In an aligned capture: the board, the start of its capture, its calibration
+	int32_t            StartOffset   = 0;  // coefficients, and the number and time of its capture; otherwise they are taken
+	uint16_t           OffsetCoeff   = 0;  // from Capture::Info
+	uint16_t           GainCoeff     = 0;
+	uint32_t           CaptureNumber = 0;
+	uint64_t           BoardTime     = 0;
+};
+
+// A capture in memory, as parsed from the text sent by the board
+struct Capture {
+	bool        HasInfo = false;  // The capture started with the header line
+	bool        Aligned = false;  // The capture joins the captures of several boards (see CaptureAligner.h)
+	uint32_t    BoardCount   = 1;
+	CaptureInfo Info;
+	uint64_t    ReceiveTime  = 0; // In ns since the Unix epoch (an aligned capture: the estimated start on the receiver clock)
+	uint32_t    InvalidLines = 0;
+	uint32_t    MissingSamples = 0; // Samples the board didn't send as values (see CAPTURE_GAP_PREFIX and CAPTURE_SUMMARY_PREFIX)
+	std::vector<CaptureSeries> Series;
+};
+
+/* Parser of the text of a capture (see WriteSamples() in main.cpp and CaptureFormat.h). The text can be fed in pieces
+ * of any size as it comes from the network. The series of the sequencer and simultaneous modes repeated in each chunk
+ * of the large-capture mode are joined into one series per channel. */
+class CaptureTextParser {
+public:
+	explicit CaptureTextParser( uint64_t ReceiveTime ) { Result.ReceiveTime = ReceiveTime; }
+
+	void Feed( const char *Data, size_t Size );
+
+	// Parse the rest of the text (a last line without the line end) and get the capture
+	Capture &Finish();
+
+	// Tell whether the first byte of a stream can start the text of a capture (e.g., not the binary event trace)
+	static bool IsCaptureText( char First );
+
+private:
+	void ParseLine( const char *Begin, const char *End );
+
+	std::string    Partial; // Start of a line, whose end didn't come yet
+	CaptureSeries *Current = nullptr;
+	Capture        Result;
+}; // CaptureTextParser
+
+// Writer appending the captures to an archive. The methods print the errors to cerr.
+class CaptureArchiveWriter {
+public:
+	~CaptureArchiveWriter() { Close(); }
+
+	/* Open the archive at the Path (the index is Path + CAPTURE_INDEX_SUFFIX) for appending. A new archive is created when
+	 * it doesn't exist. Returns false on an error. */
+	bool Open( const std::string &Path );
+	void Close();
+
+	// Append the capture. Returns false on an error.
+	bool Append( const Capture &C );
+
+	uint64_t Count() const { return Entries; } // Number of the captures in the archive
+
+private:
+	int      DataFile  = -1;
+	int      IndexFile = -1;
+	uint64_t DataSize  = 0; // The next record is written here
+	uint64_t Entries   = 0;
+}; // CaptureArchiveWriter
+
+// A capture record in the memory-mapped archive
+class CaptureView {
+public:
+	const CaptureRecordHeader &Header() const { return *(const CaptureRecordHeader *)Record; }
+	const SeriesHeader &Series( uint32_t s ) const { return ((const SeriesHeader *)( Record + sizeof(CaptureRecordHeader) ))[s]; }
+	const float *Samples( uint32_t s ) const { return (const float *)( Record + Series( s ).Offset ); } // Rows x Columns floats
+	uint32_t SeriesCount() const { return Header().SeriesCount; }
+	CaptureInfo Info() const; // The fields of the header line; Channel is the channel of the single series, if any
+
+private:
+	friend class CaptureArchiveReader;
+	const uint8_t *Record = nullptr;
+}; // CaptureView
+
+// Reader of an archive. It maps the files read-only; the captures appended after Open() are not visible.
+class CaptureArchiveReader {
+public:
+	~CaptureArchiveReader() { Close(); }
+
+	bool Open( const std::string &Path ); // Returns false on an error (which is printed)
+	void Close();
+
+	size_t Count() const { return Entries; }
+	uint64_t ReceiveTime( size_t i ) const { return Index[i].ReceiveTime; }
+
+	// Get the capture i in O(1). Returns false (and prints the error) when the record is damaged.
+	bool Get( size_t i, CaptureView &View ) const;
+
+private:
+	const uint8_t           *Data      = nullptr;
+	size_t                   DataSize  = 0;
+	const uint8_t           *IndexMap  = nullptr;
+	size_t                   IndexSize = 0;
+	const CaptureIndexEntry *Index     = nullptr; // The entries in IndexMap
+	size_t                   Entries   = 0;
+}; // CaptureArchiveReader
+
+#endif // CAPTUREARCHIVE_H
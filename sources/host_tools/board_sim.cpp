@@ -0,0 +1,464 @@
+/*
+This is the source file of board_sim, the simulation of the XADC tutorial board running on Linux.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* board_sim runs the command server of the firmware (CommandServer.cpp) with a simulated board behind it.
+ * A capture waits as long as the XADC would need for the samples and sends a synthetic signal (a 1 kHz sine
+ * on VAUX[1], a 100 Hz sine on VP/VN) to the data server in the format of the single channel mode.
+ * It allows testing of the host tools and of the protocol without a board; see README.md for the build command.
+ *
+ * Usage: board_sim [-p <command port>] [-s <data server IP>] [-d <data server port>] [-b <board ID>] [-S <spool file>]
+ *                  [-T <clock sync interval ms>]
+ * Without -s, the samples are generated, but not sent anywhere. The board ID (1 by default) is sent in the capture header.
+ * With -S, a capture, which can't be sent because the data server is unreachable, is kept in the spool mapped from
+ * the file (see CaptureSpool.h) and replayed by a separate thread when the server is reachable again. The file keeps
+ * the captures not replayed yet till the next run.
+ * With -T, each capture ends with the timing line (like the firmware with CAPTURE_TIMING 1, see CaptureFormat.h), and
+ * the offset of the clock of the data server is measured by the clock exchange (see ClockSync.h) at most this often.
+ * When built with -DLATENCY_PROBES=1, the latency of the stages of the captures is printed after a triggered capture
+ * and when the continuous mode stops. When built with -DEVENT_TRACE=1, the event trace (see EventTrace.h) is sent
+ * to the data server when the continuous mode stops; trace2json converts it. */
+#include "CommandServer.h"
+#include "FileViaSocket.h"
+#include "LatencyProbes.h"
+#include "EventTrace.h"
+#include "CaptureFormat.h"
+#include "CaptureSpool.h"
+#include "ClockSync.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define SIM_MAX_SAMPLE_COUNT 0x01FFFFFF // The same limit as in the large-capture mode of the firmware
+#define SIM_XADC_CLOCK_HZ    104e6      // XADC input clock of the HW design
+#define SIM_ADCCLKS_PER_SAMPLE 26       // A conversion takes 26 ADCCLK cycles in the continuous sampling mode
+#define SIM_SPOOL_SIZE       ( 64*1024*1024 ) // Size of the spool file
+#define SIM_SPOOL_RETRY_MS   1000       // While the server is unreachable, the replay is tried this often
+
+class SimulatedBoard : public CommandHandler {
+public:
+	SimulatedBoard( const std::string &ServerAddr, unsigned short ServerPort, uint32_t BoardId, uint32_t ClockSyncMs )
+		: ServerAddr( ServerAddr ), ServerPort( ServerPort ), BoardId( BoardId ), ClockSyncMs( ClockSyncMs ) {}
+	~SimulatedBoard() override;
+
+	void Execute( const CommandRequest &Request, Timestamp Received, CommandResponse &Response ) override;
+
+	// Keep the captures, which can't be sent, in the spool mapped from the file at the Path. Returns false on an error.
+	bool OpenSpool( const std::string &Path );
+
+private:
+	bool Capture( Timestamp Received, bool RecordLatency ); // Returns false when the data couldn't be sent
+	void StopContinuous();
+	void SendTrace();
+	void FillStatus( CommandResponse &Response );
+	void ReplaySpool(); // Runs in ReplayThread
+	void SyncServerClock();
+
+	const std::string    ServerAddr; // Empty when the data are not sent
+	const unsigned short ServerPort;
+	const uint32_t       BoardId;
+	const uint32_t       ClockSyncMs; // 0 when the captures have no timing line
+
+	ClockProbe ServerClock;          // Used by Capture() only, i.e., guarded by the Mutex
+	Timestamp  ServerClockTried = 0; // The last clock exchange, whether it succeeded or not
+
+	std::mutex Mutex; // Guards the settings and the statistics below; held during a capture
+	bool       Vpvn          = false;
+	uint32_t   SampleCount   = 1000;
+	uint16_t   Averaging     = 0;
+	uint8_t    AdcClkDivisor = 4;
+	uint32_t   CaptureCount  = 0;
+	uint32_t   LastLatencyNs = 0, MinLatencyNs = 0, MaxLatencyNs = 0;
+	uint32_t   LatencyCount  = 0;
+
+	std::atomic<bool> Continuous{ false };
+	std::thread       ContinuousThread;
+
+	// The spool is used by Capture() and ReplaySpool(), so it's guarded by SpoolMutex (the firmware needs no lock,
+	// sender_thread does both). The mutex isn't held while a capture is being replayed.
+	CaptureSpool      Spool;
+	bool              Spooling = false; // OpenSpool() succeeded
+	std::mutex        SpoolMutex;
+	std::atomic<bool> Replaying{ false };
+	std::thread       ReplayThread;
+}; // SimulatedBoard
+
+SimulatedBoard::~SimulatedBoard()
+{
+	StopContinuous();
+	Replaying = false;
+	if( ReplayThread.joinable() )
+		ReplayThread.join();
+} // SimulatedBoard::~SimulatedBoard
+
+bool SimulatedBoard::OpenSpool( const std::string &Path )
+{
+	if( !Spool.MapFile( Path, SIM_SPOOL_SIZE ) )
+		return false;
+	Spooling  = true;
+	Replaying = true;
+	ReplayThread = std::thread( &SimulatedBoard::ReplaySpool, this );
+	const uint32_t Recovered = Spool.GetStatistics().Recovered;
+	if( Recovered > 0 )
+		cout << Recovered << " capture(s) spooled by the previous run will be replayed" << endl;
+	return true;
+} // SimulatedBoard::OpenSpool
+
+/* Send the spooled captures to the data server, the oldest first. A record is copied out of the spool, so that
+ * Capture() can store new captures while it's being sent; when the copied record was dropped from the spool meanwhile,
+ * Remove() ignores it. */
+void SimulatedBoard::ReplaySpool()
+{
+	TRACE_TASK_START( "replay" );
+	while( Replaying ) {
+		std::string Text;
+		uint32_t    Sequence = 0;
+		{
+			std::lock_guard<std::mutex> Lock( SpoolMutex );
+			CaptureSpool::Record Record;
+			if( Spool.Peek( Record ) ) {
+				Text.assign( (const char *)Record.Data, Record.Size );
+				Sequence = Record.Sequence;
+			}
+		}
+		if( Text.empty() ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+			continue;
+		}
+
+		const Timestamp Start = TimestampNow();
+		bool Sent = false;
+		try {
+			FileViaSocket f( ServerAddr, ServerPort );
+			f.write( Text.data(), Text.size() );
+			f.flush();
+			Sent = bool(f);
+		}
+		catch( const std::exception& ) {
+			// The server is still unreachable; the capture stays in the spool
+		}
+		if( !Sent ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( SIM_SPOOL_RETRY_MS ) );
+			continue;
+		}
+
+		std::lock_guard<std::mutex> Lock( SpoolMutex );
+		Spool.Remove( Sequence, TimestampNow() - Start );
+		if( Spool.Empty() ) {
+			const CaptureSpool::Statistics Stats = Spool.GetStatistics();
+			const double Seconds = TimestampToNs( Stats.ReplayTime ) / 1e9;
+			cout << "spool replayed: " << Stats.Replayed << " capture(s), " << Stats.ReplayedBytes << " bytes in "
+			     << std::fixed << std::setprecision(1) << Seconds * 1e3 << " ms (" << ( Seconds > 0 ? Stats.ReplayedBytes / Seconds / 1e6 : 0.0 )
+			     << " MB/s), high water: " << Stats.HighWater << " bytes, overwritten: " << Stats.Overwritten << endl
+			     << std::defaultfloat;
+		}
+	}
+	TRACE_EVENT( TaskStop, 0 );
+} // SimulatedBoard::ReplaySpool
+
+// Measure the offset of the clock of the data server, when the last exchange is older than ClockSyncMs (like the firmware)
+void SimulatedBoard::SyncServerClock()
+{
+	if( !ServerClock.IsOpen() ) {
+		int Error = ServerClock.Open( ServerAddr.c_str(), ServerPort );
+		if( Error != 0 ) {
+			cerr << "ClockProbe::Open failed! errno == " << Error << " (" << strerror( Error ) << ")" << endl;
+			return;
+		}
+	}
+	const Timestamp Now = TimestampNow();
+	if( ServerClockTried != 0 && Now - ServerClockTried < ClockSyncMs * TIMESTAMP_TICKS_PER_SECOND / 1000 )
+		return;
+	const bool First = ServerClockTried == 0;
+	ServerClockTried = Now;
+	const bool Synced = ServerClock.Measure( 4, 20 ); // CLOCK_SYNC_PROBES and CLOCK_SYNC_TIMEOUT_MS of the firmware
+	if( First )
+		cout << ( Synced ? "clock of the data server synchronized" : "the data server doesn't answer the clock exchange" ) << endl;
+} // SimulatedBoard::SyncServerClock
+
+bool SimulatedBoard::Capture( Timestamp Received, bool RecordLatency )
+{
+	// The capture starts right away; the firmware additionally waits up to 1 ms for XADC_thread to wake up
+	Timestamp DmaStart = TimestampNow();
+	LATENCY_PROBE_START( Trigger );
+	TRACE_EVENT( CaptureBegin, uint16_t(CaptureCount) );
+	if( RecordLatency ) {
+		uint64_t Ns = TimestampToNs( DmaStart - Received );
+		LastLatencyNs = Ns > 0xFFFFFFFF ? 0xFFFFFFFF : uint32_t(Ns);
+		if( LatencyCount == 0 || LastLatencyNs < MinLatencyNs )
+			MinLatencyNs = LastLatencyNs;
+		if( LatencyCount == 0 || LastLatencyNs > MaxLatencyNs )
+			MaxLatencyNs = LastLatencyNs;
+		LatencyCount++;
+	}
+
+	// The "DMA transfer" takes as long as the XADC needs for the samples (with averaging, an output needs more conversions)
+	const double SampleRate = SIM_XADC_CLOCK_HZ / AdcClkDivisor / SIM_ADCCLKS_PER_SAMPLE / ( Averaging ? Averaging : 1 );
+	TRACE_EVENT( DmaStart, TraceSize( SampleCount * 4 ) );
+	std::this_thread::sleep_until( std::chrono::steady_clock::now() + std::chrono::duration<double>( SampleCount / SampleRate ) );
+	CaptureCount++;
+	const Timestamp DmaDone = TimestampNow();
+	LATENCY_PROBE_RECORD( DmaCompletion, DmaDone - DmaStart );
+	TRACE_EVENT( DmaDone, TraceSize( SampleCount * 4 ) );
+
+	cout << "capture " << CaptureCount << ": " << SampleCount << " samples of " << ( Vpvn ? "VP/VN" : "VAUX[1]" ) << endl;
+	if( ServerAddr.empty() ) {
+		TRACE_EVENT( CaptureEnd, 0 );
+		return true;
+	}
+
+	auto WriteCapture = [&]( std::ostream &f ) {
+		f << std::setprecision(7);
+		CaptureInfo Info; // Like the firmware with CAPTURE_HEADER 1; the simulation has no calibration coefficients
+		Info.Board         = BoardId;
+		Info.Number        = CaptureCount;
+		Info.Averaging     = Averaging;
+		Info.AdcClkDivisor = AdcClkDivisor;
+		Info.Time          = TimestampToNs( DmaStart );
+		Info.Channel       = Vpvn ? "VP/VN" : "VAUX[1]";
+		WriteCaptureHeader( f, Info );
+		for( uint32_t i = 0; i < SampleCount; i++ ) {
+			double t = i / SampleRate;
+			f << ( Vpvn ? 0.25 * sin( 2 * M_PI * 100 * t ) : 1.65 + 1.0 * sin( 2 * M_PI * 1000 * t ) ) << '\n';
+		}
+	};
+
+	try {
+		FileViaSocket f( ServerAddr, ServerPort );
+		LATENCY_PROBE_START( Format );
+		WriteCapture( f );
+		f.flush();
+		LATENCY_PROBE_LAP( Formatting, Format );
+		if( ClockSyncMs != 0 && f ) {
+			CaptureTiming Timing;
+			Timing.Number    = CaptureCount;
+			Timing.Samples   = SampleCount;
+			Timing.Averaging = Averaging;
+			Timing.Trigger   = TimestampToNs( RecordLatency ? Received : DmaStart ); // The continuous mode has no trigger
+			Timing.DmaDone   = TimestampToNs( DmaDone );
+			Timing.FirstSend = TimestampToNs( f.sink().firstSendTime() );
+			Timing.LastSend  = TimestampToNs( f.sink().lastSendTime() );
+			SyncServerClock();
+			const ClockOffset &Clock = ServerClock.Offset();
+			Timing.Synced      = Clock.Valid;
+			Timing.ClockOffset = Clock.Offset;
+			Timing.ClockRtt    = Clock.Rtt;
+			WriteCaptureTiming( f, Timing );
+			f.flush();
+		}
+		LATENCY_PROBE_LAP( Capture, Trigger );
+		TRACE_EVENT( CaptureEnd, f ? 1 : 0 );
+		return bool(f);
+	}
+	catch( const std::exception& e ) {
+		cerr << "Error on opening the socket:\n" << e.what() << endl;
+		TRACE_EVENT( CaptureEnd, 0 );
+	}
+	if( !Spooling )
+		return false;
+
+	// The simulation spools the formatted text (the firmware spools the DMA words and formats them at the replay)
+	std::ostringstream Text;
+	WriteCapture( Text );
+	const std::string Record = Text.str();
+	std::lock_guard<std::mutex> Lock( SpoolMutex );
+	if( !Spool.Store( Record.data(), uint32_t( Record.size() ) ) ) {
+		cerr << "capture " << CaptureCount << " is larger than the spool, it's lost" << endl;
+		return false;
+	}
+	cout << "capture " << CaptureCount << " kept in the spool, " << Spool.GetStatistics().Records << " capture(s) to replay" << endl;
+	return false;
+} // SimulatedBoard::Capture
+
+void SimulatedBoard::StopContinuous()
+{
+	Continuous = false;
+	if( ContinuousThread.joinable() )
+		ContinuousThread.join(); // Wait for the capture in progress
+} // SimulatedBoard::StopContinuous
+
+// Send the event trace to the data server, like the console command trace of the firmware
+void SimulatedBoard::SendTrace()
+{
+	if( ServerAddr.empty() )
+		return;
+	try {
+		FileViaSocket f( ServerAddr, ServerPort );
+		uint32_t Count = TraceDump( f );
+		cout << Count << " trace events " << ( f ? "sent" : "failed to send!" ) << endl;
+	}
+	catch( const std::exception& e ) {
+		cerr << "Error on opening the socket:\n" << e.what() << endl;
+	}
+} // SimulatedBoard::SendTrace
+
+void SimulatedBoard::FillStatus( CommandResponse &Response )
+{
+	Response.State         = Continuous ? BoardState::Continuous : BoardState::Idle;
+	Response.Channel       = Vpvn ? 1 : 0;
+	Response.AdcClkDivisor = AdcClkDivisor;
+	Response.SampleCount   = SampleCount;
+	Response.Averaging     = Averaging;
+	Response.CaptureCount  = CaptureCount;
+	Response.DroppedCaptures = 0; // The simulation waits for the data server, like OVERLOAD_BLOCK
+	Response.LastLatencyNs = LastLatencyNs;
+	Response.MinLatencyNs  = MinLatencyNs;
+	Response.MaxLatencyNs  = MaxLatencyNs;
+} // SimulatedBoard::FillStatus
+
+void SimulatedBoard::Execute( const CommandRequest &Request, Timestamp Received, CommandResponse &Response )
+{
+	if( Request.Command == CommandCode::StopContinuous && Continuous ) {
+		StopContinuous(); // Must not hold the Mutex, the continuous thread needs it to finish the capture
+#if LATENCY_PROBES
+		LatencyDump( cout );
+#endif
+#if EVENT_TRACE
+		SendTrace();
+#endif
+	}
+
+	std::lock_guard<std::mutex> Lock( Mutex );
+	Response.Result = CommandResult::Ok;
+	TRACE_EVENT( CommandBegin, uint16_t(Request.Command) );
+
+	switch( Request.Command ) {
+		case CommandCode::Status:
+		case CommandCode::StopContinuous:
+			break;
+		case CommandCode::Trigger:
+			if( Continuous )
+				Response.Result = CommandResult::Busy;
+			else if( !Capture( Received, true ) )
+				Response.Result = CommandResult::Failed;
+#if LATENCY_PROBES
+			LatencyDump( cout );
+#endif
+			break;
+		case CommandCode::SelectChannel:
+			if( Request.Argument > 1 )
+				Response.Result = CommandResult::BadArgument;
+			else if( Continuous )
+				Response.Result = CommandResult::Busy;
+			else
+				Vpvn = Request.Argument == 1;
+			break;
+		case CommandCode::SetSampleCount:
+			if( Request.Argument == 0 || Request.Argument > SIM_MAX_SAMPLE_COUNT )
+				Response.Result = CommandResult::BadArgument;
+			else
+				SampleCount = Request.Argument;
+			break;
+		case CommandCode::SetAveraging:
+			if( Request.Argument != 0 && Request.Argument != 16 && Request.Argument != 64 && Request.Argument != 256 )
+				Response.Result = CommandResult::BadArgument;
+			else
+				Averaging = uint16_t( Request.Argument );
+			break;
+		case CommandCode::StartContinuous:
+			if( !Continuous ) {
+				Continuous = true;
+				ContinuousThread = std::thread( [this, Received] {
+					TRACE_TASK_START( "continuous" );
+					bool First = true; // The latency of the first capture is recorded
+					while( Continuous ) {
+						std::lock_guard<std::mutex> Lock( Mutex );
+						Capture( Received, First );
+						First = false;
+					}
+					TRACE_EVENT( TaskStop, 0 );
+				} );
+			}
+			break;
+		default:
+			Response.Result = CommandResult::BadCommand;
+	}
+
+	FillStatus( Response );
+	TRACE_EVENT( CommandEnd, uint16_t(Response.Result) );
+} // SimulatedBoard::Execute
+
+int main( int argc, char *argv[] )
+{
+	unsigned short CommandPort = COMMAND_SERVER_DEFAULT_PORT;
+	std::string    ServerAddr;
+	unsigned short ServerPort = 65432;
+	uint32_t       BoardId    = 1;
+	std::string    SpoolPath;
+	uint32_t       ClockSyncMs = 0;
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc ) {
+			cerr << "usage: board_sim [-p <command port>] [-s <data server IP>] [-d <data server port>] [-b <board ID>] [-S <spool file>]"
+			        " [-T <clock sync interval ms>]" << endl;
+			return 2;
+		}
+		if( strcmp( argv[a], "-p" ) == 0 )
+			CommandPort = (unsigned short)strtoul( argv[a+1], nullptr, 10 );
+		else if( strcmp( argv[a], "-s" ) == 0 )
+			ServerAddr = argv[a+1];
+		else if( strcmp( argv[a], "-d" ) == 0 )
+			ServerPort = (unsigned short)strtoul( argv[a+1], nullptr, 10 );
+		else if( strcmp( argv[a], "-b" ) == 0 )
+			BoardId = uint32_t( strtoul( argv[a+1], nullptr, 10 ) );
+		else if( strcmp( argv[a], "-S" ) == 0 )
+			SpoolPath = argv[a+1];
+		else if( strcmp( argv[a], "-T" ) == 0 )
+			ClockSyncMs = uint32_t( strtoul( argv[a+1], nullptr, 10 ) );
+	}
+
+	TRACE_TASK_START( "cmd_server" );
+	SimulatedBoard Board( ServerAddr, ServerPort, BoardId, ClockSyncMs );
+	if( !SpoolPath.empty() && !ServerAddr.empty() && !Board.OpenSpool( SpoolPath ) ) {
+		cerr << "CaptureSpool::MapFile failed! (" << SpoolPath << ") terminating" << endl;
+		return 1;
+	}
+	CommandServer Server;
+	int Error = Server.Open( CommandPort );
+	if( Error != 0 ) {
+		cerr << "CommandServer::Open failed! errno == " << Error << " (" << strerror( Error ) << ")" << endl;
+		return 1;
+	}
+	cout << "simulated board: command server listens on the port " << CommandPort;
+	if( !ServerAddr.empty() )
+		cout << ", data are sent to " << ServerAddr << ':' << ServerPort;
+	cout << endl;
+
+	Error = Server.Run( Board );
+	cerr << "CommandServer::Run failed! errno == " << Error << " (" << strerror( Error ) << ")" << endl;
+	return 1;
+} // main
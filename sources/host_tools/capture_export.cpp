@@ -0,0 +1,195 @@
+/*
+This is the source file of capture_export, the tool listing and exporting the captures of the capture archive.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool lists the captures of a capture archive (written by via_socket_server -a, see CaptureArchive.h), or it exports
+ * them to text files in the format sent by the board, for the tools reading the files of file_via_socket.py.
+ * It runs on Linux; see README.md for the build command.
+ *
+ * Usage: capture_export [-o <folder>] <archive> [<first>[-<last>]]
+ *   Without -o, the captures are listed. With -o, each capture is written to the file via_socket_YYMMDD_HHMMSS.ffff.txt
+ *   named by the time it was received. The range selects the captures by their index in the archive (all by default).
+ *   An aligned record of several boards (via_socket_server -g) is written to a file per board, named
+ *   via_socket_YYMMDD_HHMMSS.ffff_b<board>.txt, with the text the board sent. */
+#include "CaptureArchive.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static void Usage()
+{
+	cerr << "usage: capture_export [-o <folder>] <archive> [<first>[-<last>]]" << endl;
+	exit( 2 );
+} // Usage
+
+// Format the real time in ns since the Unix epoch as the local time YYMMDD_HHMMSS.ffff used in the names of the files
+static std::string FormatTime( uint64_t Time )
+{
+	const time_t Seconds = time_t( Time / 1000000000ULL );
+	struct tm Local;
+	localtime_r( &Seconds, &Local );
+	char Text[ 32 ];
+	size_t Length = strftime( Text, sizeof(Text), "%y%m%d_%H%M%S", &Local );
+	snprintf( Text + Length, sizeof(Text) - Length, ".%04u", unsigned( Time % 1000000000ULL / 100000 ) );
+	return Text;
+} // FormatTime
+
+// Print a line describing the capture i
+static void ListCapture( size_t i, const CaptureView &View )
+{
+	const CaptureRecordHeader &H = View.Header();
+	cout << std::setw(6) << i << "  " << FormatTime( H.ReceiveTime );
+	if( H.Flags & CAPTURE_FLAG_ALIGNED )
+		cout << "  group " << H.CaptureNumber << " of " << H.BoardCount << " boards, avg " << H.Averaging << ", div " << H.AdcClkDivisor;
+	else if( H.Flags & CAPTURE_FLAG_INFO )
+		cout << ( H.Board ? "  board " + std::to_string( H.Board ) + "," : "" ) << "  capture " << H.CaptureNumber << " at "
+		     << std::fixed << std::setprecision(6) << H.BoardTime / 1e9 << " s, avg " << H.Averaging << ", div " << H.AdcClkDivisor;
+	for( uint32_t s = 0; s < View.SeriesCount(); s++ ) {
+		const SeriesHeader &Series = View.Series(s);
+		cout << ( s ? ", " : "  " );
+		if( H.Flags & CAPTURE_FLAG_ALIGNED ) // The board and the start of its capture relative to the earliest one
+			cout << 'B' << Series.Board << " +" << std::fixed << std::setprecision(1) << Series.StartOffset / 1e3 << " us ";
+		cout << ( Series.Channels[0] ? Series.Channels : "?" ) << ": " << Series.Rows;
+	}
+	if( H.InvalidLines )
+		cout << "  (" << H.InvalidLines << " invalid lines)";
+	if( H.MissingSamples )
+		cout << "  (" << H.MissingSamples << " samples dropped by the board)";
+	cout << '\n';
+} // ListCapture
+
+/* Write the capture in the text format sent by the board (see WriteSamples() in main.cpp). When Board isn't 0, only the
+ * series of the Board are written, with the header line of its capture. Returns false on an error. */
+static bool ExportCapture( const CaptureView &View, uint32_t Board, const std::string &Path )
+{
+	std::ofstream f( Path );
+	if( !f ) {
+		cerr << "can't create the file " << Path << endl;
+		return false;
+	}
+	f << std::setprecision(7); // The same precision as the board uses
+	std::vector<uint32_t> Selected; // The series to be written
+	for( uint32_t s = 0; s < View.SeriesCount(); s++ )
+		if( Board == 0 || View.Series(s).Board == Board )
+			Selected.push_back( s );
+
+	if( Board != 0 && !Selected.empty() ) { // The capture of the board from an aligned record
+		const SeriesHeader &First = View.Series( Selected[0] );
+		CaptureInfo Info = View.Info();
+		Info.Board       = Board;
+		Info.Number      = First.CaptureNumber;
+		Info.Time        = First.BoardTime;
+		Info.OffsetCoeff = First.OffsetCoeff;
+		Info.GainCoeff   = First.GainCoeff;
+		if( Selected.size() == 1 && !( First.Flags & SERIES_FLAG_HEADER_LINE ) )
+			Info.Channel = First.Channels;
+		WriteCaptureHeader( f, Info );
+	}
+	else if( View.Header().Flags & CAPTURE_FLAG_INFO )
+		WriteCaptureHeader( f, View.Info() );
+
+	for( uint32_t s : Selected ) {
+		const SeriesHeader &Series = View.Series(s);
+		const float *Samples = View.Samples(s);
+		if( Series.Flags & SERIES_FLAG_HEADER_LINE )
+			f << "# " << Series.Channels << ' ' << Series.Rows << '\n';
+		for( uint32_t r = 0; r < Series.Rows; r++ ) {
+			for( uint16_t c = 0; c < Series.Columns; c++ )
+				f << ( c ? "," : "" ) << Samples[ r * Series.Columns + c ];
+			f << '\n';
+		}
+	}
+	return bool( f.flush() );
+} // ExportCapture
+
+int main( int argc, char *argv[] )
+{
+	std::string Folder;
+	bool        Export = false;
+
+	int a = 1;
+	if( a + 1 < argc && strcmp( argv[a], "-o" ) == 0 ) {
+		Folder = argv[a+1];
+		Export = true;
+		a += 2;
+	}
+	if( argc - a < 1 || argc - a > 2 )
+		Usage();
+
+	CaptureArchiveReader Archive;
+	if( !Archive.Open( argv[a] ) )
+		return 1;
+
+	size_t First = 0, Last = Archive.Count() ? Archive.Count() - 1 : 0;
+	if( argc - a == 2 ) {
+		char *End;
+		First = Last = strtoul( argv[a+1], &End, 10 );
+		if( *End == '-' )
+			Last = strtoul( End + 1, &End, 10 );
+		if( *End != '\0' || First > Last )
+			Usage();
+	}
+	if( Archive.Count() == 0 || Last >= Archive.Count() ) {
+		cerr << "the archive has " << Archive.Count() << " captures" << endl;
+		return 1;
+	}
+
+	int Errors = 0;
+	for( size_t i = First; i <= Last; i++ ) {
+		CaptureView View;
+		if( !Archive.Get( i, View ) ) {
+			Errors++;
+			continue;
+		}
+		if( !Export ) {
+			ListCapture( i, View );
+			continue;
+		}
+		const std::string Name = Folder + "/via_socket_" + FormatTime( View.Header().ReceiveTime );
+		std::vector<uint32_t> Boards{ 0 }; // 0: the whole record
+		if( View.Header().Flags & CAPTURE_FLAG_ALIGNED ) {
+			Boards.clear();
+			for( uint32_t s = 0; s < View.SeriesCount(); s++ )
+				if( Boards.empty() || Boards.back() != View.Series(s).Board ) // The series are sorted by the board
+					Boards.push_back( View.Series(s).Board );
+		}
+		for( uint32_t Board : Boards ) {
+			std::string Path = Name + ( Board ? "_b" + std::to_string( Board ) : "" ) + ".txt";
+			if( !ExportCapture( View, Board, Path ) )
+				return 1;
+			cout << Path << endl;
+		}
+	}
+	return Errors ? 1 : 0;
+} // main
@@ -0,0 +1,193 @@
+/*
+This is the source file of core_ring_test, the test of the ring passing the captures between the two cores of Zynq-7000.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool tests the rings of the dual-core split (CoreRing.h) with two threads standing for the two cores.
+ * The acquisition thread takes a free buffer from the return ring, fills it with a pattern derived from the number
+ * of the capture (like the DMA would) and pushes its descriptor to the capture ring. The network thread pops
+ * the descriptors, checks their order and the content of the buffers, and hands the buffers back through
+ * the return ring. The threads get the rings by CoreRingsAttach() from the shared memory, like the two programs would.
+ * It runs on Linux; see README.md for the build command.
+ *
+ * Usage: core_ring_test [-n <captures>] [-b <buffers>] [-w <words>]
+ *
+ * The tool prints the rate of the captures and the time from the push of a descriptor till its pop.
+ * It returns 1 when a check failed. Build it with -fsanitize=thread to have the memory ordering checked as well. */
+#include "CoreRing.h"
+#include "Timestamp.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_CAPTURES 1000000
+#define DEFAULT_BUFFERS  4
+#define DEFAULT_WORDS    256 // Size of a buffer in 32-bit words
+#define MAX_WORDS        (1024*1024)
+
+// The memory shared by the threads: the rings and the buffers of the captures
+struct SharedMemory {
+	alignas(SPSC_RING_LINE_SIZE) uint8_t Rings[ sizeof(CoreRings) ]; // Stands for the OCM at CORE_RING_OCM_BASE
+	std::vector<uint32_t> Buffers; // The buffers, one after another
+	unsigned              BufferWords;
+};
+
+// Results of the network thread
+struct ConsumerResult {
+	uint32_t  Received = 0;
+	uint32_t  Errors   = 0;
+	uint64_t  TotalNs  = 0; // Sum of the times from the push till the pop
+	uint64_t  MaxNs    = 0;
+};
+
+static inline uint32_t Pattern( uint32_t Capture, uint32_t Word )
+{
+	return Capture * 2654435761u ^ Word;
+} // Pattern
+
+static void Usage()
+{
+	cerr << "usage: core_ring_test [-n <captures>] [-b <buffers>] [-w <words>]" << endl;
+	exit( 2 );
+} // Usage
+
+// The acquisition core: fill a free buffer and push its descriptor
+static void Acquisition( SharedMemory &Shared, uint32_t Captures )
+{
+	CoreRings *Rings = CoreRingsAttach( Shared.Rings );
+
+	for( uint32_t n = 0; n < Captures; n++ ) {
+		CaptureDescriptor Free;
+		while( !Rings->Returns.Pop( Free ) )
+			std::this_thread::yield();
+
+		uint32_t *Data = Shared.Buffers.data() + size_t( Free.Buffer ) * Shared.BufferWords;
+		for( uint32_t w = 0; w < Shared.BufferWords; w++ )
+			Data[w] = Pattern( n, w );
+
+		CaptureDescriptor Descriptor = {};
+		Descriptor.Bytes    = Shared.BufferWords * sizeof(uint32_t);
+		Descriptor.Number   = n;
+		Descriptor.Buffer   = Free.Buffer;
+		Descriptor.DmaDone  = TimestampNow();
+		while( !Rings->Captures.Push( Descriptor ) )
+			std::this_thread::yield();
+	}
+} // Acquisition
+
+// The network core: check the descriptors and the buffers, and hand the buffers back
+static void Network( SharedMemory &Shared, uint32_t Captures, ConsumerResult &Result )
+{
+	CoreRings *Rings = CoreRingsAttach( Shared.Rings );
+
+	while( Result.Received < Captures ) {
+		CaptureDescriptor Descriptor;
+		if( !Rings->Captures.Pop( Descriptor ) ) {
+			std::this_thread::yield();
+			continue;
+		}
+		const uint64_t Ns = TimestampToNs( TimestampNow() - Descriptor.DmaDone );
+		Result.TotalNs += Ns;
+		if( Ns > Result.MaxNs )
+			Result.MaxNs = Ns;
+
+		bool Ok = Descriptor.Number == Result.Received && Descriptor.Bytes == Shared.BufferWords * sizeof(uint32_t);
+		const uint32_t *Data = Shared.Buffers.data() + size_t( Descriptor.Buffer ) * Shared.BufferWords;
+		for( uint32_t w = 0; Ok && w < Shared.BufferWords; w++ )
+			Ok = Data[w] == Pattern( Descriptor.Number, w );
+		if( !Ok && Result.Errors++ < 10 )
+			cerr << "capture " << Result.Received << ": wrong descriptor or data (number " << Descriptor.Number
+			     << ", buffer " << Descriptor.Buffer << ")" << endl;
+		Result.Received++;
+
+		CaptureDescriptor Free = {};
+		Free.Buffer = Descriptor.Buffer;
+		while( !Rings->Returns.Push( Free ) ) // There's a slot for each buffer
+			std::this_thread::yield();
+	}
+} // Network
+
+int main( int argc, char *argv[] )
+{
+	uint32_t Captures = DEFAULT_CAPTURES;
+	uint32_t Buffers  = DEFAULT_BUFFERS;
+	uint32_t Words    = DEFAULT_WORDS;
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		uint32_t Value = uint32_t( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Captures = Value;
+		else if( strcmp( argv[a], "-b" ) == 0 )
+			Buffers = Value;
+		else if( strcmp( argv[a], "-w" ) == 0 )
+			Words = Value;
+		else
+			Usage();
+	}
+	if( Captures == 0 || Buffers == 0 || Buffers > CORE_RING_SLOTS || Words == 0 || Words > MAX_WORDS )
+		Usage(); // The return ring must hold all the buffers
+
+	static SharedMemory Shared;
+	Shared.Buffers.resize( size_t( Buffers ) * Words );
+	Shared.BufferWords = Words;
+
+	// The network core constructs the rings and gives all the buffers to the acquisition core
+	CoreRings *Rings = CoreRingsInitialize( Shared.Rings );
+	for( uint32_t b = 0; b < Buffers; b++ ) {
+		CaptureDescriptor Free = {};
+		Free.Buffer = b;
+		Rings->Returns.Push( Free );
+	}
+
+	cout << ( CORE_RING_CACHED ? "SpscNonCoherent rings: " : "SpscMultiCore rings: " ) << "passing " << Captures << " captures of " << Words * 4 << " bytes through rings of " << CORE_RING_SLOTS
+	     << " slots with " << Buffers << " buffers" << endl;
+
+	ConsumerResult Result;
+	const Timestamp Start = TimestampNow();
+	std::thread NetworkThread( Network, std::ref( Shared ), Captures, std::ref( Result ) );
+	std::thread AcquisitionThread( Acquisition, std::ref( Shared ), Captures );
+	AcquisitionThread.join();
+	NetworkThread.join();
+	const double Seconds = TimestampToNs( TimestampNow() - Start ) / 1e9;
+
+	cout << std::fixed << std::setprecision(0) << Result.Received / Seconds << " captures/s, "
+	     << std::setprecision(2) << Result.Received * double( Words ) * 4 / Seconds / 1e6 << " MB/s" << endl;
+	cout << "push-to-pop time: avg " << std::setprecision(1) << Result.TotalNs / 1000.0 / Result.Received
+	     << " us, max " << Result.MaxNs / 1000.0 << " us" << endl;
+	if( Rings->Captures.Count() != 0 || Result.Errors != 0 ) {
+		cerr << Result.Errors << " error(s)" << endl;
+		return 1;
+	}
+	cout << "all captures passed in order with the right data" << endl;
+	return 0;
+} // main
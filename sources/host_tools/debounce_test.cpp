@@ -0,0 +1,265 @@
+/*
+This is the source file of debounce_test, the equivalence test and benchmark of the debouncers of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool checks VerticalDebouncer (VerticalDebouncer.h) against the class Debouncer (button_debounce.h), which
+ * the application used originally, and against a simple model debouncing each pin on its own. Then it measures
+ * the time of a call of ButtonProcess() of both classes for 8, 32 and 64 pins.
+ * It runs on Linux; see README.md for the build command.
+ *
+ * Usage: debounce_test [-n <samples>] [-s <seed>]
+ *
+ * The input is a random signal of 64 pins: each pin is pressed and released at random times, and it bounces
+ * for up to 20 samples after each change and in rare single-sample glitches.
+ * The checks are:
+ * - VerticalDebouncer with Symmetric = false gives the same ButtonPressed/ButtonReleased/ButtonCurrent after every
+ *   sample as Debouncer (for uint8_t) and as eight Debouncers fed with the bytes of the port (for uint64_t),
+ * - VerticalDebouncer with Symmetric = true for uint32_t and uint64_t and several depths gives the same as the model.
+ * Debouncer always has NUM_BUTTON_STATES states. Build the tool with e.g. -DNUM_BUTTON_STATES=32 to compare
+ * the classes with a longer debounce. The tool returns 1 when a check failed. */
+#include "button_debounce.h"
+#include "VerticalDebouncer.h"
+#include "Timestamp.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_SAMPLES   1000000
+#define MAX_BOUNCE        20   // Max. samples of bouncing after a change of a pin
+#define CHANGE_ODDS       300  // A pin changes once in this many samples on average
+#define GLITCH_ODDS       1000 // A single-sample glitch of a pin once in this many samples on average
+#define BENCHMARK_ROUNDS  20   // Passes over the signal in each measurement
+#define PULLED_UP         0x00FF00FF00FF00FFULL // Half of the pins read as 1 when not pressed
+
+static void Usage()
+{
+	cerr << "usage: debounce_test [-n <samples>] [-s <seed>]" << endl;
+	exit( 2 );
+} // Usage
+
+// The samples of a bouncy 64-pin port
+static std::vector<uint64_t> MakeSignal( size_t Samples, uint64_t Seed )
+{
+	std::mt19937_64 Rng( Seed );
+	std::vector<uint64_t> Signal( Samples );
+	uint64_t Level = 0;          // 1 = pressed
+	unsigned Bounce[64] = {};    // Remaining samples of bouncing of each pin
+	for( size_t s = 0; s < Samples; s++ ) {
+		uint64_t Sample = Level;
+		for( unsigned Pin = 0; Pin < 64; Pin++ ) {
+			const uint64_t Random = Rng();
+			const uint64_t Bit    = 1ULL << Pin;
+			if( Random % CHANGE_ODDS == 0 ) {
+				Level ^= Bit;
+				Bounce[Pin] = unsigned( Random >> 32 ) % ( MAX_BOUNCE + 1 );
+			}
+			if( Bounce[Pin] ) {
+				Bounce[Pin]--;
+				if( Random >> 63 )
+					Sample ^= Bit;
+			}
+			else if( ( Random >> 16 ) % GLITCH_ODDS == 0 )
+				Sample ^= Bit;
+		}
+		Signal[s] = Sample ^ PULLED_UP; // What the port reads
+	}
+	return Signal;
+} // MakeSignal
+
+// Debounces each pin on its own with a counter, as the description of VerticalDebouncer says
+template<unsigned Depth, bool Symmetric>
+class ReferenceDebouncer {
+public:
+	explicit ReferenceDebouncer( uint64_t PulledUp ) : PullType( PulledUp ) {}
+
+	void ButtonProcess( uint64_t PortStatus )
+	{
+		Changed = 0;
+		for( unsigned Pin = 0; Pin < 64; Pin++ ) {
+			const uint64_t Bit = 1ULL << Pin;
+			if( ( ( PortStatus ^ PullType ) & Bit ) == ( State & Bit ) )
+				Count[Pin] = 0;
+			else if( ( !Symmetric && ( State & Bit ) ) || ++Count[Pin] == Depth ) {
+				Count[Pin] = 0;
+				State   ^= Bit;
+				Changed |= Bit;
+			}
+		}
+	} // ButtonProcess
+
+	uint64_t ButtonPressed( uint64_t Pins ) const  { return Changed & State & Pins; }
+	uint64_t ButtonReleased( uint64_t Pins ) const { return Changed & ~State & Pins; }
+	uint64_t ButtonCurrent( uint64_t Pins ) const  { return State & Pins; }
+
+private:
+	unsigned Count[64] = {};
+	uint64_t State     = 0;
+	uint64_t Changed   = 0;
+	uint64_t PullType;
+}; // ReferenceDebouncer
+
+// Eight Debouncers, one for each byte of a 64-bit port
+class ByteDebouncers {
+public:
+	explicit ByteDebouncers( uint64_t PulledUp )
+		: Lanes{ Debouncer( uint8_t( PulledUp ) ), Debouncer( uint8_t( PulledUp >> 8 ) ),
+		         Debouncer( uint8_t( PulledUp >> 16 ) ), Debouncer( uint8_t( PulledUp >> 24 ) ),
+		         Debouncer( uint8_t( PulledUp >> 32 ) ), Debouncer( uint8_t( PulledUp >> 40 ) ),
+		         Debouncer( uint8_t( PulledUp >> 48 ) ), Debouncer( uint8_t( PulledUp >> 56 ) ) } {}
+
+	void ButtonProcess( uint64_t PortStatus )
+	{
+		for( unsigned i = 0; i < 8; i++ )
+			Lanes[i].ButtonProcess( uint8_t( PortStatus >> 8*i ) );
+	} // ButtonProcess
+
+	uint64_t ButtonPressed( uint64_t Pins )
+	{
+		uint64_t Result = 0;
+		for( unsigned i = 0; i < 8; i++ )
+			Result |= uint64_t( Lanes[i].ButtonPressed( uint8_t( Pins >> 8*i ) ) ) << 8*i;
+		return Result;
+	} // ButtonPressed
+
+	uint64_t ButtonReleased( uint64_t Pins )
+	{
+		uint64_t Result = 0;
+		for( unsigned i = 0; i < 8; i++ )
+			Result |= uint64_t( Lanes[i].ButtonReleased( uint8_t( Pins >> 8*i ) ) ) << 8*i;
+		return Result;
+	} // ButtonReleased
+
+	uint64_t ButtonCurrent( uint64_t Pins )
+	{
+		uint64_t Result = 0;
+		for( unsigned i = 0; i < 8; i++ )
+			Result |= uint64_t( Lanes[i].ButtonCurrent( uint8_t( Pins >> 8*i ) ) ) << 8*i;
+		return Result;
+	} // ButtonCurrent
+
+private:
+	Debouncer Lanes[8];
+}; // ByteDebouncers
+
+/* Feed both debouncers with the signal (the low bits of it for narrower ports) and compare them after each sample.
+ * Returns true when they agree. */
+template<typename Port, typename Tested, typename Expected>
+static bool Compare( const char *Name, Tested &&A, Expected &&B, const std::vector<uint64_t> &Signal )
+{
+	const Port All = Port( ~Port( 0 ) );
+	uint64_t Presses = 0;
+	for( size_t s = 0; s < Signal.size(); s++ ) {
+		A.ButtonProcess( Port( Signal[s] ) );
+		B.ButtonProcess( Port( Signal[s] ) );
+		const uint64_t Pressed = A.ButtonPressed( All );
+		if( Pressed != uint64_t( Port( B.ButtonPressed( All ) ) )
+		    || A.ButtonReleased( All ) != Port( B.ButtonReleased( All ) )
+		    || A.ButtonCurrent( All ) != Port( B.ButtonCurrent( All ) ) ) {
+			cout << std::left << std::setw(48) << Name << "FAILED at sample " << s << std::hex
+			     << ": current 0x" << uint64_t( A.ButtonCurrent( All ) ) << ", expected 0x"
+			     << uint64_t( Port( B.ButtonCurrent( All ) ) ) << std::dec << endl;
+			return false;
+		}
+		Presses += __builtin_popcountll( Pressed );
+	}
+	cout << std::left << std::setw(48) << Name << "OK (" << Presses << " presses)" << endl;
+	return true;
+} // Compare
+
+template<typename Port, unsigned Depth>
+static bool CheckSymmetric( const char *Name, const std::vector<uint64_t> &Signal )
+{
+	return Compare<Port>( Name, VerticalDebouncer<Port, Depth>( Port( PULLED_UP ) ),
+	                      ReferenceDebouncer<Depth, true>( Port( PULLED_UP ) ), Signal );
+} // CheckSymmetric
+
+// Print the time of a call of ButtonProcess() of the debouncer
+template<typename Port, typename Debouncer>
+static void Benchmark( const char *Name, unsigned Pins, Debouncer &&D, const std::vector<uint64_t> &Signal )
+{
+	uint64_t Sink = 0; // Keeps the compiler from removing the calls
+	const Timestamp Start = TimestampNow();
+	for( unsigned Round = 0; Round < BENCHMARK_ROUNDS; Round++ )
+		for( uint64_t Sample : Signal ) {
+			D.ButtonProcess( Port( Sample ) );
+			Sink += D.ButtonPressed( Port( ~Port( 0 ) ) );
+		}
+	const double Ns = double( TimestampToNs( TimestampNow() - Start ) ) / ( double( Signal.size() ) * BENCHMARK_ROUNDS );
+	cout << std::left << std::setw(48) << Name << std::right << std::fixed << std::setprecision(2) << std::setw(8)
+	     << Ns << " ns" << std::setw(8) << Ns / Pins << " ns/pin" << ( Sink == 1 ? " " : "" ) << endl;
+} // Benchmark
+
+int main( int argc, char *argv[] )
+{
+	size_t   Samples = DEFAULT_SAMPLES;
+	uint64_t Seed    = 1;
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Samples = strtoull( argv[a+1], nullptr, 10 );
+		else if( strcmp( argv[a], "-s" ) == 0 )
+			Seed = strtoull( argv[a+1], nullptr, 10 );
+		else
+			Usage();
+	}
+	if( Samples == 0 )
+		Usage();
+
+	const std::vector<uint64_t> Signal = MakeSignal( Samples, Seed );
+	cout << Samples << " samples of 64 pins, seed " << Seed << ", NUM_BUTTON_STATES " << NUM_BUTTON_STATES << endl;
+
+	bool Ok = true;
+	Ok &= Compare<uint8_t>( "Debouncer == Vertical<u8,false>",
+	                        VerticalDebouncer<uint8_t, NUM_BUTTON_STATES, false>( uint8_t( PULLED_UP ) ),
+	                        Debouncer( uint8_t( PULLED_UP ) ), Signal );
+	Ok &= Compare<uint64_t>( "8 x Debouncer == Vertical<u64,false>",
+	                         VerticalDebouncer<uint64_t, NUM_BUTTON_STATES, false>( PULLED_UP ),
+	                         ByteDebouncers( PULLED_UP ), Signal );
+	Ok &= CheckSymmetric<uint32_t, 1>( "model == Vertical<u32> depth 1", Signal );
+	Ok &= CheckSymmetric<uint32_t, 3>( "model == Vertical<u32> depth 3", Signal );
+	Ok &= CheckSymmetric<uint32_t, NUM_BUTTON_STATES>( "model == Vertical<u32> depth NUM_BUTTON_STATES", Signal );
+	Ok &= CheckSymmetric<uint64_t, 7>( "model == Vertical<u64> depth 7", Signal );
+	Ok &= CheckSymmetric<uint64_t, NUM_BUTTON_STATES>( "model == Vertical<u64> depth NUM_BUTTON_STATES", Signal );
+	Ok &= CheckSymmetric<uint64_t, 32>( "model == Vertical<u64> depth 32", Signal );
+	Ok &= CheckSymmetric<uint64_t, 255>( "model == Vertical<u64> depth 255", Signal );
+
+	cout << endl << "time of ButtonProcess() (depth NUM_BUTTON_STATES):" << endl;
+	Benchmark<uint8_t>( "Debouncer (8 pins)", 8, Debouncer( 0 ), Signal );
+	Benchmark<uint8_t>( "VerticalDebouncer<uint8_t> (8 pins)", 8, VerticalDebouncer<uint8_t>(), Signal );
+	Benchmark<uint64_t>( "8 x Debouncer (64 pins)", 64, ByteDebouncers( 0 ), Signal );
+	Benchmark<uint32_t>( "VerticalDebouncer<uint32_t> (32 pins)", 32, VerticalDebouncer<uint32_t>(), Signal );
+	Benchmark<uint64_t>( "VerticalDebouncer<uint64_t> (64 pins)", 64, VerticalDebouncer<uint64_t>(), Signal );
+
+	return Ok ? 0 : 1;
+} // main
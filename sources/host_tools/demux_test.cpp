@@ -0,0 +1,258 @@
+/*
+This is the source file of demux_test, the test of the demultiplexing of the simultaneous mode of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool tests the pairing of the DMA words of the simultaneous mode (SplitPairs() of ChannelDemux.h). It runs
+ * on Linux; see README.md for the build command.
+ *
+ * Usage: demux_test [-n <captures>] [-s <seed>]
+ *
+ * The fixed cases check the odd number of words, a transfer starting between the two results of a conversion
+ * (with a single pair, where a pairing accepting either order would shift all the following pairs), a missing
+ * result of ADC A or ADC B, results of other channels among the pairs, and the results coming in the other order
+ * than the expected one. The random test generates captures of random pairs in both orders, deletes random words
+ * (never two adjacent ones, after which no pairing could tell the conversions apart) and compares the series with
+ * the conversions whose both results remained. The tool returns 1 when a check failed. */
+#include "ChannelDemux.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_CAPTURES 2000
+#define DEFAULT_SEED     1
+#define MAX_CONVERSIONS  300
+#define CH_VPVN          3  // Channel address of VP/VN
+#define CH_TEMP          0  // Channel address of the temperature sensor
+
+// A conversion of the simultaneous mode: the results of ADC A and of ADC B
+struct Conversion {
+	int      Pair;
+	uint16_t RawA;
+	uint16_t RawB;
+};
+
+static uint32_t MakeWord( uint8_t Channel, uint16_t Raw )
+{
+	return uint32_t( Channel ) << 16 | Raw;
+} // MakeWord
+
+// The DMA words of the conversions in the order of BFirst
+static std::vector<uint32_t> MakeWords( const std::vector<Conversion> &Conversions, bool BFirst )
+{
+	std::vector<uint32_t> Words;
+	for( const Conversion &C : Conversions ) {
+		const uint32_t A = MakeWord( uint8_t( DEMUX_CH_AUX_MIN + C.Pair ), C.RawA );
+		const uint32_t B = MakeWord( uint8_t( DEMUX_CH_AUX_MIN + C.Pair + 8 ), C.RawB );
+		Words.push_back( BFirst ? B : A );
+		Words.push_back( BFirst ? A : B );
+	}
+	return Words;
+} // MakeWords
+
+// Compare the result of SplitPairs() of Words with the series of the Expected conversions and with ExpectedUnpaired
+static bool CheckSplit( const char *Case, const std::vector<uint32_t> &Words, bool BFirst,
+                        const std::vector<Conversion> &Expected, uint32_t ExpectedUnpaired )
+{
+	std::vector<uint32_t> Out( Words.size() + 1, 0xDEADBEEF ); // One extra sample to detect a write past the pairs
+	PairSeries<uint32_t> Series[ DEMUX_PAIRS ];
+	uint32_t Unpaired = 0;
+	const int SeriesCount = SplitPairs( Words.data(), uint32_t( Words.size() ), BFirst, Out.data(), Series, Unpaired,
+	                                    []( uint16_t Raw ) { return uint32_t( Raw ); } );
+
+	bool Ok = Unpaired == ExpectedUnpaired;
+	if( !Ok )
+		cerr << Case << ": " << Unpaired << " unpaired words instead of " << ExpectedUnpaired << endl;
+
+	// The series are ordered by the pair, contiguous, and hold the conversions of the pair in their order
+	uint32_t *Free = Out.data();
+	int s = 0;
+	for( int Pair = 0; Pair < DEMUX_PAIRS; Pair++ ) {
+		std::vector<uint32_t> Samples;
+		for( const Conversion &C : Expected )
+			if( C.Pair == Pair ) {
+				Samples.push_back( C.RawA );
+				Samples.push_back( C.RawB );
+			}
+		if( Samples.empty() )
+			continue;
+		if( s >= SeriesCount || Series[s].Pair != Pair || Series[s].Count != Samples.size() / 2 || Series[s].Samples != Free ) {
+			cerr << Case << ": wrong series of the pair " << Pair << endl;
+			return false;
+		}
+		if( !std::equal( Samples.begin(), Samples.end(), Series[s].Samples ) ) {
+			cerr << Case << ": wrong samples of the pair " << Pair << endl;
+			return false;
+		}
+		Free += Samples.size();
+		s++;
+	}
+	if( s != SeriesCount ) {
+		cerr << Case << ": " << SeriesCount << " series instead of " << s << endl;
+		return false;
+	}
+	if( *Free != 0xDEADBEEF ) {
+		cerr << Case << ": a sample written past the series" << endl;
+		return false;
+	}
+	return Ok;
+} // CheckSplit
+
+// The fixed cases; returns the number of the failed ones
+static uint32_t FixedCases()
+{
+	uint32_t Errors = 0;
+	auto Check = [&Errors]( bool Ok ) { Errors += !Ok; };
+	const std::vector<Conversion> One  = { { 1, 10, 11 }, { 1, 20, 21 }, { 1, 30, 31 }, { 1, 40, 41 } };
+	const std::vector<Conversion> Two  = { { 1, 10, 11 }, { 5, 20, 21 }, { 1, 30, 31 }, { 5, 40, 41 } };
+
+	for( bool BFirst : { false, true } ) {
+		const char *Order = BFirst ? " (B first)" : " (A first)";
+		std::vector<uint32_t> W = MakeWords( One, BFirst );
+		Check( CheckSplit( ( std::string( "all pairs" ) + Order ).c_str(), W, BFirst, One, 0 ) );
+		Check( CheckSplit( ( std::string( "no words" ) + Order ).c_str(), {}, BFirst, {}, 0 ) );
+		Check( CheckSplit( ( std::string( "single word" ) + Order ).c_str(), { W[0] }, BFirst, {}, 1 ) );
+
+		// Odd number of words: the result of the second ADC of the last conversion didn't make it into the transfer
+		std::vector<uint32_t> Odd( W.begin(), W.end() - 1 );
+		Check( CheckSplit( ( std::string( "odd count" ) + Order ).c_str(), Odd, BFirst, { One[0], One[1], One[2] }, 1 ) );
+
+		// The transfer started between the two results of a conversion; the following pairs must not shift
+		std::vector<uint32_t> Late( W.begin() + 1, W.end() );
+		Check( CheckSplit( ( std::string( "start between results" ) + Order ).c_str(), Late, BFirst, { One[1], One[2], One[3] }, 1 ) );
+		std::vector<uint32_t> Both( W.begin() + 1, W.end() - 1 );
+		Check( CheckSplit( ( std::string( "start and end between results" ) + Order ).c_str(), Both, BFirst, { One[1], One[2] }, 2 ) );
+
+		// A result missing in the middle: the first (A in the A first order) and the second one of the conversion
+		std::vector<uint32_t> NoFirst = W;
+		NoFirst.erase( NoFirst.begin() + 4 );
+		Check( CheckSplit( ( std::string( "missing first result" ) + Order ).c_str(), NoFirst, BFirst, { One[0], One[1], One[3] }, 1 ) );
+		std::vector<uint32_t> NoSecond = W;
+		NoSecond.erase( NoSecond.begin() + 3 );
+		Check( CheckSplit( ( std::string( "missing second result" ) + Order ).c_str(), NoSecond, BFirst, { One[0], One[2], One[3] }, 1 ) );
+
+		// Two pairs; a missing result mustn't pair the remaining one with the next conversion of the other pair
+		std::vector<uint32_t> W2 = MakeWords( Two, BFirst );
+		Check( CheckSplit( ( std::string( "two pairs" ) + Order ).c_str(), W2, BFirst, Two, 0 ) );
+		W2.erase( W2.begin() + 2 );
+		Check( CheckSplit( ( std::string( "two pairs, missing result" ) + Order ).c_str(), W2, BFirst, { Two[0], Two[2], Two[3] }, 1 ) );
+
+		// Results of other channels between the pairs are skipped
+		std::vector<uint32_t> Other = MakeWords( Two, BFirst );
+		Other.insert( Other.begin() + 2, MakeWord( CH_VPVN, 7 ) );
+		Other.insert( Other.begin(), MakeWord( CH_TEMP, 8 ) );
+		Check( CheckSplit( ( std::string( "other channels" ) + Order ).c_str(), Other, BFirst, Two, 2 ) );
+
+		// VAUX[n+8] followed by VAUX[n]: the swapped order is not a pair (several pairs keep the conversions apart)
+		std::vector<uint32_t> Swapped = MakeWords( Two, !BFirst );
+		Check( CheckSplit( ( std::string( "swapped order" ) + Order ).c_str(), Swapped, BFirst, {}, uint32_t( Swapped.size() ) ) );
+	}
+	return Errors;
+} // FixedCases
+
+// Split random captures with random missing words; returns the number of the failed captures
+static uint32_t RandomTest( uint32_t Captures, uint32_t Seed )
+{
+	std::mt19937 Random( Seed );
+	uint32_t Errors = 0;
+	for( uint32_t c = 0; c < Captures && Errors < 10; c++ ) {
+		const bool BFirst = Random() & 1;
+		const uint32_t EnabledPairs = 1 + Random() % 255; // Bit n enables the pair n, like SIMULTANEOUS_AUX_PAIRS
+		std::vector<int> Enabled;
+		for( int Pair = 0; Pair < DEMUX_PAIRS; Pair++ )
+			if( EnabledPairs >> Pair & 1 )
+				Enabled.push_back( Pair );
+
+		// The sequencer converts the enabled pairs in turn
+		std::vector<Conversion> Conversions( Random() % MAX_CONVERSIONS );
+		for( size_t i = 0; i < Conversions.size(); i++ )
+			Conversions[i] = { Enabled[ i % Enabled.size() ], uint16_t( Random() ), uint16_t( Random() ) };
+		std::vector<uint32_t> Words = MakeWords( Conversions, BFirst );
+
+		// Delete random words, never two adjacent ones
+		const uint32_t DeletePercent = Random() % 4 == 0 ? 0 : Random() % 20;
+		std::vector<bool> Deleted( Words.size(), false );
+		for( size_t i = 0; i < Words.size(); i++ )
+			Deleted[i] = Random() % 100 < DeletePercent && ( i == 0 || !Deleted[i-1] );
+
+		std::vector<uint32_t> Kept;
+		std::vector<Conversion> Expected;
+		uint32_t Unpaired = 0;
+		for( size_t i = 0; i < Words.size(); i++ )
+			if( !Deleted[i] )
+				Kept.push_back( Words[i] );
+		for( size_t i = 0; i < Conversions.size(); i++ ) {
+			const bool First = !Deleted[ 2 * i ], Second = !Deleted[ 2 * i + 1 ];
+			if( First && Second )
+				Expected.push_back( Conversions[i] );
+			else
+				Unpaired += First || Second;
+		}
+		Errors += !CheckSplit( "random capture", Kept, BFirst, Expected, Unpaired );
+	}
+	return Errors;
+} // RandomTest
+
+static void Usage()
+{
+	cerr << "usage: demux_test [-n <captures>] [-s <seed>]" << endl;
+	exit( 2 );
+} // Usage
+
+int main( int argc, char *argv[] )
+{
+	uint32_t Captures = DEFAULT_CAPTURES;
+	uint32_t Seed     = DEFAULT_SEED;
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		uint32_t Value = uint32_t( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Captures = Value;
+		else if( strcmp( argv[a], "-s" ) == 0 )
+			Seed = Value;
+		else
+			Usage();
+	}
+
+	uint32_t Errors = FixedCases();
+	cout << "random test of " << Captures << " captures, seed " << Seed << endl;
+	Errors += RandomTest( Captures, Seed );
+
+	if( Errors ) {
+		cerr << Errors << " check(s) failed" << endl;
+		return 1;
+	}
+	cout << "all checks passed" << endl;
+	return 0;
+} // main
@@ -0,0 +1,213 @@
+/*
+This is the source file of flush_deadline_test, the test of the latency mode of the sink of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool measures the latency of a slow stream of small messages sent through FileViaSocket in the throughput mode
+ * and in the latency mode of its sink (SocketSink::setFlushDeadline(), see SocketSink.h). It runs on Linux;
+ * see README.md for the build command.
+ *
+ * Usage: flush_deadline_test [-n <messages>] [-i <interval in us>] [-d <deadline in us>]
+ *
+ * A writer sends a line with its number and the time it was written every interval, over the loopback to a receiver
+ * thread, which takes the latency of each line when it reads it. This is repeated with the data sent in full buffers
+ * only, flushed after each line (like std::endl), and with the deadline with TCP_NODELAY on and off. While waiting
+ * for the next line, the writer calls flushDue() when the deadline expires, like the owner of the sink should.
+ * The tool prints the number of send() calls (about the number of TCP segments) and the latency percentiles of each
+ * mode. It returns 1 when the lines weren't received complete and in order. */
+#include "FileViaSocket.h"
+#include "Timestamp.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_MESSAGES 2000
+#define DEFAULT_INTERVAL 500  // us
+#define DEFAULT_DEADLINE 2000 // us
+#define LOOPBACK_IP      "127.0.0.1"
+
+// A way of sending the messages
+struct Mode {
+	const char *Name;
+	bool        Deadline;  // The latency mode with the deadline of -d
+	int         NoDelay;   // TCP_NODELAY; -1 keeps the default of the stack
+	bool        FlushEach; // Flush after each line
+};
+
+// What the receiver got
+struct Received {
+	std::vector<uint64_t> Latencies; // In ns, in the order of the lines
+	bool                  InOrder = true;
+};
+
+static int            Listener = -1;
+static unsigned short Port     = 0;
+
+// Accept a connection, read the lines "<number> <time in ns>" till it's closed and take their latencies
+static void Receive( Received &Result )
+{
+	const int Connection = accept( Listener, nullptr, nullptr );
+	if( Connection < 0 )
+		return;
+	char Buffer[ 65536 ];
+	std::string Line;
+	ssize_t n;
+	while( ( n = read( Connection, Buffer, sizeof(Buffer) ) ) > 0 ) {
+		const uint64_t Now = TimestampToNs( TimestampNow() );
+		for( ssize_t i = 0; i < n; i++ ) {
+			if( Buffer[i] != '\n' ) {
+				Line += Buffer[i];
+				continue;
+			}
+			char *End;
+			const unsigned long Number  = strtoul( Line.c_str(), &End, 10 );
+			const uint64_t      Written = strtoull( End, nullptr, 10 );
+			if( Number != Result.Latencies.size() )
+				Result.InOrder = false;
+			Result.Latencies.push_back( Now - Written );
+			Line.clear();
+		}
+	}
+	close( Connection );
+} // Receive
+
+static void Usage()
+{
+	cerr << "usage: flush_deadline_test [-n <messages>] [-i <interval in us>] [-d <deadline in us>]" << endl;
+	exit( 2 );
+} // Usage
+
+int main( int argc, char *argv[] )
+{
+	unsigned Messages = DEFAULT_MESSAGES;
+	unsigned Interval = DEFAULT_INTERVAL;
+	unsigned Deadline = DEFAULT_DEADLINE;
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		const unsigned Value = unsigned( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Messages = Value;
+		else if( strcmp( argv[a], "-i" ) == 0 )
+			Interval = Value;
+		else if( strcmp( argv[a], "-d" ) == 0 )
+			Deadline = Value;
+		else
+			Usage();
+	}
+	if( Messages == 0 || Deadline == 0 )
+		Usage();
+
+	// The receiver listens on a free port of the loopback
+	Listener = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in Addr = {};
+	Addr.sin_family      = AF_INET;
+	Addr.sin_addr.s_addr = inet_addr( LOOPBACK_IP );
+	socklen_t AddrLength = sizeof(Addr);
+	if( Listener < 0 || bind( Listener, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 || listen( Listener, 1 ) < 0
+	    || getsockname( Listener, (struct sockaddr *)&Addr, &AddrLength ) < 0 ) {
+		cerr << "Opening the receiver failed! terminating" << endl;
+		return 1;
+	}
+	Port = ntohs( Addr.sin_port );
+
+	cout << Messages << " lines every " << Interval << " us over the loopback, deadline " << Deadline << " us" << endl;
+	cout << std::left << std::setw(24) << "mode" << std::right << std::setw(10) << "sends" << std::setw(10) << "p50 us"
+	     << std::setw(10) << "p99 us" << std::setw(10) << "max us" << endl;
+
+	const Mode Modes[] = {
+		{ "full buffers",          false, -1, false },
+		{ "flush each",            false,  1, true  },
+		{ "deadline",              true,   1, false },
+		{ "deadline, Nagle on",    true,   0, false },
+	};
+	int Failed = 0;
+	for( const Mode &m : Modes ) {
+		Received Data;
+		std::thread Receiver( Receive, std::ref( Data ) );
+
+		FileViaSocket f;
+		SocketSink &Sink = f.sink();
+		if( m.NoDelay >= 0 )
+			Sink.setNoDelay( m.NoDelay == 1 );
+		Sink.setFlushDeadline( m.Deadline ? Deadline : 0 );
+		if( Sink.open( LOOPBACK_IP, Port ) != SinkError::None ) {
+			cerr << "Opening the connection failed! terminating" << endl;
+			Receiver.detach();
+			return 1;
+		}
+		const Timestamp Start = TimestampNow();
+		for( unsigned i = 0; i < Messages; i++ ) {
+			// Wait for the time of the line; the data waiting in the sink are sent when their deadline expires meanwhile
+			const uint64_t Next = TimestampToNs( Start ) + uint64_t( i ) * Interval * 1000;
+			for( ;; ) {
+				const uint64_t Now = TimestampToNs( TimestampNow() );
+				if( Now >= Next )
+					break;
+				uint64_t Wait = Next - Now;
+				const uint32_t Due = Sink.timeToDeadline();
+				if( Due != UINT32_MAX && uint64_t( Due ) * 1000 < Wait )
+					Wait = uint64_t( Due ) * 1000;
+				if( Wait > 0 )
+					std::this_thread::sleep_for( std::chrono::nanoseconds( Wait ) );
+				Sink.flushDue();
+			}
+			f << i << ' ' << TimestampToNs( TimestampNow() ) << '\n';
+			if( m.FlushEach )
+				f.flush();
+		}
+		f.flush();
+		const bool Sent = bool( f );
+		const uint32_t Sends = Sink.sendCount();
+		f.close();
+		Receiver.join();
+
+		std::vector<uint64_t> Sorted = Data.Latencies;
+		std::sort( Sorted.begin(), Sorted.end() );
+		auto Percentile = [&]( double p ) { return Sorted.empty() ? 0.0 : Sorted[ size_t( p * ( Sorted.size() - 1 ) ) ] / 1e3; };
+		cout << std::left << std::setw(24) << m.Name << std::right << std::setw(10) << Sends << std::fixed << std::setprecision(0)
+		     << std::setw(10) << Percentile( 0.5 ) << std::setw(10) << Percentile( 0.99 ) << std::setw(10) << Percentile( 1.0 );
+		if( !Sent || !Data.InOrder || Data.Latencies.size() != Messages ) {
+			cout << "   lines lost or out of order!";
+			Failed++;
+		}
+		cout << endl;
+	}
+	close( Listener );
+	return Failed ? 1 : 0;
+} // main
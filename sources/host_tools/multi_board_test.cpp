@@ -0,0 +1,242 @@
+/*
+This is the source file of multi_board_test, the scale test of the alignment of the captures of several boards by the receiver.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool simulates several boards triggered at the same time, e.g., by a common trigger signal, and measures
+ * the rate at which the receiver (via_socket_server -a <archive> -g <tolerance>) stores their captures.
+ * Each board is a thread sending its captures through FileViaSocket (the same send path as the board uses),
+ * a connection per capture, with the capture header line (see CaptureFormat.h) carrying its board ID and the time
+ * of the capture on its own clock. The clocks of the boards start at different times, like the clocks of real boards do.
+ * It runs on Linux; see README.md for the build command.
+ *
+ * Usage: multi_board_test [-p <port>] [-n <boards>[,<boards>...]] [-s <samples>] [-r <rounds per second>] [-t <seconds>] <server IP>
+ *
+ * In a round, all the boards wait for each other and then send a capture, i.e., the receiver gets the captures
+ * of a round within a short time. Without -r, the next round starts as soon as all the boards sent their captures,
+ * which measures the max. rate of the receiver; with -r, the rounds start at the given rate, like the triggers would.
+ * The test runs for the given time with each number of the boards. Start with the smallest number: the receiver
+ * expects the captures of all the boards it has seen so far. */
+#include "FileViaSocket.h"
+#include "CaptureFormat.h"
+#include "Timestamp.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_PORT    65432 // The same as file_via_socket.py and SERVER_PORT in main.cpp
+#define DEFAULT_SAMPLES 1000
+#define DEFAULT_SECONDS 5
+#define MAX_BOARDS      64
+#define BOARD_CLOCK_STEP_NS 1234567890ULL // The clock of the board i started i times this long before the test
+
+/* All the boards wait for each other at the start of a round. The last one to come decides whether there's another round
+ * and when it starts. */
+class RoundBarrier {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	RoundBarrier( unsigned Count, Timestamp End, double RoundsPerSecond )
+	: Count( Count ), End( End ), Period( RoundsPerSecond > 0 ? 1 / RoundsPerSecond : 0 ), RoundStart( Clock::now() ) {}
+
+	// Wait for the other boards and for the start of the round. Returns false when the time of the test is over.
+	bool Wait()
+	{
+		std::unique_lock<std::mutex> Lock( Mutex );
+		const uint64_t Round = Rounds;
+		if( ++Waiting == Count ) {
+			Waiting = 0;
+			Rounds++;
+			Continue = TimestampNow() < End;
+			RoundStart = std::max( Clock::now(), RoundStart + std::chrono::duration_cast<Clock::duration>( Period ) );
+			Released.notify_all();
+		}
+		else
+			Released.wait( Lock, [this, Round] { return Rounds != Round; } );
+		const Clock::time_point Start = RoundStart;
+		Lock.unlock();
+
+		std::this_thread::sleep_until( Start ); // All the boards "trigger" at the same time
+		return Continue;
+	} // Wait
+
+private:
+	std::mutex              Mutex;
+	std::condition_variable Released;
+	const unsigned          Count;
+	const Timestamp         End;
+	const std::chrono::duration<double> Period; // Between the starts of the rounds; 0 when they start as soon as possible
+	Clock::time_point       RoundStart;
+	unsigned                Waiting  = 0;
+	uint64_t                Rounds   = 0;
+	bool                    Continue = true;
+}; // RoundBarrier
+
+// A simulated board
+struct Board {
+	uint32_t    Id       = 0;
+	uint32_t    Number   = 0; // Number of the last capture; it continues over the runs of the test
+	uint64_t    ClockStart;   // When the board "started", on the clock of this computer [ns]
+	uint64_t    Captures = 0; // Captures sent in the current run
+	uint64_t    Bytes    = 0; // Bytes sent in the current run
+	std::string Error;        // Empty when all the captures were sent
+};
+
+static void Usage()
+{
+	cerr << "usage: multi_board_test [-p <port>] [-n <boards>[,<boards>...]] [-s <samples>] [-r <rounds per second>] [-t <seconds>] <server IP>" << endl;
+	exit( 2 );
+} // Usage
+
+// Send a capture in each round till the barrier ends the test
+static void RunBoard( Board &B, const std::string &ServerIP, unsigned short Port, const std::string &Samples,
+                      RoundBarrier &Barrier )
+{
+	CaptureInfo Info;
+	Info.Board         = B.Id;
+	Info.Averaging     = 16;
+	Info.AdcClkDivisor = 4;
+	Info.Channel       = "VAUX[1]";
+
+	while( B.Error.empty() && Barrier.Wait() ) {
+		Info.Number = ++B.Number;
+		Info.Time   = TimestampToNs( TimestampNow() ) - B.ClockStart; // The trigger on the clock of the board
+		try {
+			FileViaSocket f( ServerIP, Port );
+			WriteCaptureHeader( f, Info );
+			f.write( Samples.data(), Samples.size() );
+			f.flush();
+			if( !f )
+				B.Error = "the connection broke";
+			f.close();
+		}
+		catch( const std::exception& e ) {
+			B.Error = e.what();
+		}
+		if( B.Error.empty() ) {
+			B.Captures++;
+			B.Bytes += Samples.size();
+		}
+	}
+	while( Barrier.Wait() ) // A failed board keeps coming to the rounds, so that the others don't wait forever
+		;
+} // RunBoard
+
+int main( int argc, char *argv[] )
+{
+	unsigned short        Port    = DEFAULT_PORT;
+	std::vector<unsigned> Counts  = { 1, 2, 4, 8 };
+	unsigned              Samples = DEFAULT_SAMPLES;
+	unsigned              Seconds = DEFAULT_SECONDS;
+	double                Rate    = 0; // Rounds per second; 0: as fast as possible
+
+	int a = 1;
+	for( ; a < argc && argv[a][0] == '-'; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		if( strcmp( argv[a], "-p" ) == 0 )
+			Port = (unsigned short)strtoul( argv[a+1], nullptr, 10 );
+		else if( strcmp( argv[a], "-n" ) == 0 ) {
+			Counts.clear();
+			std::istringstream List( argv[a+1] );
+			std::string Item;
+			while( std::getline( List, Item, ',' ) )
+				Counts.push_back( unsigned( strtoul( Item.c_str(), nullptr, 10 ) ) );
+		}
+		else if( strcmp( argv[a], "-s" ) == 0 )
+			Samples = unsigned( strtoul( argv[a+1], nullptr, 10 ) );
+		else if( strcmp( argv[a], "-r" ) == 0 )
+			Rate = strtod( argv[a+1], nullptr );
+		else if( strcmp( argv[a], "-t" ) == 0 )
+			Seconds = unsigned( strtoul( argv[a+1], nullptr, 10 ) );
+		else
+			Usage();
+	}
+	if( argc - a != 1 || Port == 0 || Counts.empty() || Samples == 0 || Seconds == 0 || Rate < 0 )
+		Usage();
+	for( unsigned Count : Counts )
+		if( Count == 0 || Count > MAX_BOARDS )
+			Usage();
+	const std::string ServerIP( argv[a] );
+
+	// The samples of a capture in the format of the single channel mode (1 kHz sine sampled at 1 MSPS / 16)
+	std::ostringstream Lines;
+	Lines << std::setprecision(7);
+	for( unsigned i = 0; i < Samples; i++ )
+		Lines << float( 0.5 + 0.4 * sin( 2 * M_PI * 1000.0 * i * 16 / 1e6 ) ) << '\n';
+	const std::string Text = Lines.str();
+
+	std::vector<Board> Boards( MAX_BOARDS );
+	const uint64_t Now = TimestampToNs( TimestampNow() );
+	for( unsigned i = 0; i < MAX_BOARDS; i++ ) {
+		Boards[i].Id         = i + 1;
+		Boards[i].ClockStart = Now - ( i + 1 ) * BOARD_CLOCK_STEP_NS;
+	}
+
+	cout << "sending captures of " << Samples << " samples to " << ServerIP << ':' << Port << " for " << Seconds
+	     << " s with each number of the boards" << endl;
+	cout << "boards  captures  captures/s  rounds/s     MB/s" << endl;
+	int Failed = 0;
+	for( unsigned Count : Counts ) {
+		const Timestamp Start = TimestampNow();
+		RoundBarrier Barrier( Count, Start + Timestamp( Seconds ) * TIMESTAMP_TICKS_PER_SECOND, Rate );
+		std::vector<std::thread> Threads;
+		for( unsigned i = 0; i < Count; i++ ) {
+			Boards[i].Captures = 0;
+			Boards[i].Bytes    = 0;
+			Boards[i].Error.clear();
+			Threads.emplace_back( RunBoard, std::ref( Boards[i] ), std::cref( ServerIP ), Port, std::cref( Text ), std::ref( Barrier ) );
+		}
+		uint64_t Captures = 0, Bytes = 0;
+		for( unsigned i = 0; i < Count; i++ ) {
+			Threads[i].join();
+			Captures += Boards[i].Captures;
+			Bytes    += Boards[i].Bytes;
+			if( !Boards[i].Error.empty() ) {
+				cerr << "board " << Boards[i].Id << ": " << Boards[i].Error << endl;
+				Failed++;
+			}
+		}
+
+		const double   Elapsed  = TimestampToNs( TimestampNow() - Start ) / 1e9;
+		cout << std::setw(6) << Count << std::setw(10) << Captures << std::fixed << std::setprecision(1)
+		     << std::setw(12) << Captures / Elapsed << std::setw(10) << Captures / Count / Elapsed
+		     << std::setprecision(2) << std::setw(9) << Bytes / Elapsed / 1e6 << endl;
+	}
+	return Failed ? 1 : 0;
+} // main
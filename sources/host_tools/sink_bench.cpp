@@ -0,0 +1,289 @@
+/*
+This is the source file of sink_bench, the comparison of the stream and the sink sending the samples of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool compares the two ways of sending the samples: the stream FileViaSocket, which formats each value by
+ * operator<<(float), and the sink SocketSink (SocketSink.h), to which the firmware writes the values formatted by
+ * FormatSampleValue() (CaptureFormat.h). It runs on Linux; see README.md for the build command.
+ *
+ * Usage: sink_bench [-n <values>] [-r <rounds>]
+ *
+ * The values are sent over the loopback to a receiver thread. Each path sends them formatted ("<<" and "format"),
+ * and then the same text pre-formatted, line by line ("write"), which tells the cost of the stream itself.
+ * The receiver hashes the data of the first round, and the tool checks that both paths sent the same text.
+ * The number of the heap allocations made after the connection was opened is counted as well.
+ *
+ * SINK_BENCH_PATHS selects the paths compiled in: 1 the stream only, 2 the sink only, 3 both (the default).
+ * The builds with a single path are for comparing the code size (see README.md); therefore the tool prints
+ * by printf(), because cout would link the streams into the build with the sink only.
+ * The tool returns 1 when a check failed. */
+#ifndef SINK_BENCH_PATHS
+#define SINK_BENCH_PATHS 3
+#endif
+
+#if SINK_BENCH_PATHS & 1
+#include "FileViaSocket.h"
+#endif
+#include "SocketSink.h"
+#include "CaptureFormat.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define DEFAULT_VALUES 1000000
+#define DEFAULT_ROUNDS 5
+#define LOOPBACK_IP    "127.0.0.1"
+
+// Heap allocations made by operator new
+static std::atomic<uint64_t> Allocations{ 0 };
+
+void *operator new( size_t Size )
+{
+	Allocations++;
+	if( void *p = malloc( Size ? Size : 1 ) )
+		return p;
+	throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete( void *p ) noexcept { free( p ); }
+__attribute__((noinline)) void operator delete( void *p, size_t ) noexcept { free( p ); }
+
+// The data received by a connection
+struct Received {
+	uint64_t Bytes = 0;
+	uint64_t Hash  = 0xCBF29CE484222325ULL; // FNV-1a of the data, when hashed
+};
+
+static int            Listener = -1;
+static unsigned short Port     = 0;
+
+// Accept a connection and read it till it's closed
+static void Receive( Received &Result, bool Hash )
+{
+	const int Connection = accept( Listener, nullptr, nullptr );
+	if( Connection < 0 )
+		return;
+	static char Buffer[ 256*1024 ];
+	ssize_t n;
+	while( ( n = read( Connection, Buffer, sizeof(Buffer) ) ) > 0 ) {
+		Result.Bytes += uint64_t( n );
+		if( Hash )
+			for( ssize_t i = 0; i < n; i++ )
+				Result.Hash = ( Result.Hash ^ uint8_t( Buffer[i] ) ) * 0x100000001B3ULL;
+	}
+	close( Connection );
+} // Receive
+
+// The result of a path, the best of the rounds
+struct PathResult {
+	explicit PathResult( const char *Name ) : Name( Name ) {}
+	const char *Name;
+	uint64_t    Ticks = UINT64_MAX; // Sending time of the fastest round
+	uint64_t    Allocations = 0;    // Max. allocations after the open in a round
+	Received    Data;               // What the receiver got in the first round
+	bool        Failed = false;
+};
+
+/* Run the path Send (called with the number of the allocations before its data are written, returning the time
+ * it took to send them, or 0 on an error) Rounds times */
+template<typename SendFunction>
+static void RunPath( PathResult &Result, unsigned Rounds, SendFunction Send )
+{
+	for( unsigned r = 0; r < Rounds && !Result.Failed; r++ ) {
+		Received Data;
+		std::thread Receiver( Receive, std::ref( Data ), r == 0 );
+		uint64_t AllocationsAfterOpen = 0;
+		const uint64_t Ticks = Send( AllocationsAfterOpen );
+		const uint64_t Made = Allocations - AllocationsAfterOpen;
+		Receiver.join();
+		if( Ticks == 0 ) {
+			Result.Failed = true;
+			break;
+		}
+		if( r == 0 )
+			Result.Data = Data;
+		if( Ticks < Result.Ticks )
+			Result.Ticks = Ticks;
+		if( Made > Result.Allocations )
+			Result.Allocations = Made;
+	}
+} // RunPath
+
+static void Usage()
+{
+	fprintf( stderr, "usage: sink_bench [-n <values>] [-r <rounds>]\n" );
+	exit( 2 );
+} // Usage
+
+int main( int argc, char *argv[] )
+{
+	unsigned Count  = DEFAULT_VALUES;
+	unsigned Rounds = DEFAULT_ROUNDS;
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		const unsigned Value = unsigned( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Count = Value;
+		else if( strcmp( argv[a], "-r" ) == 0 )
+			Rounds = Value;
+		else
+			Usage();
+	}
+	if( Count == 0 || Rounds == 0 )
+		Usage();
+
+	// A sine on VAUX[1] in the unipolar mode: the 12-bit conversions of 0 to 1 V, like the board sends
+	std::vector<float> Values( Count );
+	for( unsigned i = 0; i < Count; i++ )
+		Values[i] = float( 2048 + int( 2000 * sin( i * 0.001 ) ) ) / 4096.0f;
+
+	// The text the board would send, and the length of each of its lines
+	std::string Text;
+	std::vector<uint8_t> Lengths( Count );
+	for( unsigned i = 0; i < Count; i++ ) {
+		char Line[ SAMPLE_VALUE_MAX_CHARS + 1 ];
+#if SINK_BENCH_PATHS & 2
+		size_t n = FormatSampleValue( Line, Values[i] );
+#else
+		size_t n = size_t( snprintf( Line, sizeof(Line), "%.7g", double( Values[i] ) ) );
+#endif
+		Line[ n++ ] = '\n';
+		Text.append( Line, n );
+		Lengths[i] = uint8_t( n );
+	}
+
+	// The receiver listens on a free port of the loopback
+	Listener = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in Addr = {};
+	Addr.sin_family      = AF_INET;
+	Addr.sin_addr.s_addr = inet_addr( LOOPBACK_IP );
+	socklen_t AddrLength = sizeof(Addr);
+	if( Listener < 0 || bind( Listener, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 || listen( Listener, 1 ) < 0
+	    || getsockname( Listener, (struct sockaddr *)&Addr, &AddrLength ) < 0 ) {
+		fprintf( stderr, "Opening the receiver failed! terminating\n" );
+		return 1;
+	}
+	Port = ntohs( Addr.sin_port );
+
+	printf( "%u values (%.1f MB of text) over the loopback, best of %u rounds\n", Count, Text.size() / 1e6, Rounds );
+
+	std::vector<PathResult> Results;
+#if SINK_BENCH_PATHS & 1
+	Results.emplace_back( "stream <<" );
+	RunPath( Results.back(), Rounds, [&]( uint64_t &AllocationsAfterOpen ) -> uint64_t {
+		FileViaSocket f( LOOPBACK_IP, Port );
+		f.precision( 7 );
+		AllocationsAfterOpen = Allocations;
+		const Timestamp Start = TimestampNow();
+		for( unsigned i = 0; i < Count; i++ )
+			f << Values[i] << '\n';
+		f.flush();
+		const Timestamp End = TimestampNow();
+		return f ? End - Start : 0;
+	} );
+	Results.emplace_back( "stream write" );
+	RunPath( Results.back(), Rounds, [&]( uint64_t &AllocationsAfterOpen ) -> uint64_t {
+		FileViaSocket f( LOOPBACK_IP, Port );
+		AllocationsAfterOpen = Allocations;
+		const Timestamp Start = TimestampNow();
+		const char *p = Text.data();
+		for( unsigned i = 0; i < Count; p += Lengths[i++] )
+			f.write( p, Lengths[i] );
+		f.flush();
+		const Timestamp End = TimestampNow();
+		return f ? End - Start : 0;
+	} );
+#endif
+#if SINK_BENCH_PATHS & 2
+	Results.emplace_back( "sink format" );
+	RunPath( Results.back(), Rounds, [&]( uint64_t &AllocationsAfterOpen ) -> uint64_t {
+		SocketSink Sink;
+		if( Sink.open( LOOPBACK_IP, Port ) != SinkError::None )
+			return 0;
+		AllocationsAfterOpen = Allocations;
+		const Timestamp Start = TimestampNow();
+		char Line[ SAMPLE_VALUE_MAX_CHARS + 1 ];
+		for( unsigned i = 0; i < Count; i++ ) {
+			size_t n = FormatSampleValue( Line, Values[i] );
+			Line[ n++ ] = '\n';
+			Sink.write( Line, n );
+		}
+		const SinkError Error = Sink.flush();
+		const Timestamp End = TimestampNow();
+		return Error == SinkError::None ? End - Start : 0;
+	} );
+	Results.emplace_back( "sink write" );
+	RunPath( Results.back(), Rounds, [&]( uint64_t &AllocationsAfterOpen ) -> uint64_t {
+		SocketSink Sink;
+		if( Sink.open( LOOPBACK_IP, Port ) != SinkError::None )
+			return 0;
+		AllocationsAfterOpen = Allocations;
+		const Timestamp Start = TimestampNow();
+		const char *p = Text.data();
+		for( unsigned i = 0; i < Count; p += Lengths[i++] )
+			Sink.write( p, Lengths[i] );
+		const SinkError Error = Sink.flush();
+		const Timestamp End = TimestampNow();
+		return Error == SinkError::None ? End - Start : 0;
+	} );
+#endif
+	close( Listener );
+
+	// All the paths must have sent the text
+	Received Expected;
+	for( char c : Text )
+		Expected.Hash = ( Expected.Hash ^ uint8_t( c ) ) * 0x100000001B3ULL;
+	Expected.Bytes = Text.size();
+
+	int Failed = 0;
+	printf( "%-14s %10s %9s %9s %12s\n", "path", "ns/value", "ns/byte", "MB/s", "allocations" );
+	for( const PathResult &Result : Results ) {
+		if( Result.Failed ) {
+			printf( "%-14s sending failed!\n", Result.Name );
+			Failed++;
+			continue;
+		}
+		const double Ns = double( TimestampToNs( Result.Ticks ) );
+		printf( "%-14s %10.1f %9.2f %9.1f %12llu", Result.Name, Ns / Count, Ns / Text.size(), Text.size() / Ns * 1e3,
+		        (unsigned long long)Result.Allocations );
+		if( Result.Data.Bytes != Expected.Bytes || Result.Data.Hash != Expected.Hash ) {
+			printf( "   the text differs!" );
+			Failed++;
+		}
+		printf( "\n" );
+	}
+	return Failed ? 1 : 0;
+} // main
@@ -0,0 +1,352 @@
+/*
+This is the source file of spool_test, the test of the spool of the captures of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool tests CaptureSpool (CaptureSpool.h) and measures its throughput. It runs on Linux; see README.md for
+ * the build command.
+ *
+ * Usage: spool_test [-n <operations>] [-s <seed>]
+ *
+ * The model test stores and removes records of random sizes (incl. records larger than the spool) and compares
+ * the spool with a std::deque: the spool must keep the newest records in order, drop the oldest ones only when
+ * the new record doesn't fit, and recover all its records when it's attached again (like after a reset of the board).
+ * The corruption test checks that a damaged spool is formatted instead of replaying garbage, and the file test that
+ * a spool mapped from a file keeps its records till the next run. The benchmark stores and removes records of the size
+ * of a capture of 1000 and of 1000000 samples. The tool returns 1 when a check failed. */
+#include "CaptureSpool.h"
+#include "Timestamp.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_OPERATIONS 200000
+#define DEFAULT_SEED       1
+#define META_SIZE          8 // The records start with their sequence number and size, like a capture with its description
+
+// A record in the model
+struct ModelRecord {
+	uint32_t Sequence;
+	uint32_t Size;
+};
+
+// The content of the byte i of the record Sequence
+static inline uint8_t RecordByte( uint32_t Sequence, uint32_t i )
+{
+	return uint8_t( Sequence * 131 + i * 7 + ( i >> 8 ) );
+} // RecordByte
+
+// Store the record Sequence of Size bytes (at least META_SIZE) the way the firmware does: the description, then the data
+static bool StoreRecord( CaptureSpool &Spool, uint32_t Sequence, uint32_t Size, std::vector<uint8_t> &Buffer )
+{
+	Buffer.resize( Size );
+	for( uint32_t i = 0; i < Size; i++ )
+		Buffer[i] = RecordByte( Sequence, i );
+	return Spool.Store( Buffer.data(), META_SIZE, Buffer.data() + META_SIZE, Size - META_SIZE );
+} // StoreRecord
+
+static bool RecordOk( const CaptureSpool::Record &R, const ModelRecord &Expected )
+{
+	if( R.Sequence != Expected.Sequence || R.Size != Expected.Size || (uintptr_t)R.Data % 8 != 0 )
+		return false;
+	const uint8_t *Data = (const uint8_t *)R.Data;
+	for( uint32_t i = 0; i < R.Size; i++ )
+		if( Data[i] != RecordByte( Expected.Sequence, i ) )
+			return false;
+	return true;
+} // RecordOk
+
+// Number of bytes a record of Size bytes of data takes in the spool (see CaptureSpool.cpp)
+static inline uint64_t RecordBytes( uint32_t Size )
+{
+	return 16 + ( uint64_t( Size ) + 7 ) / 8 * 8;
+} // RecordBytes
+
+static void Usage()
+{
+	cerr << "usage: spool_test [-n <operations>] [-s <seed>]" << endl;
+	exit( 2 );
+} // Usage
+
+/* Run random operations on a spool of SpoolSize bytes of memory and compare it with a model.
+ * Returns the number of the errors. */
+static uint32_t ModelTest( uint32_t Operations, uint32_t Seed, uint32_t SpoolSize )
+{
+	std::vector<uint64_t>   Memory( SpoolSize / 8 );
+	std::deque<ModelRecord> Model;
+	std::mt19937            Random( Seed );
+	std::vector<uint8_t>    Buffer;
+	uint32_t NextSequence = 0, Errors = 0;
+
+	CaptureSpool Spool;
+	if( !Spool.Attach( Memory.data(), SpoolSize ) ) {
+		cerr << "model test, spool of " << SpoolSize << " bytes: Attach() failed" << endl;
+		return 1;
+	}
+	const uint32_t Capacity = Spool.GetStatistics().Capacity;
+
+	auto Expect = [&]( bool Ok, const char *What ) {
+		if( !Ok && Errors++ < 10 )
+			cerr << "model test, spool of " << SpoolSize << " bytes: " << What << " differs from the model" << endl;
+	};
+
+	for( uint32_t o = 0; o < Operations; o++ ) {
+		const CaptureSpool::Statistics Before = Spool.GetStatistics();
+		switch( Random() % 8 ) {
+		case 0: case 1: case 2: { // Store a record, mostly small ones, now and then a large or a too large one
+			const uint32_t Kind = Random() % 32;
+			const uint32_t Size = META_SIZE + ( Kind == 0 ? Random() % ( Capacity + 64 )
+			                                  : Kind < 4 ? Random() % ( Capacity / 3 ) : Random() % ( Capacity / 40 ) );
+			const bool Fits = RecordBytes( Size ) <= Capacity;
+			Expect( StoreRecord( Spool, NextSequence, Size, Buffer ) == Fits, "Store()" );
+			const CaptureSpool::Statistics After = Spool.GetStatistics();
+			if( !Fits ) {
+				Expect( After.Rejected == Before.Rejected + 1 && After.Records == Before.Records, "rejected Store()" );
+				break;
+			}
+			// The skipped end of the ring is shorter than the record, so there must be room without dropping anything
+			const uint32_t Dropped = After.Overwritten - Before.Overwritten;
+			Expect( Dropped <= Model.size(), "number of the dropped records" );
+			if( uint64_t( Before.Used ) + 2 * RecordBytes( Size ) <= Capacity )
+				Expect( Dropped == 0, "Store() with enough room" );
+			for( uint32_t i = 0; i < Dropped && !Model.empty(); i++ )
+				Model.pop_front(); // The oldest records are dropped
+			Model.push_back( ModelRecord{ NextSequence++, Size } );
+			break;
+		}
+		case 3: case 4: case 5: { // Replay the oldest record
+			CaptureSpool::Record R;
+			const bool Ok = Spool.Peek( R );
+			Expect( Ok == !Model.empty(), "Peek()" );
+			if( !Ok )
+				break;
+			Expect( RecordOk( R, Model.front() ), "peeked record" );
+			if( Random() % 8 == 0 ) { // A stale sequence number, nothing is removed
+				Spool.Remove( R.Sequence + 1, 1 );
+				Expect( Spool.GetStatistics().Records == Before.Records, "Remove() of a stale record" );
+				break;
+			}
+			Spool.Remove( R.Sequence, 1 );
+			Model.pop_front();
+			const CaptureSpool::Statistics After = Spool.GetStatistics();
+			Expect( After.Replayed == Before.Replayed + 1 && After.ReplayedBytes == Before.ReplayedBytes + R.Size,
+			        "replay counters" );
+			break;
+		}
+		case 6: // Attach the memory again, like after a reset of the board
+			if( Random() % 16 == 0 ) {
+				Expect( Spool.Attach( Memory.data(), SpoolSize ), "Attach()" );
+				Expect( Spool.GetStatistics().Recovered == Model.size(), "number of the recovered records" );
+			}
+			break;
+		default: // Compare all the records now and then
+			if( Random() % 64 == 0 ) {
+				CaptureSpool Copy; // A spool attached to a copy of the memory, so that its records can be removed
+				std::vector<uint64_t> Snapshot( Memory );
+				Copy.Attach( Snapshot.data(), SpoolSize );
+				for( const ModelRecord &M : Model ) {
+					CaptureSpool::Record R;
+					Expect( Copy.Peek( R ) && RecordOk( R, M ), "recovered record" );
+					Copy.Remove( R.Sequence, 0 );
+				}
+				Expect( Copy.Empty(), "end of the recovered records" );
+			}
+			break;
+		}
+
+		const CaptureSpool::Statistics S = Spool.GetStatistics();
+		uint64_t Bytes = 0;
+		for( const ModelRecord &M : Model )
+			Bytes += RecordBytes( M.Size );
+		Expect( S.Records == Model.size() && Spool.Empty() == Model.empty(), "number of the records" );
+		Expect( S.Used >= Bytes && S.Used <= S.Capacity && S.HighWater >= S.Used, "usage" );
+	}
+	return Errors;
+} // ModelTest
+
+// Damage the header of the spool and the header of a record; Attach() must format the spool. Returns the number of the errors.
+static uint32_t CorruptionTest()
+{
+	const uint32_t SpoolSize = 64 * 1024;
+	std::vector<uint64_t> Memory( SpoolSize / 8 );
+	std::vector<uint8_t>  Buffer;
+	uint32_t Errors = 0;
+
+	auto Check = [&]( bool Ok, const char *What ) {
+		if( !Ok && Errors++ < 10 )
+			cerr << "corruption test: " << What << endl;
+	};
+
+	CaptureSpool Spool;
+	Check( Spool.Attach( Memory.data(), SpoolSize ) && Spool.GetStatistics().Recovered == 0, "a zeroed memory isn't empty" );
+	Check( !Spool.Attach( Memory.data(), 512 ), "a spool of 512 bytes was attached" );
+	for( int Damage = 0; Damage < 3; Damage++ ) {
+		std::fill( Memory.begin(), Memory.end(), 0 ); // The first record is at the start of the ring
+		Spool.Attach( Memory.data(), SpoolSize );
+		for( uint32_t s = 0; s < 10; s++ )
+			StoreRecord( Spool, s, 1000, Buffer );
+		uint8_t *Bytes = (uint8_t *)Memory.data();
+		if( Damage == 0 )
+			Bytes[ 8 ] ^= 1;       // The offset of the oldest record in the header of the spool
+		else if( Damage == 1 )
+			Bytes[ 32 + 4 ] ^= 1;  // The size in the header of the first record
+		else
+			Bytes[ 32 + 1016 ] ^= 1; // The marker of the second record (the first one takes 16 + 1000 bytes)
+		CaptureSpool Other;
+		Check( Other.Attach( Memory.data(), SpoolSize ) && Other.GetStatistics().Recovered == 0 && Other.Empty(),
+		       "a damaged spool wasn't formatted" );
+		Check( StoreRecord( Other, 0, 100, Buffer ), "Store() to the formatted spool failed" );
+	}
+
+	// A spool of a different size isn't recovered
+	Spool.Attach( Memory.data(), SpoolSize );
+	StoreRecord( Spool, 0, 100, Buffer );
+	Check( Spool.Attach( Memory.data(), SpoolSize - 8 ) && Spool.Empty(), "a spool of another size was recovered" );
+	return Errors;
+} // CorruptionTest
+
+// Store records to a spool mapped from a file, map it again and check the records. Returns the number of the errors.
+static uint32_t FileTest()
+{
+	const std::string Path = "/tmp/spool_test." + std::to_string( getpid() );
+	const uint32_t SpoolSize = 1024 * 1024;
+	std::vector<uint8_t> Buffer;
+	uint32_t Errors = 0;
+
+	auto Check = [&]( bool Ok, const char *What ) {
+		if( !Ok && Errors++ < 10 )
+			cerr << "file test: " << What << endl;
+	};
+
+	{
+		CaptureSpool Spool;
+		Check( Spool.MapFile( Path, SpoolSize ) && Spool.Empty(), "a new file isn't an empty spool" );
+		for( uint32_t s = 0; s < 100; s++ )
+			StoreRecord( Spool, s, 20000, Buffer ); // The first records are dropped
+		CaptureSpool::Record R;
+		while( Spool.Peek( R ) && R.Sequence < 60 )
+			Spool.Remove( R.Sequence, 1 );
+	} // The spool is unmapped, like at the end of a run
+
+	CaptureSpool Spool;
+	Check( Spool.MapFile( Path, SpoolSize ), "MapFile() failed" );
+	Check( Spool.GetStatistics().Recovered == 40, "the records weren't recovered from the file" );
+	for( uint32_t s = 60; s < 100; s++ ) {
+		CaptureSpool::Record R;
+		Check( Spool.Peek( R ) && RecordOk( R, ModelRecord{ s, 20000 } ), "wrong record from the file" );
+		Spool.Remove( R.Sequence, 1 );
+	}
+	Check( Spool.Empty(), "more records in the file" );
+
+	Check( Spool.MapFile( Path, SpoolSize / 2 ) && Spool.Empty(), "a resized file wasn't formatted" );
+	Check( !Spool.MapFile( "/nonexistent/spool", SpoolSize ), "a spool was mapped from a nonexistent directory" );
+	unlink( Path.c_str() );
+	return Errors;
+} // FileTest
+
+/* Store and replay Count records of RecordSize bytes through a spool of SpoolSize bytes, which is kept about half full.
+ * Returns the throughput in bytes per second, 0 when a record was wrong. */
+static double Benchmark( uint32_t SpoolSize, uint32_t RecordSize, uint32_t Count )
+{
+	std::vector<uint64_t> Memory( SpoolSize / 8 );
+	std::vector<uint8_t>  Buffer( RecordSize );
+	CaptureSpool Spool;
+	Spool.Attach( Memory.data(), SpoolSize );
+	for( uint32_t i = 0; i < RecordSize; i++ )
+		Buffer[i] = uint8_t( i );
+	const uint32_t Backlog = uint32_t( SpoolSize / 2 / RecordBytes( RecordSize ) );
+
+	bool Ok = true;
+	const Timestamp Start = TimestampNow();
+	for( uint32_t i = 0; i < Count + Backlog; i++ ) {
+		if( i < Count )
+			Spool.Store( Buffer.data(), META_SIZE, Buffer.data() + META_SIZE, RecordSize - META_SIZE );
+		if( i >= Backlog ) {
+			CaptureSpool::Record R;
+			Ok = Ok && Spool.Peek( R ) && R.Size == RecordSize && ( (const uint8_t *)R.Data )[ RecordSize - 1 ] == Buffer.back();
+			Spool.Remove( R.Sequence, 0 );
+		}
+	}
+	const double Seconds = TimestampToNs( TimestampNow() - Start ) / 1e9;
+	return Ok && Spool.GetStatistics().Overwritten == 0 ? double( RecordSize ) * Count / Seconds : 0;
+} // Benchmark
+
+int main( int argc, char *argv[] )
+{
+	uint32_t Operations = DEFAULT_OPERATIONS;
+	uint32_t Seed       = DEFAULT_SEED;
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		uint32_t Value = uint32_t( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Operations = Value;
+		else if( strcmp( argv[a], "-s" ) == 0 )
+			Seed = Value;
+		else
+			Usage();
+	}
+	if( Operations == 0 )
+		Usage();
+
+	uint32_t Errors = 0;
+	cout << "model test of " << Operations << " operations, seed " << Seed << endl;
+	Errors += ModelTest( Operations, Seed, 4096 );
+	Errors += ModelTest( Operations, Seed, 65536 );
+	Errors += ModelTest( Operations / 10, Seed, 1024 * 1024 );
+	cout << "corruption test" << endl;
+	Errors += CorruptionTest();
+	cout << "file test" << endl;
+	Errors += FileTest();
+
+	// A capture of 1000 samples takes 2000 bytes in the single channel mode, one of 1000000 samples 2 MB
+	static const struct { uint32_t RecordSize, Count; } Sizes[] = { { 2000, 200000 }, { 2000000, 200 } };
+	cout << "benchmark of storing and replaying the records through a spool of 16 MB" << endl << std::fixed << std::setprecision(1);
+	for( const auto &S : Sizes ) {
+		const double Rate = Benchmark( 16 * 1024 * 1024, S.RecordSize, S.Count );
+		if( Rate == 0 && Errors++ < 10 )
+			cerr << "records of " << S.RecordSize << " bytes: wrong record" << endl;
+		cout << "  records of " << std::setw(7) << S.RecordSize << " bytes: " << std::setw(8) << Rate / 1e6 << " MB/s, "
+		     << std::setw(9) << Rate / S.RecordSize << " records/s" << endl;
+	}
+
+	if( Errors ) {
+		cerr << Errors << " check(s) failed" << endl;
+		return 1;
+	}
+	cout << "all checks passed" << endl;
+	return 0;
+} // main
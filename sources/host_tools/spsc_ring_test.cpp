@@ -0,0 +1,385 @@
+/*
+This is the source file of spsc_ring_test, the test and benchmark of the SPSC ring of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool tests SpscRing (SpscRing.h) and measures its throughput. It runs on Linux; see README.md for the build command.
+ *
+ * Usage: spsc_ring_test [-n <items>] [-s <seed>]
+ *
+ * The model test runs random operations of both sides in a single thread and compares the ring with a std::deque.
+ * The stress test passes the items from a producer thread to a consumer thread through rings of several capacities;
+ * each side picks the single, batch or in-place operations at random, and the consumer checks the order and
+ * the content of the items. The benchmark passes the items by each kind of the operations, and by a std::deque
+ * locked by a mutex for comparison. The tool returns 1 when a check failed. */
+#include "SpscRing.h"
+#include "Timestamp.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_ITEMS  2000000
+#define DEFAULT_SEED   1
+#define MAX_BATCH      48   // The batch operations take up to this many items (more than some of the capacities)
+#define BENCH_CAPACITY 1024
+#define BENCH_BATCH    32
+
+// An item with a check of its sequence number, so that a torn or stale slot is detected
+struct Item {
+	uint32_t Sequence;
+	uint32_t Check;
+	uint64_t Payload;
+};
+
+static inline Item MakeItem( uint32_t Sequence )
+{
+	return Item{ Sequence, ~Sequence * 2654435761u, uint64_t( Sequence ) << 20 | 0xABCDE };
+} // MakeItem
+
+static inline bool ItemOk( const Item &I, uint32_t Sequence )
+{
+	const Item Expected = MakeItem( Sequence );
+	return I.Sequence == Expected.Sequence && I.Check == Expected.Check && I.Payload == Expected.Payload;
+} // ItemOk
+
+static void Usage()
+{
+	cerr << "usage: spsc_ring_test [-n <items>] [-s <seed>]" << endl;
+	exit( 2 );
+} // Usage
+
+/* Run Operations random operations of the producer and the consumer of a ring of Capacity items in a single thread
+ * and compare each result with a std::deque. Returns the number of the errors. */
+template<uint32_t Capacity>
+static uint32_t ModelTest( uint32_t Operations, uint32_t Seed )
+{
+	static SpscRing<Item, Capacity, SpscSameCore> Ring;
+	std::deque<Item> Model;
+	std::mt19937     Random( Seed );
+	uint32_t Pushed = 0, Errors = 0;
+	Item     Items[ MAX_BATCH ];
+
+	auto Expect = [&]( bool Ok, const char *What ) {
+		if( !Ok && Errors++ < 10 )
+			cerr << "model test, capacity " << Capacity << ": " << What << " differs from the model" << endl;
+	};
+
+	for( uint32_t o = 0; o < Operations; o++ ) {
+		const uint32_t Free  = Capacity - uint32_t( Model.size() );
+		const uint32_t Count = 1 + Random() % MAX_BATCH;
+		switch( Random() % 7 ) {
+		case 0: { // Push
+			const Item I = MakeItem( Pushed );
+			const bool Ok = Ring.Push( I );
+			Expect( Ok == ( Free > 0 ), "Push()" );
+			if( Ok ) {
+				Model.push_back( I );
+				Pushed++;
+			}
+			break;
+		}
+		case 1: { // Batch push
+			for( uint32_t i = 0; i < Count; i++ )
+				Items[i] = MakeItem( Pushed + i );
+			const uint32_t Done = Ring.Push( Items, Count );
+			Expect( Done == std::min( Count, Free ), "batch Push()" );
+			for( uint32_t i = 0; i < Done; i++ )
+				Model.push_back( Items[i] );
+			Pushed += Done;
+			break;
+		}
+		case 2: { // Reserve and commit a part of the span
+			SpscSpan<Item> Span = Ring.Reserve( Count );
+			const uint32_t Contiguous = Capacity - Pushed % Capacity;
+			Expect( Span.Count == std::min( { Count, Free, Contiguous } ), "Reserve()" );
+			const uint32_t Done = Span.Count ? Random() % ( Span.Count + 1 ) : 0;
+			for( uint32_t i = 0; i < Done; i++ ) {
+				Span.Data[i] = MakeItem( Pushed + i );
+				Model.push_back( Span.Data[i] );
+			}
+			Ring.Commit( Done );
+			Pushed += Done;
+			break;
+		}
+		case 3: { // Pop
+			Item I;
+			const bool Ok = Ring.Pop( I );
+			Expect( Ok == !Model.empty(), "Pop()" );
+			if( Ok ) {
+				Expect( memcmp( &I, &Model.front(), sizeof(Item) ) == 0, "popped item" );
+				Model.pop_front();
+			}
+			break;
+		}
+		case 4: { // Batch pop
+			const uint32_t Done = Ring.Pop( Items, Count );
+			Expect( Done == std::min( Count, uint32_t( Model.size() ) ), "batch Pop()" );
+			for( uint32_t i = 0; i < Done; i++ ) {
+				Expect( memcmp( &Items[i], &Model.front(), sizeof(Item) ) == 0, "batch popped item" );
+				Model.pop_front();
+			}
+			break;
+		}
+		case 5: { // Peek and consume a part of the span
+			SpscSpan<const Item> Span = Ring.Peek( Count );
+			const uint32_t Contiguous = Capacity - ( Pushed - uint32_t( Model.size() ) ) % Capacity;
+			Expect( Span.Count == std::min( { Count, uint32_t( Model.size() ), Contiguous } ), "Peek()" );
+			const uint32_t Done = Span.Count ? Random() % ( Span.Count + 1 ) : 0;
+			for( uint32_t i = 0; i < Done; i++ ) {
+				Expect( memcmp( &Span.Data[i], &Model.front(), sizeof(Item) ) == 0, "peeked item" );
+				Model.pop_front();
+			}
+			Ring.Consume( Done );
+			break;
+		}
+		default: // Clear now and then, else check the count
+			if( Random() % 64 == 0 ) {
+				Ring.Clear();
+				Model.clear();
+			}
+			break;
+		}
+		Expect( Ring.Count() == Model.size(), "Count()" );
+	}
+	return Errors;
+} // ModelTest
+
+/* Pass Items from a producer thread to a consumer thread through a ring of Capacity items with the policy Sync.
+ * Both sides pick the operations at random. Returns the number of the errors. */
+template<uint32_t Capacity, class Sync>
+static uint32_t StressTest( uint32_t Items, uint32_t Seed )
+{
+	static SpscRing<Item, Capacity, Sync> Ring;
+	uint32_t Errors = 0;
+
+	std::thread Producer( [Items, Seed] {
+		std::mt19937 Random( Seed );
+		Item Batch[ MAX_BATCH ];
+		for( uint32_t n = 0; n < Items; ) {
+			const uint32_t Count = std::min( 1 + uint32_t( Random() % MAX_BATCH ), Items - n );
+			uint32_t Done = 0;
+			switch( Random() % 3 ) {
+			case 0:
+				Done = Ring.Push( MakeItem( n ) ) ? 1 : 0;
+				break;
+			case 1:
+				for( uint32_t i = 0; i < Count; i++ )
+					Batch[i] = MakeItem( n + i );
+				Done = Ring.Push( Batch, Count );
+				break;
+			default: {
+				SpscSpan<Item> Span = Ring.Reserve( Count );
+				for( ; Done < Span.Count; Done++ )
+					Span.Data[ Done ] = MakeItem( n + Done );
+				Ring.Commit( Done );
+			}
+			}
+			n += Done;
+			if( Done == 0 )
+				std::this_thread::yield();
+		}
+	} );
+
+	std::mt19937 Random( Seed * 7919 + 1 );
+	Item Batch[ MAX_BATCH ];
+	for( uint32_t n = 0; n < Items; ) {
+		const uint32_t Count = 1 + Random() % MAX_BATCH;
+		uint32_t Done = 0;
+		bool     Ok   = true;
+		switch( Random() % 3 ) {
+		case 0:
+			if( Ring.Pop( Batch[0] ) ) {
+				Ok = ItemOk( Batch[0], n );
+				Done = 1;
+			}
+			break;
+		case 1:
+			Done = Ring.Pop( Batch, Count );
+			for( uint32_t i = 0; i < Done; i++ )
+				Ok = Ok && ItemOk( Batch[i], n + i );
+			break;
+		default: {
+			SpscSpan<const Item> Span = Ring.Peek( Count );
+			for( ; Done < Span.Count; Done++ )
+				Ok = Ok && ItemOk( Span.Data[ Done ], n + Done );
+			Ring.Consume( Done );
+		}
+		}
+		if( !Ok && Errors++ < 10 )
+			cerr << "stress test, capacity " << Capacity << ": wrong item at " << n << endl;
+		n += Done;
+		if( Done == 0 )
+			std::this_thread::yield();
+	}
+	Producer.join();
+	if( Ring.Count() != 0 && Errors++ < 10 )
+		cerr << "stress test, capacity " << Capacity << ": the ring isn't empty at the end" << endl;
+	return Errors;
+} // StressTest
+
+// The ways the benchmark passes the items
+enum class BenchMode { Single, Batch, Span, MutexDeque };
+
+/* Pass Items uint64_t numbers from a producer thread to a consumer thread in the Mode. Returns the items per second,
+ * or 0 when the consumer got a wrong number. */
+static double Benchmark( BenchMode Mode, uint32_t Items )
+{
+	static SpscRing<uint64_t, BENCH_CAPACITY> Ring;
+	std::deque<uint64_t> Queue;
+	std::mutex           QueueLock;
+
+	const Timestamp Start = TimestampNow();
+	std::thread Producer( [&, Mode, Items] {
+		uint64_t Batch[ BENCH_BATCH ];
+		for( uint32_t n = 0; n < Items; ) {
+			const uint32_t Count = std::min( uint32_t( BENCH_BATCH ), Items - n );
+			uint32_t Done = 0;
+			if( Mode == BenchMode::Single )
+				Done = Ring.Push( n ) ? 1 : 0;
+			else if( Mode == BenchMode::Batch ) {
+				for( uint32_t i = 0; i < Count; i++ )
+					Batch[i] = n + i;
+				Done = Ring.Push( Batch, Count );
+			}
+			else if( Mode == BenchMode::Span ) {
+				SpscSpan<uint64_t> Span = Ring.Reserve( Count );
+				for( ; Done < Span.Count; Done++ )
+					Span.Data[ Done ] = n + Done;
+				Ring.Commit( Done );
+			}
+			else {
+				std::lock_guard<std::mutex> Lock( QueueLock );
+				if( Queue.size() < BENCH_CAPACITY ) {
+					Queue.push_back( n );
+					Done = 1;
+				}
+			}
+			n += Done;
+			if( Done == 0 )
+				std::this_thread::yield();
+		}
+	} );
+
+	bool Ok = true;
+	uint64_t Batch[ BENCH_BATCH ];
+	for( uint32_t n = 0; n < Items; ) {
+		uint32_t Done = 0;
+		if( Mode == BenchMode::Single ) {
+			if( Ring.Pop( Batch[0] ) ) {
+				Ok = Ok && Batch[0] == n;
+				Done = 1;
+			}
+		}
+		else if( Mode == BenchMode::Batch ) {
+			Done = Ring.Pop( Batch, BENCH_BATCH );
+			for( uint32_t i = 0; i < Done; i++ )
+				Ok = Ok && Batch[i] == n + i;
+		}
+		else if( Mode == BenchMode::Span ) {
+			SpscSpan<const uint64_t> Span = Ring.Peek( BENCH_BATCH );
+			for( ; Done < Span.Count; Done++ )
+				Ok = Ok && Span.Data[ Done ] == n + Done;
+			Ring.Consume( Done );
+		}
+		else {
+			std::lock_guard<std::mutex> Lock( QueueLock );
+			if( !Queue.empty() ) {
+				Ok = Ok && Queue.front() == n;
+				Queue.pop_front();
+				Done = 1;
+			}
+		}
+		n += Done;
+		if( Done == 0 )
+			std::this_thread::yield();
+	}
+	Producer.join();
+
+	const double Elapsed = TimestampToNs( TimestampNow() - Start ) / 1e9;
+	return Ok && Elapsed > 0 ? Items / Elapsed : 0;
+} // Benchmark
+
+int main( int argc, char *argv[] )
+{
+	uint32_t Items = DEFAULT_ITEMS;
+	uint32_t Seed  = DEFAULT_SEED;
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		uint32_t Value = uint32_t( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-n" ) == 0 )
+			Items = Value;
+		else if( strcmp( argv[a], "-s" ) == 0 )
+			Seed = Value;
+		else
+			Usage();
+	}
+	if( Items == 0 )
+		Usage();
+
+	uint32_t Errors = 0;
+	cout << "model test of " << Items << " operations, seed " << Seed << endl;
+	Errors += ModelTest<2>( Items, Seed );
+	Errors += ModelTest<16>( Items, Seed );
+	Errors += ModelTest<64>( Items, Seed );
+
+	cout << "stress test of " << Items << " items per ring" << endl;
+	Errors += StressTest<2, SpscMultiCore>( Items, Seed );
+	Errors += StressTest<16, SpscMultiCore>( Items, Seed );
+	Errors += StressTest<64, SpscNonCoherent>( Items, Seed );
+	Errors += StressTest<1024, SpscMultiCore>( Items, Seed );
+
+	static const struct { BenchMode Mode; const char *Name; } Modes[] = {
+		{ BenchMode::Single,     "Push()/Pop()" },
+		{ BenchMode::Batch,      "batch Push()/Pop()" },
+		{ BenchMode::Span,       "Reserve()/Peek()" },
+		{ BenchMode::MutexDeque, "std::deque with a mutex" },
+	};
+	cout << "benchmark of " << Items << " items through " << BENCH_CAPACITY << " slots (batches of " << BENCH_BATCH << ")"
+	     << endl << std::fixed << std::setprecision(1);
+	for( const auto &M : Modes ) {
+		const double Rate = Benchmark( M.Mode, Items );
+		if( Rate == 0 && Errors++ < 10 )
+			cerr << M.Name << ": wrong item" << endl;
+		cout << "  " << std::left << std::setw(24) << M.Name << std::right << std::setw(8) << Rate / 1e6 << " M items/s" << endl;
+	}
+
+	if( Errors ) {
+		cerr << Errors << " check(s) failed" << endl;
+		return 1;
+	}
+	cout << "all checks passed" << endl;
+	return 0;
+} // main
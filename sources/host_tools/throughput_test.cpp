@@ -0,0 +1,187 @@
+/*
+This is the source file of throughput_test, the TCP throughput test of the XADC tutorial application on Linux.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool runs the TCP throughput test of the firmware (ThroughputTest.cpp) on Linux, and it provides the sink,
+ * which receives (and discards) the data streamed by the console command tput of the board.
+ * See README.md for the build command.
+ *
+ * Usage: throughput_test [-d <port>] [-t <seconds>] [-w <write size>[,<write size>...]] sink | loopback | <sink IP>
+ *   sink       receive the streams on the port and print the throughput of each of them
+ *   loopback   run the sink in a thread on 127.0.0.1 and stream to it
+ *   <sink IP>  stream to the sink running on another machine
+ * With a list of write sizes, the test is repeated for each size. */
+#include "ThroughputTest.h"
+#include "FileViaSocket.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static void Usage()
+{
+	cerr << "usage: throughput_test [-d <port>] [-t <seconds>] [-w <write size>[,<write size>...]] sink | loopback | <sink IP>" << endl;
+	exit( 2 );
+} // Usage
+
+// Open the socket listening on the Port of the Address. Returns -1 on an error (which is printed).
+static int Listen( uint32_t Address, unsigned short Port )
+{
+	int Socket = socket( AF_INET, SOCK_STREAM, 0 );
+	if( Socket < 0 ) {
+		cerr << "socket failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return -1;
+	}
+	int Enable = 1;
+	setsockopt( Socket, SOL_SOCKET, SO_REUSEADDR, &Enable, sizeof(Enable) );
+
+	struct sockaddr_in Addr = {};
+	Addr.sin_family      = AF_INET;
+	Addr.sin_port        = htons( Port );
+	Addr.sin_addr.s_addr = htonl( Address );
+	if( bind( Socket, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 || listen( Socket, 1 ) < 0 ) {
+		cerr << "bind/listen on the port " << Port << " failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		close( Socket );
+		return -1;
+	}
+	return Socket;
+} // Listen
+
+// Accept a client and receive its data till it closes the connection. Returns false when accept failed.
+static bool ReceiveStream( int ListenSocket )
+{
+	static char Buffer[ 256 * 1024 ];
+
+	int Client = accept( ListenSocket, nullptr, nullptr );
+	if( Client < 0 ) {
+		cerr << "accept failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return false;
+	}
+
+	uint64_t  Bytes = 0;
+	Timestamp Start = 0;
+	ssize_t   n;
+	while( (n = recv( Client, Buffer, sizeof(Buffer), 0 )) > 0 ) {
+		if( Bytes == 0 )
+			Start = TimestampNow(); // Measured from the first data, like the sender
+		Bytes += uint64_t(n);
+	}
+	const double Seconds = Bytes ? TimestampToNs( TimestampNow() - Start ) / 1e9 : 0;
+	close( Client );
+
+	cout << "sink: received " << Bytes << " bytes in " << std::fixed << std::setprecision(2) << Seconds << " s: "
+	     << ( Seconds > 0 ? Bytes * 8 / Seconds / 1e6 : 0.0 ) << " Mbit/s" << endl;
+	return true;
+} // ReceiveStream
+
+int main( int argc, char *argv[] )
+{
+	unsigned short        Port    = THROUGHPUT_TEST_DEFAULT_PORT;
+	unsigned              Seconds = THROUGHPUT_TEST_DEFAULT_SECONDS;
+	std::vector<uint32_t> WriteSizes;
+
+	int a = 1;
+	for( ; a < argc && argv[a][0] == '-'; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		if( strcmp( argv[a], "-d" ) == 0 )
+			Port = (unsigned short)strtoul( argv[a+1], nullptr, 10 );
+		else if( strcmp( argv[a], "-t" ) == 0 )
+			Seconds = unsigned( strtoul( argv[a+1], nullptr, 10 ) );
+		else if( strcmp( argv[a], "-w" ) == 0 ) {
+			std::istringstream List( argv[a+1] );
+			std::string Size;
+			while( std::getline( List, Size, ',' ) )
+				WriteSizes.push_back( uint32_t( strtoul( Size.c_str(), nullptr, 10 ) ) );
+		}
+		else
+			Usage();
+	}
+	if( argc - a != 1 || Seconds == 0 || Seconds > THROUGHPUT_TEST_MAX_SECONDS )
+		Usage();
+	if( WriteSizes.empty() )
+		WriteSizes.push_back( THROUGHPUT_TEST_DEFAULT_WRITE_SIZE );
+	for( uint32_t Size : WriteSizes )
+		if( Size == 0 || Size > THROUGHPUT_TEST_MAX_WRITE_SIZE ) {
+			cerr << "the write size must be from 1 to " << THROUGHPUT_TEST_MAX_WRITE_SIZE << endl;
+			return 2;
+		}
+	const std::string Target( argv[a] );
+
+	if( Target == "sink" ) {
+		int Socket = Listen( INADDR_ANY, Port );
+		if( Socket < 0 )
+			return 1;
+		cout << "sink listens on the port " << Port << endl;
+		while( ReceiveStream( Socket ) )
+			;
+		return 1;
+	}
+
+	const bool Loopback = Target == "loopback";
+	int SinkSocket = -1;
+	if( Loopback && (SinkSocket = Listen( INADDR_LOOPBACK, Port )) < 0 )
+		return 1;
+
+	for( uint32_t Size : WriteSizes ) {
+		std::thread Sink;
+		if( Loopback )
+			Sink = std::thread( ReceiveStream, SinkSocket );
+
+		ThroughputResult Result;
+		try {
+			RunThroughputTest( Loopback ? "127.0.0.1" : Target, Port, Seconds, Size, Result );
+		}
+		catch( const std::exception& e ) {
+			cerr << "Error on opening the socket:\n" << e.what() << endl;
+			if( Loopback ) {
+				shutdown( SinkSocket, SHUT_RDWR ); // Makes accept() of the sink fail
+				Sink.join();
+			}
+			return 1;
+		}
+		if( Loopback )
+			Sink.join(); // The sink prints its result when the connection is closed
+		PrintThroughputResult( cout, Result );
+	}
+
+	if( Loopback )
+		close( SinkSocket );
+	return 0;
+} // main
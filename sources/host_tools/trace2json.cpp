@@ -0,0 +1,272 @@
+/*
+This is the source file of trace2json, the converter of the event trace of the XADC tutorial application to the Chrome trace format.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool converts the event trace sent by the board (the console command trace, see EventTrace.h) to the JSON
+ * trace format of Chrome, which trace viewers like Perfetto (https://ui.perfetto.dev) or chrome://tracing open.
+ * It runs on Linux; see README.md for the build command.
+ *
+ * Usage: trace2json <trace file> [<JSON file>]
+ * Without the JSON file, the result is written to the standard output.
+ *
+ * Each task is a thread of the trace, interrupt handlers share the thread "ISR". The pairs of the events
+ * (capture, send, queue wait, remote command) become spans, the other events are instant events. */
+#include "EventTrace.h"
+#include "CommandProtocol.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static void Usage()
+{
+	cerr << "usage: trace2json <trace file> [<JSON file>]" << endl;
+	exit( 2 );
+} // Usage
+
+static const char *QueueName( uint16_t Queue )
+{
+	switch( TraceQueue( Queue & ~TRACE_QUEUE_TIMEOUT ) ) {
+		case TraceQueue::FilledChunks:  return "wait FilledChunks";
+		case TraceQueue::RemoteReplies: return "wait RemoteReplies";
+		case TraceQueue::SendJobs:      return "wait SendJobs";
+	}
+	return "wait (unknown queue)";
+} // QueueName
+
+static const char *CommandName( uint16_t Command )
+{
+	// The names used by xadc_cmd
+	switch( CommandCode( Command ) ) {
+		case CommandCode::Status:          return "command status";
+		case CommandCode::Trigger:         return "command trigger";
+		case CommandCode::SelectChannel:   return "command channel";
+		case CommandCode::SetSampleCount:  return "command count";
+		case CommandCode::SetAveraging:    return "command avg";
+		case CommandCode::StartContinuous: return "command start";
+		case CommandCode::StopContinuous:  return "command stop";
+	}
+	return "command (unknown)";
+} // CommandName
+
+// Write a JSON string with the characters, which JSON doesn't allow as they are, escaped
+static void WriteString( std::ostream &Out, const std::string &s )
+{
+	Out << '"';
+	for( char c : s ) {
+		if( c == '"' || c == '\\' )
+			Out << '\\' << c;
+		else if( (unsigned char)c < 0x20 ) {
+			char Escaped[8];
+			snprintf( Escaped, sizeof(Escaped), "\\u%04x", c );
+			Out << Escaped;
+		}
+		else
+			Out << c;
+	}
+	Out << '"';
+} // WriteString
+
+/* Writer of the traceEvents array. Spans are written as the phases B and E; an E without its B (which was overwritten
+ * in the ring of the board) is skipped, because the viewers would close an unrelated span with it. */
+class ChromeTraceWriter {
+public:
+	ChromeTraceWriter( std::ostream &Out, uint64_t TicksPerSecond, uint64_t FirstTime )
+		: Out( Out ), TicksPerSecond( TicksPerSecond ), FirstTime( FirstTime ) {}
+
+	void ThreadName( uint32_t Thread, const std::string &Name ) {
+		Begin( "thread_name", "M", Thread );
+		Out << ",\"args\":{\"name\":";
+		WriteString( Out, Name );
+		Out << "}}";
+	}
+	void SpanBegin( const char *Name, uint32_t Thread, uint64_t Time, const std::string &Args ) {
+		Begin( Name, "B", Thread, Time );
+		End( Args );
+		OpenSpans[ Thread ]++;
+	}
+	void SpanEnd( const char *Name, uint32_t Thread, uint64_t Time, const std::string &Args ) {
+		if( OpenSpans[ Thread ] == 0 )
+			return;
+		OpenSpans[ Thread ]--;
+		Begin( Name, "E", Thread, Time );
+		End( Args );
+	}
+	void Instant( const char *Name, uint32_t Thread, uint64_t Time, const std::string &Args ) {
+		Begin( Name, "i", Thread, Time );
+		Out << ",\"s\":\"t\"";
+		End( Args );
+	}
+
+private:
+	void Begin( const char *Name, const char *Phase, uint32_t Thread ) {
+		Out << ( First ? "\n" : ",\n" ) << "{\"name\":";
+		WriteString( Out, Name );
+		Out << ",\"ph\":\"" << Phase << "\",\"pid\":1,\"tid\":" << Thread;
+		First = false;
+	}
+	void Begin( const char *Name, const char *Phase, uint32_t Thread, uint64_t Time ) {
+		Begin( Name, Phase, Thread );
+		// The viewers take microseconds; the fraction keeps the resolution of the timer of the board
+		char Us[32];
+		snprintf( Us, sizeof(Us), "%.3f", double( Time - FirstTime ) * 1e6 / double( TicksPerSecond ) );
+		Out << ",\"ts\":" << Us;
+	}
+	void End( const std::string &Args ) {
+		if( !Args.empty() )
+			Out << ",\"args\":{" << Args << '}';
+		Out << '}';
+	}
+
+	std::ostream &Out;
+	uint64_t TicksPerSecond;
+	uint64_t FirstTime;
+	bool     First = true;
+	std::map<uint32_t, unsigned> OpenSpans; // Number of B without their E of each thread
+}; // ChromeTraceWriter
+
+static std::string Arg( const char *Name, unsigned long Value )
+{
+	return std::string( "\"" ) + Name + "\":" + std::to_string( Value );
+} // Arg
+
+int main( int argc, char *argv[] )
+{
+	if( argc < 2 || argc > 3 )
+		Usage();
+
+	std::ifstream In( argv[1], std::ios::binary );
+	if( !In ) {
+		cerr << "cannot open " << argv[1] << endl;
+		return 1;
+	}
+	std::vector<uint8_t> Data( (std::istreambuf_iterator<char>( In )), std::istreambuf_iterator<char>() );
+
+	const size_t HEADER_SIZE = 16;
+	const size_t TASK_SIZE   = 4 + TRACE_TASK_NAME_SIZE;
+	if( Data.size() < HEADER_SIZE || GetU32( &Data[0] ) != TRACE_DUMP_MAGIC ) {
+		cerr << argv[1] << " is not a trace dump" << endl;
+		return 1;
+	}
+	if( GetU16( &Data[4] ) != TRACE_DUMP_VERSION ) {
+		cerr << argv[1] << " has an unsupported version " << GetU16( &Data[4] ) << endl;
+		return 1;
+	}
+	const uint16_t TaskCount      = GetU16( &Data[6] );
+	const uint32_t EventCount     = GetU32( &Data[8] );
+	const uint32_t TicksPerSecond = GetU32( &Data[12] );
+	if( TicksPerSecond == 0 || Data.size() < HEADER_SIZE + TaskCount * TASK_SIZE + uint64_t(EventCount) * sizeof(TraceRecord) ) {
+		cerr << argv[1] << " is truncated" << endl;
+		return 1;
+	}
+
+	// The threads of the trace are numbered from 1 in the order of the tasks; 0 is the ISR
+	std::map<uint32_t, uint32_t>    Threads;
+	std::vector<std::string>        ThreadNames{ "ISR" };
+	const uint8_t *p = &Data[ HEADER_SIZE ];
+	for( unsigned t = 0; t < TaskCount; t++, p += TASK_SIZE ) {
+		const char *Name = (const char *)p + 4;
+		Threads[ GetU32( p ) ] = uint32_t( ThreadNames.size() );
+		ThreadNames.emplace_back( Name, strnlen( Name, TRACE_TASK_NAME_SIZE ) );
+	}
+
+	std::vector<TraceRecord> Events( EventCount );
+	for( TraceRecord &e : Events ) {
+		e.Time     = GetU32( p ) | uint64_t( GetU32( p + 4 ) ) << 32;
+		e.Task     = GetU32( p + 8 );
+		e.Event    = GetU16( p + 12 );
+		e.Argument = GetU16( p + 14 );
+		p += sizeof(TraceRecord);
+	}
+	// An event interrupted by an ISR between taking its slot and reading the timer can be out of order
+	std::stable_sort( Events.begin(), Events.end(),
+	                  []( const TraceRecord &a, const TraceRecord &b ) { return a.Time < b.Time; } );
+
+	// Tasks, which name wasn't registered (the task table of the board is full), get a number
+	for( const TraceRecord &e : Events )
+		if( e.Task != TRACE_TASK_ISR && Threads.find( e.Task ) == Threads.end() ) {
+			Threads[ e.Task ] = uint32_t( ThreadNames.size() );
+			ThreadNames.push_back( "task " + std::to_string( ThreadNames.size() ) );
+		}
+
+	std::ofstream File;
+	if( argc == 3 ) {
+		File.open( argv[2] );
+		if( !File ) {
+			cerr << "cannot create " << argv[2] << endl;
+			return 1;
+		}
+	}
+	std::ostream &Out = argc == 3 ? File : cout;
+
+	Out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	ChromeTraceWriter Writer( Out, TicksPerSecond, Events.empty() ? 0 : Events.front().Time );
+	for( uint32_t t = 0; t < ThreadNames.size(); t++ )
+		Writer.ThreadName( t, ThreadNames[t] );
+
+	for( const TraceRecord &e : Events ) {
+		const uint32_t Thread = e.Task == TRACE_TASK_ISR ? 0 : Threads[ e.Task ];
+		const uint16_t a = e.Argument;
+		switch( TraceEvent( e.Event ) ) {
+			case TraceEvent::TaskStart:      Writer.Instant( "task start", Thread, e.Time, "" ); break;
+			case TraceEvent::TaskStop:       Writer.Instant( "task stop", Thread, e.Time, "" ); break;
+			case TraceEvent::CaptureBegin:   Writer.SpanBegin( "capture", Thread, e.Time, Arg( "capture", a ) ); break;
+			case TraceEvent::CaptureEnd:     Writer.SpanEnd( "capture", Thread, e.Time, Arg( "sent", a ) ); break;
+			case TraceEvent::DmaStart:       Writer.Instant( "DMA start", Thread, e.Time, Arg( "bytes", a ) ); break;
+			case TraceEvent::DmaDone:        Writer.Instant( "DMA done", Thread, e.Time, Arg( "bytes", a ) ); break;
+			case TraceEvent::DmaChunk:
+				if( a == TRACE_CHUNK_DROPPED )
+					Writer.Instant( "DMA chunk dropped", Thread, e.Time, "" );
+				else
+					Writer.Instant( "DMA chunk", Thread, e.Time, Arg( "block", a ) );
+				break;
+			case TraceEvent::SendBegin:      Writer.SpanBegin( "send", Thread, e.Time, Arg( "bytes", a ) ); break;
+			case TraceEvent::SendEnd:        Writer.SpanEnd( "send", Thread, e.Time, Arg( "sent", a ) ); break;
+			case TraceEvent::QueueWaitBegin: Writer.SpanBegin( QueueName( a ), Thread, e.Time, "" ); break;
+			case TraceEvent::QueueWaitEnd:
+				Writer.SpanEnd( QueueName( a ), Thread, e.Time, Arg( "timeout", ( a & TRACE_QUEUE_TIMEOUT ) ? 1 : 0 ) );
+				break;
+			case TraceEvent::CommandBegin:   Writer.SpanBegin( CommandName( a ), Thread, e.Time, "" ); break;
+			case TraceEvent::CommandEnd:     Writer.SpanEnd( "command", Thread, e.Time, Arg( "result", a ) ); break;
+			case TraceEvent::CaptureDrop:    Writer.Instant( "capture dropped", Thread, e.Time, Arg( "capture", a ) ); break;
+			default:                         Writer.Instant( "unknown event", Thread, e.Time, Arg( "event", e.Event ) );
+		}
+	}
+	Out << "\n]}" << endl;
+
+	cerr << EventCount << " events of " << ThreadNames.size() << " threads converted, "
+	     << ( EventCount > 0 ? double( Events.back().Time - Events.front().Time ) * 1e3 / TicksPerSecond : 0.0 ) << " ms" << endl;
+	return Out ? 0 : 1;
+} // main
@@ -0,0 +1,158 @@
+/*
+This is the source file of via_socket_load, the load test of the receiver of the data sent by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool measures the data rate a receiver (via_socket_server or file_via_socket.py) can absorb. It opens a number
+ * of connections, like that many boards would, and streams sample lines through FileViaSocket (the same send path
+ * as the board uses) for the given time. It runs on Linux; see README.md for the build command.
+ *
+ * Usage: via_socket_load [-p <port>] [-c <connections>] [-t <seconds>] [-w <write size>] <server IP>
+ *
+ * The rate is measured from the start till the last connection is closed. The kernel buffers of the sockets
+ * hold at most a few MB which the receiver may not have written yet, so the test should run for several seconds. */
+#include "FileViaSocket.h"
+#include "Timestamp.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_PORT        65432 // The same as file_via_socket.py and SERVER_PORT in main.cpp
+#define DEFAULT_CONNECTIONS 1
+#define DEFAULT_SECONDS     10
+#define DEFAULT_WRITE_SIZE  65536 // Number of bytes passed to the stream by a single write
+#define MAX_CONNECTIONS     256
+#define MAX_WRITE_SIZE      (1024*1024)
+
+// The result of a single connection
+struct StreamResult {
+	uint64_t    Bytes = 0;
+	Timestamp   End   = 0; // When the connection was closed
+	std::string Error;     // Empty when all the data were sent
+};
+
+static void Usage()
+{
+	cerr << "usage: via_socket_load [-p <port>] [-c <connections>] [-t <seconds>] [-w <write size>] <server IP>" << endl;
+	exit( 2 );
+} // Usage
+
+// Stream the Payload to the server till the End, then close the connection
+static void Stream( const std::string &ServerIP, unsigned short Port, const std::string &Payload, Timestamp End,
+                    StreamResult &Result )
+{
+	try {
+		FileViaSocket f( ServerIP, Port ); // Declare the object and open the network connection
+		while( f && TimestampNow() < End ) {
+			f.write( Payload.data(), Payload.size() );
+			Result.Bytes += Payload.size();
+		}
+		f.flush();
+		if( !f )
+			Result.Error = "the connection broke";
+		f.close();
+	}
+	catch( const std::exception& e ) {
+		Result.Error = e.what();
+	}
+	Result.End = TimestampNow();
+} // Stream
+
+int main( int argc, char *argv[] )
+{
+	unsigned short Port        = DEFAULT_PORT;
+	unsigned       Connections = DEFAULT_CONNECTIONS;
+	unsigned       Seconds     = DEFAULT_SECONDS;
+	unsigned       WriteSize   = DEFAULT_WRITE_SIZE;
+
+	int a = 1;
+	for( ; a < argc && argv[a][0] == '-'; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		unsigned Value = unsigned( strtoul( argv[a+1], nullptr, 10 ) );
+		if( strcmp( argv[a], "-p" ) == 0 )
+			Port = (unsigned short)Value;
+		else if( strcmp( argv[a], "-c" ) == 0 )
+			Connections = Value;
+		else if( strcmp( argv[a], "-t" ) == 0 )
+			Seconds = Value;
+		else if( strcmp( argv[a], "-w" ) == 0 )
+			WriteSize = Value;
+		else
+			Usage();
+	}
+	if( argc - a != 1 || Port == 0 || Connections == 0 || Connections > MAX_CONNECTIONS || Seconds == 0
+	    || WriteSize == 0 || WriteSize > MAX_WRITE_SIZE )
+		Usage();
+	const std::string ServerIP( argv[a] );
+
+	// The payload are the lines of a capture as the board formats them (a voltage with 7 digits per line)
+	std::ostringstream Lines;
+	Lines << std::setprecision(7);
+	for( unsigned i = 0; Lines.tellp() < std::streampos( WriteSize ); i++ )
+		Lines << 0.5f + 0.4f * float( i % 1000 ) / 1000 << '\n';
+	const std::string Payload = Lines.str().substr( 0, WriteSize );
+
+	cout << "streaming to " << ServerIP << ':' << Port << " over " << Connections << " connection(s) for "
+	     << Seconds << " s in writes of " << WriteSize << " bytes" << endl;
+
+	std::vector<StreamResult> Results( Connections );
+	std::vector<std::thread>  Threads;
+	const Timestamp Start = TimestampNow();
+	const Timestamp End   = Start + Timestamp( Seconds ) * TIMESTAMP_TICKS_PER_SECOND;
+	for( unsigned i = 0; i < Connections; i++ )
+		Threads.emplace_back( Stream, std::cref( ServerIP ), Port, std::cref( Payload ), End, std::ref( Results[i] ) );
+
+	uint64_t  TotalBytes = 0;
+	Timestamp LastEnd    = Start;
+	int       Failed     = 0;
+	for( unsigned i = 0; i < Connections; i++ ) {
+		Threads[i].join();
+		const StreamResult &Result = Results[i];
+		TotalBytes += Result.Bytes;
+		if( Result.End > LastEnd )
+			LastEnd = Result.End;
+		if( !Result.Error.empty() ) {
+			cerr << "connection " << i << ": " << Result.Error << endl;
+			Failed++;
+		}
+	}
+
+	const double Elapsed = TimestampToNs( LastEnd - Start ) / 1e9;
+	cout << std::fixed << std::setprecision(2) << TotalBytes << " bytes in " << Elapsed << " s: "
+	     << ( Elapsed > 0 ? TotalBytes / Elapsed / 1e6 : 0.0 ) << " MB/s";
+	if( Connections > 1 )
+		cout << " (" << ( Elapsed > 0 ? TotalBytes / Elapsed / 1e6 / Connections : 0.0 ) << " MB/s per connection)";
+	cout << endl;
+	return Failed ? 1 : 0;
+} // main
@@ -0,0 +1,655 @@
+/*
+This is the source file of via_socket_server, the receiver of the data sent by the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool is a C++ replacement of the Python script file_via_socket.py (https://github.com/viktor-nikolov/lwIP-file-via-socket)
+ * for high data rates and several boards. Like the script, it writes the data of each connection to a new file
+ * named via_socket_YYMMDD_HHMMSS.ffff.txt, byte for byte as received (the text of the samples as well as the binary
+ * event trace). It runs on Linux; see README.md for the build command.
+ *
+ * Usage: via_socket_server [-b <bind IP>] [-p <port>] [-o <folder>] [-r <receive buffer in KiB>] [-a <archive> [-g <tolerance in ms>]]
+ *
+ * A single thread serves all the connections by an epoll event loop. The data are received directly into a large
+ * buffer of each connection, which is written to the file when it's full, when the connection closes, and when
+ * no data came for FLUSH_INTERVAL_SECONDS. So a file is written in a few large writes instead of a write per packet.
+ *
+ * With -a, the captures are parsed as they come and appended to the binary capture archive (see CaptureArchive.h)
+ * instead of being written to the text files. Streams which aren't the text of a capture (e.g., the event trace)
+ * are still written to the files.
+ * With -g, the captures of several boards triggered at the same time (within the tolerance) are joined into one
+ * aligned record of the archive (see CaptureAligner.h).
+ * In the archive mode, the tool prints the captures and the samples each board dropped because the network was behind
+ * (the counters in the header of the capture, see CaptureFormat.h).
+ *
+ * The tool answers the clock exchange of the boards (see ClockSync.h) on the UDP port with the same number as its TCP
+ * port. A capture ending with the timing line (CAPTURE_TIMING in main.cpp, board_sim -T) gets the latency of its stages
+ * computed from the line, the offset of the clocks, and the time its last value was received. The histograms
+ * of the stages of each setting (number of samples and averaging) are printed when the tool terminates. */
+#include "Timestamp.h"
+#include "CaptureArchive.h"
+#include "CaptureAligner.h"
+#include "CaptureFormat.h"
+#include "ClockSync.h"
+#include "LatencyHistogram.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#define DEFAULT_PORT           65432        // The same as file_via_socket.py and SERVER_PORT in main.cpp
+#define FILE_BUFFER_SIZE       (1024*1024)  // Data of a connection collected before they are written to the file
+#define DEFAULT_RCVBUF_KIB     4096         // Receive buffer of the socket requested from the kernel
+#define FLUSH_INTERVAL_SECONDS 1            // Data of an idle connection are written to the file after this time
+#define MAX_EVENTS             64           // Events returned by a single epoll_wait()
+#define MAX_RECEIVES_PER_EVENT 16           // Receives from one connection before others get their turn
+#define MAX_ACCEPTS_PER_EVENT  16           // Connections accepted before the connected clients get their turn
+#define ALIGN_HOLD_SECONDS     5            // A group of the captures of several boards is closed after this time, even if incomplete
+#define TIMING_TAIL_SIZE       512          // The last bytes of a connection kept to find the timing line of the capture
+#define MAX_CLOCK_PROBES_PER_EVENT 16       // Clock probes answered before the connections get their turn
+
+// A connection of a client and the file its data are written to
+struct Connection {
+	int               Socket = -1;
+	int               File   = -1;
+	std::string       FileName;
+	std::string       Peer;         // IP address and port of the client
+	std::vector<char> Buffer;       // Data received and not written to the file yet
+	size_t            Used  = 0;    // Number of bytes in the Buffer
+	uint64_t          Bytes = 0;    // Number of bytes received
+	Timestamp         Start = 0;    // When the connection was accepted
+	Timestamp         LastData = 0; // When the last data were received
+	Timestamp         PreviousData  = 0; // When the data before the last ones were received
+	uint64_t          LastDataStart = 0; // Position of the first byte received at LastData in the stream
+	std::string       Tail;         // The last bytes received (at most TIMING_TAIL_SIZE); the timing line ends a capture
+	struct timespec   Accepted;     // The real time the connection was accepted; it gives the name of the file
+	std::unique_ptr<CaptureTextParser> Parser; // Parser of the capture, when it's appended to the archive
+};
+
+static CaptureArchiveWriter Archive;
+static bool ArchiveMode = false; // The captures are appended to the Archive
+static std::unique_ptr<CaptureAligner> Aligner; // Joins the captures of several boards (-g)
+
+// The counters of the dropped data from the last header of a board
+struct BoardDrops {
+	uint32_t Captures = 0;
+	uint64_t Samples  = 0;
+};
+static std::map<uint32_t, BoardDrops> Drops; // Indexed by the ID of the board
+
+/* Describe the data the board of the capture C dropped since its previous capture, as the cumulative counters
+ * of the headers tell. Returns an empty string when nothing was dropped. */
+static std::string DescribeDrops( const Capture &C )
+{
+	if( !C.HasInfo )
+		return "";
+	BoardDrops &Last = Drops[ C.Info.Board ];
+	if( C.Info.DroppedCaptures < Last.Captures || C.Info.DroppedSamples < Last.Samples )
+		Last = BoardDrops{}; // The board restarted
+	const uint32_t Captures = C.Info.DroppedCaptures - Last.Captures;
+	const uint64_t Samples  = C.Info.DroppedSamples - Last.Samples;
+	Last.Captures = C.Info.DroppedCaptures;
+	Last.Samples  = C.Info.DroppedSamples;
+	if( Captures == 0 && Samples == 0 )
+		return "";
+	return ", the board dropped " + std::to_string( Captures ) + " captures and " + std::to_string( Samples )
+	     + " samples before it";
+} // DescribeDrops
+
+// Stages of a capture measured from its timing line (see CaptureFormat.h)
+enum TimingStage {
+	TriggerToDmaDone,     // The capture itself (incl. the wait for a free buffer)
+	DmaDoneToFirstSend,   // Wait for sender_thread, the connection and the first buffer of text (missing in the large-capture
+	                      // mode, where the sending overlaps the capture)
+	FirstToLastSend,      // Formatting and sending the values
+	LastSendToReceived,   // The network incl. the send buffer of the board (needs the clock offset)
+	TriggerToReceived,    // The whole way (needs the clock offset)
+	TIMING_STAGES
+};
+
+// The latency of the captures of a setting
+struct TimingStats {
+	LatencyHistogram Stages[ TIMING_STAGES ];
+	uint32_t         Captures = 0;
+	uint32_t         Unsynced = 0; // Captures without the clock offset
+	uint32_t         Negative = 0; // Network times below 0 (the error of the offset is larger than the time), counted as 0
+};
+static std::map<std::pair<uint32_t, uint16_t>, TimingStats> Timings; // Indexed by the number of samples and the averaging
+
+// Keep the last TIMING_TAIL_SIZE bytes of the connection
+static void KeepTail( Connection &Conn, const char *Data, size_t Size )
+{
+	if( Size >= TIMING_TAIL_SIZE ) {
+		Conn.Tail.assign( Data + Size - TIMING_TAIL_SIZE, TIMING_TAIL_SIZE );
+		return;
+	}
+	Conn.Tail.append( Data, Size );
+	if( Conn.Tail.size() > TIMING_TAIL_SIZE )
+		Conn.Tail.erase( 0, Conn.Tail.size() - TIMING_TAIL_SIZE );
+} // KeepTail
+
+/* Find the timing line at the end of the data of the connection and record the latency of the stages of the capture.
+ * Returns the description of the latency for the line printed for the connection; an empty string without the timing line. */
+static std::string RecordTiming( const Connection &Conn )
+{
+	size_t Begin = Conn.Tail.rfind( CAPTURE_TIMING_PREFIX " " );
+	if( Begin == std::string::npos || ( Begin > 0 && Conn.Tail[ Begin - 1 ] != '\n' ) )
+		return "";
+	size_t End = Conn.Tail.find( '\n', Begin );
+	CaptureTiming Timing;
+	if( !ParseCaptureTiming( Conn.Tail.substr( Begin, End == std::string::npos ? std::string::npos : End - Begin ), Timing ) )
+		return "";
+
+	/* The timing line was sent after the last value, and after the clock exchange, if one was due. So the values were
+	 * complete when the byte before the line came: by the last receive when it had that byte, or the one before. */
+	const uint64_t LineStart = Conn.Bytes - ( Conn.Tail.size() - Begin );
+	const uint64_t Received  = TimestampToNs( LineStart > Conn.LastDataStart || Conn.PreviousData == 0 ? Conn.LastData : Conn.PreviousData );
+
+	TimingStats &Stats = Timings[ { Timing.Samples, Timing.Averaging } ];
+	Stats.Captures++;
+	if( Timing.DmaDone >= Timing.Trigger )
+		Stats.Stages[ TriggerToDmaDone ].Record( Timing.DmaDone - Timing.Trigger );
+	if( Timing.FirstSend >= Timing.DmaDone )
+		Stats.Stages[ DmaDoneToFirstSend ].Record( Timing.FirstSend - Timing.DmaDone );
+	if( Timing.LastSend >= Timing.FirstSend )
+		Stats.Stages[ FirstToLastSend ].Record( Timing.LastSend - Timing.FirstSend );
+	if( !Timing.Synced ) {
+		Stats.Unsynced++;
+		return ", no clock offset";
+	}
+
+	// The times of the board in the clock of this receiver
+	const int64_t Network = int64_t( Received - ( Timing.LastSend + uint64_t( Timing.ClockOffset ) ) );
+	const int64_t Total   = int64_t( Received - ( Timing.Trigger + uint64_t( Timing.ClockOffset ) ) );
+	if( Network < 0 )
+		Stats.Negative++;
+	Stats.Stages[ LastSendToReceived ].Record( uint64_t( Network > 0 ? Network : 0 ) );
+	Stats.Stages[ TriggerToReceived ].Record( uint64_t( Total > 0 ? Total : 0 ) );
+
+	std::ostringstream Text;
+	Text << std::fixed << std::setprecision(3) << ", latency " << Total / 1e6 << " ms (network " << Network / 1e6 << " ms)";
+	return Text.str();
+} // RecordTiming
+
+// Print the histograms of the stages of the captures of each setting
+static void PrintTimings()
+{
+	const char *StageNames[] = { "trigger-DMA done", "DMA-first send", "first-last send", "last send-received", "trigger-received" };
+	static_assert( sizeof(StageNames) / sizeof(StageNames[0]) == TIMING_STAGES, "a stage has no name" );
+
+	for( const auto &Item : Timings ) {
+		const TimingStats &Stats = Item.second;
+		cout << "latency of " << Stats.Captures << " captures of " << Item.first.first << " samples, averaging " << Item.first.second;
+		if( Stats.Unsynced > 0 )
+			cout << " (" << Stats.Unsynced << " without the clock offset)";
+		if( Stats.Negative > 0 )
+			cout << " (" << Stats.Negative << " network times below 0 counted as 0)";
+		cout << ":\nstage                  count         min         p50         p99         max [us]\n" << std::fixed << std::setprecision(2);
+		for( int s = 0; s < TIMING_STAGES; s++ ) {
+			const LatencyHistogram &h = Stats.Stages[s];
+			cout << std::left << std::setw(19) << StageNames[s] << std::right << std::setw(9) << h.RecordedCount();
+			if( h.RecordedCount() > 0 )
+				cout << std::setw(12) << h.MinTicks() / 1000.0 << std::setw(12) << h.Percentile( 500 ) / 1000.0
+				     << std::setw(12) << h.Percentile( 990 ) / 1000.0 << std::setw(12) << h.MaxTicks() / 1000.0;
+			cout << '\n';
+		}
+	}
+	cout.flush();
+} // PrintTimings
+
+static volatile sig_atomic_t Terminate = 0;
+
+static void SignalHandler( int )
+{
+	Terminate = 1;
+} // SignalHandler
+
+static void Usage()
+{
+	cerr << "usage: via_socket_server [-b <bind IP>] [-p <port>] [-o <folder>] [-r <receive buffer in KiB>] [-a <archive> [-g <tolerance in ms>]]" << endl;
+	exit( 2 );
+} // Usage
+
+/* Create a new file with the name used by file_via_socket.py, i.e., via_socket_YYMMDD_HHMMSS.ffff.txt with the local Time
+ * (ffff are the tenths of milliseconds). When two connections come within the same 100 us, the later one gets the name
+ * of the next 100 us, so no file is overwritten. Returns the file descriptor, or -1 on an error (which is printed). */
+static int CreateFile( const std::string &Folder, struct timespec Now, std::string &FileName )
+{
+	for( int Attempt = 0; Attempt < 1000; Attempt++ ) {
+		struct tm Local;
+		localtime_r( &Now.tv_sec, &Local );
+		char Name[ 64 ];
+		size_t Length = strftime( Name, sizeof(Name), "via_socket_%y%m%d_%H%M%S", &Local );
+		snprintf( Name + Length, sizeof(Name) - Length, ".%04ld.txt", Now.tv_nsec / 100000 );
+
+		FileName = Folder.empty() ? std::string( Name ) : Folder + '/' + Name;
+		int File = open( FileName.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+		if( File >= 0 )
+			return File;
+		if( errno != EEXIST )
+			break;
+
+		Now.tv_nsec += 100000;
+		if( Now.tv_nsec >= 1000000000 ) {
+			Now.tv_nsec -= 1000000000;
+			Now.tv_sec++;
+		}
+	}
+	cerr << "open of the file " << FileName << " failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+	return -1;
+} // CreateFile
+
+// Write the buffered data of the connection to its file. Returns false on an error (which is printed).
+static bool WriteBuffer( Connection &Conn )
+{
+	if( Conn.File < 0 )
+		return true; // The data go to the archive
+	size_t Written = 0;
+	while( Written < Conn.Used ) {
+		ssize_t n = write( Conn.File, Conn.Buffer.data() + Written, Conn.Used - Written );
+		if( n < 0 ) {
+			if( errno == EINTR )
+				continue;
+			cerr << "write to the file " << Conn.FileName << " failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+			return false;
+		}
+		Written += size_t(n);
+	}
+	Conn.Used = 0;
+	return true;
+} // WriteBuffer
+
+// The real time in ns since the Unix epoch, i.e., the clock of CaptureRecordHeader::ReceiveTime
+static uint64_t RealTimeNs()
+{
+	struct timespec Now;
+	clock_gettime( CLOCK_REALTIME, &Now );
+	return uint64_t( Now.tv_sec ) * 1000000000ULL + uint64_t( Now.tv_nsec );
+} // RealTimeNs
+
+// Append the captures (or the aligned groups of captures) to the archive
+static void StoreCaptures( std::vector<Capture> &Ready )
+{
+	for( const Capture &C : Ready ) {
+		if( !Archive.Append( C ) ) {
+			cerr << "a capture was lost" << endl;
+			continue;
+		}
+		if( !C.Aligned )
+			continue;
+		cout << "capture " << Archive.Count() - 1 << " of the archive: aligned capture of " << C.BoardCount << " boards (";
+		uint32_t Board = 0;
+		for( const CaptureSeries &Series : C.Series ) {
+			if( Series.Board == Board )
+				continue;
+			Board = Series.Board;
+			cout << ( &Series == &C.Series.front() ? "" : ", " ) << "board " << Board << " +" << Series.StartOffset / 1000 << " us";
+		}
+		cout << ")" << endl;
+	}
+	Ready.clear();
+} // StoreCaptures
+
+// Write the rest of the data, close the file and the socket, and print the statistics of the connection
+static void CloseConnection( Connection &Conn )
+{
+	WriteBuffer( Conn );
+	if( Conn.File >= 0 )
+		close( Conn.File );
+	close( Conn.Socket );
+
+	std::string Destination = Conn.FileName;
+	if( Conn.Parser ) {
+		Capture &C = Conn.Parser->Finish();
+		size_t Samples = 0;
+		for( const CaptureSeries &Series : C.Series )
+			Samples += Series.Samples.size();
+		const uint32_t InvalidLines = C.InvalidLines;
+		const uint32_t MissingSamples = C.MissingSamples;
+		const std::string DropText = DescribeDrops( C );
+		if( Aligner && C.HasInfo && C.Info.Board != 0 ) {
+			Destination = "capture " + std::to_string( C.Info.Number ) + " of board " + std::to_string( C.Info.Board )
+			            + " (" + std::to_string( Samples ) + " samples";
+			std::vector<Capture> Ready;
+			Aligner->Add( std::move( C ), RealTimeNs(), Ready );
+			StoreCaptures( Ready ); // The aligned records are printed before the line of the connection
+		}
+		else {
+			if( !Archive.Append( C ) )
+				cerr << "the capture from " << Conn.Peer << " was lost" << endl;
+			Destination = "capture " + std::to_string( Archive.Count() - 1 ) + " of the archive (" + std::to_string( Samples ) + " samples";
+		}
+		if( InvalidLines > 0 )
+			Destination += ", " + std::to_string( InvalidLines ) + " invalid lines";
+		if( MissingSamples > 0 )
+			Destination += ", " + std::to_string( MissingSamples ) + " samples dropped";
+		Destination += DropText + ')';
+	}
+	else if( Conn.File < 0 )
+		Destination = "no data";
+	const std::string TimingText = RecordTiming( Conn );
+
+	const double Seconds = TimestampToNs( ( Conn.LastData ? Conn.LastData : TimestampNow() ) - Conn.Start ) / 1e9;
+	cout << Destination << ": " << Conn.Bytes << " bytes from " << Conn.Peer << " in " << std::fixed << std::setprecision(2)
+	     << Seconds << " s (" << ( Seconds > 0 ? Conn.Bytes / Seconds / 1e6 : 0.0 ) << " MB/s)" << TimingText << endl;
+} // CloseConnection
+
+/* Accept the pending connections and register them with the epoll. At most MAX_ACCEPTS_PER_EVENT are accepted, so that
+ * the clients connecting faster than they are served (e.g., many boards sending short captures) don't starve
+ * the established connections. Returns false on a fatal error. */
+static bool AcceptConnections( int ListenSocket, int Epoll, int ReceiveBuffer, const std::string &Folder,
+                               std::map<int, std::unique_ptr<Connection>> &Connections )
+{
+	for( int Accepted = 0; Accepted < MAX_ACCEPTS_PER_EVENT; Accepted++ ) {
+		struct sockaddr_in Addr;
+		socklen_t AddrLength = sizeof(Addr);
+		int Socket = accept4( ListenSocket, (struct sockaddr *)&Addr, &AddrLength, SOCK_NONBLOCK | SOCK_CLOEXEC );
+		if( Socket < 0 ) {
+			if( errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EINTR )
+				return true;
+			cerr << "accept failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+			return errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM; // Not fatal; try later
+		}
+		setsockopt( Socket, SOL_SOCKET, SO_RCVBUF, &ReceiveBuffer, sizeof(ReceiveBuffer) );
+
+		std::unique_ptr<Connection> Conn( new Connection );
+		Conn->Socket = Socket;
+		Conn->Peer   = std::string( inet_ntoa( Addr.sin_addr ) ) + ':' + std::to_string( ntohs( Addr.sin_port ) );
+		Conn->Start  = TimestampNow();
+		clock_gettime( CLOCK_REALTIME, &Conn->Accepted );
+		if( !ArchiveMode ) { // In the archive mode, the first data tell where they go (see ReceiveData())
+			Conn->File = CreateFile( Folder, Conn->Accepted, Conn->FileName );
+			if( Conn->File < 0 ) {
+				close( Socket );
+				continue;
+			}
+		}
+		Conn->Buffer.resize( FILE_BUFFER_SIZE );
+
+		struct epoll_event Event = {};
+		Event.events  = EPOLLIN | EPOLLRDHUP;
+		Event.data.fd = Socket;
+		if( epoll_ctl( Epoll, EPOLL_CTL_ADD, Socket, &Event ) < 0 ) {
+			cerr << "epoll_ctl failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+			if( Conn->File >= 0 ) {
+				close( Conn->File );
+				unlink( Conn->FileName.c_str() );
+			}
+			close( Socket );
+			continue;
+		}
+		if( ArchiveMode )
+			cout << "Connection from " << Conn->Peer << endl;
+		else
+			cout << "Connection from " << Conn->Peer << ", writing to " << Conn->FileName << endl;
+		Connections[ Socket ] = std::move( Conn );
+	}
+	return true; // The level-triggered epoll reports the rest of the pending connections again
+} // AcceptConnections
+
+/* In the archive mode, decide by the first byte received whether the connection is a capture to be parsed into
+ * the archive, or another stream to be written to a file. Returns false on an error. */
+static bool ChooseDestination( Connection &Conn, const std::string &Folder )
+{
+	if( CaptureTextParser::IsCaptureText( Conn.Buffer[0] ) ) {
+		const uint64_t ReceiveTime = uint64_t( Conn.Accepted.tv_sec ) * 1000000000ULL + uint64_t( Conn.Accepted.tv_nsec );
+		Conn.Parser.reset( new CaptureTextParser( ReceiveTime ) );
+		return true;
+	}
+	Conn.File = CreateFile( Folder, Conn.Accepted, Conn.FileName );
+	if( Conn.File < 0 )
+		return false;
+	cout << "Data from " << Conn.Peer << " are not a capture, writing to " << Conn.FileName << endl;
+	return true;
+} // ChooseDestination
+
+/* Receive the data available on the connection into its buffer, writing the buffer to the file when it's full
+ * (or passing the data to the parser in the archive mode).
+ * Returns false when the connection is to be closed (the client closed it, or an error occurred). */
+static bool ReceiveData( Connection &Conn, const std::string &Folder )
+{
+	for( int i = 0; i < MAX_RECEIVES_PER_EVENT; i++ ) {
+		if( Conn.Used == Conn.Buffer.size() && !WriteBuffer( Conn ) )
+			return false;
+
+		ssize_t n = recv( Conn.Socket, Conn.Buffer.data() + Conn.Used, Conn.Buffer.size() - Conn.Used, 0 );
+		if( n > 0 ) {
+			if( ArchiveMode && Conn.Bytes == 0 && !Conn.Parser && !ChooseDestination( Conn, Folder ) )
+				return false;
+			Conn.PreviousData  = Conn.LastData;
+			Conn.LastDataStart = Conn.Bytes;
+			Conn.Bytes   += uint64_t(n);
+			Conn.LastData = TimestampNow();
+			KeepTail( Conn, Conn.Buffer.data() + Conn.Used, size_t(n) );
+			if( Conn.Parser )
+				Conn.Parser->Feed( Conn.Buffer.data(), size_t(n) ); // The buffer is reused for the next data
+			else
+				Conn.Used += size_t(n);
+			continue;
+		}
+		if( n == 0 )
+			return false; // The client closed the connection
+		if( errno == EAGAIN || errno == EWOULDBLOCK )
+			return true;
+		if( errno == EINTR )
+			continue;
+		cerr << "recv from " << Conn.Peer << " failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return false;
+	}
+	return true; // More data may be waiting; the level-triggered epoll reports the connection again
+} // ReceiveData
+
+/* Answer the clock probes waiting on the UDP Socket (see ClockSync.h). The time of the reception is taken right after
+ * the probe was read, i.e., it includes the wake-up of this thread; the error of the offset is smaller than half of it. */
+static void AnswerClockProbes( int Socket )
+{
+	for( int i = 0; i < MAX_CLOCK_PROBES_PER_EVENT; i++ ) {
+		uint8_t Probe[ CLOCK_ECHO_SIZE ]; // Larger than a probe, so that a longer datagram isn't taken for one
+		struct sockaddr_in From;
+		socklen_t FromLength = sizeof(From);
+		ssize_t n = recvfrom( Socket, Probe, sizeof(Probe), 0, (struct sockaddr *)&From, &FromLength );
+		const uint64_t ReceivedNs = TimestampToNs( TimestampNow() );
+		if( n < 0 )
+			return; // EAGAIN, or an error of a previous datagram (e.g., an echo to a board, which wasn't reachable)
+
+		uint8_t Echo[ CLOCK_ECHO_SIZE ];
+		if( EncodeClockEcho( Probe, size_t(n), ReceivedNs, TimestampToNs( TimestampNow() ), Echo ) )
+			sendto( Socket, Echo, sizeof(Echo), 0, (struct sockaddr *)&From, FromLength );
+	}
+} // AnswerClockProbes
+
+int main( int argc, char *argv[] )
+{
+	std::string    BindIP( "0.0.0.0" );
+	unsigned short Port = DEFAULT_PORT;
+	std::string    Folder;
+	std::string    ArchivePath;
+	int            ReceiveBuffer = DEFAULT_RCVBUF_KIB * 1024;
+	double         ToleranceMs = -1; // No alignment
+
+	for( int a = 1; a < argc; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		if( strcmp( argv[a], "-b" ) == 0 )
+			BindIP = argv[a+1];
+		else if( strcmp( argv[a], "-p" ) == 0 )
+			Port = (unsigned short)strtoul( argv[a+1], nullptr, 10 );
+		else if( strcmp( argv[a], "-o" ) == 0 )
+			Folder = argv[a+1];
+		else if( strcmp( argv[a], "-r" ) == 0 )
+			ReceiveBuffer = int( strtoul( argv[a+1], nullptr, 10 ) * 1024 );
+		else if( strcmp( argv[a], "-a" ) == 0 )
+			ArchivePath = argv[a+1];
+		else if( strcmp( argv[a], "-g" ) == 0 )
+			ToleranceMs = strtod( argv[a+1], nullptr );
+		else
+			Usage();
+	}
+	if( Port == 0 || ReceiveBuffer <= 0 || ( ToleranceMs >= 0 && ArchivePath.empty() ) )
+		Usage();
+	if( !ArchivePath.empty() ) {
+		if( !Archive.Open( ArchivePath ) )
+			return 1;
+		ArchiveMode = true;
+		cout << "Appending the captures to the archive " << ArchivePath << " (" << Archive.Count() << " captures)" << endl;
+	}
+	if( ToleranceMs >= 0 ) {
+		Aligner.reset( new CaptureAligner( uint64_t( ToleranceMs * 1e6 ), uint64_t( ALIGN_HOLD_SECONDS ) * 1000000000ULL ) );
+		cout << "Aligning the captures of the boards within " << ToleranceMs << " ms" << endl;
+	}
+
+	struct sigaction Action = {};
+	Action.sa_handler = SignalHandler; // Without SA_RESTART, so that epoll_wait() returns on Ctrl+C
+	sigaction( SIGINT, &Action, nullptr );
+	sigaction( SIGTERM, &Action, nullptr );
+
+	struct sockaddr_in Addr = {};
+	Addr.sin_family = AF_INET;
+	Addr.sin_port   = htons( Port );
+	if( inet_pton( AF_INET, BindIP.c_str(), &Addr.sin_addr ) != 1 ) {
+		cerr << "invalid bind IP address " << BindIP << endl;
+		return 2;
+	}
+
+	int ListenSocket = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+	if( ListenSocket < 0 ) {
+		cerr << "socket failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return 1;
+	}
+	int Enable = 1;
+	setsockopt( ListenSocket, SOL_SOCKET, SO_REUSEADDR, &Enable, sizeof(Enable) );
+	// Accepted sockets inherit the receive buffer; setting it before listen() lets the TCP window scale to it
+	setsockopt( ListenSocket, SOL_SOCKET, SO_RCVBUF, &ReceiveBuffer, sizeof(ReceiveBuffer) );
+	if( bind( ListenSocket, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 || listen( ListenSocket, SOMAXCONN ) < 0 ) {
+		cerr << "bind/listen on " << BindIP << ':' << Port << " failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return 1;
+	}
+
+	// The clock exchange isn't essential; without it, the captures just get no network latency
+	int ClockSocket = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+	if( ClockSocket >= 0 && bind( ClockSocket, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 ) {
+		cerr << "bind of the UDP port " << Port << " failed! errno == " << errno << " (" << strerror( errno ) << "), the clock exchange is disabled" << endl;
+		close( ClockSocket );
+		ClockSocket = -1;
+	}
+
+	int Epoll = epoll_create1( EPOLL_CLOEXEC );
+	struct epoll_event Event = {};
+	Event.events  = EPOLLIN;
+	Event.data.fd = ListenSocket;
+	if( Epoll < 0 || epoll_ctl( Epoll, EPOLL_CTL_ADD, ListenSocket, &Event ) < 0 ) {
+		cerr << "epoll failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return 1;
+	}
+	Event.data.fd = ClockSocket;
+	if( ClockSocket >= 0 && epoll_ctl( Epoll, EPOLL_CTL_ADD, ClockSocket, &Event ) < 0 ) {
+		cerr << "epoll failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return 1;
+	}
+
+	cout << "Waiting for connection on " << BindIP << ':' << Port << "\n(Press Ctrl+C to terminate)" << endl;
+
+	std::map<int, std::unique_ptr<Connection>> Connections; // Indexed by the socket
+	struct epoll_event Events[ MAX_EVENTS ];
+	while( !Terminate ) {
+		int Count = epoll_wait( Epoll, Events, MAX_EVENTS, FLUSH_INTERVAL_SECONDS * 1000 );
+		if( Count < 0 ) {
+			if( errno == EINTR )
+				continue;
+			cerr << "epoll_wait failed! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+			break;
+		}
+
+		for( int i = 0; i < Count; i++ ) {
+			if( Events[i].data.fd == ListenSocket ) {
+				if( !AcceptConnections( ListenSocket, Epoll, ReceiveBuffer, Folder, Connections ) )
+					Terminate = 1;
+				continue;
+			}
+			if( Events[i].data.fd == ClockSocket ) {
+				AnswerClockProbes( ClockSocket );
+				continue;
+			}
+			auto Found = Connections.find( Events[i].data.fd );
+			if( Found == Connections.end() )
+				continue;
+			if( !ReceiveData( *Found->second, Folder ) ) {
+				CloseConnection( *Found->second ); // Closing the socket removes it from the epoll
+				Connections.erase( Found );
+			}
+		}
+
+		// Write the data of the idle connections, so that a file of a slow or stalled client isn't left incomplete on disk
+		const Timestamp Now = TimestampNow();
+		for( auto &Item : Connections ) {
+			Connection &Conn = *Item.second;
+			if( Conn.Used > 0 && Now - Conn.LastData >= Timestamp( FLUSH_INTERVAL_SECONDS ) * TIMESTAMP_TICKS_PER_SECOND )
+				WriteBuffer( Conn );
+		}
+
+		// Store the groups of the captures, which didn't get the captures of all the boards in time
+		if( Aligner ) {
+			std::vector<Capture> Ready;
+			Aligner->Flush( RealTimeNs(), false, Ready );
+			StoreCaptures( Ready );
+		}
+	}
+
+	for( auto &Item : Connections )
+		CloseConnection( *Item.second );
+	if( Aligner ) {
+		std::vector<Capture> Ready;
+		Aligner->Flush( RealTimeNs(), true, Ready );
+		StoreCaptures( Ready );
+		const CaptureAligner::Statistics &Stats = Aligner->GetStatistics();
+		cout << Aligner->BoardCount() << " boards; groups of captures: " << Stats.Complete << " complete, " << Stats.Incomplete
+		     << " incomplete; " << Stats.Unaligned << " captures not aligned; max. spread of a group " << std::fixed
+		     << std::setprecision(3) << Stats.MaxSpread / 1e6 << " ms" << endl;
+	}
+	PrintTimings();
+	close( Epoll );
+	if( ClockSocket >= 0 )
+		close( ClockSocket );
+	close( ListenSocket );
+	return 0;
+} // main
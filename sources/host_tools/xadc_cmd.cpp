@@ -0,0 +1,196 @@
+/*
+This is the source file of xadc_cmd, the command-line client of the command server of the XADC tutorial application.
+Details are explained on GitHub: https://github.com/viktor-nikolov/Zynq-XADC-DMA-lwIP
+
+BSD 2-Clause License:
+
+Copyright (c) 2024 Viktor Nikolov
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/* The tool sends commands to the board (or to the board simulation board_sim) and prints the responses.
+ * It runs on Linux; see README.md for the build command.
+ *
+ * Usage: xadc_cmd [-p <port>] [-n <repeat>] <board IP> <command> [<argument>]
+ *   status               print the status of the board
+ *   trigger              perform a capture (the response comes when the capture was sent to the data server)
+ *   channel <vaux1|vpvn> select the input (single channel mode only)
+ *   count <n>            set the number of samples of a capture
+ *   avg <0|16|64|256>    set the number of samples the XADC averages
+ *   start                start the continuous mode
+ *   stop                 stop the continuous mode
+ * With -n, the command is sent <repeat> times over the same connection, and the statistics of the round-trip time
+ * and of the command-to-DMA-start latency reported by the board are printed. */
+#include "CommandProtocol.h"
+#include "Timestamp.h"
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static void Usage()
+{
+	cerr << "usage: xadc_cmd [-p <port>] [-n <repeat>] <board IP> <command> [<argument>]\n"
+	        "commands: status, trigger, channel <vaux1|vpvn>, count <n>, avg <0|16|64|256>, start, stop" << endl;
+	exit( 2 );
+} // Usage
+
+static const char *ResultName( CommandResult Result )
+{
+	switch( Result ) {
+		case CommandResult::Ok:          return "ok";
+		case CommandResult::BadCommand:  return "bad command";
+		case CommandResult::BadArgument: return "bad argument";
+		case CommandResult::Busy:        return "busy (continuous mode is running)";
+		case CommandResult::Unsupported: return "not supported in this XADC mode";
+		case CommandResult::Failed:      return "failed";
+	}
+	return "unknown result";
+} // ResultName
+
+static void PrintStatus( const CommandResponse &Response )
+{
+	cout << "result:           " << ResultName( Response.Result ) << '\n'
+	     << "state:            " << ( Response.State == BoardState::Continuous ? "continuous" : "idle" ) << '\n'
+	     << "input:            " << ( Response.Channel == 0 ? "VAUX[1]" : Response.Channel == 1 ? "VP/VN" : "given by the XADC mode" ) << '\n'
+	     << "sample count:     " << Response.SampleCount << '\n'
+	     << "averaging:        " << Response.Averaging << '\n'
+	     << "ADCCLK divider:   " << unsigned( Response.AdcClkDivisor ) << '\n'
+	     << "captures:         " << Response.CaptureCount << '\n'
+	     << "dropped captures: " << Response.DroppedCaptures << '\n'
+	     << std::fixed << std::setprecision(1)
+	     << "command-to-DMA-start latency [us]: last " << Response.LastLatencyNs / 1000.0
+	     << ", min " << Response.MinLatencyNs / 1000.0 << ", max " << Response.MaxLatencyNs / 1000.0 << endl;
+} // PrintStatus
+
+// Send the request and receive the response. Returns false when the connection failed.
+static bool Transact( int Socket, const CommandRequest &Request, CommandResponse &Response )
+{
+	uint8_t Buffer[ COMMAND_RESPONSE_SIZE ];
+
+	EncodeRequest( Request, Buffer );
+	if( send( Socket, Buffer, COMMAND_REQUEST_SIZE, 0 ) != COMMAND_REQUEST_SIZE )
+		return false;
+
+	int Received = 0;
+	while( Received < COMMAND_RESPONSE_SIZE ) {
+		ssize_t n = recv( Socket, Buffer + Received, COMMAND_RESPONSE_SIZE - Received, 0 );
+		if( n <= 0 )
+			return false;
+		Received += int(n);
+	}
+	return DecodeResponse( Buffer, Response ) && Response.Sequence == Request.Sequence;
+} // Transact
+
+int main( int argc, char *argv[] )
+{
+	unsigned short Port = COMMAND_SERVER_DEFAULT_PORT;
+	unsigned long Repeat = 1;
+
+	int a = 1;
+	for( ; a < argc && argv[a][0] == '-'; a += 2 ) {
+		if( a + 1 >= argc )
+			Usage();
+		if( strcmp( argv[a], "-p" ) == 0 )
+			Port = (unsigned short)strtoul( argv[a+1], nullptr, 10 );
+		else if( strcmp( argv[a], "-n" ) == 0 )
+			Repeat = strtoul( argv[a+1], nullptr, 10 );
+		else
+			Usage();
+	}
+	if( argc - a < 2 || Repeat == 0 )
+		Usage();
+	const std::string BoardIP( argv[a] );
+	const std::string Name( argv[a+1] );
+	const char *Arg = argc - a > 2 ? argv[a+2] : nullptr;
+
+	CommandRequest Request{ CommandCode::Status, 0, 0 };
+	if( Name == "status" )
+		Request.Command = CommandCode::Status;
+	else if( Name == "trigger" )
+		Request.Command = CommandCode::Trigger;
+	else if( Name == "start" )
+		Request.Command = CommandCode::StartContinuous;
+	else if( Name == "stop" )
+		Request.Command = CommandCode::StopContinuous;
+	else if( Name == "channel" && Arg && ( strcmp( Arg, "vaux1" ) == 0 || strcmp( Arg, "vpvn" ) == 0 ) ) {
+		Request.Command  = CommandCode::SelectChannel;
+		Request.Argument = strcmp( Arg, "vaux1" ) == 0 ? 0 : 1;
+	}
+	else if( ( Name == "count" || Name == "avg" ) && Arg ) {
+		Request.Command  = Name == "count" ? CommandCode::SetSampleCount : CommandCode::SetAveraging;
+		Request.Argument = uint32_t( strtoul( Arg, nullptr, 10 ) );
+	}
+	else
+		Usage();
+
+	int Socket = socket( AF_INET, SOCK_STREAM, 0 );
+	struct sockaddr_in Addr = {};
+	Addr.sin_family = AF_INET;
+	Addr.sin_port   = htons( Port );
+	if( inet_pton( AF_INET, BoardIP.c_str(), &Addr.sin_addr ) != 1 ) {
+		cerr << "Board IP was provided in a wrong format '" << BoardIP << "'!" << endl;
+		return 1;
+	}
+	if( Socket < 0 || connect( Socket, (struct sockaddr *)&Addr, sizeof(Addr) ) < 0 ) {
+		cerr << "Socket connection error! errno == " << errno << " (" << strerror( errno ) << ")" << endl;
+		return 1;
+	}
+	int Enable = 1;
+	setsockopt( Socket, IPPROTO_TCP, TCP_NODELAY, &Enable, sizeof(Enable) );
+
+	CommandResponse Response = {};
+	uint64_t RttMin = UINT64_MAX, RttMax = 0, RttSum = 0;
+	unsigned long Done = 0; // Number of the requests done
+	for( unsigned long i = 0; i < Repeat; i++ ) {
+		Request.Sequence = uint16_t(i);
+		Timestamp Start = TimestampNow();
+		if( !Transact( Socket, Request, Response ) ) {
+			cerr << "the connection to the board failed" << endl;
+			close( Socket );
+			return 1;
+		}
+		uint64_t Rtt = TimestampToNs( TimestampNow() - Start );
+		RttMin = std::min( RttMin, Rtt );
+		RttMax = std::max( RttMax, Rtt );
+		RttSum += Rtt;
+		Done++;
+		if( Response.Result != CommandResult::Ok )
+			break;
+	}
+	close( Socket );
+
+	PrintStatus( Response );
+	if( Repeat > 1 )
+		cout << "round-trip time of " << Done << " requests [us]: min " << RttMin / 1000.0
+		     << ", avg " << RttSum / 1000.0 / Done << ", max " << RttMax / 1000.0 << endl;
+
+	return Response.Result == CommandResult::Ok ? 0 : 1;
+} // main